@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_alloc.c
+//  Description    : This is the implementation of the allocation counter.
+//                   Each __wrap_ function counts the call (when counting is
+//                   on) and passes it to the real one.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <stddef.h>
+
+// Project Includes
+#include <block_alloc.h>
+
+static volatile int counting = 0; // Set while counting
+static uint64_t allocations = 0; // Allocations counted
+
+// The real allocators (bound by the linker)
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_aligned_alloc(size_t align, size_t size);
+int __real_posix_memalign(void** ptr, size_t align, size_t size);
+char* __real_strdup(const char* s);
+
+//
+// Functional Prototypes
+
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t n, size_t size);
+void* __wrap_realloc(void* ptr, size_t size);
+void* __wrap_aligned_alloc(size_t align, size_t size);
+int __wrap_posix_memalign(void** ptr, size_t align, size_t size);
+char* __wrap_strdup(const char* s);
+static inline void count_allocation(void);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : start_block_alloc_count
+// Description  : Zero the count and start counting
+//
+// Inputs       : none
+// Outputs      : none
+
+void start_block_alloc_count(void)
+{
+    __atomic_store_n(&allocations, 0, __ATOMIC_RELAXED);
+    counting = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : stop_block_alloc_count
+// Description  : Stop counting
+//
+// Inputs       : none
+// Outputs      : the allocations counted since the start
+
+uint64_t stop_block_alloc_count(void)
+{
+    counting = 0;
+    return (__atomic_load_n(&allocations, __ATOMIC_RELAXED));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : __wrap_malloc, __wrap_calloc, __wrap_realloc,
+//                __wrap_aligned_alloc, __wrap_posix_memalign, __wrap_strdup
+// Description  : Count an allocation and make it
+//
+// Inputs       : as for the real function
+// Outputs      : as for the real function
+
+void* __wrap_malloc(size_t size)
+{
+    count_allocation();
+    return (__real_malloc(size));
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+    count_allocation();
+    return (__real_calloc(n, size));
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    count_allocation();
+    return (__real_realloc(ptr, size));
+}
+
+void* __wrap_aligned_alloc(size_t align, size_t size)
+{
+    count_allocation();
+    return (__real_aligned_alloc(align, size));
+}
+
+int __wrap_posix_memalign(void** ptr, size_t align, size_t size)
+{
+    count_allocation();
+    return (__real_posix_memalign(ptr, align, size));
+}
+
+char* __wrap_strdup(const char* s)
+{
+    count_allocation();
+    return (__real_strdup(s));
+}
+
+static inline void count_allocation(void)
+{
+    if (counting) {
+        __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    }
+}
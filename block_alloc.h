@@ -0,0 +1,30 @@
+#ifndef BLOCK_ALLOC_INCLUDED
+#define BLOCK_ALLOC_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_alloc.h
+//  Description    : This is the interface for counting heap allocations, to
+//                   check that a stretch of code (a replay) does not make
+//                   any.  The counting wraps malloc, calloc, realloc,
+//                   aligned_alloc, posix_memalign and strdup at link time
+//                   (-Wl,--wrap, see the Makefile), so it sees the calls
+//                   made by the program and the static libraries, not those
+//                   made inside the C library itself.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+//
+// Interface functions
+
+void start_block_alloc_count(void);
+// Zero the count and start counting allocations (on every thread)
+
+uint64_t stop_block_alloc_count(void);
+// Stop counting and return the allocations made since the start
+
+#endif
@@ -0,0 +1,250 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_async.c
+//  Description    : This is the implementation of the asynchronous BLOCK I/O
+//                   engine.  The submission and completion rings are sized
+//                   to the number of requests allowed in flight, so a
+//                   completion always has a slot.  Workers sleep on the
+//                   submission ring and reapers on the completion ring.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <pthread.h>
+#include <stdlib.h>
+
+// Project Includes
+#include <block_async.h>
+#include <block_driver.h>
+#include <cmpsc311_log.h>
+
+// The engine state
+struct BlockAsync {
+    uint32_t entries; // Ring size (requests allowed in flight)
+    BlockAsyncSqe* sq; // Submission ring
+    uint32_t sq_head, sq_count; // Oldest submission and number queued
+    BlockAsyncCqe* cq; // Completion ring
+    uint32_t cq_head, cq_count; // Oldest completion and number queued
+    uint32_t inflight; // Submitted and not yet reaped
+    int stopping; // Set to stop the workers
+    int workers; // Number of worker threads
+    pthread_t* threads; // The worker threads
+    pthread_mutex_t lock; // Protects all of the above
+    pthread_cond_t submitted; // Signalled when a request is queued or stopping
+    pthread_cond_t completed; // Signalled when a completion is queued
+};
+
+//
+// Functional Prototypes
+
+static void* async_worker(void* arg);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : create_block_async
+// Description  : Create the rings and start the worker threads
+//
+// Inputs       : entries - requests allowed in flight (ring size)
+//                workers - worker threads to run them
+// Outputs      : the engine, or NULL on failure
+
+BlockAsync* create_block_async(uint32_t entries, int workers)
+{
+    BlockAsync* as;
+    int i;
+
+    if ((entries == 0) || (workers < 1)) {
+        logMessage(LOG_ERROR_LEVEL, "Bad async engine size (%u entries, %d workers).", entries, workers);
+        return (NULL);
+    }
+    if ((as = calloc(1, sizeof(BlockAsync))) == NULL) {
+        return (NULL);
+    }
+    as->entries = entries;
+    as->sq = malloc(sizeof(BlockAsyncSqe) * entries);
+    as->cq = malloc(sizeof(BlockAsyncCqe) * entries);
+    as->threads = malloc(sizeof(pthread_t) * workers);
+    if ((as->sq == NULL) || (as->cq == NULL) || (as->threads == NULL)) {
+        logMessage(LOG_ERROR_LEVEL, "Failed allocating async engine rings.");
+        free(as->sq);
+        free(as->cq);
+        free(as->threads);
+        free(as);
+        return (NULL);
+    }
+    pthread_mutex_init(&as->lock, NULL);
+    pthread_cond_init(&as->submitted, NULL);
+    pthread_cond_init(&as->completed, NULL);
+
+    // Start the workers
+    for (i = 0; i < workers; i++) {
+        if (pthread_create(&as->threads[i], NULL, async_worker, as) != 0) {
+            logMessage(LOG_ERROR_LEVEL, "Failed starting async worker thread.");
+            break;
+        }
+        as->workers++;
+    }
+    if (as->workers == 0) {
+        free_block_async(as);
+        return (NULL);
+    }
+    return (as);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_async_submit
+// Description  : Queue a request on the submission ring
+//
+// Inputs       : as - the engine
+//                sqe - the request (copied)
+// Outputs      : 0 if queued, -1 if the rings are full
+
+int block_async_submit(BlockAsync* as, const BlockAsyncSqe* sqe)
+{
+    pthread_mutex_lock(&as->lock);
+    if (as->inflight == as->entries) {
+        pthread_mutex_unlock(&as->lock);
+        return (-1);
+    }
+    as->sq[(as->sq_head + as->sq_count++) % as->entries] = *sqe;
+    as->inflight++;
+    pthread_cond_signal(&as->submitted);
+    pthread_mutex_unlock(&as->lock);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_async_reap
+// Description  : Take completions off the completion ring
+//
+// Inputs       : as - the engine
+//                cqes - where to put them
+//                max - most to take
+//                wait - block until there is one (if any are in flight)
+// Outputs      : the number taken
+
+int block_async_reap(BlockAsync* as, BlockAsyncCqe* cqes, int max, int wait)
+{
+    int n = 0;
+
+    pthread_mutex_lock(&as->lock);
+    while (wait && (as->cq_count == 0) && (as->inflight > 0)) {
+        pthread_cond_wait(&as->completed, &as->lock);
+    }
+    while ((n < max) && (as->cq_count > 0)) {
+        cqes[n++] = as->cq[as->cq_head];
+        as->cq_head = (as->cq_head + 1) % as->entries;
+        as->cq_count--;
+        as->inflight--;
+    }
+    pthread_mutex_unlock(&as->lock);
+    return (n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_async_inflight
+// Description  : Count the requests submitted but not yet reaped
+//
+// Inputs       : as - the engine
+// Outputs      : the count
+
+uint32_t block_async_inflight(BlockAsync* as)
+{
+    uint32_t n;
+
+    pthread_mutex_lock(&as->lock);
+    n = as->inflight;
+    pthread_mutex_unlock(&as->lock);
+    return (n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : free_block_async
+// Description  : Stop the workers once the queued requests are run, and
+//                release the engine (unreaped completions are dropped)
+//
+// Inputs       : as - the engine
+// Outputs      : none
+
+void free_block_async(BlockAsync* as)
+{
+    int i;
+
+    if (as == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&as->lock);
+    as->stopping = 1;
+    pthread_cond_broadcast(&as->submitted);
+    pthread_mutex_unlock(&as->lock);
+    for (i = 0; i < as->workers; i++) {
+        pthread_join(as->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&as->lock);
+    pthread_cond_destroy(&as->submitted);
+    pthread_cond_destroy(&as->completed);
+    free(as->sq);
+    free(as->cq);
+    free(as->threads);
+    free(as);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : async_worker
+// Description  : Run requests off the submission ring until stopped
+//
+// Inputs       : arg - the engine
+// Outputs      : NULL
+
+static void* async_worker(void* arg)
+{
+    BlockAsync* as = arg;
+    BlockAsyncSqe sqe;
+    int32_t res;
+
+    pthread_mutex_lock(&as->lock);
+    while (1) {
+        while ((as->sq_count == 0) && !as->stopping) {
+            pthread_cond_wait(&as->submitted, &as->lock);
+        }
+        if (as->sq_count == 0) {
+            break;
+        }
+        sqe = as->sq[as->sq_head];
+        as->sq_head = (as->sq_head + 1) % as->entries;
+        as->sq_count--;
+        pthread_mutex_unlock(&as->lock);
+
+        // Run it without the engine lock (the driver has its own)
+        switch (sqe.op) {
+        case BLOCK_ASYNC_READ:
+            res = block_pread(sqe.fd, sqe.buf, sqe.count, sqe.loc);
+            break;
+        case BLOCK_ASYNC_WRITE:
+            res = block_pwrite(sqe.fd, sqe.buf, sqe.count, sqe.loc);
+            break;
+        case BLOCK_ASYNC_NOP:
+            res = 0;
+            break;
+        default:
+            res = -1;
+            break;
+        }
+
+        // Post the completion (there is always room for one in flight)
+        pthread_mutex_lock(&as->lock);
+        as->cq[(as->cq_head + as->cq_count++) % as->entries] = (BlockAsyncCqe) { res, sqe.user_data };
+        pthread_cond_signal(&as->completed);
+    }
+    pthread_mutex_unlock(&as->lock);
+    return (NULL);
+}
@@ -0,0 +1,67 @@
+#ifndef BLOCK_ASYNC_INCLUDED
+#define BLOCK_ASYNC_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_async.h
+//  Description    : This is the interface for the asynchronous BLOCK I/O
+//                   engine.  Requests go on a submission ring, a small pool
+//                   of worker threads runs them against the driver
+//                   (block_pread / block_pwrite), and the results come back
+//                   on a completion ring, tagged with the caller's user_data.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// Defines
+#define BLOCK_ASYNC_DEFAULT_ENTRIES 256 // Default ring size
+#define BLOCK_ASYNC_DEFAULT_WORKERS 2 // Default worker threads
+
+// The operations
+typedef enum {
+    BLOCK_ASYNC_NOP = 0, // Complete at once with 0
+    BLOCK_ASYNC_READ = 1, // block_pread
+    BLOCK_ASYNC_WRITE = 2, // block_pwrite
+} BlockAsyncOp;
+
+// A submission ring entry
+typedef struct {
+    uint8_t op; // BlockAsyncOp
+    int16_t fd; // File handle
+    int32_t count; // Bytes to read or write
+    uint32_t loc; // Offset in the file
+    void* buf; // Buffer to read into or write from
+    uint64_t user_data; // Returned with the completion
+} BlockAsyncSqe;
+
+// A completion ring entry
+typedef struct {
+    int32_t res; // What the call returned (bytes, or -1)
+    uint64_t user_data; // From the submission
+} BlockAsyncCqe;
+
+// The engine state (opaque)
+typedef struct BlockAsync BlockAsync;
+
+//
+// Interface functions
+
+BlockAsync* create_block_async(uint32_t entries, int workers);
+// Create the rings and start the workers, NULL on failure
+
+int block_async_submit(BlockAsync* as, const BlockAsyncSqe* sqe);
+// Queue a request, -1 if "entries" requests are already in flight
+
+int block_async_reap(BlockAsync* as, BlockAsyncCqe* cqes, int max, int wait);
+// Take up to "max" completions, waiting for one if "wait" and any are in flight
+
+uint32_t block_async_inflight(BlockAsync* as);
+// Requests submitted but not yet reaped
+
+void free_block_async(BlockAsync* as);
+// Stop the workers (after the queued requests) and release the engine
+
+#endif
@@ -0,0 +1,435 @@
+#ifndef BLOCK_ASYNC_HPP_INCLUDED
+#define BLOCK_ASYNC_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_async.hpp
+//  Description    : This is the C++20 coroutine interface to the asynchronous
+//                   BLOCK engine (block_async.h).  A block::task is a lazy
+//                   coroutine, block::async_file gives awaitable read_at and
+//                   write_at, and block::io_context runs the event loop:
+//                   it submits the suspended operations to the engine's
+//                   submission ring and resumes each coroutine when its
+//                   completion is reaped.
+//
+//                   An operation lives in its coroutine frame, and frames
+//                   come from a per-thread pool of size classes, so once the
+//                   pool is warm an I/O allocates nothing.  One thread runs
+//                   an io_context (and its coroutines), and the engine's
+//                   workers do the blocking calls.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+// Project Includes
+#include <block_driver.hpp>
+extern "C" {
+#include <block_async.h>
+}
+
+namespace block {
+
+class io_context;
+
+namespace detail {
+
+    ////////////////////////////////////////////////////////////////////////////
+    //
+    // Class        : frame_pool
+    // Description  : Per-thread free lists of coroutine frames by 64 byte
+    //                size class (frames over 2 KiB use the heap).  Blocks
+    //                freed on another thread join that thread's lists.
+
+    class frame_pool {
+    public:
+        static constexpr std::size_t granule = 64; // Size class step
+        static constexpr std::size_t classes = 32; // Size classes kept
+
+        ~frame_pool()
+        {
+            for (void* head : free_) {
+                while (head != nullptr) {
+                    void* next = *static_cast<void**>(head);
+                    ::operator delete(head);
+                    head = next;
+                }
+            }
+        }
+
+        static void* allocate(std::size_t n)
+        {
+            frame_pool& pool = local();
+            std::size_t c = (n + granule - 1) / granule;
+
+            if ((c < classes) && (pool.free_[c] != nullptr)) {
+                void* block = pool.free_[c];
+                pool.free_[c] = *static_cast<void**>(block);
+                pool.reused_++;
+                return block;
+            }
+            pool.allocated_++;
+            return ::operator new((c < classes) ? c * granule : n);
+        }
+
+        static void deallocate(void* block, std::size_t n) noexcept
+        {
+            frame_pool& pool = local();
+            std::size_t c = (n + granule - 1) / granule;
+
+            if (c < classes) {
+                *static_cast<void**>(block) = pool.free_[c];
+                pool.free_[c] = block;
+            } else {
+                ::operator delete(block);
+            }
+        }
+
+        // This thread's pool
+        static frame_pool& local() noexcept
+        {
+            thread_local frame_pool pool;
+            return pool;
+        }
+
+        uint64_t reused_ = 0; // Frames taken from a free list
+        uint64_t allocated_ = 0; // Frames taken from the heap
+
+    private:
+        void* free_[classes] = {}; // Free list heads, linked through the blocks
+    };
+
+    // What every task promise shares
+    struct promise_base {
+        static void* operator new(std::size_t n) { return frame_pool::allocate(n); }
+        static void operator delete(void* p, std::size_t n) noexcept { frame_pool::deallocate(p, n); }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        // Resume the awaiting coroutine, or retire a spawned task
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+            template <class Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept;
+            void await_resume() noexcept {}
+        };
+        final_awaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+        std::coroutine_handle<> continuation; // Who awaits this task
+        io_context* owner = nullptr; // The context a spawned task reports to
+        std::exception_ptr exception; // Thrown out of the body
+    };
+
+    template <class T>
+    struct promise : promise_base {
+        template <class U>
+        void return_value(U&& v)
+        {
+            value.emplace(std::forward<U>(v));
+        }
+        std::optional<T> value; // What the body returned
+    };
+
+    template <>
+    struct promise<void> : promise_base {
+        void return_void() noexcept {}
+    };
+
+}
+
+// The frames the pool on this thread reused and took from the heap
+struct frame_pool_stats {
+    uint64_t reused; // From a free list
+    uint64_t allocated; // From the heap
+};
+
+inline frame_pool_stats frame_pool_local_stats() noexcept
+{
+    const detail::frame_pool& pool = detail::frame_pool::local();
+    return { pool.reused_, pool.allocated_ };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : task
+// Description  : A lazy coroutine returning T.  It starts when awaited (the
+//                awaiter resumes when it finishes) or when spawned on an
+//                io_context.
+
+template <class T = void>
+class task {
+public:
+    struct promise_type : detail::promise<T> {
+        task get_return_object() noexcept
+        {
+            return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    task() noexcept = default;
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+    task(task&& other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+    task& operator=(task&& other) noexcept
+    {
+        if (this != &other) {
+            if (h_) {
+                h_.destroy();
+            }
+            h_ = std::exchange(other.h_, nullptr);
+        }
+        return *this;
+    }
+    ~task()
+    {
+        if (h_) {
+            h_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return !h_ || h_.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        h_.promise().continuation = awaiter;
+        return h_;
+    }
+    T await_resume()
+    {
+        if (h_.promise().exception) {
+            std::rethrow_exception(h_.promise().exception);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*h_.promise().value);
+        }
+    }
+
+    // Give up the coroutine (for io_context::spawn)
+    std::coroutine_handle<promise_type> release() noexcept { return std::exchange(h_, nullptr); }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> h) noexcept : h_(h) {}
+
+    std::coroutine_handle<promise_type> h_; // The coroutine, null if moved from
+};
+
+namespace detail {
+
+    ////////////////////////////////////////////////////////////////////////////
+    //
+    // Class        : io_op
+    // Description  : The awaiter of one read_at or write_at.  It lives in the
+    //                awaiting coroutine's frame and its address is the
+    //                request's user_data.
+
+    struct io_op {
+        bool await_ready() const noexcept { return pre != errc::ok; }
+        inline bool await_suspend(std::coroutine_handle<> h) noexcept;
+        result<std::size_t> await_resume() const noexcept
+        {
+            if (pre != errc::ok) {
+                return fail(pre);
+            }
+            if (res < 0) {
+                return fail((sqe.op == BLOCK_ASYNC_WRITE) ? errc::write_failed : errc::read_failed);
+            }
+            return static_cast<std::size_t>(res);
+        }
+
+        io_context* ctx = nullptr; // The loop to complete on
+        BlockAsyncSqe sqe = {}; // The request
+        errc pre = errc::ok; // Failed before submission
+        int32_t res = -1; // What the request returned
+        std::coroutine_handle<> handle; // Who to resume
+        io_op* next = nullptr; // Waiting for a ring slot
+    };
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : io_context
+// Description  : The event loop.  run() submits suspended operations,
+//                waiting for ring slots when more are outstanding than the
+//                rings hold, and resumes coroutines as they complete.  It is
+//                not thread safe; run one per thread for more parallelism.
+
+class io_context {
+public:
+    explicit io_context(uint32_t entries = BLOCK_ASYNC_DEFAULT_ENTRIES, int workers = BLOCK_ASYNC_DEFAULT_WORKERS)
+        : engine_(create_block_async(entries, workers))
+    {
+    }
+    io_context(const io_context&) = delete;
+    io_context& operator=(const io_context&) = delete;
+    ~io_context() { free_block_async(engine_); }
+
+    // The engine started (operations fail at once if not)
+    bool valid() const noexcept { return engine_ != nullptr; }
+
+    // Start a task now, it runs to its first operation; run() finishes it
+    void spawn(task<void> t)
+    {
+        auto h = t.release();
+        if (!h) {
+            return;
+        }
+        h.promise().owner = this;
+        live_++;
+        h.resume();
+    }
+
+    // Run until every spawned task has finished, rethrowing the first
+    // exception one of them threw
+    void run()
+    {
+        BlockAsyncCqe cqes[64];
+        detail::io_op* op;
+        int i, n;
+
+        while (live_ > 0) {
+            flush_waiting();
+            if ((engine_ == nullptr) || (block_async_inflight(engine_) == 0)) {
+                break;
+            }
+            n = block_async_reap(engine_, cqes, 64, 1);
+            for (i = 0; i < n; i++) {
+                op = reinterpret_cast<detail::io_op*>(static_cast<uintptr_t>(cqes[i].user_data));
+                op->res = cqes[i].res;
+                op->handle.resume();
+            }
+        }
+        if (error_) {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+    // Tasks spawned and not finished
+    std::size_t live() const noexcept { return live_; }
+
+    // Queue an operation for the engine (from io_op::await_suspend)
+    bool submit(detail::io_op* op) noexcept
+    {
+        if (engine_ == nullptr) {
+            op->res = -1;
+            return false;
+        }
+        if ((waiting_ == nullptr) && (block_async_submit(engine_, &op->sqe) == 0)) {
+            return true;
+        }
+        op->next = nullptr;
+        if (waiting_ == nullptr) {
+            waiting_ = op;
+        } else {
+            waiting_tail_->next = op;
+        }
+        waiting_tail_ = op;
+        return true;
+    }
+
+    // A spawned task finished (from its final suspend)
+    void retire(std::exception_ptr error) noexcept
+    {
+        live_--;
+        if (error && !error_) {
+            error_ = error;
+        }
+    }
+
+private:
+    // Submit the operations waiting for ring slots, oldest first
+    void flush_waiting() noexcept
+    {
+        while ((waiting_ != nullptr) && (block_async_submit(engine_, &waiting_->sqe) == 0)) {
+            waiting_ = waiting_->next;
+        }
+    }
+
+    BlockAsync* engine_; // The rings and workers
+    std::size_t live_ = 0; // Spawned tasks not finished
+    detail::io_op* waiting_ = nullptr; // Operations waiting for a ring slot
+    detail::io_op* waiting_tail_ = nullptr; // The newest of them
+    std::exception_ptr error_; // First exception out of a spawned task
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : async_file
+// Description  : Awaitable positional I/O on an open file (not owned), with
+//                completions delivered through an io_context.  The buffer
+//                must stay valid until the operation completes.
+
+class async_file {
+public:
+    async_file(io_context& ctx, const File& file) noexcept : ctx_(&ctx), fd_(file.native_handle()) {}
+
+    // co_await read_at(buf, off) gives a result<size_t> of the bytes read
+    detail::io_op read_at(std::span<std::byte> buf, uint32_t loc) const noexcept
+    {
+        return make(BLOCK_ASYNC_READ, buf.data(), buf.size(), loc);
+    }
+
+    // co_await write_at(buf, off) gives a result<size_t> of the bytes written
+    detail::io_op write_at(std::span<const std::byte> buf, uint32_t loc) const noexcept
+    {
+        return make(BLOCK_ASYNC_WRITE, const_cast<std::byte*>(buf.data()), buf.size(), loc);
+    }
+
+private:
+    detail::io_op make(BlockAsyncOp op, std::byte* buf, std::size_t size, uint32_t loc) const noexcept
+    {
+        detail::io_op io;
+        io.ctx = ctx_;
+        io.sqe = { static_cast<uint8_t>(op), fd_, static_cast<int32_t>(size), loc, buf, 0 };
+        if (fd_ < 0) {
+            io.pre = errc::bad_handle;
+        } else if (size > static_cast<std::size_t>(INT32_MAX)) {
+            io.pre = errc::bad_argument;
+        }
+        return io;
+    }
+
+    io_context* ctx_; // The loop completions go through
+    int16_t fd_; // The C handle
+};
+
+//
+// Out of line members (they need io_context)
+
+inline bool detail::io_op::await_suspend(std::coroutine_handle<> h) noexcept
+{
+    handle = h;
+    sqe.user_data = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this));
+    return ctx->submit(this);
+}
+
+template <class Promise>
+std::coroutine_handle<> detail::promise_base::final_awaiter::await_suspend(std::coroutine_handle<Promise> h) noexcept
+{
+    promise_base& p = h.promise();
+    if (p.continuation) {
+        return p.continuation;
+    }
+    if (p.owner != nullptr) {
+        io_context* owner = p.owner;
+        std::exception_ptr error = p.exception;
+        h.destroy();
+        owner->retire(error);
+    }
+    return std::noop_coroutine();
+}
+
+} // namespace block
+
+#endif
@@ -0,0 +1,505 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_backend.c
+//  Description    : This is the implementation of the storage backends for
+//                   the BLOCK simulator: the block driver itself, a directory
+//                   of POSIX files and an in-memory map.  The last two give a
+//                   baseline for how much of a replay is driver and device
+//                   cost.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_backend.h>
+#include <block_controller.h>
+#include <block_driver.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define POSIX_DEFAULT_DIR "block_posix" // Directory used by "posix"
+
+// An open file in the POSIX backend
+typedef struct {
+    int fd; // The operating system descriptor (-1 if closed)
+    uint32_t loc; // Current position
+} PosixHandle;
+
+// A file in the memory backend
+typedef struct {
+    char name[BLOCK_MAX_PATH_LENGTH]; // The file name
+    char* data; // The contents
+    uint32_t size; // Size of the file
+    uint32_t alloc; // Allocated size of data
+} MemFile;
+
+// An open file in the memory backend
+typedef struct {
+    MemFile* file; // The file (NULL if closed)
+    uint32_t loc; // Current position
+} MemHandle;
+
+//
+// Functional Prototypes
+
+static int32_t posix_poweron(void);
+static int32_t posix_poweroff(void);
+static int16_t posix_open(char* path);
+static int16_t posix_close(int16_t fd);
+static int32_t posix_read(int16_t fd, void* buf, int32_t count);
+static int32_t posix_write(int16_t fd, void* buf, int32_t count);
+static int32_t posix_seek(int16_t fd, uint32_t loc);
+static int32_t mem_poweron(void);
+static int32_t mem_poweroff(void);
+static int16_t mem_open(char* path);
+static int16_t mem_close(int16_t fd);
+static int32_t mem_read(int16_t fd, void* buf, int32_t count);
+static int32_t mem_write(int16_t fd, void* buf, int32_t count);
+static int32_t mem_seek(int16_t fd, uint32_t loc);
+
+//
+// Global Data
+
+static const BlockBackend driver_backend = {
+    "driver", block_poweron, block_poweroff, block_open, block_close, block_read, block_write, block_seek
+};
+static const BlockBackend posix_backend = {
+    "posix", posix_poweron, posix_poweroff, posix_open, posix_close, posix_read, posix_write, posix_seek
+};
+static const BlockBackend mem_backend = {
+    "mem", mem_poweron, mem_poweroff, mem_open, mem_close, mem_read, mem_write, mem_seek
+};
+const BlockBackend* block_backend = &driver_backend;
+
+static pthread_mutex_t backend_lock = PTHREAD_MUTEX_INITIALIZER; // Protects the open tables
+static char posix_dir[BLOCK_MAX_PATH_LENGTH] = POSIX_DEFAULT_DIR; // Where POSIX files live
+static char* posix_names[BLOCK_MAX_TOTAL_FILES]; // Files created since power on
+static int posix_nnames; // Number of files created
+static PosixHandle posix_handles[BLOCK_MAX_TOTAL_FILES]; // Open POSIX files
+static int posix_nhandles; // Handles used since power on
+static MemFile* mem_files[BLOCK_MAX_TOTAL_FILES]; // The memory files
+static int mem_nfiles; // Number of memory files
+static MemHandle mem_handles[BLOCK_MAX_TOTAL_FILES]; // Open memory files
+static int mem_nhandles; // Handles used since power on
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : find_block_backend
+// Description  : Look up a backend by name
+//
+// Inputs       : spec - "driver", "mem" or "posix[:<dir>]"
+// Outputs      : the backend, or NULL if unknown
+
+const BlockBackend* find_block_backend(const char* spec)
+{
+    if (strcmp(spec, "driver") == 0) {
+        return (&driver_backend);
+    }
+    if (strcmp(spec, "mem") == 0) {
+        return (&mem_backend);
+    }
+    if (strncmp(spec, "posix", 5) == 0) {
+        if (spec[5] == ':') {
+            snprintf(posix_dir, BLOCK_MAX_PATH_LENGTH, "%s", spec + 6);
+        } else if (spec[5] != 0x0) {
+            return (NULL);
+        }
+        return (&posix_backend);
+    }
+    return (NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : select_block_backend
+// Description  : Make a backend the one in use
+//
+// Inputs       : backend - the backend
+// Outputs      : none
+
+void select_block_backend(const BlockBackend* backend)
+{
+    block_backend = backend;
+}
+
+//
+// POSIX directory backend
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : posix_poweron
+// Description  : Make sure the directory exists, start with no files
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int32_t posix_poweron(void)
+{
+    int i;
+
+    if ((mkdir(posix_dir, S_IRWXU) != 0) && (errno != EEXIST)) {
+        logMessage(LOG_ERROR_LEVEL, "Failure creating backend directory [%s], error: %s.",
+            posix_dir, strerror(errno));
+        return (-1);
+    }
+    for (i = 0; i < BLOCK_MAX_TOTAL_FILES; i++) {
+        posix_handles[i].fd = -1;
+    }
+    posix_nhandles = 0;
+    posix_nnames = 0;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : posix_poweroff
+// Description  : Close all of the files
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int32_t posix_poweroff(void)
+{
+    int i;
+
+    for (i = 0; i < posix_nhandles; i++) {
+        posix_close(i);
+    }
+    for (i = 0; i < posix_nnames; i++) {
+        free(posix_names[i]);
+    }
+    posix_nhandles = 0;
+    posix_nnames = 0;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : posix_open
+// Description  : Open a file in the directory, truncating it the first time
+//                it is opened after power on (the device starts zeroed)
+//
+// Inputs       : path - the file name
+// Outputs      : file handle if successful, -1 if failure
+
+static int16_t posix_open(char* path)
+{
+    char fname[BLOCK_MAX_PATH_LENGTH * 2];
+    int i, flags, fd;
+    int16_t ret = -1;
+
+    pthread_mutex_lock(&backend_lock);
+    if (posix_nhandles < BLOCK_MAX_TOTAL_FILES) {
+        flags = O_RDWR | O_CREAT | O_TRUNC;
+        for (i = 0; i < posix_nnames; i++) {
+            if (strcmp(posix_names[i], path) == 0) {
+                flags &= ~O_TRUNC;
+            }
+        }
+        snprintf(fname, sizeof(fname), "%s/%s", posix_dir, path);
+        if ((fd = open(fname, flags, S_IRUSR | S_IWUSR)) != -1) {
+            if ((flags & O_TRUNC) && (posix_nnames < BLOCK_MAX_TOTAL_FILES)) {
+                posix_names[posix_nnames++] = strdup(path);
+            }
+            posix_handles[posix_nhandles].fd = fd;
+            posix_handles[posix_nhandles].loc = 0;
+            ret = posix_nhandles++;
+        } else {
+            logMessage(LOG_ERROR_LEVEL, "Failure opening backend file [%s], error: %s.", fname, strerror(errno));
+        }
+    }
+    pthread_mutex_unlock(&backend_lock);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : posix_close
+// Description  : Close a file
+//
+// Inputs       : fd - the file handle
+// Outputs      : 0 if successful, -1 if failure
+
+static int16_t posix_close(int16_t fd)
+{
+    if ((fd < 0) || (fd >= BLOCK_MAX_TOTAL_FILES) || (posix_handles[fd].fd == -1)) {
+        return (-1);
+    }
+    close(posix_handles[fd].fd);
+    posix_handles[fd].fd = -1;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : posix_read
+// Description  : Read from the current position (short at the end of file)
+//
+// Inputs       : fd - the file handle
+//                buf - the buffer to read into
+//                count - the number of bytes to read
+// Outputs      : bytes read if successful, -1 if failure
+
+static int32_t posix_read(int16_t fd, void* buf, int32_t count)
+{
+    PosixHandle* h;
+    int32_t done = 0;
+    ssize_t ret;
+
+    if ((fd < 0) || (fd >= BLOCK_MAX_TOTAL_FILES) || ((h = &posix_handles[fd])->fd == -1)) {
+        return (-1);
+    }
+    while (done < count) {
+        if ((ret = pread(h->fd, (char*)buf + done, count - done, h->loc + done)) < 0) {
+            return (-1);
+        }
+        if (ret == 0) {
+            break;
+        }
+        done += ret;
+    }
+    h->loc += done;
+    return (done);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : posix_write
+// Description  : Write at the current position
+//
+// Inputs       : fd - the file handle
+//                buf - the buffer to write from
+//                count - the number of bytes to write
+// Outputs      : bytes written if successful, -1 if failure
+
+static int32_t posix_write(int16_t fd, void* buf, int32_t count)
+{
+    PosixHandle* h;
+    int32_t done = 0;
+    ssize_t ret;
+
+    if ((fd < 0) || (fd >= BLOCK_MAX_TOTAL_FILES) || ((h = &posix_handles[fd])->fd == -1)) {
+        return (-1);
+    }
+    while (done < count) {
+        if ((ret = pwrite(h->fd, (char*)buf + done, count - done, h->loc + done)) <= 0) {
+            return (-1);
+        }
+        done += ret;
+    }
+    h->loc += done;
+    return (done);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : posix_seek
+// Description  : Seek to a position, which may not be past the end
+//
+// Inputs       : fd - the file handle
+//                loc - the new position
+// Outputs      : 0 if successful, -1 if failure
+
+static int32_t posix_seek(int16_t fd, uint32_t loc)
+{
+    struct stat st;
+
+    if ((fd < 0) || (fd >= BLOCK_MAX_TOTAL_FILES) || (posix_handles[fd].fd == -1)
+        || (fstat(posix_handles[fd].fd, &st) != 0) || (st.st_size < loc)) {
+        return (-1);
+    }
+    posix_handles[fd].loc = loc;
+    return (0);
+}
+
+//
+// In-memory backend
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mem_poweron
+// Description  : Start with no files
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int32_t mem_poweron(void)
+{
+    memset(mem_handles, 0x0, sizeof(mem_handles));
+    mem_nhandles = 0;
+    mem_nfiles = 0;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mem_poweroff
+// Description  : Close and release all of the files
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int32_t mem_poweroff(void)
+{
+    int i;
+
+    for (i = 0; i < mem_nfiles; i++) {
+        free(mem_files[i]->data);
+        free(mem_files[i]);
+    }
+    memset(mem_handles, 0x0, sizeof(mem_handles));
+    mem_nhandles = 0;
+    mem_nfiles = 0;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mem_open
+// Description  : Open a memory file, creating it if needed
+//
+// Inputs       : path - the file name
+// Outputs      : file handle if successful, -1 if failure
+
+static int16_t mem_open(char* path)
+{
+    MemFile* file = NULL;
+    int16_t ret = -1;
+    int i;
+
+    pthread_mutex_lock(&backend_lock);
+    for (i = 0; (i < mem_nfiles) && (file == NULL); i++) {
+        if (strcmp(mem_files[i]->name, path) == 0) {
+            file = mem_files[i];
+        }
+    }
+    if ((file == NULL) && (mem_nfiles < BLOCK_MAX_TOTAL_FILES) && ((file = calloc(1, sizeof(MemFile))) != NULL)) {
+        snprintf(file->name, BLOCK_MAX_PATH_LENGTH, "%s", path);
+        mem_files[mem_nfiles++] = file;
+    }
+    if ((file != NULL) && (mem_nhandles < BLOCK_MAX_TOTAL_FILES)) {
+        mem_handles[mem_nhandles].file = file;
+        mem_handles[mem_nhandles].loc = 0;
+        ret = mem_nhandles++;
+    }
+    pthread_mutex_unlock(&backend_lock);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mem_close
+// Description  : Close a memory file
+//
+// Inputs       : fd - the file handle
+// Outputs      : 0 if successful, -1 if failure
+
+static int16_t mem_close(int16_t fd)
+{
+    if ((fd < 0) || (fd >= BLOCK_MAX_TOTAL_FILES) || (mem_handles[fd].file == NULL)) {
+        return (-1);
+    }
+    mem_handles[fd].file = NULL;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mem_read
+// Description  : Read from the current position (short at the end of file)
+//
+// Inputs       : fd - the file handle
+//                buf - the buffer to read into
+//                count - the number of bytes to read
+// Outputs      : bytes read if successful, -1 if failure
+
+static int32_t mem_read(int16_t fd, void* buf, int32_t count)
+{
+    MemHandle* h;
+
+    if ((fd < 0) || (fd >= BLOCK_MAX_TOTAL_FILES) || ((h = &mem_handles[fd])->file == NULL) || (count < 0)) {
+        return (-1);
+    }
+    if (h->file->size - h->loc < count) {
+        count = h->file->size - h->loc;
+    }
+    if (count == 0) {
+        return (0);
+    }
+    memcpy(buf, h->file->data + h->loc, count);
+    h->loc += count;
+    return (count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mem_write
+// Description  : Write at the current position, growing the file
+//
+// Inputs       : fd - the file handle
+//                buf - the buffer to write from
+//                count - the number of bytes to write
+// Outputs      : bytes written if successful, -1 if failure
+
+static int32_t mem_write(int16_t fd, void* buf, int32_t count)
+{
+    MemHandle* h;
+    MemFile* f;
+    uint32_t alloc;
+    char* data;
+
+    if ((fd < 0) || (fd >= BLOCK_MAX_TOTAL_FILES) || ((h = &mem_handles[fd])->file == NULL) || (count < 0)) {
+        return (-1);
+    }
+    if (count == 0) {
+        return (0);
+    }
+    f = h->file;
+    if (h->loc + count > f->alloc) {
+        for (alloc = (f->alloc == 0) ? BLOCK_FRAME_SIZE : f->alloc; alloc < h->loc + count; alloc *= 2)
+            ;
+        if ((data = realloc(f->data, alloc)) == NULL) {
+            return (-1);
+        }
+        f->data = data;
+        f->alloc = alloc;
+    }
+    memcpy(f->data + h->loc, buf, count);
+    h->loc += count;
+    if (h->loc > f->size) {
+        f->size = h->loc;
+    }
+    return (count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mem_seek
+// Description  : Seek to a position, which may not be past the end
+//
+// Inputs       : fd - the file handle
+//                loc - the new position
+// Outputs      : 0 if successful, -1 if failure
+
+static int32_t mem_seek(int16_t fd, uint32_t loc)
+{
+    if ((fd < 0) || (fd >= BLOCK_MAX_TOTAL_FILES) || (mem_handles[fd].file == NULL)
+        || (mem_handles[fd].file->size < loc)) {
+        return (-1);
+    }
+    mem_handles[fd].loc = loc;
+    return (0);
+}
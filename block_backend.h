@@ -0,0 +1,46 @@
+#ifndef BLOCK_BACKEND_INCLUDED
+#define BLOCK_BACKEND_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_backend.h
+//  Description    : This is the interface for the storage backends the BLOCK
+//                   simulator can replay a workload against.  Every backend
+//                   has the same calls (and semantics) as block_driver.h.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// Defines
+#define BLOCK_BACKEND_MAX 8 // Maximum backends compared in one run
+
+// The operations table of a backend
+typedef struct {
+    const char* name; // Name used on the command line
+    int32_t (*poweron)(void); // Startup, start with no files
+    int32_t (*poweroff)(void); // Shut down, close all files
+    int16_t (*open)(char* path); // Open (creating) a file, returns a handle
+    int16_t (*close)(int16_t fd); // Close a file
+    int32_t (*read)(int16_t fd, void* buf, int32_t count); // Read at the position
+    int32_t (*write)(int16_t fd, void* buf, int32_t count); // Write at the position
+    int32_t (*seek)(int16_t fd, uint32_t loc); // Seek (not past the end)
+} BlockBackend;
+
+//
+// Global Data
+
+extern const BlockBackend* block_backend; // The backend in use (the driver by default)
+
+//
+// Interface functions
+
+const BlockBackend* find_block_backend(const char* spec);
+// Look up a backend by name, "driver", "mem" or "posix[:<dir>]"
+
+void select_block_backend(const BlockBackend* backend);
+// Make a backend the one in use
+
+#endif
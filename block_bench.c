@@ -0,0 +1,862 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_bench.c
+//  Description    : This is the microbenchmark suite for the BLOCK driver and
+//                   frame cache primitives.  Each benchmark is calibrated to
+//                   run for a minimum time per sample, and the ns/op of every
+//                   sample is written out as JSON so versions can be compared
+//                   (see block_benchcmp).
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_buffer.h>
+#include <block_cache.h>
+#include <block_controller.h>
+#include <block_copy.h>
+#include <block_driver.h>
+#include <block_stats.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define BENCH_ARGUMENTS "hn:t:f:o:"
+#define BENCH_MAX_SAMPLES 100 // Most samples per benchmark
+#define BENCH_MAX_IO (4 * 1024 * 1024) // Largest read or write
+#define BENCH_INDEXES 4096 // Pre-drawn frame numbers for the cache benchmarks
+#define BENCH_MODEL_DEVICE (16 * 1024 * 1024) // Frame model device size
+#define BENCH_MODEL_CACHE (1024 * 1024) // Frame model cache size
+#define BENCH_MODEL_MAX_IO 16384 // Largest frame model read or write
+#define BENCH_HOT_WORDS (128 * 1024) // Words in the scan benchmark's hot table (512 KiB)
+#define BENCH_HOT_TOUCHES 65536 // Hot table lookups after each scan
+#define BENCH_STREAM_THRESHOLD (256 * 1024) // Streaming threshold for scan_hot/stream
+#define USAGE                                                                  \
+    "USAGE: block_bench [-h] [-n <samples>] [-t <ms>] [-f <filter>] [-o <file>]\n" \
+    "\n"                                                                       \
+    "where:\n"                                                                 \
+    "    -h - help mode (display this message)\n"                              \
+    "    -n - samples per benchmark (default 10)\n"                            \
+    "    -t - minimum time per sample in milliseconds (default 20)\n"          \
+    "    -f - only run benchmarks whose name contains <filter>\n"              \
+    "    -o - write the JSON results to <file> (default block_bench.json)\n"   \
+    "\n"
+
+// The state a benchmark runs against
+typedef struct {
+    int16_t fd; // File handle
+    uint32_t off; // Offset of the I/O
+    int32_t len; // Length of the I/O
+    uint32_t size; // Cache size
+    char* name; // File name to open
+    uint16_t* index; // Frame numbers to touch
+    char* buf; // Data buffer
+    void* cache; // A specialized C++ frame cache
+    void* model; // A C++ frame model
+    uint32_t* offs; // Frame model offsets
+    uint32_t* lens; // Frame model lengths (top bit set for writes)
+    char* copy; // Copy kernel destination
+    uint32_t* hot; // The scan benchmark's hot table
+} BenchArg;
+
+// A benchmark body, runs "iters" operations
+typedef void (*BenchFunc)(BenchArg* arg, uint64_t iters);
+
+//
+// Global Data
+
+static int bench_samples = 10; // Samples per benchmark
+static uint64_t bench_min_ns = 20000000; // Minimum time per sample
+static const char* bench_filter = NULL; // Only run matching benchmarks
+static FILE* bench_out; // The JSON results
+static int bench_count = 0; // Benchmarks written so far
+static volatile uint64_t bench_sink; // Keeps results alive
+
+// The helpers in the driver
+extern BlockXferRegister pack(uint32_t ky1, uint32_t fm1, uint32_t cs1, uint32_t rt1);
+extern void unpack(BlockXferRegister reg, uint32_t* ky1, uint32_t* fm1, uint32_t* cs1, uint32_t* rt1);
+extern int compute_frame_checksum(void* frame, uint32_t* cs1);
+
+// The C++ interface bodies (block_bench_cxx.cpp)
+extern void bench_cxx_read(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters);
+extern void bench_cxx_write(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters);
+extern void bench_cxx_read_pmr(int16_t fd, int32_t len, uint64_t iters);
+extern void bench_cxx_pread(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters);
+extern void bench_cxx_pwrite(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters);
+extern void bench_cxx_format(int16_t fd, uint64_t iters);
+extern void bench_cxx_async_pread(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters, int tasks);
+extern void* bench_cxx_cache_create(uint32_t size, char* buf, int fill);
+extern void bench_cxx_cache_get(void* cache, const uint16_t* index, uint32_t count, uint64_t iters);
+extern void bench_cxx_cache_put(void* cache, const uint16_t* index, uint32_t count, uint64_t iters);
+extern void bench_cxx_cache_free(void* cache);
+extern int bench_cxx_copy_frame(uint32_t size, char* dst, const char* src, uint64_t iters);
+extern int bench_cxx_frame_checksum(uint32_t size, const char* buf, uint64_t iters);
+extern void* bench_cxx_model_create(uint32_t size, uint32_t device_bytes, uint32_t cache_bytes);
+extern void bench_cxx_model_run(void* model, const uint32_t* offs, const uint32_t* lens, uint32_t count, char* buf,
+    uint64_t iters);
+extern double bench_cxx_model_bus_ops(void* model);
+extern void bench_cxx_model_free(void* model);
+
+//
+// Functional Prototypes
+
+static void run_bench(const char* name, BenchFunc func, BenchArg* arg, uint64_t bytes);
+static int compare_double(const void* a, const void* b);
+static void bench_cache_get(BenchArg* arg, uint64_t iters);
+static void bench_cache_put(BenchArg* arg, uint64_t iters);
+static void bench_cache_get_cxx(BenchArg* arg, uint64_t iters);
+static void bench_cache_put_cxx(BenchArg* arg, uint64_t iters);
+static void bench_checksum(BenchArg* arg, uint64_t iters);
+static void bench_pack(BenchArg* arg, uint64_t iters);
+static void bench_copy_frame_cxx(BenchArg* arg, uint64_t iters);
+static void bench_frame_checksum_cxx(BenchArg* arg, uint64_t iters);
+static void bench_model_cxx(BenchArg* arg, uint64_t iters);
+static void bench_read(BenchArg* arg, uint64_t iters);
+static void bench_write(BenchArg* arg, uint64_t iters);
+static void bench_pread(BenchArg* arg, uint64_t iters);
+static void bench_pwrite(BenchArg* arg, uint64_t iters);
+static void bench_read_cxx(BenchArg* arg, uint64_t iters);
+static void bench_read_malloc(BenchArg* arg, uint64_t iters);
+static void bench_read_pool(BenchArg* arg, uint64_t iters);
+static void bench_read_pmr_cxx(BenchArg* arg, uint64_t iters);
+static void bench_copy(BenchArg* arg, uint64_t iters);
+static void bench_scan_hot(BenchArg* arg, uint64_t iters);
+static void bench_write_cxx(BenchArg* arg, uint64_t iters);
+static void bench_pread_cxx(BenchArg* arg, uint64_t iters);
+static void bench_pwrite_cxx(BenchArg* arg, uint64_t iters);
+static void bench_format(BenchArg* arg, uint64_t iters);
+static void bench_format_cxx(BenchArg* arg, uint64_t iters);
+static void bench_async_pread_cxx(BenchArg* arg, uint64_t iters);
+static void bench_open(BenchArg* arg, uint64_t iters);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the benchmark suite
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main(int argc, char* argv[])
+{
+    // Local variables
+    static const uint32_t cache_sizes[] = { 16, 256, 1024, 4096 };
+    static const int32_t io_sizes[] = { 1, 64, 512, 4096, 65536, 1048576, BENCH_MAX_IO };
+    static const int open_counts[] = { 16, 128, 1000 };
+    static const uint32_t async_tasks[] = { 1, 64, 4096 };
+    static const uint32_t frame_sizes[] = { 512, 4096, 16384, 65536 };
+    static const int32_t buffer_sizes[] = { 4096, 65536, 1048576 };
+    static const int32_t copy_sizes[] = { 4096, 65536, 1048576, BENCH_MAX_IO };
+    static const char* copy_kernels[] = { "auto", "memcpy", "sse2", "avx2" };
+    char name[128], fname[BLOCK_MAX_PATH_LENGTH], *outname = "block_bench.json";
+    BenchArg arg;
+    int ch, i, j, k, nfiles;
+    uint64_t t, model_bytes;
+
+    // Process the command line parameters
+    while ((ch = getopt(argc, argv, BENCH_ARGUMENTS)) != -1) {
+        switch (ch) {
+        case 'h': // Help, print usage
+            fprintf(stderr, USAGE);
+            return (-1);
+
+        case 'n': // Samples
+            if ((sscanf(optarg, "%d", &bench_samples) != 1) || (bench_samples < 1)
+                || (bench_samples > BENCH_MAX_SAMPLES)) {
+                fprintf(stderr, "Bad sample count [%s], must be 1-%d.\n", optarg, BENCH_MAX_SAMPLES);
+                return (-1);
+            }
+            break;
+
+        case 't': // Time per sample
+            if ((sscanf(optarg, "%" SCNu64, &t) != 1) || (t == 0)) {
+                fprintf(stderr, "Bad sample time [%s].\n", optarg);
+                return (-1);
+            }
+            bench_min_ns = t * 1000000;
+            break;
+
+        case 'f': // Filter
+            bench_filter = optarg;
+            break;
+
+        case 'o': // Output file
+            outname = optarg;
+            break;
+
+        default: // Default (unknown)
+            fprintf(stderr, "Unknown command line option (%c), aborting.\n", ch);
+            return (-1);
+        }
+    }
+    initializeLogWithFilehandle(CMPSC311_LOG_STDERR);
+    if ((bench_out = fopen(outname, "w")) == NULL) {
+        fprintf(stderr, "Failure opening results file [%s], error: %s.\n", outname, strerror(errno));
+        return (-1);
+    }
+    fprintf(bench_out, "{\n  \"suite\": \"block_bench\",\n  \"samples\": %d,\n  \"min_sample_ns\": %" PRIu64 ",\n"
+                       "  \"benchmarks\": [\n",
+        bench_samples, bench_min_ns);
+
+    // Setup the shared state
+    memset(&arg, 0x0, sizeof(arg));
+    arg.index = malloc(sizeof(uint16_t) * BENCH_INDEXES);
+    arg.buf = malloc(BENCH_MAX_IO + BLOCK_FRAME_SIZE);
+    for (i = 0; i < BENCH_MAX_IO + BLOCK_FRAME_SIZE; i++) {
+        arg.buf[i] = (char)(i * 31);
+    }
+
+    // The cache on its own, before the driver owns it, through the C
+    // interface (run time capacity) and specialized to the capacity
+    for (i = 0; i < sizeof(cache_sizes) / sizeof(cache_sizes[0]); i++) {
+        arg.size = cache_sizes[i];
+        set_block_cache_size(arg.size);
+        init_block_cache();
+        for (j = 0; j < arg.size; j++) {
+            put_block_cache(0, j, arg.buf);
+        }
+        arg.cache = bench_cxx_cache_create(arg.size, arg.buf, 1);
+
+        // Hits touch frames in the cache, misses frames that are not
+        for (j = 0; j < BENCH_INDEXES; j++) {
+            arg.index[j] = rand() % arg.size;
+        }
+        snprintf(name, sizeof(name), "cache_get_hit/%u", arg.size);
+        run_bench(name, bench_cache_get, &arg, 0);
+        set_block_front_cache(0);
+        snprintf(name, sizeof(name), "cache_get_hit/shared/%u", arg.size);
+        run_bench(name, bench_cache_get, &arg, 0);
+        set_block_front_cache(1);
+        snprintf(name, sizeof(name), "cxx_cache_get_hit/%u", arg.size);
+        run_bench(name, bench_cache_get_cxx, &arg, 0);
+        snprintf(name, sizeof(name), "cache_put_hit/%u", arg.size);
+        run_bench(name, bench_cache_put, &arg, 0);
+        snprintf(name, sizeof(name), "cxx_cache_put_hit/%u", arg.size);
+        run_bench(name, bench_cache_put_cxx, &arg, 0);
+        for (j = 0; j < BENCH_INDEXES; j++) {
+            arg.index[j] = arg.size + rand() % (BLOCK_BLOCK_SIZE - arg.size);
+        }
+        snprintf(name, sizeof(name), "cache_get_miss/%u", arg.size);
+        run_bench(name, bench_cache_get, &arg, 0);
+        snprintf(name, sizeof(name), "cxx_cache_get_miss/%u", arg.size);
+        run_bench(name, bench_cache_get_cxx, &arg, 0);
+        close_block_cache();
+        bench_cxx_cache_free(arg.cache);
+
+        // A put miss evicts, so cycle through more frames than fit
+        init_block_cache();
+        arg.cache = bench_cxx_cache_create(arg.size, arg.buf, 0);
+        for (j = 0; j < BENCH_INDEXES; j++) {
+            arg.index[j] = j % (arg.size * 2 < BLOCK_BLOCK_SIZE ? arg.size * 2 : BLOCK_BLOCK_SIZE);
+        }
+        snprintf(name, sizeof(name), "cache_put_miss/%u", arg.size);
+        run_bench(name, bench_cache_put, &arg, 0);
+        snprintf(name, sizeof(name), "cxx_cache_put_miss/%u", arg.size);
+        run_bench(name, bench_cache_put_cxx, &arg, 0);
+        close_block_cache();
+        bench_cxx_cache_free(arg.cache);
+    }
+    set_block_cache_size(DEFAULT_BLOCK_FRAME_CACHE_SIZE);
+
+    // Register helpers and the checksum
+    run_bench("compute_frame_checksum", bench_checksum, &arg, BLOCK_FRAME_SIZE);
+    run_bench("pack_unpack", bench_pack, &arg, 0);
+
+    // The streaming copy kernels (auto is the driver's)
+    arg.copy = malloc(BENCH_MAX_IO + 64);
+    for (i = 0; i < sizeof(copy_kernels) / sizeof(copy_kernels[0]); i++) {
+        if (set_block_copy_kernel(i) != 0) {
+            continue;
+        }
+        for (j = 0; j < sizeof(copy_sizes) / sizeof(copy_sizes[0]); j++) {
+            arg.len = copy_sizes[j];
+            snprintf(name, sizeof(name), "copy_stream/%s/%d", copy_kernels[i], arg.len);
+            run_bench(name, bench_copy, &arg, arg.len);
+        }
+    }
+    set_block_copy_kernel(BLOCK_COPY_AUTO);
+    free(arg.copy);
+
+    // The frame kernels and the frame protocol at each frame size, the
+    // model doing the same random reads and writes with the same cache bytes
+    arg.offs = malloc(sizeof(uint32_t) * BENCH_INDEXES);
+    arg.lens = malloc(sizeof(uint32_t) * BENCH_INDEXES);
+    for (j = 0, model_bytes = 0; j < BENCH_INDEXES; j++) {
+        arg.lens[j] = 1 + rand() % BENCH_MODEL_MAX_IO;
+        arg.offs[j] = rand() % (BENCH_MODEL_DEVICE - BENCH_MODEL_MAX_IO);
+        model_bytes += arg.lens[j];
+        arg.lens[j] |= (rand() % 2) ? 0x80000000 : 0;
+    }
+    for (i = 0; i < sizeof(frame_sizes) / sizeof(frame_sizes[0]); i++) {
+        arg.size = frame_sizes[i];
+        snprintf(name, sizeof(name), "copy_frame/%u", arg.size);
+        run_bench(name, bench_copy_frame_cxx, &arg, arg.size);
+        snprintf(name, sizeof(name), "frame_checksum/%u", arg.size);
+        run_bench(name, bench_frame_checksum_cxx, &arg, arg.size);
+        arg.model = bench_cxx_model_create(arg.size, BENCH_MODEL_DEVICE, BENCH_MODEL_CACHE);
+        snprintf(name, sizeof(name), "frame_model/%u", arg.size);
+        run_bench(name, bench_model_cxx, &arg, model_bytes / BENCH_INDEXES);
+        if ((bench_filter == NULL) || (strstr(name, bench_filter) != NULL)) {
+            fprintf(stderr, "%-32s %14.2f bus ops/op\n", name, bench_cxx_model_bus_ops(arg.model));
+        }
+        bench_cxx_model_free(arg.model);
+    }
+    free(arg.offs);
+    free(arg.lens);
+
+    // The driver (it can only be powered on once)
+    if (block_poweron() != 0) {
+        logMessage(LOG_ERROR_LEVEL, "Benchmark failed powering on the driver.");
+        return (-1);
+    }
+
+    // Reads and writes, frame aligned and one byte off
+    arg.fd = block_open("bench_io");
+    if ((arg.fd == -1) || (block_write(arg.fd, arg.buf, BENCH_MAX_IO + BLOCK_FRAME_SIZE) == -1)) {
+        logMessage(LOG_ERROR_LEVEL, "Benchmark failed creating the I/O file.");
+        return (-1);
+    }
+    for (i = 0; i < sizeof(io_sizes) / sizeof(io_sizes[0]); i++) {
+        arg.len = io_sizes[i];
+        for (k = 0; k < 2; k++) {
+            arg.off = k;
+            snprintf(name, sizeof(name), "block_write/%d/%s", arg.len, k ? "unaligned" : "aligned");
+            run_bench(name, bench_write, &arg, arg.len);
+            snprintf(name, sizeof(name), "block_read/%d/%s", arg.len, k ? "unaligned" : "aligned");
+            run_bench(name, bench_read, &arg, arg.len);
+            snprintf(name, sizeof(name), "block_pwrite/%d/%s", arg.len, k ? "unaligned" : "aligned");
+            run_bench(name, bench_pwrite, &arg, arg.len);
+            snprintf(name, sizeof(name), "block_pread/%d/%s", arg.len, k ? "unaligned" : "aligned");
+            run_bench(name, bench_pread, &arg, arg.len);
+
+            // The same I/O through the C++ interface
+            snprintf(name, sizeof(name), "cxx_write/%d/%s", arg.len, k ? "unaligned" : "aligned");
+            run_bench(name, bench_write_cxx, &arg, arg.len);
+            snprintf(name, sizeof(name), "cxx_read/%d/%s", arg.len, k ? "unaligned" : "aligned");
+            run_bench(name, bench_read_cxx, &arg, arg.len);
+            snprintf(name, sizeof(name), "cxx_pwrite/%d/%s", arg.len, k ? "unaligned" : "aligned");
+            run_bench(name, bench_pwrite_cxx, &arg, arg.len);
+            snprintf(name, sizeof(name), "cxx_pread/%d/%s", arg.len, k ? "unaligned" : "aligned");
+            run_bench(name, bench_pread_cxx, &arg, arg.len);
+        }
+    }
+
+    // Reads into a fresh buffer each time, from malloc and from the pool
+    arg.off = 0;
+    for (i = 0; i < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]); i++) {
+        arg.len = buffer_sizes[i];
+        snprintf(name, sizeof(name), "read_buffer/malloc/%d", arg.len);
+        run_bench(name, bench_read_malloc, &arg, arg.len);
+        snprintf(name, sizeof(name), "read_buffer/pool/%d", arg.len);
+        run_bench(name, bench_read_pool, &arg, arg.len);
+        snprintf(name, sizeof(name), "cxx_read_buffer/pmr/%d", arg.len);
+        run_bench(name, bench_read_pmr_cxx, &arg, arg.len);
+    }
+
+    // A large read between bursts of hot table lookups, copied with regular
+    // and with streaming stores (the lookups slow down as the read evicts
+    // the table from the CPU caches)
+    arg.hot = malloc(sizeof(uint32_t) * BENCH_HOT_WORDS);
+    for (j = 0; j < BENCH_HOT_WORDS; j++) {
+        arg.hot[j] = rand();
+    }
+    run_bench("scan_hot/regular", bench_scan_hot, &arg, 0);
+    set_block_copy_threshold(BENCH_STREAM_THRESHOLD);
+    run_bench("scan_hot/stream", bench_scan_hot, &arg, 0);
+    set_block_copy_threshold(BLOCK_COPY_DEFAULT_THRESHOLD);
+    free(arg.hot);
+
+    // Positional reads from many coroutines through the async engine
+    arg.off = 0;
+    arg.len = BLOCK_FRAME_SIZE;
+    for (i = 0; i < sizeof(async_tasks) / sizeof(async_tasks[0]); i++) {
+        arg.size = async_tasks[i];
+        snprintf(name, sizeof(name), "cxx_async_pread/%d/%u", arg.len, arg.size);
+        run_bench(name, bench_async_pread_cxx, &arg, arg.len);
+    }
+
+    // Small formatted writes, one call each against a buffered stream
+    run_bench("format_int/block_write", bench_format, &arg, 0);
+    run_bench("format_int/cxx_ofstream", bench_format_cxx, &arg, 0);
+    block_close(arg.fd);
+
+    // Opening the newest of many files (the lookup is a scan)
+    for (i = 0, nfiles = 1; i < sizeof(open_counts) / sizeof(open_counts[0]); i++) {
+        for (; nfiles < open_counts[i]; nfiles++) {
+            snprintf(fname, sizeof(fname), "bench_open_%04d", nfiles);
+            if ((arg.fd = block_open(fname)) == -1) {
+                logMessage(LOG_ERROR_LEVEL, "Benchmark failed creating file [%s].", fname);
+                return (-1);
+            }
+            block_close(arg.fd);
+        }
+        arg.name = fname;
+        snprintf(name, sizeof(name), "block_open/%d", open_counts[i]);
+        run_bench(name, bench_open, &arg, 0);
+    }
+    block_poweroff();
+
+    // Finish the results
+    fprintf(bench_out, "\n  ]\n}\n");
+    fclose(bench_out);
+    free(arg.index);
+    free(arg.buf);
+    fprintf(stderr, "Wrote %d benchmarks to [%s].\n", bench_count, outname);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : run_bench
+// Description  : Calibrate, run and report one benchmark
+//
+// Inputs       : name - the benchmark name
+//                func - the benchmark body
+//                arg - the state it runs against
+//                bytes - the bytes moved by each operation
+// Outputs      : none
+
+static void run_bench(const char* name, BenchFunc func, BenchArg* arg, uint64_t bytes)
+{
+    // Local variables
+    double ns[BENCH_MAX_SAMPLES], sorted[BENCH_MAX_SAMPLES], median;
+    uint64_t iters = 1, start, elapsed;
+    int s;
+
+    if ((bench_filter != NULL) && (strstr(name, bench_filter) == NULL)) {
+        return;
+    }
+
+    // Grow the iterations until a sample takes long enough
+    while (1) {
+        start = block_clock_ns();
+        func(arg, iters);
+        elapsed = block_clock_ns() - start;
+        if (elapsed >= bench_min_ns) {
+            break;
+        }
+        iters = (elapsed < bench_min_ns / 100) ? iters * 100 : iters * bench_min_ns / elapsed + 1;
+    }
+
+    // Take the samples
+    for (s = 0; s < bench_samples; s++) {
+        start = block_clock_ns();
+        func(arg, iters);
+        ns[s] = (double)(block_clock_ns() - start) / iters;
+    }
+    memcpy(sorted, ns, sizeof(double) * bench_samples);
+    qsort(sorted, bench_samples, sizeof(double), compare_double);
+    median = (bench_samples % 2) ? sorted[bench_samples / 2]
+                                 : (sorted[bench_samples / 2 - 1] + sorted[bench_samples / 2]) / 2;
+
+    // Report it
+    fprintf(stderr, "%-32s %14.1f ns/op %12.2f MB/s\n", name, median, bytes ? bytes / median * 1e3 : 0.0);
+    fprintf(bench_out, "%s    { \"name\": \"%s\", \"iterations\": %" PRIu64 ", \"bytes_per_op\": %" PRIu64 ", "
+                       "\"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, \"bytes_per_s\": %.1f, \"samples\": [",
+        (bench_count++ == 0) ? "" : ",\n", name, iters, bytes, median, sorted[0],
+        bytes ? bytes / median * 1e9 : 0.0);
+    for (s = 0; s < bench_samples; s++) {
+        fprintf(bench_out, "%s%.3f", (s == 0) ? "" : ", ", ns[s]);
+    }
+    fprintf(bench_out, "] }");
+    fflush(bench_out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : compare_double
+// Description  : qsort comparison for doubles
+//
+// Inputs       : a, b - the values to compare
+// Outputs      : <0, 0 or >0
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return ((x < y) ? -1 : (x > y));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cache_get
+// Description  : Look up the pre-drawn frames in the cache
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of lookups
+// Outputs      : none
+
+static void bench_cache_get(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        bench_sink += (uintptr_t)get_block_cache(0, arg->index[i % BENCH_INDEXES]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cache_put
+// Description  : Insert the pre-drawn frames into the cache
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of inserts
+// Outputs      : none
+
+static void bench_cache_put(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        put_block_cache(0, arg->index[i % BENCH_INDEXES], arg->buf);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cache_get_cxx, bench_cache_put_cxx
+// Description  : The cache benchmarks above, on a frame_cache specialized
+//                to the capacity
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of lookups or inserts
+// Outputs      : none
+
+static void bench_cache_get_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_cache_get(arg->cache, arg->index, BENCH_INDEXES, iters);
+}
+
+static void bench_cache_put_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_cache_put(arg->cache, arg->index, BENCH_INDEXES, iters);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_checksum
+// Description  : Checksum a frame
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of checksums
+// Outputs      : none
+
+static void bench_checksum(BenchArg* arg, uint64_t iters)
+{
+    uint32_t cs1;
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        compute_frame_checksum(arg->buf, &cs1);
+        bench_sink += cs1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_pack
+// Description  : Pack and unpack a transfer register
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of round trips
+// Outputs      : none
+
+static void bench_pack(BenchArg* arg, uint64_t iters)
+{
+    uint32_t ky1, fm1, cs1, rt1;
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        unpack(pack(BLOCK_OP_RDFRME, i & 0xffff, (uint32_t)i, 0), &ky1, &fm1, &cs1, &rt1);
+        bench_sink += ky1 + fm1 + cs1 + rt1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_copy_frame_cxx, bench_frame_checksum_cxx,
+//                bench_model_cxx
+// Description  : Copy or checksum a frame of "size" bytes, or run the frame
+//                model's reads and writes
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of frames or operations
+// Outputs      : none
+
+static void bench_copy_frame_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_copy_frame(arg->size, arg->buf + BENCH_MAX_IO / 2, arg->buf, iters);
+}
+
+static void bench_frame_checksum_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_frame_checksum(arg->size, arg->buf, iters);
+}
+
+static void bench_model_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_model_run(arg->model, arg->offs, arg->lens, BENCH_INDEXES, arg->buf, iters);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_read
+// Description  : Seek and read from the I/O file
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of reads
+// Outputs      : none
+
+static void bench_read(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        block_seek(arg->fd, arg->off);
+        block_read(arg->fd, arg->buf, arg->len);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_read_malloc, bench_read_pool, bench_read_pmr_cxx
+// Description  : Read the start of the I/O file into a buffer allocated for
+//                the read (as block_sim does for each READ), from malloc,
+//                the buffer pool or the pool's memory_resource
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of reads
+// Outputs      : none
+
+static void bench_read_malloc(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+    char* buf;
+
+    for (i = 0; i < iters; i++) {
+        buf = malloc(arg->len);
+        block_pread(arg->fd, buf, arg->len, 0);
+        free(buf);
+    }
+}
+
+static void bench_read_pool(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+    char* buf;
+
+    for (i = 0; i < iters; i++) {
+        buf = block_buffer_alloc(arg->len);
+        block_pread(arg->fd, buf, arg->len, 0);
+        block_buffer_free(buf, arg->len);
+    }
+}
+
+static void bench_read_pmr_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_read_pmr(arg->fd, arg->len, iters);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_copy
+// Description  : Copy with the chosen streaming kernel, fenced
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of copies
+// Outputs      : none
+
+static void bench_copy(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        block_copy_stream(arg->copy, arg->buf, arg->len);
+        block_copy_fence();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_scan_hot
+// Description  : Read the whole I/O file, then look up the hot table
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of scans
+// Outputs      : none
+
+static void bench_scan_hot(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+    uint32_t j, k, sum = 0;
+
+    for (i = 0; i < iters; i++) {
+        block_pread(arg->fd, arg->buf, BENCH_MAX_IO, 0);
+        for (j = 0, k = (uint32_t)i; j < BENCH_HOT_TOUCHES; j++) {
+            k = k * 1664525 + 1013904223;
+            sum += arg->hot[k % BENCH_HOT_WORDS];
+        }
+    }
+    arg->hot[0] = sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_write
+// Description  : Seek and write to the I/O file (within its frames)
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of writes
+// Outputs      : none
+
+static void bench_write(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        block_seek(arg->fd, arg->off);
+        block_write(arg->fd, arg->buf, arg->len);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_pread
+// Description  : Positional read from the I/O file
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of reads
+// Outputs      : none
+
+static void bench_pread(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        block_pread(arg->fd, arg->buf, arg->len, arg->off);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_pwrite
+// Description  : Positional write to the I/O file (within its frames)
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of writes
+// Outputs      : none
+
+static void bench_pwrite(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        block_pwrite(arg->fd, arg->buf, arg->len, arg->off);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_read_cxx, bench_write_cxx, bench_pread_cxx,
+//                bench_pwrite_cxx
+// Description  : The I/O benchmarks above, through block::File
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of operations
+// Outputs      : none
+
+static void bench_read_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_read(arg->fd, arg->off, arg->buf, arg->len, iters);
+}
+
+static void bench_write_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_write(arg->fd, arg->off, arg->buf, arg->len, iters);
+}
+
+static void bench_pread_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_pread(arg->fd, arg->off, arg->buf, arg->len, iters);
+}
+
+static void bench_pwrite_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_pwrite(arg->fd, arg->off, arg->buf, arg->len, iters);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_format
+// Description  : Format integers, one per line, with a block_write each
+//                (rewinding every 64K lines to bound the file)
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of lines
+// Outputs      : none
+
+static void bench_format(BenchArg* arg, uint64_t iters)
+{
+    char line[32];
+    uint64_t i;
+    int n;
+
+    block_seek(arg->fd, 0);
+    for (i = 0; i < iters; i++) {
+        n = snprintf(line, sizeof(line), "%" PRIu64 "\n", i);
+        block_write(arg->fd, line, n);
+        if ((i & 0xffff) == 0xffff) {
+            block_seek(arg->fd, 0);
+        }
+    }
+}
+
+static void bench_format_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_format(arg->fd, iters);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_async_pread_cxx
+// Description  : Positional reads of the I/O file from "size" coroutines
+//                sharing one io_context
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of reads
+// Outputs      : none
+
+static void bench_async_pread_cxx(BenchArg* arg, uint64_t iters)
+{
+    bench_cxx_async_pread(arg->fd, arg->off, arg->buf, arg->len, iters, arg->size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_open
+// Description  : Open and close an existing file
+//
+// Inputs       : arg - the benchmark state
+//                iters - the number of opens
+// Outputs      : none
+
+static void bench_open(BenchArg* arg, uint64_t iters)
+{
+    uint64_t i;
+
+    for (i = 0; i < iters; i++) {
+        block_close(block_open(arg->name));
+    }
+}
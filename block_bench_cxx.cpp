@@ -0,0 +1,463 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_bench_cxx.cpp
+//  Description    : These are the block_bench bodies for the C++ interface
+//                   (block_driver.hpp, block_stream.hpp, block_async.hpp,
+//                   block_cache.hpp, block_geometry.hpp and block_buffer.hpp).  Most do the
+//                   same work as a C benchmark in block_bench.c, so the cxx_
+//                   and C rows show what the wrappers cost, or what
+//                   specializing saves.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Project Includes
+#include <block_async.hpp>
+#include <block_buffer.hpp>
+#include <block_cache.hpp>
+#include <block_driver.hpp>
+#include <block_geometry.hpp>
+#include <block_stream.hpp>
+extern "C" {
+#include <block_controller.h>
+}
+
+extern "C" {
+void bench_cxx_read(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters);
+void bench_cxx_write(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters);
+void bench_cxx_read_pmr(int16_t fd, int32_t len, uint64_t iters);
+void bench_cxx_pread(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters);
+void bench_cxx_pwrite(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters);
+void bench_cxx_format(int16_t fd, uint64_t iters);
+void bench_cxx_async_pread(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters, int tasks);
+void* bench_cxx_cache_create(uint32_t size, char* buf, int fill);
+void bench_cxx_cache_get(void* cache, const uint16_t* index, uint32_t count, uint64_t iters);
+void bench_cxx_cache_put(void* cache, const uint16_t* index, uint32_t count, uint64_t iters);
+void bench_cxx_cache_free(void* cache);
+int bench_cxx_copy_frame(uint32_t size, char* dst, const char* src, uint64_t iters);
+int bench_cxx_frame_checksum(uint32_t size, const char* buf, uint64_t iters);
+void* bench_cxx_model_create(uint32_t size, uint32_t device_bytes, uint32_t cache_bytes);
+void bench_cxx_model_run(void* model, const uint32_t* offs, const uint32_t* lens, uint32_t count, char* buf,
+    uint64_t iters);
+double bench_cxx_model_bus_ops(void* model);
+void bench_cxx_model_free(void* model);
+}
+
+// Call f with the frame size as a constant (512 B, 4, 16 or 64 KiB)
+template <class F>
+static bool with_frame_size(uint32_t size, F&& f)
+{
+    switch (size) {
+    case 512:
+        f(std::integral_constant<std::size_t, 512> {});
+        return true;
+    case 4096:
+        f(std::integral_constant<std::size_t, 4096> {});
+        return true;
+    case 16384:
+        f(std::integral_constant<std::size_t, 16384> {});
+        return true;
+    case 65536:
+        f(std::integral_constant<std::size_t, 65536> {});
+        return true;
+    }
+    return false;
+}
+
+// A frame model of one geometry, behind one virtual call per run
+struct BenchModel {
+    virtual ~BenchModel() = default;
+    virtual void run(const uint32_t* offs, const uint32_t* lens, uint32_t count, char* buf, uint64_t iters) = 0;
+    virtual uint64_t bus_ops() const = 0;
+    uint64_t ops = 0; // Reads and writes run
+};
+
+template <std::size_t FrameSize>
+struct BenchModelN : BenchModel {
+    using Geometry = block::geometry<FrameSize, BLOCK_BLOCK_SIZE, BLOCK_MAX_FRAME_PER_FILE>;
+    BenchModelN(std::size_t frames, std::size_t cache_frames) : model(frames, cache_frames) {}
+    void run(const uint32_t* offs, const uint32_t* lens, uint32_t count, char* buf, uint64_t iters) override
+    {
+        for (uint64_t i = 0; i < iters; i++) {
+            uint32_t len = lens[i % count];
+            if (len & 0x80000000) {
+                model.write(buf, offs[i % count], len & 0x7fffffff);
+            } else {
+                model.read(buf, offs[i % count], len);
+            }
+        }
+        ops += iters;
+    }
+    uint64_t bus_ops() const override { return model.bus_ops(); }
+    block::frame_model<Geometry> model;
+};
+
+// A frame cache specialized to one capacity, behind one virtual call per run
+struct BenchCache {
+    virtual ~BenchCache() = default;
+    virtual void get(const uint16_t* index, uint32_t count, uint64_t iters) = 0;
+    virtual void put(const uint16_t* index, uint32_t count, uint64_t iters) = 0;
+    char* buf; // Frame data to put
+};
+
+template <std::size_t N>
+struct BenchCacheN : BenchCache {
+    void get(const uint16_t* index, uint32_t count, uint64_t iters) override
+    {
+        for (uint64_t i = 0; i < iters; i++) {
+            bench_cxx_sink = bench_cxx_sink + reinterpret_cast<uintptr_t>(cache.get(index[i % count]));
+        }
+    }
+    void put(const uint16_t* index, uint32_t count, uint64_t iters) override
+    {
+        for (uint64_t i = 0; i < iters; i++) {
+            cache.put(index[i % count], buf);
+        }
+    }
+    block::frame_cache<uint32_t, BLOCK_FRAME_SIZE, block::lru_on_put, N> cache;
+    static inline volatile uint64_t bench_cxx_sink; // Keeps results alive
+};
+
+//
+// Functional Prototypes
+
+static block::task<> async_reader(block::async_file file, std::span<std::byte> buf, uint32_t off, uint64_t n);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_read
+// Description  : Seek and read through block::File
+//
+// Inputs       : fd - the open I/O file (borrowed, not closed)
+//                off - offset of the I/O
+//                buf - data buffer
+//                len - length of the I/O
+//                iters - the number of reads
+// Outputs      : none
+
+void bench_cxx_read(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters)
+{
+    block::File file(fd);
+    std::span<std::byte> data(reinterpret_cast<std::byte*>(buf), len);
+
+    for (uint64_t i = 0; i < iters; i++) {
+        (void)file.seek(off);
+        (void)file.read(data);
+    }
+    file.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_write
+// Description  : Seek and write through block::File
+//
+// Inputs       : fd - the open I/O file (borrowed, not closed)
+//                off - offset of the I/O
+//                buf - data buffer
+//                len - length of the I/O
+//                iters - the number of writes
+// Outputs      : none
+
+void bench_cxx_write(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters)
+{
+    block::File file(fd);
+    std::span<const std::byte> data(reinterpret_cast<const std::byte*>(buf), len);
+
+    for (uint64_t i = 0; i < iters; i++) {
+        (void)file.seek(off);
+        (void)file.write(data);
+    }
+    file.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_read_pmr
+// Description  : Positional read from the start of the file into a buffer
+//                allocated for it from block::frame_buffer_resource()
+//
+// Inputs       : fd - the open I/O file (borrowed, not closed)
+//                len - length of the I/O
+//                iters - the number of reads
+// Outputs      : none
+
+void bench_cxx_read_pmr(int16_t fd, int32_t len, uint64_t iters)
+{
+    block::File file(fd);
+    std::pmr::polymorphic_allocator<std::byte> alloc(block::frame_buffer_resource());
+
+    for (uint64_t i = 0; i < iters; i++) {
+        std::byte* buf = alloc.allocate(len);
+        (void)file.pread(std::span<std::byte>(buf, len), 0);
+        alloc.deallocate(buf, len);
+    }
+    file.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_pread
+// Description  : Positional read through block::File
+//
+// Inputs       : fd - the open I/O file (borrowed, not closed)
+//                off - offset of the I/O
+//                buf - data buffer
+//                len - length of the I/O
+//                iters - the number of reads
+// Outputs      : none
+
+void bench_cxx_pread(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters)
+{
+    block::File file(fd);
+    std::span<std::byte> data(reinterpret_cast<std::byte*>(buf), len);
+
+    for (uint64_t i = 0; i < iters; i++) {
+        (void)file.pread(data, off);
+    }
+    file.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_pwrite
+// Description  : Positional write through block::File
+//
+// Inputs       : fd - the open I/O file (borrowed, not closed)
+//                off - offset of the I/O
+//                buf - data buffer
+//                len - length of the I/O
+//                iters - the number of writes
+// Outputs      : none
+
+void bench_cxx_pwrite(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters)
+{
+    block::File file(fd);
+    std::span<const std::byte> data(reinterpret_cast<const std::byte*>(buf), len);
+
+    for (uint64_t i = 0; i < iters; i++) {
+        (void)file.pwrite(data, off);
+    }
+    file.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_format
+// Description  : Format integers, one per line, through block::ofstream
+//                (rewinding every 64K lines to bound the file)
+//
+// Inputs       : fd - the open I/O file (borrowed, not closed)
+//                iters - the number of lines
+// Outputs      : none
+
+void bench_cxx_format(int16_t fd, uint64_t iters)
+{
+    block::ofstream out { block::File { fd } };
+
+    for (uint64_t i = 0; i < iters; i++) {
+        out << i << '\n';
+        if ((i & 0xffff) == 0xffff) {
+            out.seekp(0);
+        }
+    }
+    out.flush();
+    out.rdbuf()->file().release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_async_pread
+// Description  : Positional reads from many coroutines at once, through an
+//                io_context and the async engine
+//
+// Inputs       : fd - the open I/O file (borrowed, not closed)
+//                off - offset of the I/O
+//                buf - data buffer (shared by every reader)
+//                len - length of the I/O
+//                iters - the number of reads
+//                tasks - the number of coroutines sharing them
+// Outputs      : none
+
+void bench_cxx_async_pread(int16_t fd, uint32_t off, char* buf, int32_t len, uint64_t iters, int tasks)
+{
+    block::io_context ctx;
+    block::File file(fd);
+    block::async_file afile(ctx, file);
+    std::span<std::byte> data(reinterpret_cast<std::byte*>(buf), len);
+
+    for (int t = 0; t < tasks; t++) {
+        ctx.spawn(async_reader(afile, data, off, iters / tasks + (static_cast<uint64_t>(t) < iters % tasks)));
+    }
+    ctx.run();
+    file.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : async_reader
+// Description  : Read the same range "n" times, one await at a time
+//
+// Inputs       : file - the file to read
+//                buf - where to read into
+//                off - offset of the I/O
+//                n - number of reads
+// Outputs      : the task
+
+static block::task<> async_reader(block::async_file file, std::span<std::byte> buf, uint32_t off, uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++) {
+        (void)co_await file.read_at(buf, off);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_cache_create
+// Description  : Make a frame cache specialized to a capacity (16, 256,
+//                1024 or 4096), the same policy as the driver's
+//
+// Inputs       : size - the capacity
+//                buf - frame data to put
+//                fill - put frames 0 to size - 1 first
+// Outputs      : the cache, or NULL for another capacity
+
+void* bench_cxx_cache_create(uint32_t size, char* buf, int fill)
+{
+    BenchCache* cache;
+
+    switch (size) {
+    case 16:
+        cache = new BenchCacheN<16>;
+        break;
+    case 256:
+        cache = new BenchCacheN<256>;
+        break;
+    case 1024:
+        cache = new BenchCacheN<1024>;
+        break;
+    case 4096:
+        cache = new BenchCacheN<4096>;
+        break;
+    default:
+        return nullptr;
+    }
+    cache->buf = buf;
+    for (uint32_t i = 0; fill && (i < size); i++) {
+        uint16_t frm = static_cast<uint16_t>(i);
+        cache->put(&frm, 1, 1);
+    }
+    return cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_cache_get, bench_cxx_cache_put,
+//                bench_cxx_cache_free
+// Description  : Look up or insert the pre-drawn frames, or free the cache
+//
+// Inputs       : cache - from bench_cxx_cache_create
+//                index - the frame numbers
+//                count - how many there are (cycled through)
+//                iters - the number of lookups or inserts
+// Outputs      : none
+
+void bench_cxx_cache_get(void* cache, const uint16_t* index, uint32_t count, uint64_t iters)
+{
+    static_cast<BenchCache*>(cache)->get(index, count, iters);
+}
+
+void bench_cxx_cache_put(void* cache, const uint16_t* index, uint32_t count, uint64_t iters)
+{
+    static_cast<BenchCache*>(cache)->put(index, count, iters);
+}
+
+void bench_cxx_cache_free(void* cache)
+{
+    delete static_cast<BenchCache*>(cache);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_copy_frame, bench_cxx_frame_checksum
+// Description  : Copy or checksum one frame with the kernel for its size
+//
+// Inputs       : size - the frame size (512, 4096, 16384 or 65536)
+//                dst, src, buf - the frames
+//                iters - the number of frames
+// Outputs      : 0 if successful, -1 for another size
+
+int bench_cxx_copy_frame(uint32_t size, char* dst, const char* src, uint64_t iters)
+{
+    return with_frame_size(size, [&](auto n) {
+        for (uint64_t i = 0; i < iters; i++) {
+            block::copy_frame<n>(dst, src);
+            asm volatile("" : : "r"(dst) : "memory");
+        }
+    }) ? 0 : -1;
+}
+
+int bench_cxx_frame_checksum(uint32_t size, const char* buf, uint64_t iters)
+{
+    return with_frame_size(size, [&](auto n) {
+        uint32_t sum = 0;
+        for (uint64_t i = 0; i < iters; i++) {
+            sum += block::frame_checksum<n>(buf);
+            asm volatile("" : "+r"(sum) : : "memory");
+        }
+    }) ? 0 : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_model_create
+// Description  : Make a frame model for a frame size
+//
+// Inputs       : size - the frame size (512, 4096, 16384 or 65536)
+//                device_bytes - the device size
+//                cache_bytes - the cache size (the same for every frame size)
+// Outputs      : the model, or NULL for another size
+
+void* bench_cxx_model_create(uint32_t size, uint32_t device_bytes, uint32_t cache_bytes)
+{
+    BenchModel* model = nullptr;
+
+    with_frame_size(size, [&](auto n) { model = new BenchModelN<n>(device_bytes / n, cache_bytes / n); });
+    return model;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cxx_model_run, bench_cxx_model_bus_ops,
+//                bench_cxx_model_free
+// Description  : Run reads and writes (lens with the top bit set) through a
+//                model, get its bus transfers per operation, or free it
+//
+// Inputs       : model - from bench_cxx_model_create
+//                offs, lens - the operations (cycled through)
+//                count - how many there are
+//                buf - data buffer
+//                iters - the number of operations
+// Outputs      : bench_cxx_model_bus_ops returns the transfers per operation
+
+void bench_cxx_model_run(void* model, const uint32_t* offs, const uint32_t* lens, uint32_t count, char* buf,
+    uint64_t iters)
+{
+    static_cast<BenchModel*>(model)->run(offs, lens, count, buf, iters);
+}
+
+double bench_cxx_model_bus_ops(void* model)
+{
+    BenchModel* m = static_cast<BenchModel*>(model);
+    return m->ops ? static_cast<double>(m->bus_ops()) / m->ops : 0.0;
+}
+
+void bench_cxx_model_free(void* model)
+{
+    delete static_cast<BenchModel*>(model);
+}
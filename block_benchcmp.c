@@ -0,0 +1,464 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_benchcmp.c
+//  Description    : This is the benchmark comparison tool for the BLOCK
+//                   driver.  It reads a baseline and a new set of results
+//                   (block_bench or block_sim --json output), tests every
+//                   metric for a change with the Mann-Whitney U test, and
+//                   prints the speedup with a bootstrap confidence interval.
+//                   It exits 1 if any metric regressed significantly by more
+//                   than the threshold.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_json.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define BENCHCMP_ARGUMENTS "ht:a:b:S:"
+#define BENCHCMP_MAX_NAME 160 // Longest metric name
+#define USAGE                                                                      \
+    "USAGE: block_benchcmp [-h] [-t <pct>] [-a <alpha>] [-b <n>] [-S <seed>]\n"    \
+    "                      <base.json>[,<base.json>...] <new.json>[,<new.json>...]\n" \
+    "\n"                                                                           \
+    "where:\n"                                                                     \
+    "    -h - help mode (display this message)\n"                                  \
+    "    -t - regression threshold in percent (default 5)\n"                       \
+    "    -a - significance level of the Mann-Whitney test (default 0.05)\n"        \
+    "    -b - bootstrap resamples for the speedup interval (default 2000)\n"       \
+    "    -S - random seed for the bootstrap (default 1)\n"                         \
+    "\n"                                                                           \
+    "  Each side is one or more result files from block_bench or block_sim\n"      \
+    "  --json, their samples are pooled.  Exits 1 if any metric regressed.\n"      \
+    "\n"
+
+// One metric, with the samples from each side
+typedef struct {
+    char name[BENCHCMP_MAX_NAME]; // The metric name
+    int higher_better; // Larger values are improvements
+    double* samples[2]; // Baseline and new samples
+    int count[2]; // Number of samples on each side
+    int max[2]; // Allocated samples on each side
+} BenchMetric;
+
+//
+// Global Data
+
+static BenchMetric* metrics = NULL; // All of the metrics seen
+static int nmetrics = 0, maxmetrics = 0; // Metrics used and allocated
+static uint64_t cmp_rng = 1; // Bootstrap PRNG state
+
+//
+// Functional Prototypes
+
+static int load_side(char* list, int side);
+static void add_sample(const char* name, int higher_better, int side, double v);
+static void add_samples(const char* name, int higher_better, int side, BlockJson* arr);
+static double median(double* x, int n);
+static double mann_whitney(double* a, int na, double* b, int nb);
+static double speedup(BenchMetric* m, double* a, double* b);
+static void bootstrap(BenchMetric* m, int boots, double* lo, double* hi);
+static int compare_double(const void* a, const void* b);
+static uint64_t cmp_next(void);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the comparison tool
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if nothing regressed, 1 if something did, -1 on failure
+
+int main(int argc, char* argv[])
+{
+    // Local variables
+    double threshold = 5.0, alpha = 0.05, p, s, lo, hi;
+    int ch, boots = 2000, regressions = 0, i;
+    BenchMetric* m;
+    const char* verdict;
+
+    // Process the command line parameters
+    while ((ch = getopt(argc, argv, BENCHCMP_ARGUMENTS)) != -1) {
+        switch (ch) {
+        case 'h': // Help, print usage
+            fprintf(stderr, USAGE);
+            return (-1);
+
+        case 't': // Regression threshold
+            if ((sscanf(optarg, "%lf", &threshold) != 1) || (threshold < 0) || (threshold >= 100)) {
+                fprintf(stderr, "Bad threshold [%s].\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'a': // Significance level
+            if ((sscanf(optarg, "%lf", &alpha) != 1) || (alpha <= 0) || (alpha >= 1)) {
+                fprintf(stderr, "Bad significance level [%s].\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'b': // Bootstrap resamples
+            if ((sscanf(optarg, "%d", &boots) != 1) || (boots < 100)) {
+                fprintf(stderr, "Bad bootstrap count [%s], must be at least 100.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'S': // Seed
+            if ((sscanf(optarg, "%" SCNu64, &cmp_rng) != 1) || (cmp_rng == 0)) {
+                fprintf(stderr, "Bad seed [%s].\n", optarg);
+                return (-1);
+            }
+            break;
+
+        default: // Default (unknown)
+            fprintf(stderr, "Unknown command line option (%c), aborting.\n", ch);
+            return (-1);
+        }
+    }
+    initializeLogWithFilehandle(CMPSC311_LOG_STDERR);
+    if (argc - optind != 2) {
+        fprintf(stderr, "Need a baseline and a new set of results, use -h to see usage, aborting.\n");
+        return (-1);
+    }
+    if ((load_side(argv[optind], 0) != 0) || (load_side(argv[optind + 1], 1) != 0)) {
+        return (-1);
+    }
+
+    // Compare every metric both sides have
+    printf("%-40s %4s %4s %14s %14s %8s %19s %8s  %s\n", "metric", "n0", "n1", "base", "new",
+        "speedup", "95% CI", "p", "verdict");
+    for (i = 0; i < nmetrics; i++) {
+        m = &metrics[i];
+        if ((m->count[0] == 0) || (m->count[1] == 0)) {
+            continue;
+        }
+        p = mann_whitney(m->samples[0], m->count[0], m->samples[1], m->count[1]);
+        s = speedup(m, m->samples[0], m->samples[1]);
+        bootstrap(m, boots, &lo, &hi);
+
+        if (p >= alpha) {
+            verdict = "same";
+        } else if (s < 1.0 - threshold / 100.0) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else {
+            verdict = (s > 1.0) ? "faster" : "slower";
+        }
+        printf("%-40s %4d %4d %14.6g %14.6g %7.3fx [%7.3fx, %7.3fx] %8.4f  %s\n", m->name, m->count[0],
+            m->count[1], median(m->samples[0], m->count[0]), median(m->samples[1], m->count[1]), s, lo, hi, p,
+            verdict);
+    }
+    printf("%d regression(s) beyond %.1f%% at p < %.3f.\n", regressions, threshold, alpha);
+
+    // Cleanup and report
+    for (i = 0; i < nmetrics; i++) {
+        free(metrics[i].samples[0]);
+        free(metrics[i].samples[1]);
+    }
+    free(metrics);
+    return (regressions ? 1 : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : load_side
+// Description  : Load the samples of one side from its result files
+//
+// Inputs       : list - comma separated result files
+//                side - 0 for the baseline, 1 for the new results
+// Outputs      : 0 if successful, -1 if failure
+
+static int load_side(char* list, int side)
+{
+    // Local variables
+    char name[BENCHCMP_MAX_NAME], *file, *save;
+    BlockJson *root, *e, *r, *v, *c;
+
+    for (file = strtok_r(list, ",", &save); file != NULL; file = strtok_r(NULL, ",", &save)) {
+        if ((root = load_block_json(file)) == NULL) {
+            return (-1);
+        }
+
+        // block_bench results, ns/op samples of each benchmark
+        if ((e = block_json_get(root, "benchmarks")) != NULL) {
+            for (e = e->child; e != NULL; e = e->next) {
+                if (((v = block_json_get(e, "name")) != NULL) && (v->type == BLOCK_JSON_STRING)) {
+                    add_samples(v->string, 0, side, block_json_get(e, "samples"));
+                }
+            }
+
+        // block_sim results, per backend throughput, hit ratio and latency
+        } else if ((e = block_json_get(root, "runs")) != NULL) {
+            for (r = e->child; r != NULL; r = r->next) {
+                if (((v = block_json_get(r, "backend")) == NULL) || (v->type != BLOCK_JSON_STRING)) {
+                    continue;
+                }
+                snprintf(name, sizeof(name), "%s/ops_per_s", v->string);
+                add_samples(name, 1, side, block_json_get(block_json_get(r, "ops_per_s"), "samples"));
+                snprintf(name, sizeof(name), "%s/hit_ratio", v->string);
+                add_samples(name, 1, side, block_json_get(block_json_get(r, "hit_ratio"), "samples"));
+                for (c = (e = block_json_get(r, "commands")) ? e->child : NULL; c != NULL; c = c->next) {
+                    if (((e = block_json_get(c, "count")) == NULL) || (e->number == 0)) {
+                        continue;
+                    }
+                    if ((e = block_json_get(c, "mean_ns")) != NULL) {
+                        snprintf(name, sizeof(name), "%s/%s/mean_ns", v->string, c->key);
+                        add_sample(name, 0, side, e->number);
+                    }
+                    if ((e = block_json_get(c, "p99_ns")) != NULL) {
+                        snprintf(name, sizeof(name), "%s/%s/p99_ns", v->string, c->key);
+                        add_sample(name, 0, side, e->number);
+                    }
+                }
+            }
+
+        } else {
+            logMessage(LOG_ERROR_LEVEL, "Result file [%s] is not from block_bench or block_sim.", file);
+            free_block_json(root);
+            return (-1);
+        }
+        free_block_json(root);
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : add_sample
+// Description  : Add a sample to a metric, creating the metric as needed
+//
+// Inputs       : name - the metric name
+//                higher_better - larger values are improvements
+//                side - 0 for the baseline, 1 for the new results
+//                v - the sample
+// Outputs      : none
+
+static void add_sample(const char* name, int higher_better, int side, double v)
+{
+    BenchMetric* m = NULL;
+    int i;
+
+    for (i = 0; i < nmetrics; i++) {
+        if (strcmp(metrics[i].name, name) == 0) {
+            m = &metrics[i];
+            break;
+        }
+    }
+    if (m == NULL) {
+        if (nmetrics == maxmetrics) {
+            maxmetrics = (maxmetrics == 0) ? 64 : maxmetrics * 2;
+            metrics = realloc(metrics, sizeof(BenchMetric) * maxmetrics);
+        }
+        m = &metrics[nmetrics++];
+        memset(m, 0x0, sizeof(BenchMetric));
+        snprintf(m->name, sizeof(m->name), "%s", name);
+        m->higher_better = higher_better;
+    }
+    if (m->count[side] == m->max[side]) {
+        m->max[side] = (m->max[side] == 0) ? 16 : m->max[side] * 2;
+        m->samples[side] = realloc(m->samples[side], sizeof(double) * m->max[side]);
+    }
+    m->samples[side][m->count[side]++] = v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : add_samples
+// Description  : Add every number in a JSON array to a metric
+//
+// Inputs       : name - the metric name
+//                higher_better - larger values are improvements
+//                side - 0 for the baseline, 1 for the new results
+//                arr - the array (ignored if NULL)
+// Outputs      : none
+
+static void add_samples(const char* name, int higher_better, int side, BlockJson* arr)
+{
+    BlockJson* e;
+
+    if ((arr == NULL) || (arr->type != BLOCK_JSON_ARRAY)) {
+        return;
+    }
+    for (e = arr->child; e != NULL; e = e->next) {
+        if (e->type == BLOCK_JSON_NUMBER) {
+            add_sample(name, higher_better, side, e->number);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : median
+// Description  : The median of a set of samples
+//
+// Inputs       : x - the samples
+//                n - the number of samples (> 0)
+// Outputs      : the median
+
+static double median(double* x, int n)
+{
+    double* s = malloc(sizeof(double) * n), v;
+
+    memcpy(s, x, sizeof(double) * n);
+    qsort(s, n, sizeof(double), compare_double);
+    v = (n % 2) ? s[n / 2] : (s[n / 2 - 1] + s[n / 2]) / 2;
+    free(s);
+    return (v);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : mann_whitney
+// Description  : Two-sided Mann-Whitney U test that the samples come from
+//                the same distribution (normal approximation with tie and
+//                continuity corrections)
+//
+// Inputs       : a, na - the first samples
+//                b, nb - the second samples
+// Outputs      : the p value
+
+static double mann_whitney(double* a, int na, double* b, int nb)
+{
+    // Local variables
+    int n = na + nb, i, j, k;
+    double *v, r1 = 0, ties = 0, u, mu, sigma, z, rank;
+
+    // Rank the pooled samples, ties get the average rank
+    v = malloc(sizeof(double) * n * 2);
+    for (i = 0; i < na; i++) {
+        v[i * 2] = a[i];
+        v[i * 2 + 1] = 0;
+    }
+    for (i = 0; i < nb; i++) {
+        v[(na + i) * 2] = b[i];
+        v[(na + i) * 2 + 1] = 1;
+    }
+    qsort(v, n, sizeof(double) * 2, compare_double);
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; (j < n) && (v[j * 2] == v[i * 2]); j++)
+            ;
+        rank = (i + 1 + j) / 2.0;
+        for (k = i; k < j; k++) {
+            if (v[k * 2 + 1] == 0) {
+                r1 += rank;
+            }
+        }
+        ties += (double)(j - i) * (j - i) * (j - i) - (j - i);
+    }
+    free(v);
+
+    // Compare U with its distribution under the null hypothesis
+    u = r1 - na * (na + 1) / 2.0;
+    mu = na * (double)nb / 2.0;
+    sigma = sqrt(na * (double)nb / 12.0 * ((n + 1) - ties / ((double)n * (n - 1))));
+    if ((n < 2) || (sigma == 0)) {
+        return (1.0);
+    }
+    z = (fabs(u - mu) - 0.5) / sigma;
+    if (z < 0) {
+        z = 0;
+    }
+    return (erfc(z / sqrt(2.0)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : speedup
+// Description  : The ratio of the medians, above 1 when the new side is
+//                better
+//
+// Inputs       : m - the metric
+//                a - the baseline samples (m->count[0] of them)
+//                b - the new samples (m->count[1] of them)
+// Outputs      : the speedup
+
+static double speedup(BenchMetric* m, double* a, double* b)
+{
+    double ma = median(a, m->count[0]), mb = median(b, m->count[1]);
+
+    if (m->higher_better) {
+        return ((ma == 0) ? 1.0 : mb / ma);
+    }
+    return ((mb == 0) ? 1.0 : ma / mb);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bootstrap
+// Description  : Percentile bootstrap 95% interval of the speedup,
+//                resampling each side with replacement
+//
+// Inputs       : m - the metric
+//                boots - the number of resamples
+//                lo, hi - set to the interval
+// Outputs      : none
+
+static void bootstrap(BenchMetric* m, int boots, double* lo, double* hi)
+{
+    double *a = malloc(sizeof(double) * m->count[0]), *b = malloc(sizeof(double) * m->count[1]);
+    double* s = malloc(sizeof(double) * boots);
+    int i, j;
+
+    for (i = 0; i < boots; i++) {
+        for (j = 0; j < m->count[0]; j++) {
+            a[j] = m->samples[0][cmp_next() % m->count[0]];
+        }
+        for (j = 0; j < m->count[1]; j++) {
+            b[j] = m->samples[1][cmp_next() % m->count[1]];
+        }
+        s[i] = speedup(m, a, b);
+    }
+    qsort(s, boots, sizeof(double), compare_double);
+    *lo = s[(int)(boots * 0.025)];
+    *hi = s[(int)(boots * 0.975) - 1];
+    free(a);
+    free(b);
+    free(s);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : compare_double
+// Description  : qsort comparison for doubles
+//
+// Inputs       : a, b - the values to compare
+// Outputs      : <0, 0 or >0
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return ((x < y) ? -1 : (x > y));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : cmp_next
+// Description  : Next value from the bootstrap PRNG (xorshift64*)
+//
+// Inputs       : none
+// Outputs      : the random value
+
+static uint64_t cmp_next(void)
+{
+    cmp_rng ^= cmp_rng >> 12;
+    cmp_rng ^= cmp_rng << 25;
+    cmp_rng ^= cmp_rng >> 27;
+    return (cmp_rng * 0x2545f4914f6cdd1dULL);
+}
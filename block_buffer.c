@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_buffer.c
+//  Description    : This is the implementation of the I/O buffer pool.  Each
+//                   thread has its own free lists, one per power of two
+//                   frame count, linked through the free buffers themselves.
+//                   Nothing is shared, so there is no locking; a buffer
+//                   freed on another thread joins that thread's lists.  The
+//                   lists are released when the thread exits.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <pthread.h>
+#include <stdlib.h>
+
+// Project Includes
+#include <block_buffer.h>
+#include <block_controller.h>
+#include <cmpsc311_log.h>
+
+// A free buffer (the link lives in the buffer)
+typedef struct BlockBufferFree {
+    struct BlockBufferFree* next; // Next free buffer of this size
+} BlockBufferFree;
+
+// The per-thread pool
+typedef struct {
+    BlockBufferFree* free[BLOCK_BUFFER_CLASSES]; // Free lists by size
+    uint32_t nfree[BLOCK_BUFFER_CLASSES]; // Buffers on each list
+    BlockBufferStats stats; // Counters
+    int registered; // Set once the exit destructor is armed
+} BlockBufferPool;
+
+static __thread BlockBufferPool pool; // This thread's pool
+static pthread_key_t pool_key; // Frees a thread's pool when it exits
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+
+//
+// Functional Prototypes
+
+static int buffer_class(size_t len);
+static void pool_key_create(void);
+static void pool_release(void* arg);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_buffer_alloc
+// Description  : Get a frame aligned buffer, off this thread's free list for
+//                its size if there is one
+//
+// Inputs       : len - bytes needed
+// Outputs      : the buffer, or NULL on failure
+
+void* block_buffer_alloc(size_t len)
+{
+    BlockBufferFree* buf;
+    int cls = buffer_class(len);
+
+    pool.stats.allocs++;
+    if (cls < 0) {
+        // Too big to keep, straight from the allocator
+        pool.stats.oversize++;
+        len = (len + BLOCK_FRAME_SIZE - 1) / BLOCK_FRAME_SIZE * BLOCK_FRAME_SIZE;
+        return (aligned_alloc(BLOCK_FRAME_SIZE, len));
+    }
+    if ((buf = pool.free[cls]) != NULL) {
+        pool.free[cls] = buf->next;
+        pool.nfree[cls]--;
+        pool.stats.cached--;
+        pool.stats.reused++;
+        return (buf);
+    }
+    if ((buf = aligned_alloc(BLOCK_FRAME_SIZE, (size_t)BLOCK_FRAME_SIZE << cls)) == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "Failed allocating %zu byte I/O buffer.", (size_t)BLOCK_FRAME_SIZE << cls);
+    }
+    return (buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_buffer_free
+// Description  : Put a buffer on this thread's free list for its size, or
+//                free it if the list is full
+//
+// Inputs       : buf - the buffer (NULL is ignored)
+//                len - the length it was allocated with
+// Outputs      : none
+
+void block_buffer_free(void* buf, size_t len)
+{
+    BlockBufferFree* node = buf;
+    int cls = buffer_class(len);
+
+    if (buf == NULL) {
+        return;
+    }
+    if ((cls < 0) || (pool.nfree[cls] == BLOCK_BUFFER_CACHED)) {
+        free(buf);
+        return;
+    }
+
+    // Arm the destructor the first time this thread keeps a buffer
+    if (!pool.registered) {
+        pthread_once(&pool_key_once, pool_key_create);
+        pthread_setspecific(pool_key, &pool);
+        pool.registered = 1;
+    }
+    node->next = pool.free[cls];
+    pool.free[cls] = node;
+    pool.nfree[cls]++;
+    pool.stats.cached++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_buffer_trim
+// Description  : Free every buffer on this thread's free lists
+//
+// Inputs       : none
+// Outputs      : none
+
+void block_buffer_trim(void)
+{
+    pool_release(&pool);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : get_block_buffer_stats
+// Description  : Get this thread's pool counters
+//
+// Inputs       : stats - where to put them
+// Outputs      : none
+
+void get_block_buffer_stats(BlockBufferStats* stats)
+{
+    *stats = pool.stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : buffer_class
+// Description  : Find the free list for a length (the smallest power of two
+//                frame count that holds it)
+//
+// Inputs       : len - bytes needed
+// Outputs      : the class, or -1 if too big to pool
+
+static int buffer_class(size_t len)
+{
+    size_t frames = (len + BLOCK_FRAME_SIZE - 1) / BLOCK_FRAME_SIZE;
+    int cls = 0;
+
+    while (((size_t)1 << cls) < frames) {
+        if (++cls == BLOCK_BUFFER_CLASSES) {
+            return (-1);
+        }
+    }
+    return (cls);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : pool_key_create, pool_release
+// Description  : Create the thread exit key, and free a pool's buffers (run
+//                by the key when a thread that kept buffers exits)
+//
+// Inputs       : arg - the pool
+// Outputs      : none
+
+static void pool_key_create(void)
+{
+    pthread_key_create(&pool_key, pool_release);
+}
+
+static void pool_release(void* arg)
+{
+    BlockBufferPool* p = arg;
+    BlockBufferFree* buf;
+    int i;
+
+    for (i = 0; i < BLOCK_BUFFER_CLASSES; i++) {
+        while ((buf = p->free[i]) != NULL) {
+            p->free[i] = buf->next;
+            free(buf);
+        }
+        p->nfree[i] = 0;
+    }
+    p->stats.cached = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef BLOCK_BUFFER_INCLUDED
+#define BLOCK_BUFFER_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_buffer.h
+//  Description    : This is the interface for the I/O buffer pool.  Buffers
+//                   are whole frames, aligned to a frame, and kept on a free
+//                   list per size and per thread when released, so reads and
+//                   writes can reuse them without going to malloc (or taking
+//                   its locks).  block_buffer.hpp wraps the pool as a
+//                   std::pmr::memory_resource.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stddef.h>
+#include <stdint.h>
+
+// Defines
+#define BLOCK_BUFFER_CLASSES 9 // Pooled sizes (1, 2, 4 ... 256 frames)
+#define BLOCK_BUFFER_CACHED 8 // Free buffers kept per size, per thread
+
+// The pool counters (for the calling thread)
+typedef struct {
+    uint64_t allocs; // Buffers handed out
+    uint64_t reused; // Of those, taken off a free list
+    uint64_t oversize; // Of those, too big to pool
+    uint32_t cached; // Free buffers held now
+} BlockBufferStats;
+
+//
+// Interface functions
+
+void* block_buffer_alloc(size_t len);
+// Get a frame aligned buffer of at least "len" bytes, NULL on failure
+
+void block_buffer_free(void* buf, size_t len);
+// Release a buffer (len as allocated) onto this thread's free list
+
+void block_buffer_trim(void);
+// Free the buffers this thread holds on its free lists
+
+void get_block_buffer_stats(BlockBufferStats* stats);
+// Get this thread's pool counters
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef BLOCK_BUFFER_HPP_INCLUDED
+#define BLOCK_BUFFER_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_buffer.hpp
+//  Description    : This is the I/O buffer pool (block_buffer.h) as a
+//                   std::pmr::memory_resource.  Containers built on
+//                   block::frame_buffer_resource() get frame aligned storage
+//                   from the calling thread's free lists:
+//
+//                       std::pmr::vector<std::byte> buf(len, block::frame_buffer_resource());
+//                       file->pread(buf, 0);
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+// Project Includes
+extern "C" {
+#include <block_buffer.h>
+#include <block_controller.h>
+}
+
+namespace block {
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : frame_resource
+// Description  : Frame aligned memory from the per-thread buffer pool.
+//                Every frame_resource draws on the same pool, so they all
+//                compare equal.
+
+class frame_resource final : public std::pmr::memory_resource {
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        void* p = (alignment <= BLOCK_FRAME_SIZE) ? block_buffer_alloc(bytes) : nullptr;
+        if (p == nullptr) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t) override { block_buffer_free(p, bytes); }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return dynamic_cast<const frame_resource*>(&other) != nullptr;
+    }
+};
+
+// The shared instance
+inline frame_resource* frame_buffer_resource() noexcept
+{
+    static frame_resource resource;
+    return &resource;
+}
+
+} // namespace block
+
+#endif
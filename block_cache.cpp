@@ -0,0 +1,503 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_cache.cpp
+//  Description    : This is the implementation of the cache for the BLOCK
+//                   driver.  It is the C interface to one instantiation of
+//                   block::frame_cache (block_cache.hpp): frames keyed by
+//                   block and frame number, sized at init, and ordered by
+//                   when they were last written (reads do not reorder).
+//
+//                   In front of it each thread has a small direct-mapped
+//                   cache of pointers to the frames it found there.  Every
+//                   frame has a version that is bumped when it is put or
+//                   evicted, and an entry is only used while the version it
+//                   was taken at is current, so repeated hits from a thread
+//                   skip the shared table.  A thread that puts a frame keeps
+//                   it in its own front cache at the new version.  Since
+//                   reads do not reorder the cache, skipping it on a hit
+//                   changes nothing it evicts.
+//
+//  Author         : Chloe Gregory
+//  Last Modified  : 8/7/19
+//
+
+// Includes
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <pthread.h>
+
+// Project includes
+#include <block_cache.hpp>
+#include <block_geometry.hpp>
+extern "C" {
+#include <block_cache.h>
+#include <block_copy.h>
+#include <cmpsc311_log.h>
+}
+
+// The driver's instantiation of the cache
+typedef block::frame_cache<uint32_t, block::device_geometry::frame_size, block::lru_on_put> DriverCache;
+
+// A front cache entry, a frame pointer taken at a version
+struct FrontEntry {
+    uint32_t key; // The frame's key
+    uint32_t version; // Its version when found
+    uint32_t epoch; // The cache it was found in
+    unsigned char* frame; // The frame in the shared cache
+};
+
+// A thread's front cache, on a list once used so the counters can be summed
+// (constant initialized, so thread_local access needs no guard)
+struct FrontCache {
+    FrontEntry entries[BLOCK_FRONT_CACHE_ENTRIES] = {}; // Direct mapped by key
+    std::atomic<uint64_t> hits { 0 }, lookups { 0 }; // Written by the owner only
+    FrontCache* next = NULL; // Next on the list
+    int listed = 0; // On the list
+};
+
+uint32_t block_cache_max_items = DEFAULT_BLOCK_FRAME_CACHE_SIZE; // Maximum number of items in cache
+static DriverCache* cache = NULL; // The cache, NULL until init
+static int front_enabled = 1; // Use the front caches
+static uint32_t front_epoch = 0; // Bumped at init and close, retiring every front entry
+static std::atomic<uint32_t> versions[BLOCK_BLOCK_SIZE]; // Per frame, bumped on put and evict
+static pthread_mutex_t fronts_lock = PTHREAD_MUTEX_INITIALIZER; // Guards the list below
+static FrontCache* fronts = NULL; // The front caches of live threads
+static uint64_t front_retired[2] = { 0, 0 }; // Hits and lookups of exited threads
+static uint64_t front_base[2] = { 0, 0 }; // Hits and lookups at init
+static pthread_key_t front_key; // Takes a thread's front cache off the list when it exits
+static pthread_once_t front_key_once = PTHREAD_ONCE_INIT;
+static thread_local FrontCache front; // This thread's front cache
+
+// The key of a frame
+static inline uint32_t cache_key(BlockIndex block, BlockFrameIndex frm)
+{
+    return ((uint32_t)block << 16) | frm;
+}
+
+// The version of a key (keys of other blocks share the frame's, which only costs a miss)
+static inline std::atomic<uint32_t>& key_version(uint32_t key)
+{
+    return versions[key & (BLOCK_BLOCK_SIZE - 1)];
+}
+
+// Retire the front entries for a key put into the cache and for the key it
+// evicted, then note the new frame in this thread's own front cache
+static inline void bump_versions(uint32_t key, const DriverCache::put_result& put)
+{
+    uint32_t version = key_version(key).fetch_add(1, std::memory_order_release) + 1;
+
+    if (put.evicted) {
+        key_version(*put.evicted).fetch_add(1, std::memory_order_release);
+    }
+    if (front_enabled) {
+        front.entries[key & (BLOCK_FRONT_CACHE_ENTRIES - 1)] = FrontEntry { key, version, front_epoch, put.frame };
+    }
+}
+
+// Fold an exiting thread's counters into the totals and unlist its cache
+static void front_release(void* arg)
+{
+    FrontCache* f = static_cast<FrontCache*>(arg);
+
+    pthread_mutex_lock(&fronts_lock);
+    front_retired[0] += f->hits.load(std::memory_order_relaxed);
+    front_retired[1] += f->lookups.load(std::memory_order_relaxed);
+    for (FrontCache** p = &fronts; *p != NULL; p = &(*p)->next) {
+        if (*p == f) {
+            *p = f->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&fronts_lock);
+}
+
+static void front_key_create(void)
+{
+    pthread_key_create(&front_key, front_release);
+}
+
+// List this thread's front cache (on its first lookup)
+static void front_list(void)
+{
+    pthread_once(&front_key_once, front_key_create);
+    pthread_setspecific(front_key, &front);
+    pthread_mutex_lock(&fronts_lock);
+    front.next = fronts;
+    fronts = &front;
+    front.listed = 1;
+    pthread_mutex_unlock(&fronts_lock);
+}
+
+// Sum the front cache counters of every thread
+static void sum_front_stats(uint64_t* hits, uint64_t* lookups)
+{
+    pthread_mutex_lock(&fronts_lock);
+    *hits = front_retired[0];
+    *lookups = front_retired[1];
+    for (FrontCache* f = fronts; f != NULL; f = f->next) {
+        *hits += f->hits.load(std::memory_order_relaxed);
+        *lookups += f->lookups.load(std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&fronts_lock);
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : set_block_cache_size
+// Description  : Set the size of the cache (must be called before init)
+//
+// Inputs       : max_frames - the maximum number of items your cache can hold
+// Outputs      : 0 if successful, -1 if failure
+
+int set_block_cache_size(uint32_t max_frames)
+{
+    block_cache_max_items = max_frames;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : init_block_cache
+// Description  : Initialize the cache and note maximum frames
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int init_block_cache(void)
+{
+    front_epoch++;
+    sum_front_stats(&front_base[0], &front_base[1]);
+    delete cache;
+    cache = new (std::nothrow) DriverCache(block_cache_max_items);
+    if (cache == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "Failed allocating the frame cache (%u frames).", block_cache_max_items);
+        return (-1);
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : close_block_cache
+// Description  : Clear all of the contents of the cache, cleanup
+//
+// Inputs       : none
+// Outputs      : o if successful, -1 if failure
+
+int close_block_cache(void)
+{
+    front_epoch++;
+    delete cache;
+    cache = NULL;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : put_block_cache
+// Description  : Put an object into the frame cache
+//
+// Inputs       : block - the block number of the frame to cache
+//                frm - the frame number of the frame to cache
+//                buf - the buffer to insert into the cache
+// Outputs      : 0 if successful, -1 if failure
+
+int put_block_cache(BlockIndex block, BlockFrameIndex frm, void* buf)
+{
+    uint32_t key = cache_key(block, frm);
+    bump_versions(key, cache->put(key, buf));
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : stream_block_cache
+// Description  : Put a frame into the frame cache with streaming stores (for
+//                frames of a large read or write, unlikely to be used again
+//                soon; the caller fences with block_copy_fence)
+//
+// Inputs       : block - the block number of the frame to cache
+//                frm - the frame number of the frame to cache
+//                buf - the buffer to insert into the cache
+// Outputs      : 0 if successful, -1 if failure
+
+int stream_block_cache(BlockIndex block, BlockFrameIndex frm, void* buf)
+{
+    uint32_t key = cache_key(block, frm);
+    bump_versions(key, cache->put(key, buf, [](void* dst, const void* src) {
+        block_copy_stream(dst, src, block::device_geometry::frame_size);
+    }));
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : get_block_cache
+// Description  : Get an frame from the cache (and return it), from the
+//                thread's front cache if it found it there before and the
+//                frame has not been put or evicted since
+//
+// Inputs       : block - the block number of the block to find
+//                frm - the  number of the frame to find
+// Outputs      : pointer to cached frame or NULL if not found
+
+void* get_block_cache(BlockIndex block, BlockFrameIndex frm)
+{
+    uint32_t key = cache_key(block, frm), version;
+    unsigned char* frame;
+
+    if (!front_enabled) {
+        return (cache->get(key));
+    }
+    if (!front.listed) {
+        front_list();
+    }
+    FrontEntry& entry = front.entries[key & (BLOCK_FRONT_CACHE_ENTRIES - 1)];
+    version = key_version(key).load(std::memory_order_acquire);
+    front.lookups.store(front.lookups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if ((entry.frame != NULL) && (entry.key == key) && (entry.version == version) && (entry.epoch == front_epoch)) {
+        front.hits.store(front.hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return (entry.frame);
+    }
+    if ((frame = cache->get(key)) != NULL) {
+        entry = FrontEntry { key, version, front_epoch, frame };
+    }
+    return (frame);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : peek_block_cache
+// Description  : Check whether a frame is in the cache, without counting the
+//                lookup as a hit or miss
+//
+// Inputs       : block - the block number of the block to find
+//                frm - the  number of the frame to find
+// Outputs      : 1 if the frame is cached, 0 if not
+
+int peek_block_cache(BlockIndex block, BlockFrameIndex frm)
+{
+    return (cache->contains(cache_key(block, frm)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : get_block_cache_stats
+// Description  : Get the number of cache lookups that hit and missed since
+//                the cache was initialized
+//
+// Inputs       : hits - set to the number of hits
+//                misses - set to the number of misses
+// Outputs      : none (both 0 if the cache is closed)
+
+void get_block_cache_stats(uint64_t* hits, uint64_t* misses)
+{
+    uint64_t front_hits, front_lookups;
+
+    get_block_front_cache_stats(&front_hits, &front_lookups);
+    *hits = (cache != NULL) ? cache->hits() + front_hits : 0;
+    *misses = (cache != NULL) ? cache->misses() : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : set_block_front_cache
+// Description  : Turn the per-thread front caches on or off
+//
+// Inputs       : enabled - 1 to use them (the default), 0 to go straight
+//                          to the shared cache
+// Outputs      : none
+
+void set_block_front_cache(int enabled)
+{
+    front_enabled = enabled;
+    front_epoch++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : get_block_front_cache_stats
+// Description  : Get the number of lookups the front caches of all threads
+//                answered, and the number made, since the cache was
+//                initialized
+//
+// Inputs       : hits - set to the number answered by a front cache
+//                lookups - set to the number of lookups
+// Outputs      : none
+
+void get_block_front_cache_stats(uint64_t* hits, uint64_t* lookups)
+{
+    sum_front_stats(hits, lookups);
+    *hits -= front_base[0];
+    *lookups -= front_base[1];
+}
+
+//
+// Unit test
+
+// Log a failed check
+static bool unit_check(bool ok, const char* what)
+{
+    if (!ok) {
+        logMessage(LOG_ERROR_LEVEL, "Cache unit test failed: %s.", what);
+    }
+    return ok;
+}
+
+// Check that a frame holds the fill a key was put with
+static bool unit_frame_is(const unsigned char* frame, uint32_t key)
+{
+    for (std::size_t i = 0; i < block::device_geometry::frame_size; i++) {
+        if (frame[i] != (unsigned char)(key * 7 + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Put a frame filled for a key
+static DriverCache::put_result unit_put(DriverCache& c, uint32_t key)
+{
+    alignas(64) unsigned char buf[block::device_geometry::frame_size];
+
+    std::memset(buf, key * 7 + 1, sizeof(buf));
+    return c.put(key, buf);
+}
+
+// The same through the C interface (frame frm of block 0)
+static void unit_put_block(BlockFrameIndex frm)
+{
+    alignas(64) unsigned char buf[block::device_geometry::frame_size];
+
+    std::memset(buf, frm * 7 + 1, sizeof(buf));
+    put_block_cache(0, frm, buf);
+}
+
+// Put a frame from another thread (so this one's front entry is not renewed)
+static void* unit_put_thread(void* arg)
+{
+    unit_put_block(*static_cast<BlockFrameIndex*>(arg));
+    return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : blockCacheUnitTest
+// Description  : Run a UNIT test checking the cache implementation: the
+//                eviction order, removing keys from the middle of a probe
+//                run, frames staying put, and the front caches dropping
+//                entries whose frames were rewritten, evicted or freed
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int blockCacheUnitTest(void)
+{
+    uint32_t saved_size = block_cache_max_items, chain[4], key, n, i;
+    int saved_front = front_enabled;
+    uint64_t hits, lookups, hits2, lookups2;
+    BlockFrameIndex other = 3;
+    unsigned char *frame[4], *p;
+    pthread_t thread;
+    bool ok = true;
+
+    // Eviction follows the order of the puts, reads do not reorder
+    {
+        DriverCache c(3);
+        ok &= unit_check(!unit_put(c, 1).evicted && !unit_put(c, 2).evicted && !unit_put(c, 3).evicted,
+            "put into a cache with room evicted");
+        ok &= unit_check((c.get(1) != nullptr) && (c.get(2) != nullptr), "put frames not found");
+        ok &= unit_check(unit_put(c, 4).evicted == 1u, "first written frame not evicted first");
+        ok &= unit_check(unit_put(c, 2).evicted == std::nullopt, "rewrite of a cached frame evicted");
+        ok &= unit_check(unit_put(c, 5).evicted == 3u, "rewritten frame not moved to the front");
+        ok &= unit_check(unit_put(c, 6).evicted == 4u, "eviction out of order");
+        ok &= unit_check(!c.contains(1) && !c.contains(3) && !c.contains(4) && c.contains(2) && c.contains(5)
+                && c.contains(6) && (c.size() == 3),
+            "wrong frames cached after evictions");
+        ok &= unit_check((c.hits() == 2) && (c.misses() == 0), "lookups miscounted");
+    }
+
+    // Keys with the same home slot form one probe run; evicting its head
+    // and then its middle must leave the rest findable, in the same frames
+    {
+        DriverCache c(4);
+        std::size_t mask = block::detail::table_size(4) - 1;
+        auto home = [mask](uint32_t k) { return (static_cast<uint64_t>(k) * 0x9e3779b97f4a7c15ULL >> 32) & mask; };
+
+        for (key = 100, n = 0; n < 4; key++) {
+            if ((n == 0) || (home(key) == home(chain[0]))) {
+                chain[n++] = key;
+            }
+        }
+        for (i = 0; i < 4; i++) {
+            frame[i] = unit_put(c, chain[i]).frame;
+        }
+        for (key = chain[3] + 1; home(key) == home(chain[0]); key++)
+            ;
+        ok &= unit_check(unit_put(c, key).evicted == chain[0], "head of the run not evicted");
+        for (i = 1; i < 4; i++) {
+            p = c.get(chain[i]);
+            ok &= unit_check(p == frame[i], "frame moved or lost after erasing the head of its run");
+            ok &= unit_check((p != nullptr) && unit_frame_is(p, chain[i]), "frame contents changed by an erase");
+        }
+        unit_put(c, chain[1]);
+        unit_put(c, chain[3]);
+        ok &= unit_check(unit_put(c, key + 1).evicted == chain[2], "middle of the run not evicted");
+        ok &= unit_check(!c.contains(chain[0]) && !c.contains(chain[2]), "erased keys still found");
+        ok &= unit_check((c.get(chain[1]) == frame[1]) && (c.get(chain[3]) == frame[3]),
+            "frames moved or lost after erasing the middle of their run");
+        ok &= unit_check(unit_frame_is(frame[1], chain[1]) && unit_frame_is(frame[3], chain[3]),
+            "frame contents changed by a middle erase");
+    }
+
+    // Front cache entries retire when their frame is put by another thread
+    set_block_front_cache(1);
+    set_block_cache_size(2);
+    init_block_cache();
+    unit_put_block(1);
+    unit_put_block(other);
+    get_block_cache(0, other);
+    get_block_front_cache_stats(&hits, &lookups);
+    p = static_cast<unsigned char*>(get_block_cache(0, other));
+    get_block_front_cache_stats(&hits2, &lookups2);
+    ok &= unit_check((hits2 == hits + 1) && (lookups2 == lookups + 1), "repeated lookup not answered up front");
+    pthread_create(&thread, NULL, unit_put_thread, &other);
+    pthread_join(thread, NULL);
+    p = static_cast<unsigned char*>(get_block_cache(0, other));
+    get_block_front_cache_stats(&hits, &lookups);
+    ok &= unit_check((hits == hits2) && (lookups == lookups2 + 1), "front entry used after another thread's put");
+    ok &= unit_check((p != NULL) && unit_frame_is(p, other), "wrong frame after another thread's put");
+
+    // ... and when their frame is evicted
+    get_block_cache(0, 1);
+    unit_put_block(5);
+    unit_put_block(6);
+    ok &= unit_check(get_block_cache(0, 1) == NULL, "front entry used after its frame was evicted");
+    ok &= unit_check(get_block_cache(0, other) == NULL, "front entry used after another frame was evicted");
+
+    // ... and when the cache is closed and made again
+    p = static_cast<unsigned char*>(get_block_cache(0, 6));
+    ok &= unit_check((p != NULL) && unit_frame_is(p, 6), "put frame not found");
+    close_block_cache();
+    init_block_cache();
+    ok &= unit_check(get_block_cache(0, 6) == NULL, "front entry used after the cache was closed");
+    get_block_front_cache_stats(&hits, &lookups);
+    ok &= unit_check((hits == 0) && (lookups == 1), "front counters not reset at init");
+
+    // Leave the cache as it was found
+    close_block_cache();
+    set_block_cache_size(saved_size);
+    set_block_front_cache(saved_front);
+    if (!ok) {
+        return (-1);
+    }
+
+    // Return successfully
+    logMessage(LOG_OUTPUT_LEVEL, "Cache unit test completed successfully.");
+    return (0);
+}
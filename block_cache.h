@@ -16,6 +16,7 @@
 
 // Defines
 #define DEFAULT_BLOCK_FRAME_CACHE_SIZE 1024 // Default size for cache
+#define BLOCK_FRONT_CACHE_ENTRIES 256 // Entries in each thread's front cache (a power of two)
 
 ///
 // Cache Interfaces
@@ -32,9 +33,24 @@ int close_block_cache(void);
 int put_block_cache(BlockIndex blk, BlockFrameIndex frm, void* frame);
 // Put an object into the object cache, evicting other items as necessary
 
+int stream_block_cache(BlockIndex blk, BlockFrameIndex frm, void* frame);
+// The same, copying the frame in with streaming stores (see block_copy.h)
+
 void* get_block_cache(BlockIndex blk, BlockFrameIndex frm);
 // Get an object from the cache (and return it)
 
+int peek_block_cache(BlockIndex blk, BlockFrameIndex frm);
+// Check whether a frame is cached (not counted as a hit or miss)
+
+void get_block_cache_stats(uint64_t* hits, uint64_t* misses);
+// Get the number of cache lookups that hit and missed since init
+
+void set_block_front_cache(int enabled);
+// Turn the per-thread front caches in front of the cache on (default) or off
+
+void get_block_front_cache_stats(uint64_t* hits, uint64_t* lookups);
+// Get the number of lookups the front caches answered, and made, since init
+
 //
 // Unit test
 
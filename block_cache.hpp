@@ -0,0 +1,328 @@
+#ifndef BLOCK_CACHE_HPP_INCLUDED
+#define BLOCK_CACHE_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_cache.hpp
+//  Description    : This is the compile-time specialized frame cache.
+//                   block::frame_cache<Key, FrameSize, Policy, Capacity>
+//                   keeps the frames in one array, finds them through an
+//                   open addressing table and orders them on a recency list
+//                   that the Policy's static hooks move entries on.  With a
+//                   fixed Capacity the storage is inline and every size is a
+//                   constant, and the policy hooks and frame copies inline.
+//                   With dynamic_capacity the size is set at construction
+//                   (this is how block_cache.h is built).
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace block {
+
+inline constexpr std::size_t dynamic_capacity = 0; // Capacity chosen at run time
+
+//
+// Policies: where a frame goes on the recency list when it is read (on_get)
+// or written (on_put), and which frame to evict (victim).  New frames go to
+// the front.
+
+// Least recently used
+struct lru {
+    template <class List>
+    static void on_get(List& list, uint32_t slot) noexcept { list.move_to_front(slot); }
+    template <class List>
+    static void on_put(List& list, uint32_t slot) noexcept { list.move_to_front(slot); }
+    template <class List>
+    static uint32_t victim(const List& list) noexcept { return list.back(); }
+};
+
+// Least recently written (reads do not reorder, the BLOCK driver's cache)
+struct lru_on_put {
+    template <class List>
+    static void on_get(List&, uint32_t) noexcept {}
+    template <class List>
+    static void on_put(List& list, uint32_t slot) noexcept { list.move_to_front(slot); }
+    template <class List>
+    static uint32_t victim(const List& list) noexcept { return list.back(); }
+};
+
+// First in, first out
+struct fifo {
+    template <class List>
+    static void on_get(List&, uint32_t) noexcept {}
+    template <class List>
+    static void on_put(List&, uint32_t) noexcept {}
+    template <class List>
+    static uint32_t victim(const List& list) noexcept { return list.back(); }
+};
+
+namespace detail {
+
+    // An array of N elements, inline, or on the heap when N is dynamic
+    template <class T, std::size_t N>
+    struct storage {
+        explicit storage(std::size_t) noexcept {}
+        T* data() noexcept { return items; }
+        const T* data() const noexcept { return items; }
+        T& operator[](std::size_t i) noexcept { return items[i]; }
+        const T& operator[](std::size_t i) const noexcept { return items[i]; }
+        T items[N];
+    };
+
+    template <class T>
+    struct storage<T, dynamic_capacity> {
+        explicit storage(std::size_t n) : items(std::make_unique<T[]>(n)) {}
+        T* data() noexcept { return items.get(); }
+        const T* data() const noexcept { return items.get(); }
+        T& operator[](std::size_t i) noexcept { return items[i]; }
+        const T& operator[](std::size_t i) const noexcept { return items[i]; }
+        std::unique_ptr<T[]> items;
+    };
+
+    // The smallest power of two at least twice n (the table size)
+    constexpr std::size_t table_size(std::size_t n) noexcept
+    {
+        std::size_t s = 2;
+        while (s < 2 * n) {
+            s <<= 1;
+        }
+        return s;
+    }
+
+    // A frame, aligned for whole-frame copies
+    template <std::size_t FrameSize>
+    struct alignas(64) frame {
+        unsigned char bytes[FrameSize];
+    };
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : frame_cache
+// Description  : A fixed size cache of FrameSize byte frames keyed by Key.
+//                Lookups count hits and misses; contains() does not.
+
+template <class Key, std::size_t FrameSize, class Policy = lru, std::size_t Capacity = dynamic_capacity>
+class frame_cache {
+public:
+    static constexpr std::size_t frame_size = FrameSize;
+    static constexpr uint32_t none = UINT32_MAX; // No slot
+
+    // The recency list the policy works on (slot indexes, front is newest)
+    class recency_list {
+    public:
+        void move_to_front(uint32_t slot) noexcept
+        {
+            if (slot != head_) {
+                unlink(slot);
+                push_front(slot);
+            }
+        }
+        uint32_t front() const noexcept { return head_; }
+        uint32_t back() const noexcept { return tail_; }
+        uint32_t next(uint32_t slot) const noexcept { return next_[slot]; }
+
+    private:
+        friend class frame_cache;
+        explicit recency_list(std::size_t n) : prev_(n), next_(n) {}
+
+        void push_front(uint32_t slot) noexcept
+        {
+            prev_[slot] = none;
+            next_[slot] = head_;
+            if (head_ != none) {
+                prev_[head_] = slot;
+            } else {
+                tail_ = slot;
+            }
+            head_ = slot;
+        }
+        void unlink(uint32_t slot) noexcept
+        {
+            (prev_[slot] != none ? next_[prev_[slot]] : head_) = next_[slot];
+            (next_[slot] != none ? prev_[next_[slot]] : tail_) = prev_[slot];
+        }
+
+        detail::storage<uint32_t, Capacity> prev_, next_; // Links by slot
+        uint32_t head_ = none, tail_ = none; // Newest and oldest slots
+    };
+
+    frame_cache() requires(Capacity != dynamic_capacity)
+        : frame_cache(Capacity)
+    {
+    }
+
+    explicit frame_cache(std::size_t capacity)
+        : capacity_(Capacity != dynamic_capacity ? Capacity : (capacity ? capacity : 1))
+        , mask_(detail::table_size(capacity_) - 1)
+        , frames_(capacity_)
+        , keys_(capacity_)
+        , list_(capacity_)
+        , table_(mask_ + 1)
+    {
+        clear();
+    }
+
+    // Find a frame (nullptr if not cached), counting a hit or miss
+    unsigned char* get(const Key& key) noexcept
+    {
+        uint32_t slot = find(key);
+        if (slot == none) {
+            misses_++;
+            return nullptr;
+        }
+        hits_++;
+        Policy::on_get(list_, slot);
+        return frames_.data()[slot].bytes;
+    }
+
+    // Check whether a frame is cached, without counting it
+    bool contains(const Key& key) const noexcept { return find(key) != none; }
+
+    // What a put did: where the frame is now, and the key it evicted (if any)
+    struct put_result {
+        unsigned char* frame;
+        std::optional<Key> evicted;
+    };
+
+    // Cache a copy of a frame, evicting one if full
+    put_result put(const Key& key, const void* frame) noexcept
+    {
+        return put(key, frame, [](void* dst, const void* src) { std::memcpy(dst, src, FrameSize); });
+    }
+
+    // The same, copying the frame in with copy(dst, src)
+    template <class Copy>
+    put_result put(const Key& key, const void* frame, Copy&& copy) noexcept
+    {
+        std::optional<Key> evicted;
+        uint32_t slot = find(key);
+
+        if (slot != none) {
+            Policy::on_put(list_, slot);
+        } else {
+            if (size_ < capacity()) {
+                slot = static_cast<uint32_t>(size_++);
+            } else {
+                slot = Policy::victim(list_);
+                list_.unlink(slot);
+                evicted = keys_.data()[slot];
+                erase(*evicted);
+            }
+            keys_.data()[slot] = key;
+            insert(key, slot);
+            list_.push_front(slot);
+        }
+        unsigned char* dst = frames_.data()[slot].bytes;
+        if (dst != frame) {
+            copy(dst, frame);
+        }
+        return { dst, evicted };
+    }
+
+    // Drop every frame and zero the counters
+    void clear() noexcept
+    {
+        std::memset(table_.data(), 0, sizeof(uint32_t) * (mask_ + 1));
+        list_.head_ = list_.tail_ = none;
+        size_ = 0;
+        hits_ = misses_ = 0;
+    }
+
+    constexpr std::size_t capacity() const noexcept
+    {
+        if constexpr (Capacity != dynamic_capacity) {
+            return Capacity;
+        } else {
+            return capacity_;
+        }
+    }
+    std::size_t size() const noexcept { return size_; }
+    uint64_t hits() const noexcept { return hits_; }
+    uint64_t misses() const noexcept { return misses_; }
+    const recency_list& order() const noexcept { return list_; }
+
+private:
+    // Home table position of a key
+    std::size_t home(const Key& key) const noexcept
+    {
+        return (static_cast<uint64_t>(std::hash<Key> {}(key)) * 0x9e3779b97f4a7c15ULL >> 32) & table_mask();
+    }
+
+    std::size_t table_mask() const noexcept
+    {
+        if constexpr (Capacity != dynamic_capacity) {
+            return detail::table_size(Capacity) - 1;
+        } else {
+            return mask_;
+        }
+    }
+
+    // The slot of a key, or none (table entries are slot + 1, 0 empty)
+    uint32_t find(const Key& key) const noexcept
+    {
+        const uint32_t* table = table_.data();
+        for (std::size_t i = home(key);; i = (i + 1) & table_mask()) {
+            if (table[i] == 0) {
+                return none;
+            }
+            if (keys_.data()[table[i] - 1] == key) {
+                return table[i] - 1;
+            }
+        }
+    }
+
+    void insert(const Key& key, uint32_t slot) noexcept
+    {
+        uint32_t* table = table_.data();
+        std::size_t i = home(key);
+        while (table[i] != 0) {
+            i = (i + 1) & table_mask();
+        }
+        table[i] = slot + 1;
+    }
+
+    // Remove a key, shifting later entries of its run back (no tombstones)
+    void erase(const Key& key) noexcept
+    {
+        uint32_t* table = table_.data();
+        std::size_t i = home(key), j, k;
+
+        while (keys_.data()[table[i] - 1] != key) {
+            i = (i + 1) & table_mask();
+        }
+        table[i] = 0;
+        for (j = (i + 1) & table_mask(); table[j] != 0; j = (j + 1) & table_mask()) {
+            k = home(keys_.data()[table[j] - 1]);
+            if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j))) {
+                continue;
+            }
+            table[i] = table[j];
+            table[j] = 0;
+            i = j;
+        }
+    }
+
+    std::size_t capacity_; // Frames held
+    std::size_t mask_; // Table size - 1
+    detail::storage<detail::frame<FrameSize>, Capacity> frames_; // The frames by slot
+    detail::storage<Key, Capacity> keys_; // The key of each slot
+    recency_list list_; // Slot order for the policy
+    detail::storage<uint32_t, (Capacity != dynamic_capacity ? detail::table_size(Capacity) : dynamic_capacity)>
+        table_; // Key to slot + 1
+    std::size_t size_ = 0; // Slots in use
+    uint64_t hits_ = 0, misses_ = 0; // Lookups counted
+};
+
+} // namespace block
+
+#endif
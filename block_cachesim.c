@@ -0,0 +1,819 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_cachesim.c
+//  Description    : This is an offline cache policy simulator for the BLOCK
+//                   frame cache.  It reads a frame access trace, either the
+//                   access log written by block_sim --access-log or the bus
+//                   trace in a verbose (-v) block_sim log, and simulates LRU,
+//                   CLOCK, ARC, W-TinyLFU and Belady's optimal policy (OPT)
+//                   at each cache size, in parallel.  It prints the hit ratio
+//                   of every policy and size, and its gap to OPT, as a CSV.
+//
+//                   Every access (read or write) looks up and then holds the
+//                   frame, as the driver cache does, so the LRU results match
+//                   the block_sim --sweep ones.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_controller.h>
+#include <block_sweep.h>
+
+// Defines
+#define CACHESIM_ARGUMENTS "hs:p:j:"
+#define CACHESIM_MAX_JOBS 64 // Most simulation threads
+#define CACHESIM_MAX_LINE 1024 // Longest trace line
+#define CACHESIM_FRAMES BLOCK_BLOCK_SIZE // Frames on the device
+#define CACHESIM_LISTS 4 // Most lists a policy keeps
+#define CACHESIM_NODES (CACHESIM_FRAMES + CACHESIM_LISTS) // Frames plus a head for each list
+#define CACHESIM_NEVER UINT32_MAX // Next use of a frame never used again
+#define USAGE                                                                                \
+    "USAGE: block_cachesim [-h] [-s <min>:<max>:x<f>] [-p <list>] [-j <n>] <trace>\n"        \
+    "\n"                                                                                     \
+    "where:\n"                                                                               \
+    "    -h - help mode (display this message)\n"                                            \
+    "    -s - cache sizes to simulate, x<f> multiplies and +<s> adds (default 16:4096:x2)\n" \
+    "    -p - comma separated policies: lru, clock, arc, tinylfu (default all, OPT is\n"     \
+    "         always simulated)\n"                                                           \
+    "    -j - simulation threads (default 4)\n"                                              \
+    "\n"                                                                                     \
+    "    <trace> - a block_sim --access-log file or a block_sim -v log\n"                    \
+    "\n"
+
+// A frame trace, and the next use of each access (for OPT)
+typedef struct {
+    uint16_t* frames; // The frame of each access
+    uint32_t* next; // Index of the next access to the same frame
+    uint64_t count; // Number of accesses
+    uint64_t alloc; // Allocated size of frames
+    uint64_t writes; // Number of those that were writes
+} CachesimTrace;
+
+// Doubly linked lists threaded through the frames.  Node CACHESIM_FRAMES + l
+// is the head of list l, and where[] says which list (+1) a frame is on.
+typedef struct {
+    int32_t prev[CACHESIM_NODES]; // Previous node (towards the MRU end)
+    int32_t next[CACHESIM_NODES]; // Next node (towards the LRU end)
+    uint8_t where[CACHESIM_FRAMES]; // List of each frame + 1, 0 if none
+    uint32_t count[CACHESIM_LISTS]; // Frames on each list
+} CachesimLists;
+
+// A policy simulation, returns the number of hits
+typedef uint64_t (*CachesimPolicy)(const CachesimTrace* trace, uint32_t size);
+
+// The policies
+typedef enum {
+    CACHESIM_LRU = 0,
+    CACHESIM_CLOCK = 1,
+    CACHESIM_ARC = 2,
+    CACHESIM_TINYLFU = 3,
+    CACHESIM_OPT = 4,
+    CACHESIM_MAXVAL = 5,
+} CachesimPolicyType;
+
+// The work shared by the simulation threads
+typedef struct {
+    const CachesimTrace* trace; // The trace
+    const uint32_t* sizes; // The cache sizes
+    int nsizes; // Number of sizes
+    const int* policies; // The policies
+    int npolicies; // Number of policies
+    uint64_t* hits; // Hits of each policy (row) and size (column)
+    pthread_mutex_t lock; // Protects next
+    int next; // Next simulation to run
+} CachesimShared;
+
+//
+// Functional Prototypes
+
+static int read_trace(const char* name, CachesimTrace* trace);
+static void* cachesim_worker(void* arg);
+static uint64_t simulate_lru(const CachesimTrace* trace, uint32_t size);
+static uint64_t simulate_clock(const CachesimTrace* trace, uint32_t size);
+static uint64_t simulate_arc(const CachesimTrace* trace, uint32_t size);
+static uint64_t simulate_tinylfu(const CachesimTrace* trace, uint32_t size);
+static uint64_t simulate_opt(const CachesimTrace* trace, uint32_t size);
+static CachesimLists* create_lists(int nlists);
+static void list_push(CachesimLists* l, int list, int32_t f);
+static void list_remove(CachesimLists* l, int32_t f);
+static int32_t list_lru(CachesimLists* l, int list);
+static uint32_t sketch_estimate(const uint8_t* sketch, uint32_t mask, uint16_t f);
+static void sketch_increment(uint8_t* sketch, uint32_t mask, uint16_t f);
+static void heap_push(uint64_t* heap, uint64_t* n, uint64_t v);
+static uint64_t heap_pop(uint64_t* heap, uint64_t* n);
+
+//
+// Global Data
+
+static const char* policy_names[CACHESIM_MAXVAL] = { "lru", "clock", "arc", "tinylfu", "opt" };
+static const CachesimPolicy policy_funcs[CACHESIM_MAXVAL] = {
+    simulate_lru, simulate_clock, simulate_arc, simulate_tinylfu, simulate_opt
+};
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the cache policy simulator
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main(int argc, char* argv[])
+{
+    // Local variables
+    uint32_t sizes[BLOCK_SWEEP_MAX_SIZES];
+    int policies[CACHESIM_MAXVAL], npolicies = 0, nsizes, jobs = 4, started, ch, i, p, s;
+    pthread_t threads[CACHESIM_MAX_JOBS];
+    CachesimTrace trace;
+    CachesimShared shared;
+    uint64_t hits, opt;
+    char* tok;
+
+    nsizes = parse_block_sweep("16:4096:x2", sizes, BLOCK_SWEEP_MAX_SIZES);
+
+    // Process the command line parameters
+    while ((ch = getopt(argc, argv, CACHESIM_ARGUMENTS)) != -1) {
+        switch (ch) {
+        case 'h': // Help, print usage
+            fprintf(stderr, USAGE);
+            return (-1);
+
+        case 's': // Cache sizes
+            if ((nsizes = parse_block_sweep(optarg, sizes, BLOCK_SWEEP_MAX_SIZES)) <= 0) {
+                return (-1);
+            }
+            break;
+
+        case 'p': // Policies
+            for (tok = strtok(optarg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+                for (p = 0; (p < CACHESIM_OPT) && (strcmp(tok, policy_names[p]) != 0); p++)
+                    ;
+                for (i = 0; (i < npolicies) && (policies[i] != p); i++)
+                    ;
+                if ((p == CACHESIM_OPT) || (i < npolicies)) {
+                    fprintf(stderr, "Bad or repeated policy [%s].\n", tok);
+                    return (-1);
+                }
+                policies[npolicies++] = p;
+            }
+            break;
+
+        case 'j': // Threads
+            if ((sscanf(optarg, "%d", &jobs) != 1) || (jobs < 1) || (jobs > CACHESIM_MAX_JOBS)) {
+                fprintf(stderr, "Bad thread count [%s], must be 1-%d.\n", optarg, CACHESIM_MAX_JOBS);
+                return (-1);
+            }
+            break;
+
+        default: // Default (unknown)
+            fprintf(stderr, "Unknown command line option (%c), aborting.\n", ch);
+            return (-1);
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "Missing trace file, aborting.\n\n" USAGE);
+        return (-1);
+    }
+    if (npolicies == 0) {
+        for (p = 0; p < CACHESIM_OPT; p++) {
+            policies[npolicies++] = p;
+        }
+    }
+    policies[npolicies++] = CACHESIM_OPT;
+
+    // Read the trace
+    if (read_trace(argv[optind], &trace) != 0) {
+        return (-1);
+    }
+
+    // Run every policy at every size, the threads taking them in turn
+    shared.trace = &trace;
+    shared.sizes = sizes;
+    shared.nsizes = nsizes;
+    shared.policies = policies;
+    shared.npolicies = npolicies;
+    shared.hits = calloc(npolicies * nsizes, sizeof(uint64_t));
+    shared.next = 0;
+    pthread_mutex_init(&shared.lock, NULL);
+    for (started = 0; (started < jobs - 1) && (started < npolicies * nsizes - 1); started++) {
+        if (pthread_create(&threads[started], NULL, cachesim_worker, &shared) != 0) {
+            fprintf(stderr, "Failed creating a simulation thread.\n");
+            break;
+        }
+    }
+    cachesim_worker(&shared);
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&shared.lock);
+
+    // Report, OPT being the last policy
+    printf("cache_size,policy,accesses,hits,hit_ratio,opt_hit_ratio,gap_to_opt\n");
+    for (s = 0; s < nsizes; s++) {
+        opt = shared.hits[(npolicies - 1) * nsizes + s];
+        for (p = 0; p < npolicies; p++) {
+            hits = shared.hits[p * nsizes + s];
+            printf("%u,%s,%" PRIu64 ",%" PRIu64 ",%.4f,%.4f,%.4f\n", sizes[s], policy_names[policies[p]],
+                trace.count, hits, (double)hits / trace.count, (double)opt / trace.count,
+                (double)(opt - hits) / trace.count);
+        }
+    }
+
+    free(shared.hits);
+    free(trace.frames);
+    free(trace.next);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : read_trace
+// Description  : Read the frame accesses from a trace, and work out the next
+//                use of each.  Lines are "R <frame>" or "W <frame>" (an
+//                access log) or the controller's frame read and write lines
+//                (a verbose log); anything else is skipped.
+//
+// Inputs       : name - the trace file
+//                trace - the trace to fill in
+// Outputs      : 0 if successful, -1 if failure
+
+static int read_trace(const char* name, CachesimTrace* trace)
+{
+    char line[CACHESIM_MAX_LINE], op, *p;
+    uint32_t* last;
+    uint64_t i, distinct = 0;
+    unsigned int frm, blk;
+    uint16_t* frames;
+    int write;
+    FILE* fh;
+
+    memset(trace, 0x0, sizeof(CachesimTrace));
+    if ((fh = fopen(name, "r")) == NULL) {
+        fprintf(stderr, "Failure opening trace file [%s], error: %s.\n", name, strerror(errno));
+        return (-1);
+    }
+    while (fgets(line, sizeof(line), fh) != NULL) {
+        if ((sscanf(line, "%c %u", &op, &frm) == 2) && ((op == 'R') || (op == 'W'))) {
+            write = (op == 'W');
+        } else if (((p = strstr(line, "RDFRME: read frame ")) != NULL)
+            && (sscanf(p, "RDFRME: read frame %u from block %u ...", &frm, &blk) == 2) && (strstr(p, "success") == NULL)) {
+            write = 0;
+        } else if (((p = strstr(line, "WRFRME: written frame ")) != NULL)
+            && (sscanf(p, "WRFRME: written frame %u in block %u ...", &frm, &blk) == 2) && (strstr(p, "success") == NULL)) {
+            write = 1;
+        } else {
+            continue;
+        }
+        if (frm >= CACHESIM_FRAMES) {
+            continue;
+        }
+
+        // Add the access
+        if (trace->count == trace->alloc) {
+            trace->alloc = (trace->alloc == 0) ? 65536 : trace->alloc * 2;
+            if ((frames = realloc(trace->frames, sizeof(uint16_t) * trace->alloc)) == NULL) {
+                fprintf(stderr, "Out of memory reading the trace.\n");
+                fclose(fh);
+                return (-1);
+            }
+            trace->frames = frames;
+        }
+        trace->frames[trace->count++] = frm;
+        trace->writes += write;
+    }
+    fclose(fh);
+    if (trace->count == 0) {
+        fprintf(stderr, "No frame accesses found in trace [%s].\n", name);
+        return (-1);
+    }
+    if (trace->count >= CACHESIM_NEVER) {
+        fprintf(stderr, "Trace [%s] has too many accesses, max %u.\n", name, CACHESIM_NEVER - 1);
+        return (-1);
+    }
+
+    // Walk backwards to find the next use of every access
+    trace->next = malloc(sizeof(uint32_t) * trace->count);
+    last = malloc(sizeof(uint32_t) * CACHESIM_FRAMES);
+    for (i = 0; i < CACHESIM_FRAMES; i++) {
+        last[i] = CACHESIM_NEVER;
+    }
+    for (i = trace->count; i-- > 0;) {
+        trace->next[i] = last[trace->frames[i]];
+        last[trace->frames[i]] = i;
+    }
+    for (i = 0; i < CACHESIM_FRAMES; i++) {
+        distinct += (last[i] != CACHESIM_NEVER);
+    }
+    free(last);
+    fprintf(stderr, "Read %" PRIu64 " frame accesses (%" PRIu64 " writes, %" PRIu64 " distinct frames) from [%s].\n",
+        trace->count, trace->writes, distinct, name);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : cachesim_worker
+// Description  : Run simulations until there are none left
+//
+// Inputs       : arg - the shared state
+// Outputs      : NULL
+
+static void* cachesim_worker(void* arg)
+{
+    CachesimShared* shared = arg;
+    int job;
+
+    while (1) {
+        pthread_mutex_lock(&shared->lock);
+        job = shared->next++;
+        pthread_mutex_unlock(&shared->lock);
+        if (job >= shared->npolicies * shared->nsizes) {
+            return (NULL);
+        }
+        shared->hits[job] = policy_funcs[shared->policies[job / shared->nsizes]](shared->trace,
+            shared->sizes[job % shared->nsizes]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_lru
+// Description  : Simulate a least recently used cache
+//
+// Inputs       : trace - the trace
+//                size - the cache size in frames
+// Outputs      : the number of hits
+
+static uint64_t simulate_lru(const CachesimTrace* trace, uint32_t size)
+{
+    CachesimLists* l = create_lists(1);
+    uint64_t i, hits = 0;
+    uint16_t f;
+
+    for (i = 0; i < trace->count; i++) {
+        f = trace->frames[i];
+        if (l->where[f] != 0) {
+            hits++;
+            list_remove(l, f);
+        } else if (l->count[0] == size) {
+            list_remove(l, list_lru(l, 0));
+        }
+        list_push(l, 0, f);
+    }
+    free(l);
+    return (hits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_clock
+// Description  : Simulate a CLOCK (second chance) cache
+//
+// Inputs       : trace - the trace
+//                size - the cache size in frames
+// Outputs      : the number of hits
+
+static uint64_t simulate_clock(const CachesimTrace* trace, uint32_t size)
+{
+    int32_t* slot = malloc(sizeof(int32_t) * CACHESIM_FRAMES);
+    uint16_t* frame = malloc(sizeof(uint16_t) * size);
+    uint8_t* ref = calloc(size, 1);
+    uint32_t hand = 0, used = 0, s;
+    uint64_t i, hits = 0;
+    uint16_t f;
+
+    for (i = 0; i < CACHESIM_FRAMES; i++) {
+        slot[i] = -1;
+    }
+    for (i = 0; i < trace->count; i++) {
+        f = trace->frames[i];
+        if (slot[f] != -1) {
+            hits++;
+            ref[slot[f]] = 1;
+            continue;
+        }
+
+        // Fill the empty slots first, then sweep for one not referenced
+        if (used < size) {
+            s = used++;
+        } else {
+            while (ref[hand]) {
+                ref[hand] = 0;
+                hand = (hand + 1) % size;
+            }
+            s = hand;
+            slot[frame[s]] = -1;
+            hand = (hand + 1) % size;
+        }
+        frame[s] = f;
+        ref[s] = 1;
+        slot[f] = s;
+    }
+    free(slot);
+    free(frame);
+    free(ref);
+    return (hits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_arc
+// Description  : Simulate an adaptive replacement cache (Megiddo and Modha).
+//                T1 and T2 hold the frames seen once and more than once, B1
+//                and B2 the frames recently evicted from each, and the target
+//                size of T1 adapts to hits in the B lists.
+//
+// Inputs       : trace - the trace
+//                size - the cache size in frames
+// Outputs      : the number of hits
+
+static uint64_t simulate_arc(const CachesimTrace* trace, uint32_t size)
+{
+    enum { T1 = 0, T2 = 1, B1 = 2, B2 = 3 };
+    CachesimLists* l = create_lists(4);
+    uint64_t i, hits = 0;
+    double p = 0, d;
+    int32_t v;
+    uint16_t f;
+    int in;
+
+    for (i = 0; i < trace->count; i++) {
+        f = trace->frames[i];
+        in = l->where[f] - 1;
+
+        // Cache hits move to the frequent list
+        if ((in == T1) || (in == T2)) {
+            hits++;
+            list_remove(l, f);
+            list_push(l, T2, f);
+            continue;
+        }
+
+        // Ghost hits adapt the target, other misses make room in the ghosts
+        if (in == B1) {
+            d = (l->count[B1] >= l->count[B2]) ? 1.0 : (double)l->count[B2] / l->count[B1];
+            p = (p + d > size) ? size : p + d;
+            list_remove(l, f);
+        } else if (in == B2) {
+            d = (l->count[B2] >= l->count[B1]) ? 1.0 : (double)l->count[B1] / l->count[B2];
+            p = (p - d < 0) ? 0 : p - d;
+            list_remove(l, f);
+        } else if (l->count[T1] + l->count[B1] == size) {
+            if (l->count[T1] < size) {
+                list_remove(l, list_lru(l, B1));
+            } else {
+                list_remove(l, list_lru(l, T1));
+                list_push(l, T1, f);
+                continue;
+            }
+        } else if ((l->count[T1] + l->count[T2] + l->count[B1] + l->count[B2] == 2 * size)) {
+            list_remove(l, list_lru(l, B2));
+        }
+
+        // Replace, if the cache is full
+        if (l->count[T1] + l->count[T2] == size) {
+            if ((l->count[T1] > 0) && ((l->count[T1] > p) || ((in == B2) && (l->count[T1] == (uint32_t)p)))) {
+                v = list_lru(l, T1);
+                list_remove(l, v);
+                list_push(l, B1, v);
+            } else {
+                v = list_lru(l, T2);
+                list_remove(l, v);
+                list_push(l, B2, v);
+            }
+        }
+        list_push(l, ((in == B1) || (in == B2)) ? T2 : T1, f);
+    }
+    free(l);
+    return (hits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_tinylfu
+// Description  : Simulate a W-TinyLFU cache (Einziger et al.).  New frames
+//                enter a 1% LRU window, and frames leaving the window only
+//                enter the segmented LRU main cache (80% protected) if a
+//                count-min sketch says they are used more often than the
+//                frame they would evict.  The sketch halves its counts every
+//                10 accesses per cache frame, so it follows changes in use.
+//
+// Inputs       : trace - the trace
+//                size - the cache size in frames
+// Outputs      : the number of hits
+
+static uint64_t simulate_tinylfu(const CachesimTrace* trace, uint32_t size)
+{
+    enum { WINDOW = 0, PROBATION = 1, PROTECTED = 2 };
+    CachesimLists* l = create_lists(3);
+    uint32_t window = (size / 100 > 0) ? size / 100 : 1, main = size - window;
+    uint32_t protect = main * 8 / 10, width = 64, j;
+    uint64_t i, hits = 0, samples = 0;
+    uint8_t* sketch;
+    int32_t c, v;
+    uint16_t f;
+
+    // Four rows of 4 bit (saturating) counters, several per cache frame
+    while (width < 8 * size) {
+        width *= 2;
+    }
+    sketch = calloc(4, width);
+
+    for (i = 0; i < trace->count; i++) {
+        f = trace->frames[i];
+        sketch_increment(sketch, width - 1, f);
+        if (++samples == 10 * (uint64_t)size) {
+            for (j = 0; j < 4 * width; j++) {
+                sketch[j] >>= 1;
+            }
+            samples /= 2;
+        }
+
+        switch (l->where[f] - 1) {
+        case WINDOW:
+            hits++;
+            list_remove(l, f);
+            list_push(l, WINDOW, f);
+            continue;
+
+        case PROBATION:
+        case PROTECTED:
+            // Promote, demoting the oldest protected frame if there are too many
+            hits++;
+            list_remove(l, f);
+            list_push(l, PROTECTED, f);
+            if (l->count[PROTECTED] > protect) {
+                v = list_lru(l, PROTECTED);
+                list_remove(l, v);
+                list_push(l, PROBATION, v);
+            }
+            continue;
+        }
+
+        // A miss goes into the window, pushing out its oldest frame
+        list_push(l, WINDOW, f);
+        if (l->count[WINDOW] <= window) {
+            continue;
+        }
+        c = list_lru(l, WINDOW);
+        list_remove(l, c);
+        if (l->count[PROBATION] + l->count[PROTECTED] < main) {
+            list_push(l, PROBATION, c);
+            continue;
+        }
+        if (main == 0) {
+            continue;
+        }
+
+        // The main cache is full, keep the candidate only if it is used more
+        v = (l->count[PROBATION] > 0) ? list_lru(l, PROBATION) : list_lru(l, PROTECTED);
+        if (sketch_estimate(sketch, width - 1, c) > sketch_estimate(sketch, width - 1, v)) {
+            list_remove(l, v);
+            list_push(l, PROBATION, c);
+        }
+    }
+    free(sketch);
+    free(l);
+    return (hits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_opt
+// Description  : Simulate Belady's optimal policy, which evicts the frame
+//                used furthest in the future (or skips caching the new frame
+//                if that is the one).  A max heap of next uses finds it, with
+//                entries dropped lazily once their frame has moved on.
+//
+// Inputs       : trace - the trace
+//                size - the cache size in frames
+// Outputs      : the number of hits
+
+static uint64_t simulate_opt(const CachesimTrace* trace, uint32_t size)
+{
+    uint32_t* next = malloc(sizeof(uint32_t) * CACHESIM_FRAMES);
+    uint8_t* in = calloc(CACHESIM_FRAMES, 1);
+    uint64_t max = 2 * (uint64_t)size + CACHESIM_FRAMES;
+    uint64_t* heap = malloc(sizeof(uint64_t) * (max + 1));
+    uint64_t i, j, n = 0, k, top, hits = 0, cached = 0;
+    uint32_t nx;
+    uint16_t f;
+
+    for (i = 0; i < trace->count; i++) {
+        f = trace->frames[i];
+        nx = trace->next[i];
+        if (in[f]) {
+            hits++;
+        } else if (cached < size) {
+            in[f] = 1;
+            cached++;
+        } else {
+            // Find the cached frame used furthest away, skipping stale entries
+            for (top = heap[0]; !in[top & 0xffff] || (next[top & 0xffff] != (top >> 16)); top = heap[0]) {
+                heap_pop(heap, &n);
+            }
+            if ((top >> 16) <= nx) {
+                continue;
+            }
+            heap_pop(heap, &n);
+            in[top & 0xffff] = 0;
+            in[f] = 1;
+        }
+        next[f] = nx;
+
+        // Rebuild the heap from the live entries once it fills with stale ones
+        if (n == max) {
+            for (j = 0, k = n, n = 0; j < k; j++) {
+                if (in[heap[j] & 0xffff] && (next[heap[j] & 0xffff] == (heap[j] >> 16))) {
+                    heap_push(heap, &n, heap[j]);
+                }
+            }
+        }
+        heap_push(heap, &n, ((uint64_t)nx << 16) | f);
+    }
+    free(next);
+    free(in);
+    free(heap);
+    return (hits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : create_lists
+// Description  : Create a set of empty frame lists
+//
+// Inputs       : nlists - the number of lists (up to CACHESIM_LISTS)
+// Outputs      : the lists
+
+static CachesimLists* create_lists(int nlists)
+{
+    CachesimLists* l = calloc(1, sizeof(CachesimLists));
+    int i;
+
+    for (i = 0; i < nlists; i++) {
+        l->prev[CACHESIM_FRAMES + i] = l->next[CACHESIM_FRAMES + i] = CACHESIM_FRAMES + i;
+    }
+    return (l);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : list_push
+// Description  : Put a frame (on no list) at the MRU end of a list
+//
+// Inputs       : l - the lists
+//                list - the list
+//                f - the frame
+// Outputs      : none
+
+static void list_push(CachesimLists* l, int list, int32_t f)
+{
+    int32_t head = CACHESIM_FRAMES + list;
+
+    l->next[f] = l->next[head];
+    l->prev[f] = head;
+    l->prev[l->next[head]] = f;
+    l->next[head] = f;
+    l->where[f] = list + 1;
+    l->count[list]++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : list_remove
+// Description  : Take a frame off its list
+//
+// Inputs       : l - the lists
+//                f - the frame
+// Outputs      : none
+
+static void list_remove(CachesimLists* l, int32_t f)
+{
+    l->next[l->prev[f]] = l->next[f];
+    l->prev[l->next[f]] = l->prev[f];
+    l->count[l->where[f] - 1]--;
+    l->where[f] = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : list_lru
+// Description  : The frame at the LRU end of a (non-empty) list
+//
+// Inputs       : l - the lists
+//                list - the list
+// Outputs      : the frame
+
+static int32_t list_lru(CachesimLists* l, int list)
+{
+    return (l->prev[CACHESIM_FRAMES + list]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sketch_estimate
+// Description  : The count-min estimate of how often a frame was used
+//
+// Inputs       : sketch - the four rows of counters
+//                mask - the row width - 1
+//                f - the frame
+// Outputs      : the estimate
+
+static uint32_t sketch_estimate(const uint8_t* sketch, uint32_t mask, uint16_t f)
+{
+    uint64_t h = (f + 1) * 0x9e3779b97f4a7c15ULL;
+    uint32_t r, est = 15;
+
+    for (r = 0; r < 4; r++, h = (h ^ (h >> 29)) * 0xbf58476d1ce4e5b9ULL) {
+        if (sketch[r * (mask + 1) + ((h >> 32) & mask)] < est) {
+            est = sketch[r * (mask + 1) + ((h >> 32) & mask)];
+        }
+    }
+    return (est);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sketch_increment
+// Description  : Count a use of a frame (counters saturate at 15)
+//
+// Inputs       : sketch - the four rows of counters
+//                mask - the row width - 1
+//                f - the frame
+// Outputs      : none
+
+static void sketch_increment(uint8_t* sketch, uint32_t mask, uint16_t f)
+{
+    uint64_t h = (f + 1) * 0x9e3779b97f4a7c15ULL;
+    uint8_t* c;
+    uint32_t r;
+
+    for (r = 0; r < 4; r++, h = (h ^ (h >> 29)) * 0xbf58476d1ce4e5b9ULL) {
+        c = &sketch[r * (mask + 1) + ((h >> 32) & mask)];
+        if (*c < 15) {
+            (*c)++;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : heap_push
+// Description  : Add a value to a max heap
+//
+// Inputs       : heap - the heap
+//                n - the number of values, updated
+//                v - the value
+// Outputs      : none
+
+static void heap_push(uint64_t* heap, uint64_t* n, uint64_t v)
+{
+    uint64_t i = (*n)++;
+
+    for (; (i > 0) && (heap[(i - 1) / 2] < v); i = (i - 1) / 2) {
+        heap[i] = heap[(i - 1) / 2];
+    }
+    heap[i] = v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : heap_pop
+// Description  : Remove the largest value from a (non-empty) max heap
+//
+// Inputs       : heap - the heap
+//                n - the number of values, updated
+// Outputs      : the value removed
+
+static uint64_t heap_pop(uint64_t* heap, uint64_t* n)
+{
+    uint64_t top = heap[0], v = heap[--(*n)], i = 0, c;
+
+    while ((c = 2 * i + 1) < *n) {
+        if ((c + 1 < *n) && (heap[c + 1] > heap[c])) {
+            c++;
+        }
+        if (heap[c] <= v) {
+            break;
+        }
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = v;
+    return (top);
+}
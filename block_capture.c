@@ -0,0 +1,714 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_capture.c
+//  Description    : This is an LD_PRELOAD library that records the POSIX file
+//                   I/O an application does under a directory as a block_sim
+//                   workload.  Run the application with
+//
+//                      LD_PRELOAD=./libblockcapture.so BLOCK_CAPTURE_DIR=<dir>
+//                          [BLOCK_CAPTURE_OUT=<out>] app
+//
+//                   and <out> (default block_capture) gets:
+//
+//                      capture-workload.txt  - the workload
+//                      capture.payload       - the bytes written, which the
+//                                              workload refers to by @file
+//                      capture-workload.times - ns since start of each line
+//                      <name>                - the final contents of each
+//                                              file, for validation
+//
+//                   Files that already had contents are given an initial
+//                   write of them, so the replay starts from the same state.
+//                   Only the process that first loads the library is
+//                   captured (not its children), and I/O through mmap or
+//                   fcntl(F_DUPFD) and truncation are not seen.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_controller.h>
+#include <block_driver.h>
+#include <block_workload.h>
+
+// Defines
+#define CAPTURE_MAX_FDS 4096 // Descriptors tracked
+#define CAPTURE_MAX_FILE ((int64_t)BLOCK_MAX_FRAME_PER_FILE * BLOCK_FRAME_SIZE) // Largest file the driver holds
+#define CAPTURE_WORKLOAD "capture-workload.txt"
+#define CAPTURE_PAYLOAD "capture.payload"
+#define CAPTURE_TIMES "capture-workload.times"
+
+// A captured file, as the replay will see it
+typedef struct {
+    char name[BLOCK_MAX_PATH_LENGTH]; // The block file name
+    char path[PATH_MAX]; // The real file
+    int64_t size; // Size of the block file
+    int64_t pos; // Position of its handle in the replay
+    int warned; // Already warned it is too big
+} CaptureFile;
+
+//
+// Global Data
+
+static int capture_on = 0; // Capturing at all
+static char capture_dir[PATH_MAX]; // Only files under here are captured
+static size_t capture_dirlen; // Length of capture_dir
+static char capture_out[PATH_MAX]; // Where the results go
+static FILE* capture_wl = NULL; // The workload
+static FILE* capture_times = NULL; // The line timestamps
+static FILE* capture_payload = NULL; // The written bytes
+static int64_t capture_payload_off = 0; // Size of the payload file
+static uint64_t capture_start; // Capture start time
+static CaptureFile capture_files[BLOCK_WORKLOAD_MAX_FILES]; // The captured files
+static int capture_nfiles = 0; // Number of captured files
+static int capture_fd_file[CAPTURE_MAX_FDS]; // File index + 1 of each descriptor
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER; // Protects all of the above
+static __thread int capture_busy = 0; // Set while this thread is in the library
+
+// The real functions
+static int (*real_open)(const char*, int, ...);
+static int (*real_open64)(const char*, int, ...);
+static int (*real_openat)(int, const char*, int, ...);
+static int (*real_creat)(const char*, mode_t);
+static ssize_t (*real_read)(int, void*, size_t);
+static ssize_t (*real_write)(int, const void*, size_t);
+static ssize_t (*real_pread)(int, void*, size_t, off_t);
+static ssize_t (*real_pwrite)(int, const void*, size_t, off_t);
+static off_t (*real_lseek)(int, off_t, int);
+static int (*real_close)(int);
+static int (*real_dup)(int);
+static int (*real_dup2)(int, int);
+static int (*real_dup3)(int, int, int);
+
+//
+// Functional Prototypes
+
+static void capture_init(void) __attribute__((constructor));
+static void capture_fini(void) __attribute__((destructor));
+static void capture_prefork(void);
+static void capture_postfork(void);
+static void capture_postfork_child(void);
+static void resolve_real(void);
+static void track_open(int fd, int flags);
+static void track_dup(int oldfd, int newfd);
+static CaptureFile* tracked(int fd);
+static void emit_line(const char* fmt, ...);
+static void emit_seek(CaptureFile* f, int64_t off);
+static void record_write(CaptureFile* f, int64_t off, const void* buf, int64_t len);
+static void record_read(CaptureFile* f, int64_t off, int64_t len);
+static void snapshot_file(CaptureFile* f);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : capture_init
+// Description  : Read the settings and open the output files when loaded
+//
+// Inputs       : none
+// Outputs      : none
+
+static void capture_init(void)
+{
+    char path[PATH_MAX * 2], pid[32], *dir, *out, *owner;
+    struct timespec ts;
+
+    resolve_real();
+    if (((dir = getenv("BLOCK_CAPTURE_DIR")) == NULL) || (realpath(dir, capture_dir) == NULL)) {
+        return;
+    }
+
+    // Children inherit LD_PRELOAD, leave the capture to the first process
+    snprintf(pid, sizeof(pid), "%d", getpid());
+    if (((owner = getenv("BLOCK_CAPTURE_OWNER")) != NULL) && (strcmp(owner, pid) != 0)) {
+        return;
+    }
+    setenv("BLOCK_CAPTURE_OWNER", pid, 1);
+    pthread_atfork(capture_prefork, capture_postfork, capture_postfork_child);
+    capture_dirlen = strlen(capture_dir);
+    out = getenv("BLOCK_CAPTURE_OUT");
+    snprintf(capture_out, sizeof(capture_out), "%s", (out != NULL) ? out : "block_capture");
+    mkdir(capture_out, 0755);
+
+    // Open the outputs (stdio does not come back through this library)
+    snprintf(path, sizeof(path), "%s/%s", capture_out, CAPTURE_WORKLOAD);
+    capture_wl = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s/%s", capture_out, CAPTURE_TIMES);
+    capture_times = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s/%s", capture_out, CAPTURE_PAYLOAD);
+    capture_payload = fopen(path, "w");
+    if ((capture_wl == NULL) || (capture_times == NULL) || (capture_payload == NULL)) {
+        fprintf(stderr, "block_capture: failed creating the outputs in [%s], not capturing.\n", capture_out);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    capture_start = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    capture_on = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : capture_fini
+// Description  : Snapshot the final contents of the files and close the
+//                outputs when unloaded
+//
+// Inputs       : none
+// Outputs      : none
+
+static void capture_fini(void)
+{
+    int i;
+
+    if (!capture_on) {
+        return;
+    }
+    pthread_mutex_lock(&capture_lock);
+    capture_busy = 1;
+    capture_on = 0;
+    for (i = 0; i < capture_nfiles; i++) {
+        snapshot_file(&capture_files[i]);
+    }
+    fclose(capture_wl);
+    fclose(capture_times);
+    fclose(capture_payload);
+    capture_busy = 0;
+    pthread_mutex_unlock(&capture_lock);
+    fprintf(stderr, "block_capture: captured %d files to [%s].\n", capture_nfiles, capture_out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : capture_prefork, capture_postfork, capture_postfork_child
+// Description  : Keep a forked child from capturing, or from flushing the
+//                parent's buffered output a second time
+//
+// Inputs       : none
+// Outputs      : none
+
+static void capture_prefork(void)
+{
+    pthread_mutex_lock(&capture_lock);
+    if (capture_on) {
+        fflush(capture_wl);
+        fflush(capture_times);
+        fflush(capture_payload);
+    }
+}
+
+static void capture_postfork(void)
+{
+    pthread_mutex_unlock(&capture_lock);
+}
+
+static void capture_postfork_child(void)
+{
+    capture_on = 0;
+    pthread_mutex_unlock(&capture_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : resolve_real
+// Description  : Look up the functions this library wraps
+//
+// Inputs       : none
+// Outputs      : none
+
+static void resolve_real(void)
+{
+    if (real_read != NULL) {
+        return;
+    }
+    real_open = dlsym(RTLD_NEXT, "open");
+    real_open64 = dlsym(RTLD_NEXT, "open64");
+    real_openat = dlsym(RTLD_NEXT, "openat");
+    real_creat = dlsym(RTLD_NEXT, "creat");
+    real_write = dlsym(RTLD_NEXT, "write");
+    real_pread = dlsym(RTLD_NEXT, "pread");
+    real_pwrite = dlsym(RTLD_NEXT, "pwrite");
+    real_lseek = dlsym(RTLD_NEXT, "lseek");
+    real_close = dlsym(RTLD_NEXT, "close");
+    real_dup = dlsym(RTLD_NEXT, "dup");
+    real_dup2 = dlsym(RTLD_NEXT, "dup2");
+    real_dup3 = dlsym(RTLD_NEXT, "dup3");
+    real_read = dlsym(RTLD_NEXT, "read");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Wrapped functions : each calls the real function, then records the I/O if
+//                     the descriptor is a captured file
+//
+
+int open(const char* path, int flags, ...)
+{
+    mode_t mode = 0;
+    va_list ap;
+    int fd;
+
+    resolve_real();
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    fd = real_open(path, flags, mode);
+    track_open(fd, flags);
+    return (fd);
+}
+
+int open64(const char* path, int flags, ...)
+{
+    mode_t mode = 0;
+    va_list ap;
+    int fd;
+
+    resolve_real();
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    fd = real_open64(path, flags, mode);
+    track_open(fd, flags);
+    return (fd);
+}
+
+int openat(int dirfd, const char* path, int flags, ...)
+{
+    mode_t mode = 0;
+    va_list ap;
+    int fd;
+
+    resolve_real();
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    fd = real_openat(dirfd, path, flags, mode);
+    track_open(fd, flags);
+    return (fd);
+}
+
+int creat(const char* path, mode_t mode)
+{
+    int fd;
+
+    resolve_real();
+    fd = real_creat(path, mode);
+    track_open(fd, O_CREAT | O_WRONLY | O_TRUNC);
+    return (fd);
+}
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+    CaptureFile* f;
+    ssize_t r;
+
+    resolve_real();
+    r = real_read(fd, buf, count);
+    if ((r > 0) && ((f = tracked(fd)) != NULL)) {
+        record_read(f, real_lseek(fd, 0, SEEK_CUR) - r, r);
+        pthread_mutex_unlock(&capture_lock);
+    }
+    return (r);
+}
+
+ssize_t write(int fd, const void* buf, size_t count)
+{
+    CaptureFile* f;
+    ssize_t r;
+
+    resolve_real();
+    r = real_write(fd, buf, count);
+    if ((r > 0) && ((f = tracked(fd)) != NULL)) {
+        record_write(f, real_lseek(fd, 0, SEEK_CUR) - r, buf, r);
+        pthread_mutex_unlock(&capture_lock);
+    }
+    return (r);
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t off)
+{
+    CaptureFile* f;
+    ssize_t r;
+
+    resolve_real();
+    r = real_pread(fd, buf, count, off);
+    if ((r > 0) && ((f = tracked(fd)) != NULL)) {
+        record_read(f, off, r);
+        pthread_mutex_unlock(&capture_lock);
+    }
+    return (r);
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t off)
+{
+    CaptureFile* f;
+    ssize_t r;
+
+    resolve_real();
+    r = real_pwrite(fd, buf, count, off);
+    if ((r > 0) && ((f = tracked(fd)) != NULL)) {
+        record_write(f, off, buf, r);
+        pthread_mutex_unlock(&capture_lock);
+    }
+    return (r);
+}
+
+ssize_t pread64(int fd, void* buf, size_t count, off_t off)
+{
+    return (pread(fd, buf, count, off));
+}
+
+ssize_t pwrite64(int fd, const void* buf, size_t count, off_t off)
+{
+    return (pwrite(fd, buf, count, off));
+}
+
+off_t lseek(int fd, off_t off, int whence)
+{
+    CaptureFile* f;
+    off_t r;
+
+    resolve_real();
+    r = real_lseek(fd, off, whence);
+    if ((r >= 0) && ((f = tracked(fd)) != NULL)) {
+        // Seeks past the end only happen in the replay when written to
+        if (r <= f->size) {
+            emit_seek(f, r);
+        }
+        pthread_mutex_unlock(&capture_lock);
+    }
+    return (r);
+}
+
+off_t lseek64(int fd, off_t off, int whence)
+{
+    return (lseek(fd, off, whence));
+}
+
+int close(int fd)
+{
+    resolve_real();
+    if ((fd >= 0) && (fd < CAPTURE_MAX_FDS) && capture_on) {
+        pthread_mutex_lock(&capture_lock);
+        capture_fd_file[fd] = 0;
+        pthread_mutex_unlock(&capture_lock);
+    }
+    return (real_close(fd));
+}
+
+int dup(int oldfd)
+{
+    int fd;
+
+    resolve_real();
+    fd = real_dup(oldfd);
+    track_dup(oldfd, fd);
+    return (fd);
+}
+
+int dup2(int oldfd, int newfd)
+{
+    int fd;
+
+    resolve_real();
+    fd = real_dup2(oldfd, newfd);
+    track_dup(oldfd, fd);
+    return (fd);
+}
+
+int dup3(int oldfd, int newfd, int flags)
+{
+    int fd;
+
+    resolve_real();
+    fd = real_dup3(oldfd, newfd, flags);
+    track_dup(oldfd, fd);
+    return (fd);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : track_open
+// Description  : Start tracking a newly opened descriptor if it is a regular
+//                file under the capture directory.  The first time a file
+//                is seen its existing contents are written, so the replay
+//                starts where the application did.
+//
+// Inputs       : fd - the descriptor (-1 if the open failed)
+//                flags - the open flags
+// Outputs      : none
+
+static void track_open(int fd, int flags)
+{
+    char link[64], path[PATH_MAX], buf[65536];
+    CaptureFile* f = NULL;
+    struct stat st;
+    ssize_t len, n;
+    int64_t off;
+    int i;
+
+    if ((fd < 0) || (fd >= CAPTURE_MAX_FDS) || !capture_on || capture_busy) {
+        return;
+    }
+
+    // Find the real file behind the descriptor
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    if (((len = readlink(link, path, sizeof(path) - 1)) <= 0) || (fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    path[len] = 0x0;
+    if ((strncmp(path, capture_dir, capture_dirlen) != 0) || (path[capture_dirlen] != '/')) {
+        return;
+    }
+
+    pthread_mutex_lock(&capture_lock);
+    capture_busy = 1;
+    for (i = 0; i < capture_nfiles; i++) {
+        if (strcmp(capture_files[i].path, path) == 0) {
+            f = &capture_files[i];
+            break;
+        }
+    }
+
+    // A new file, named by its path under the directory
+    if (f == NULL) {
+        if (capture_nfiles == BLOCK_WORKLOAD_MAX_FILES) {
+            fprintf(stderr, "block_capture: too many files, not capturing [%s].\n", path);
+            goto done;
+        }
+        f = &capture_files[capture_nfiles++];
+        memset(f, 0x0, sizeof(CaptureFile));
+        snprintf(f->path, sizeof(f->path), "%s", path);
+        snprintf(f->name, sizeof(f->name), "%s", path + capture_dirlen + 1);
+        for (i = 0; f->name[i] != 0x0; i++) {
+            if ((f->name[i] == '/') || (f->name[i] == ':') || (f->name[i] <= ' ')) {
+                f->name[i] = '_';
+            }
+        }
+
+        // Bring the block file up to the existing contents
+        if (!(flags & O_TRUNC)) {
+            for (off = 0; (n = real_pread(fd, buf, sizeof(buf), off)) > 0; off += n) {
+                record_write(f, off, buf, n);
+            }
+        }
+    }
+    capture_fd_file[fd] = (f - capture_files) + 1;
+
+done:
+    capture_busy = 0;
+    pthread_mutex_unlock(&capture_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : track_dup
+// Description  : Track a duplicated descriptor as the same file as the
+//                original (or stop tracking it if the original is not)
+//
+// Inputs       : oldfd - the original descriptor
+//                newfd - the new descriptor (-1 if the dup failed)
+// Outputs      : none
+
+static void track_dup(int oldfd, int newfd)
+{
+    if ((oldfd < 0) || (oldfd >= CAPTURE_MAX_FDS) || (newfd < 0) || (newfd >= CAPTURE_MAX_FDS)
+        || (oldfd == newfd) || !capture_on) {
+        return;
+    }
+    pthread_mutex_lock(&capture_lock);
+    capture_fd_file[newfd] = capture_fd_file[oldfd];
+    pthread_mutex_unlock(&capture_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : tracked
+// Description  : Find the captured file of a descriptor, locking the
+//                capture state if there is one
+//
+// Inputs       : fd - the descriptor
+// Outputs      : the file (with the lock held), NULL if not captured
+
+static CaptureFile* tracked(int fd)
+{
+    if ((fd < 0) || (fd >= CAPTURE_MAX_FDS) || !capture_on || capture_busy || (capture_fd_file[fd] == 0)) {
+        return (NULL);
+    }
+    pthread_mutex_lock(&capture_lock);
+    if (capture_fd_file[fd] == 0) {
+        pthread_mutex_unlock(&capture_lock);
+        return (NULL);
+    }
+    return (&capture_files[capture_fd_file[fd] - 1]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : emit_line
+// Description  : Write a workload line and its timestamp
+//
+// Inputs       : fmt - the printf format of the line
+// Outputs      : none
+
+static void emit_line(const char* fmt, ...)
+{
+    struct timespec ts;
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(capture_wl, fmt, ap);
+    va_end(ap);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    fprintf(capture_times, "%" PRIu64 "\n", (uint64_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec - capture_start));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : emit_seek
+// Description  : Write a SEEK line, unless the handle is already there
+//
+// Inputs       : f - the file
+//                off - the offset (no more than the size)
+// Outputs      : none
+
+static void emit_seek(CaptureFile* f, int64_t off)
+{
+    if (f->pos != off) {
+        emit_line("%s SEEK 0 %" PRId64 " :\n", f->name, off);
+        f->pos = off;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : record_write
+// Description  : Record a write at an offset.  The bytes go to the payload
+//                file, a gap past the end is filled with zeros first (as the
+//                real file reads back), and large writes are split.
+//
+// Inputs       : f - the file
+//                off - where the bytes were written
+//                buf - the bytes
+//                len - the number of bytes
+// Outputs      : none
+
+static void record_write(CaptureFile* f, int64_t off, const void* buf, int64_t len)
+{
+    static const char zeros[BLOCK_FRAME_SIZE];
+    const char* data = buf;
+    int64_t n, gap;
+    int zero;
+
+    if ((off + len > CAPTURE_MAX_FILE) && !f->warned) {
+        fprintf(stderr, "block_capture: [%s] grows past the %" PRId64 " byte driver limit.\n", f->name,
+            CAPTURE_MAX_FILE);
+        f->warned = 1;
+    }
+    while (len > 0) {
+        // Fill any hole, then write the data
+        gap = off - f->size;
+        zero = (gap > 0);
+        emit_seek(f, zero ? f->size : off);
+        if (zero) {
+            n = (gap < BLOCK_FRAME_SIZE) ? gap : BLOCK_FRAME_SIZE;
+        } else {
+            n = (len < BLOCK_WORKLOAD_MAX_IO) ? len : BLOCK_WORKLOAD_MAX_IO;
+        }
+        fwrite(zero ? zeros : data, 1, n, capture_payload);
+        emit_line("%s WRITE %" PRId64 " 0 :@file(%s,%" PRId64 ")\n", f->name, n, CAPTURE_PAYLOAD, capture_payload_off);
+        capture_payload_off += n;
+        f->pos += n;
+        if (f->pos > f->size) {
+            f->size = f->pos;
+        }
+        if (!zero) {
+            data += n;
+            off += n;
+            len -= n;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : record_read
+// Description  : Record a read at an offset, split if it is large
+//
+// Inputs       : f - the file
+//                off - where the bytes were read
+//                len - the number of bytes
+// Outputs      : none
+
+static void record_read(CaptureFile* f, int64_t off, int64_t len)
+{
+    int64_t n;
+
+    // Only what the block file holds can be read back
+    if (off >= f->size) {
+        return;
+    }
+    if (off + len > f->size) {
+        len = f->size - off;
+    }
+    emit_seek(f, off);
+    for (; len > 0; len -= n) {
+        n = (len < BLOCK_WORKLOAD_MAX_IO) ? len : BLOCK_WORKLOAD_MAX_IO;
+        emit_line("%s READ %" PRId64 " 0 :\n", f->name, n);
+        f->pos += n;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : snapshot_file
+// Description  : Copy the final contents of a file next to the workload
+//
+// Inputs       : f - the file
+// Outputs      : none
+
+static void snapshot_file(CaptureFile* f)
+{
+    char path[PATH_MAX * 2], buf[65536];
+    int in, out;
+    ssize_t n;
+
+    snprintf(path, sizeof(path), "%s/%s", capture_out, f->name);
+    if ((in = real_open(f->path, O_RDONLY)) == -1) {
+        fprintf(stderr, "block_capture: [%s] is gone, no expected contents.\n", f->path);
+        return;
+    }
+    if ((out = real_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+        fprintf(stderr, "block_capture: failed creating [%s], error: %s.\n", path, strerror(errno));
+        real_close(in);
+        return;
+    }
+    while ((n = real_read(in, buf, sizeof(buf))) > 0) {
+        real_write(out, buf, n);
+    }
+    real_close(in);
+    real_close(out);
+}
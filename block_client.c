@@ -0,0 +1,489 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_client.c
+//  Description    : This is the implementation of the BLOCK service client
+//                   library.  Each call posts one request on the segment's
+//                   ring and waits for its completion, under a lock so the
+//                   process's threads can share the connection.  The last
+//                   BLOCK_CLIENT_STAGING bytes of the data area are kept
+//                   for copying other buffers (and open paths) through.
+//                   block_client_submit posts several requests with one
+//                   wake of the daemon, and block_client_reap takes their
+//                   completions, which the daemon posts in ring order.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_client.h>
+#include <block_driver.h>
+#include <block_service.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define BLOCK_CLIENT_STAGING (1024 * 1024) // Staging area at the end of the data area
+#define BLOCK_CLIENT_SHARED (BLOCK_SERVICE_DATA - BLOCK_CLIENT_STAGING) // Caller's buffer
+
+//
+// Functional Prototypes
+
+static int32_t client_io(uint8_t op, int16_t fd, void* buf, int32_t count, uint32_t loc);
+static int32_t client_call(uint8_t op, int16_t fd, int32_t count, uint32_t loc, uint32_t data);
+static int client_wait(void);
+
+//
+// Global Data
+
+static pthread_mutex_t client_lock = PTHREAD_MUTEX_INITIALIZER; // One call at a time
+static BlockServiceShared* client_sh = NULL; // The segment, NULL if not connected
+static int client_sock = -1; // The socket to the daemon
+static uint32_t client_posted = 0; // Requests posted
+static uint32_t client_done = 0; // Completions taken
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_connect
+// Description  : Connect to the daemon and map the segment it sends
+//
+// Inputs       : path - the socket, NULL for BLOCK_SERVICE_SOCKET
+// Outputs      : 0 if successful, -1 if failure
+
+int block_client_connect(const char* path)
+{
+    struct sockaddr_un addr;
+    BlockServiceShared* sh;
+    int sock, mfd;
+
+    if (path == NULL) {
+        path = BLOCK_SERVICE_SOCKET;
+    }
+    if ((client_sh != NULL) || (strlen(path) >= sizeof(addr.sun_path))) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK client already connected or bad socket [%s].", path);
+        return (-1);
+    }
+
+    // Connect and take the segment
+    memset(&addr, 0x0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+        || (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK client failed connecting to [%s], error: %s.", path, strerror(errno));
+        if (sock != -1) {
+            close(sock);
+        }
+        return (-1);
+    }
+    if ((mfd = block_service_recv_fd(sock)) == -1) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK client got no segment from [%s].", path);
+        close(sock);
+        return (-1);
+    }
+    sh = mmap(NULL, sizeof(BlockServiceShared), PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+    close(mfd);
+    if ((sh == MAP_FAILED) || (sh->magic != BLOCK_SERVICE_MAGIC)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK client failed mapping the segment from [%s].", path);
+        if (sh != MAP_FAILED) {
+            munmap(sh, sizeof(BlockServiceShared));
+        }
+        close(sock);
+        return (-1);
+    }
+
+    pthread_mutex_lock(&client_lock);
+    client_sh = sh;
+    client_sock = sock;
+    client_posted = client_done = 0;
+    pthread_mutex_unlock(&client_lock);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_disconnect
+// Description  : Unmap the segment and hang up (the daemon closes any files
+//                still open)
+//
+// Inputs       : none
+// Outputs      : none
+
+void block_client_disconnect(void)
+{
+    pthread_mutex_lock(&client_lock);
+    if (client_sh != NULL) {
+        munmap(client_sh, sizeof(BlockServiceShared));
+        close(client_sock);
+        client_sh = NULL;
+        client_sock = -1;
+    }
+    pthread_mutex_unlock(&client_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_buffer
+// Description  : Get the part of the data area the caller may use; reads and
+//                writes of buffers inside it are done in place by the daemon
+//
+// Inputs       : len - set to its length
+// Outputs      : the buffer, NULL if not connected
+
+void* block_client_buffer(uint32_t* len)
+{
+    if (len != NULL) {
+        *len = (client_sh != NULL) ? BLOCK_CLIENT_SHARED : 0;
+    }
+    return ((client_sh != NULL) ? client_sh->data : NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_open
+// Description  : Open a file through the daemon
+//
+// Inputs       : path - the file name
+// Outputs      : the file handle if successful, -1 if failure
+
+int16_t block_client_open(char* path)
+{
+    size_t len = strlen(path);
+    int32_t ret = -1;
+
+    if ((len == 0) || (len >= BLOCK_MAX_PATH_LENGTH)) {
+        return (-1);
+    }
+    pthread_mutex_lock(&client_lock);
+    if (client_sh != NULL) {
+        memcpy(client_sh->data + BLOCK_CLIENT_SHARED, path, len);
+        ret = client_call(BLOCK_SVC_OPEN, 0, len, 0, BLOCK_CLIENT_SHARED);
+    }
+    pthread_mutex_unlock(&client_lock);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_close
+// Description  : Close a file through the daemon
+//
+// Inputs       : fd - the file handle
+// Outputs      : 0 if successful, -1 if failure
+
+int16_t block_client_close(int16_t fd)
+{
+    int32_t ret = -1;
+
+    pthread_mutex_lock(&client_lock);
+    if (client_sh != NULL) {
+        ret = client_call(BLOCK_SVC_CLOSE, fd, 0, 0, 0);
+    }
+    pthread_mutex_unlock(&client_lock);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_read, block_client_write
+// Description  : Read or write at the file position through the daemon
+//
+// Inputs       : fd - the file handle
+//                buf - the buffer
+//                count - the bytes to read or write
+// Outputs      : bytes read or written if successful, -1 if failure
+
+int32_t block_client_read(int16_t fd, void* buf, int32_t count)
+{
+    return (client_io(BLOCK_SVC_READ, fd, buf, count, 0));
+}
+
+int32_t block_client_write(int16_t fd, void* buf, int32_t count)
+{
+    return (client_io(BLOCK_SVC_WRITE, fd, buf, count, 0));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_seek
+// Description  : Set the file position through the daemon
+//
+// Inputs       : fd - the file handle
+//                loc - the new position
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t block_client_seek(int16_t fd, uint32_t loc)
+{
+    int32_t ret = -1;
+
+    pthread_mutex_lock(&client_lock);
+    if (client_sh != NULL) {
+        ret = client_call(BLOCK_SVC_SEEK, fd, 0, loc, 0);
+    }
+    pthread_mutex_unlock(&client_lock);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_pread, block_client_pwrite
+// Description  : Read or write at an offset through the daemon
+//
+// Inputs       : fd - the file handle
+//                buf - the buffer
+//                count - the bytes to read or write
+//                loc - the offset in the file
+// Outputs      : bytes read or written if successful, -1 if failure
+
+int32_t block_client_pread(int16_t fd, void* buf, int32_t count, uint32_t loc)
+{
+    return (client_io(BLOCK_SVC_PREAD, fd, buf, count, loc));
+}
+
+int32_t block_client_pwrite(int16_t fd, void* buf, int32_t count, uint32_t loc)
+{
+    return (client_io(BLOCK_SVC_PWRITE, fd, buf, count, loc));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_submit
+// Description  : Post several requests and wake the daemon once.  The
+//                buffers must be inside the caller's part of the data area
+//                (they are not copied), and no more than BLOCK_SERVICE_RING
+//                requests can be in flight.
+//
+// Inputs       : sqes - the requests
+//                n - the number of requests
+// Outputs      : the number posted (0 if the ring is full), -1 if failure
+
+int block_client_submit(const BlockClientSqe* sqes, int n)
+{
+    BlockServiceShared* sh;
+    char* p;
+    int i;
+
+    pthread_mutex_lock(&client_lock);
+    if (((sh = client_sh) == NULL) || (n < 0)) {
+        pthread_mutex_unlock(&client_lock);
+        return (-1);
+    }
+
+    // Check them all first, so a bad one posts nothing
+    for (i = 0; i < n; i++) {
+        p = sqes[i].buf;
+        if ((sqes[i].op == BLOCK_SVC_OPEN) || (sqes[i].op >= BLOCK_SVC_MAXVAL) || (sqes[i].count < 0)
+            || ((sqes[i].count > 0)
+                && ((p < sh->data) || (p > sh->data + BLOCK_CLIENT_SHARED)
+                    || (sqes[i].count > sh->data + BLOCK_CLIENT_SHARED - p)))) {
+            pthread_mutex_unlock(&client_lock);
+            logMessage(LOG_ERROR_LEVEL, "BLOCK client bad request %d of %d submitted (op %d).", i, n, sqes[i].op);
+            return (-1);
+        }
+    }
+
+    // Post what fits, with one store of the tail
+    if (n > BLOCK_SERVICE_RING - (int)(client_posted - client_done)) {
+        n = BLOCK_SERVICE_RING - (client_posted - client_done);
+    }
+    for (i = 0; i < n; i++) {
+        sh->sq[(client_posted + i) % BLOCK_SERVICE_RING] = (BlockServiceRequest) { sqes[i].op, sqes[i].fd,
+            sqes[i].count, sqes[i].loc, (sqes[i].count > 0) ? (char*)sqes[i].buf - sh->data : 0, sqes[i].user_data };
+    }
+    if (n > 0) {
+        client_posted += n;
+        block_service_wake(&sh->sq_tail, client_posted, &sh->server_waiting);
+    }
+    pthread_mutex_unlock(&client_lock);
+    return (n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_reap
+// Description  : Take the completions of submitted requests, in the order
+//                they were submitted
+//
+// Inputs       : cqes - set to the completions
+//                max - the most to take
+//                wait - non-zero to wait for one if none are ready but some
+//                       are in flight
+// Outputs      : the number taken, -1 if failure
+
+int block_client_reap(BlockClientCqe* cqes, int max, int wait)
+{
+    BlockServiceShared* sh;
+    uint32_t tail;
+    int n = 0;
+
+    pthread_mutex_lock(&client_lock);
+    if ((sh = client_sh) == NULL) {
+        pthread_mutex_unlock(&client_lock);
+        return (-1);
+    }
+    if (wait && (max > 0) && (client_done != client_posted) && (client_wait() != 0)) {
+        pthread_mutex_unlock(&client_lock);
+        return (-1);
+    }
+    tail = __atomic_load_n(&sh->cq_tail, __ATOMIC_ACQUIRE);
+    for (; (n < max) && (client_done != tail); n++, client_done++) {
+        cqes[n] = (BlockClientCqe) { sh->cq[client_done % BLOCK_SERVICE_RING].res,
+            sh->cq[client_done % BLOCK_SERVICE_RING].tag };
+    }
+    __atomic_store_n(&sh->cq_head, client_done, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&client_lock);
+    return (n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_client_inflight
+// Description  : Count the requests submitted but not yet reaped
+//
+// Inputs       : none
+// Outputs      : the number of requests
+
+uint32_t block_client_inflight(void)
+{
+    uint32_t n;
+
+    pthread_mutex_lock(&client_lock);
+    n = client_posted - client_done;
+    pthread_mutex_unlock(&client_lock);
+    return (n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : client_io
+// Description  : Run a read or write.  A buffer inside the caller's part of
+//                the data area goes as is, one only partly inside it is
+//                refused, and any other is copied through the staging area
+//                a piece at a time.
+//
+// Inputs       : op - the request
+//                fd - the file handle
+//                buf - the buffer
+//                count - the bytes to read or write
+//                loc - the offset in the file (PREAD, PWRITE)
+// Outputs      : bytes read or written if successful, -1 if failure
+
+static int32_t client_io(uint8_t op, int16_t fd, void* buf, int32_t count, uint32_t loc)
+{
+    char *data, *p = buf;
+    int reading = (op == BLOCK_SVC_READ) || (op == BLOCK_SVC_PREAD);
+    int32_t done = 0, n, ret;
+
+    if (count < 0) {
+        return (-1);
+    }
+    pthread_mutex_lock(&client_lock);
+    if (client_sh == NULL) {
+        pthread_mutex_unlock(&client_lock);
+        return (-1);
+    }
+    data = client_sh->data;
+
+    // In place
+    if ((p >= data) && (p <= data + BLOCK_CLIENT_SHARED) && (count <= data + BLOCK_CLIENT_SHARED - p)) {
+        ret = client_call(op, fd, count, loc, p - data);
+        pthread_mutex_unlock(&client_lock);
+        return (ret);
+    }
+
+    // Anything else touching the data area would be copied over itself
+    if ((count > 0) && (p < data + BLOCK_SERVICE_DATA) && (p + count > data)) {
+        pthread_mutex_unlock(&client_lock);
+        logMessage(LOG_ERROR_LEVEL, "BLOCK client buffer overlaps the end of the shared buffer, count %d.", count);
+        return (-1);
+    }
+
+    // Through the staging area
+    while (done < count) {
+        n = (count - done < BLOCK_CLIENT_STAGING) ? count - done : BLOCK_CLIENT_STAGING;
+        if (!reading) {
+            memcpy(data + BLOCK_CLIENT_SHARED, p + done, n);
+        }
+        if ((ret = client_call(op, fd, n, loc + done, BLOCK_CLIENT_SHARED)) == -1) {
+            pthread_mutex_unlock(&client_lock);
+            return (-1);
+        }
+        if (reading) {
+            memcpy(p + done, data + BLOCK_CLIENT_SHARED, ret);
+        }
+        done += ret;
+        if (ret < n) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&client_lock);
+    return (done);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : client_call
+// Description  : Post a request and wait for the daemon to complete it
+//                (client_lock held, and nothing submitted left to reap)
+//
+// Inputs       : op - the request
+//                fd - the file handle
+//                count - the byte count
+//                loc - the file offset
+//                data - the offset of the buffer in the data area
+// Outputs      : the driver's result, -1 if failure
+
+static int32_t client_call(uint8_t op, int16_t fd, int32_t count, uint32_t loc, uint32_t data)
+{
+    BlockServiceShared* sh = client_sh;
+    int32_t ret;
+
+    if (client_posted != client_done) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK client call with %u submitted requests not reaped.",
+            client_posted - client_done);
+        return (-1);
+    }
+    sh->sq[client_posted % BLOCK_SERVICE_RING] = (BlockServiceRequest) { op, fd, count, loc, data, client_posted };
+    block_service_wake(&sh->sq_tail, ++client_posted, &sh->server_waiting);
+    if (client_wait() != 0) {
+        return (-1);
+    }
+    ret = sh->cq[client_done % BLOCK_SERVICE_RING].res;
+    __atomic_store_n(&sh->cq_head, ++client_done, __ATOMIC_RELEASE);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : client_wait
+// Description  : Wait for a completion to be posted, checking now and then
+//                that the daemon is still there (client_lock held)
+//
+// Inputs       : none
+// Outputs      : 0 if one was posted, -1 if the daemon has gone
+
+static int client_wait(void)
+{
+    struct pollfd pfd = { client_sock, POLLIN, 0 };
+
+    while (block_service_wait(&client_sh->cq_tail, client_done, &client_sh->client_waiting, BLOCK_SERVICE_POLL_MS)
+        != 0) {
+        if (poll(&pfd, 1, 0) > 0) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK client lost the daemon.");
+            return (-1);
+        }
+    }
+    return (0);
+}
@@ -0,0 +1,81 @@
+#ifndef BLOCK_CLIENT_INCLUDED
+#define BLOCK_CLIENT_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_client.h
+//  Description    : This is the client library of the BLOCK service daemon
+//                   (block_server).  The calls mirror block_driver.h and are
+//                   run by the daemon against its driver, so any number of
+//                   processes can share one device and cache.  Buffers inside
+//                   the area from block_client_buffer are used in place,
+//                   ones running past its end are refused, and others are
+//                   copied through the shared segment.  Each call waits for
+//                   its result; block_client_submit and block_client_reap
+//                   instead keep several requests on the ring at once.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// A request for block_client_submit
+typedef struct {
+    uint8_t op; // BlockServiceOp (block_service.h), any but BLOCK_SVC_OPEN
+    int16_t fd; // File handle
+    int32_t count; // Bytes to read or write
+    uint32_t loc; // Offset in the file (SEEK, PREAD, PWRITE)
+    void* buf; // Buffer, inside the area from block_client_buffer
+    uint64_t user_data; // Returned with the completion
+} BlockClientSqe;
+
+// A completion from block_client_reap
+typedef struct {
+    int32_t res; // What the driver call returned
+    uint64_t user_data; // From the request
+} BlockClientCqe;
+
+//
+// Interface functions
+
+int block_client_connect(const char* path);
+// Connect to the daemon on the socket at path (NULL for the default)
+
+void block_client_disconnect(void);
+// Disconnect, the daemon closes any files left open
+
+void* block_client_buffer(uint32_t* len);
+// The buffer the daemon reads and writes in place, its length in *len
+
+int16_t block_client_open(char* path);
+// As block_open, through the daemon
+
+int16_t block_client_close(int16_t fd);
+// As block_close, through the daemon
+
+int32_t block_client_read(int16_t fd, void* buf, int32_t count);
+// As block_read, through the daemon
+
+int32_t block_client_write(int16_t fd, void* buf, int32_t count);
+// As block_write, through the daemon
+
+int32_t block_client_seek(int16_t fd, uint32_t loc);
+// As block_seek, through the daemon
+
+int32_t block_client_pread(int16_t fd, void* buf, int32_t count, uint32_t loc);
+// As block_pread, through the daemon
+
+int32_t block_client_pwrite(int16_t fd, void* buf, int32_t count, uint32_t loc);
+// As block_pwrite, through the daemon
+
+int block_client_submit(const BlockClientSqe* sqes, int n);
+// Post up to n requests with one wake, the number posted (0 with the ring full), -1 if failure
+
+int block_client_reap(BlockClientCqe* cqes, int max, int wait);
+// Take up to max completions in order, waiting for one if wait and any are in flight
+
+uint32_t block_client_inflight(void);
+// Requests submitted but not yet reaped (the other calls fail until it is 0)
+
+#endif
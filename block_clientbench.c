@@ -0,0 +1,347 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_clientbench.c
+//  Description    : This is the throughput benchmark for the BLOCK service
+//                   daemon.  Several client processes each open a file
+//                   through the daemon and read (or write) it at random
+//                   frame-aligned offsets from the shared buffer, one call
+//                   at a time or (with -q) keeping several requests in
+//                   flight.  With -i the same loop runs in this process on
+//                   threads, against its own driver, for comparison.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_buffer.h>
+#include <block_client.h>
+#include <block_controller.h>
+#include <block_driver.h>
+#include <block_service.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define CLIENTBENCH_ARGUMENTS "his:p:n:l:q:w"
+#define CLIENTBENCH_MAX_WORKERS 64 // Most clients
+#define CLIENTBENCH_FILE_FRAMES 64 // Frames in each client's file
+#define CLIENTBENCH_FILE_SIZE (CLIENTBENCH_FILE_FRAMES * BLOCK_FRAME_SIZE)
+#define USAGE                                                                         \
+    "USAGE: block_clientbench [-h] [-i] [-w] [-s <socket>] [-p <n>] [-n <ops>]\n"     \
+    "                         [-l <len>] [-q <depth>]\n"                              \
+    "\n"                                                                              \
+    "where:\n"                                                                        \
+    "    -h - help mode (display this message)\n"                                     \
+    "    -i - in-process: threads on this process's driver, not the daemon\n"         \
+    "    -w - write instead of read\n"                                                \
+    "    -s - the daemon's socket (default " BLOCK_SERVICE_SOCKET ")\n"               \
+    "    -p - number of client processes (threads with -i, default 4)\n"              \
+    "    -n - operations per client (default 100000)\n"                               \
+    "    -l - bytes per operation (default 4096)\n"                                   \
+    "    -q - requests each client keeps in flight (daemon only, default 1)\n"        \
+    "\n"
+
+// The calls a worker makes (the daemon's or the driver's)
+typedef struct {
+    int16_t (*open)(char* path);
+    int16_t (*close)(int16_t fd);
+    int32_t (*pread)(int16_t fd, void* buf, int32_t count, uint32_t loc);
+    int32_t (*pwrite)(int16_t fd, void* buf, int32_t count, uint32_t loc);
+} ClientBenchCalls;
+
+// A worker
+typedef struct {
+    int id; // Worker number
+    const ClientBenchCalls* calls; // What it calls
+    char* buf; // Its buffer
+    int writing; // Write rather than read
+    uint32_t ops; // Operations to time
+    uint32_t len; // Bytes per operation
+    uint32_t depth; // Requests kept in flight (1 for one call at a time)
+    uint64_t ns; // Time taken, 0 on failure
+} ClientBenchWorker;
+
+//
+// Functional Prototypes
+
+static void* run_worker(void* arg);
+static int run_queued(ClientBenchWorker* w, int16_t fd, uint32_t frames);
+static uint64_t clientbench_now(void);
+
+//
+// Global Data
+
+static const ClientBenchCalls service_calls = { block_client_open, block_client_close, block_client_pread,
+    block_client_pwrite };
+static const ClientBenchCalls driver_calls = { block_open, block_close, block_pread, block_pwrite };
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : Start the clients, wait for them and report the total rate
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main(int argc, char* argv[])
+{
+    // Local variables
+    ClientBenchWorker workers[CLIENTBENCH_MAX_WORKERS];
+    pthread_t threads[CLIENTBENCH_MAX_WORKERS];
+    int pipes[CLIENTBENCH_MAX_WORKERS];
+    const char* path = NULL;
+    uint32_t nworkers = 4, ops = 100000, len = BLOCK_FRAME_SIZE, depth = 1, buflen;
+    uint64_t longest = 0;
+    int ch, inproc = 0, writing = 0, failed = 0, p[2];
+    uint32_t i;
+    pid_t pid;
+
+    // Process the command line parameters
+    while ((ch = getopt(argc, argv, CLIENTBENCH_ARGUMENTS)) != -1) {
+        switch (ch) {
+        case 'h': // Help, print usage
+            fprintf(stderr, USAGE);
+            return (-1);
+
+        case 'i': // In-process
+            inproc = 1;
+            break;
+
+        case 'w': // Write
+            writing = 1;
+            break;
+
+        case 's': // Set the socket
+            path = optarg;
+            break;
+
+        case 'p': // Number of clients
+            if ((sscanf(optarg, "%u", &nworkers) != 1) || (nworkers == 0) || (nworkers > CLIENTBENCH_MAX_WORKERS)) {
+                fprintf(stderr, "Bad client count [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'n': // Operations per client
+            if ((sscanf(optarg, "%u", &ops) != 1) || (ops == 0)) {
+                fprintf(stderr, "Bad operation count [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'l': // Bytes per operation
+            if ((sscanf(optarg, "%u", &len) != 1) || (len == 0) || (len > CLIENTBENCH_FILE_SIZE)) {
+                fprintf(stderr, "Bad length [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'q': // Requests in flight
+            if ((sscanf(optarg, "%u", &depth) != 1) || (depth == 0) || (depth > BLOCK_SERVICE_RING)) {
+                fprintf(stderr, "Bad depth [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        default: // Default (unknown)
+            fprintf(stderr, "Unknown command line option (%c), aborting.\n", ch);
+            return (-1);
+        }
+    }
+    if (inproc && (depth > 1)) {
+        fprintf(stderr, "Depth is only for the daemon, aborting.\n");
+        return (-1);
+    }
+    initializeLogWithFilehandle(CMPSC311_LOG_STDERR);
+    BlockControllerLLevel = registerLogLevel("BLOCK_CONTROLLER", 0);
+    BlockDriverLLevel = registerLogLevel("BLOCK_DRIVER", 0);
+    BlockSimulatorLLevel = registerLogLevel("BLOCK_SIMULATOR", 0);
+    for (i = 0; i < nworkers; i++) {
+        workers[i] = (ClientBenchWorker) { i, inproc ? &driver_calls : &service_calls, NULL, writing, ops, len, depth,
+            0 };
+    }
+
+    if (inproc) {
+        // Threads on our own driver
+        if (block_poweron() == -1) {
+            logMessage(LOG_ERROR_LEVEL, "Failed powering on the device.");
+            return (-1);
+        }
+        for (i = 0; i < nworkers; i++) {
+            workers[i].buf = block_buffer_alloc(CLIENTBENCH_FILE_SIZE);
+            pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+        }
+        for (i = 0; i < nworkers; i++) {
+            pthread_join(threads[i], NULL);
+            block_buffer_free(workers[i].buf, CLIENTBENCH_FILE_SIZE);
+        }
+        block_poweroff();
+    } else {
+        // Processes, each with its own connection, reporting back on a pipe
+        for (i = 0; i < nworkers; i++) {
+            if ((pipe(p) == -1) || ((pid = fork()) == -1)) {
+                logMessage(LOG_ERROR_LEVEL, "Failed starting client %u.", i);
+                return (-1);
+            }
+            if (pid == 0) {
+                close(p[0]);
+                if ((block_client_connect(path) == 0)
+                    && ((workers[i].buf = block_client_buffer(&buflen)) != NULL) && (buflen >= CLIENTBENCH_FILE_SIZE)
+                    && (buflen / len >= depth)) {
+                    run_worker(&workers[i]);
+                    block_client_disconnect();
+                }
+                if (write(p[1], &workers[i].ns, sizeof(uint64_t)) != sizeof(uint64_t)) {
+                    _exit(1);
+                }
+                _exit(0);
+            }
+            close(p[1]);
+            pipes[i] = p[0];
+        }
+        for (i = 0; i < nworkers; i++) {
+            if (read(pipes[i], &workers[i].ns, sizeof(uint64_t)) != sizeof(uint64_t)) {
+                workers[i].ns = 0;
+            }
+            close(pipes[i]);
+            wait(NULL);
+        }
+    }
+
+    // The clients run together, so the rate is over the slowest
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].ns == 0) {
+            failed = 1;
+        } else if (workers[i].ns > longest) {
+            longest = workers[i].ns;
+        }
+    }
+    if (failed || (longest == 0)) {
+        logMessage(LOG_ERROR_LEVEL, "A client failed, no result.");
+        return (-1);
+    }
+    printf("%s %u x %u %s of %u B, %u in flight: %.0f ops/s, %.1f MB/s\n", inproc ? "in-process" : "daemon",
+        nworkers, ops, writing ? "pwrites" : "preads", len, depth, (double)nworkers * ops * 1e9 / longest,
+        (double)nworkers * ops * len * 1e3 / longest);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : run_worker
+// Description  : Fill a file, then time reads or writes at random frames
+//
+// Inputs       : arg - the worker
+// Outputs      : NULL (ns is set if it worked)
+
+static void* run_worker(void* arg)
+{
+    ClientBenchWorker* w = arg;
+    uint32_t frames = (CLIENTBENCH_FILE_SIZE - w->len) / BLOCK_FRAME_SIZE + 1, seed = w->id + 1, i;
+    uint64_t start;
+    char name[32];
+    int16_t fd;
+
+    snprintf(name, sizeof(name), "clientbench_%d", w->id);
+    memset(w->buf, 'a' + w->id % 26, CLIENTBENCH_FILE_SIZE);
+    if (((fd = w->calls->open(name)) == -1)
+        || (w->calls->pwrite(fd, w->buf, CLIENTBENCH_FILE_SIZE, 0) != CLIENTBENCH_FILE_SIZE)) {
+        logMessage(LOG_ERROR_LEVEL, "Client %d failed creating [%s].", w->id, name);
+        return (NULL);
+    }
+
+    start = clientbench_now();
+    if (w->depth > 1) {
+        if (run_queued(w, fd, frames) == 0) {
+            w->ns = clientbench_now() - start;
+        }
+        w->calls->close(fd);
+        return (NULL);
+    }
+    for (i = 0; i < w->ops; i++) {
+        seed = seed * 1103515245 + 12345;
+        if ((w->writing ? w->calls->pwrite(fd, w->buf, w->len, (seed >> 8) % frames * BLOCK_FRAME_SIZE)
+                        : w->calls->pread(fd, w->buf, w->len, (seed >> 8) % frames * BLOCK_FRAME_SIZE))
+            != (int32_t)w->len) {
+            logMessage(LOG_ERROR_LEVEL, "Client %d failed an operation.", w->id);
+            w->calls->close(fd);
+            return (NULL);
+        }
+    }
+    w->ns = clientbench_now() - start;
+    w->calls->close(fd);
+    return (NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : run_queued
+// Description  : Time the reads or writes through the daemon with up to
+//                depth requests in flight, each in its own part of the
+//                shared buffer, topping the ring up after every reap
+//
+// Inputs       : w - the worker
+//                fd - its file
+//                frames - the frames an operation can start at
+// Outputs      : 0 if successful, -1 if failure
+
+static int run_queued(ClientBenchWorker* w, int16_t fd, uint32_t frames)
+{
+    BlockClientSqe sqes[BLOCK_SERVICE_RING];
+    BlockClientCqe cqes[BLOCK_SERVICE_RING];
+    uint32_t seed = w->id + 1, submitted = 0, reaped = 0, n;
+    int got, k;
+
+    while (reaped < w->ops) {
+        for (n = 0; (submitted + n < w->ops) && (submitted + n - reaped < w->depth); n++) {
+            seed = seed * 1103515245 + 12345;
+            sqes[n] = (BlockClientSqe) { w->writing ? BLOCK_SVC_PWRITE : BLOCK_SVC_PREAD, fd, w->len,
+                (seed >> 8) % frames * BLOCK_FRAME_SIZE, w->buf + (submitted + n) % w->depth * w->len, submitted + n };
+        }
+        if ((n > 0) && (block_client_submit(sqes, n) != (int)n)) {
+            logMessage(LOG_ERROR_LEVEL, "Client %d failed submitting.", w->id);
+            return (-1);
+        }
+        submitted += n;
+        if ((got = block_client_reap(cqes, w->depth, 1)) <= 0) {
+            logMessage(LOG_ERROR_LEVEL, "Client %d failed reaping.", w->id);
+            return (-1);
+        }
+        for (k = 0; k < got; k++) {
+            if (cqes[k].res != (int32_t)w->len) {
+                logMessage(LOG_ERROR_LEVEL, "Client %d failed an operation.", w->id);
+                return (-1);
+            }
+        }
+        reaped += got;
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : clientbench_now
+// Description  : Get the monotonic time
+//
+// Inputs       : none
+// Outputs      : nanoseconds
+
+static uint64_t clientbench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
@@ -0,0 +1,236 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_copy.c
+//  Description    : This is the implementation of the bulk copy kernels.
+//                   The streaming kernels copy the unaligned head of the
+//                   destination with memcpy, stream the aligned middle four
+//                   vectors at a time, and memcpy the tail.  Non-temporal
+//                   stores are weakly ordered, so a run of streamed copies
+//                   ends with block_copy_fence (an sfence).
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLOCK_COPY_X86
+#endif
+
+// Project Includes
+#include <block_copy.h>
+#include <cmpsc311_log.h>
+
+static size_t copy_threshold = BLOCK_COPY_DEFAULT_THRESHOLD; // Stream at this size or more (0 never)
+static BlockCopyKernel copy_kernel = BLOCK_COPY_AUTO; // The kernel, AUTO until first used
+
+//
+// Functional Prototypes
+
+static BlockCopyKernel resolve_kernel(void);
+#ifdef BLOCK_COPY_X86
+static void copy_stream_sse2(char* dst, const char* src, size_t len);
+static void copy_stream_avx2(char* dst, const char* src, size_t len);
+#endif
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_copy
+// Description  : Copy "len" bytes, with streaming stores if at least the
+//                threshold (and fenced, so it is ordered like memcpy)
+//
+// Inputs       : dst - where to copy to
+//                src - where to copy from
+//                len - bytes to copy
+// Outputs      : none
+
+void block_copy(void* dst, const void* src, size_t len)
+{
+    if ((copy_threshold == 0) || (len < copy_threshold)) {
+        memcpy(dst, src, len);
+        return;
+    }
+    block_copy_stream(dst, src, len);
+    block_copy_fence();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_copy_stream
+// Description  : Copy "len" bytes with streaming stores, whatever the size
+//                (the caller fences once after a run of these)
+//
+// Inputs       : dst - where to copy to
+//                src - where to copy from
+//                len - bytes to copy
+// Outputs      : none
+
+void block_copy_stream(void* dst, const void* src, size_t len)
+{
+    switch (resolve_kernel()) {
+#ifdef BLOCK_COPY_X86
+    case BLOCK_COPY_AVX2:
+        copy_stream_avx2(dst, src, len);
+        break;
+    case BLOCK_COPY_SSE2:
+        copy_stream_sse2(dst, src, len);
+        break;
+#endif
+    default:
+        memcpy(dst, src, len);
+        break;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_copy_fence
+// Description  : Make the streamed stores visible before any later store
+//
+// Inputs       : none
+// Outputs      : none
+
+void block_copy_fence(void)
+{
+#ifdef BLOCK_COPY_X86
+    _mm_sfence();
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : set_block_copy_threshold, get_block_copy_threshold
+// Description  : Set or get the copy size that streams
+//
+// Inputs       : threshold - the size (0 turns streaming off)
+// Outputs      : 0 / the size
+
+int set_block_copy_threshold(size_t threshold)
+{
+    copy_threshold = threshold;
+    return (0);
+}
+
+size_t get_block_copy_threshold(void)
+{
+    return (copy_threshold);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : set_block_copy_kernel
+// Description  : Choose the streaming kernel
+//
+// Inputs       : kernel - the kernel (AUTO picks the best the CPU has)
+// Outputs      : 0 if successful, -1 if the CPU does not have it
+
+int set_block_copy_kernel(BlockCopyKernel kernel)
+{
+    switch (kernel) {
+    case BLOCK_COPY_AUTO:
+    case BLOCK_COPY_MEMCPY:
+        break;
+#ifdef BLOCK_COPY_X86
+    case BLOCK_COPY_SSE2:
+        break;
+    case BLOCK_COPY_AVX2:
+        if (!__builtin_cpu_supports("avx2")) {
+            logMessage(LOG_ERROR_LEVEL, "AVX2 copy kernel requested, CPU does not support it.");
+            return (-1);
+        }
+        break;
+#endif
+    default:
+        logMessage(LOG_ERROR_LEVEL, "Copy kernel %d not available on this CPU.", kernel);
+        return (-1);
+    }
+    copy_kernel = kernel;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : resolve_kernel
+// Description  : Pick the kernel for AUTO the first time it is needed
+//
+// Inputs       : none
+// Outputs      : the kernel to use
+
+static BlockCopyKernel resolve_kernel(void)
+{
+    if (copy_kernel == BLOCK_COPY_AUTO) {
+#ifdef BLOCK_COPY_X86
+        copy_kernel = __builtin_cpu_supports("avx2") ? BLOCK_COPY_AVX2 : BLOCK_COPY_SSE2;
+#else
+        copy_kernel = BLOCK_COPY_MEMCPY;
+#endif
+    }
+    return (copy_kernel);
+}
+
+#ifdef BLOCK_COPY_X86
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : copy_stream_sse2, copy_stream_avx2
+// Description  : Stream a copy 64 (SSE2) or 128 (AVX2) bytes at a time
+//
+// Inputs       : dst - where to copy to
+//                src - where to copy from
+//                len - bytes to copy
+// Outputs      : none
+
+static void copy_stream_sse2(char* dst, const char* src, size_t len)
+{
+    size_t head = (-(uintptr_t)dst) & 15;
+    __m128i a, b, c, d;
+
+    if (head > len) {
+        head = len;
+    }
+    memcpy(dst, src, head);
+    dst += head, src += head, len -= head;
+    for (; len >= 64; dst += 64, src += 64, len -= 64) {
+        a = _mm_loadu_si128((const __m128i*)src);
+        b = _mm_loadu_si128((const __m128i*)(src + 16));
+        c = _mm_loadu_si128((const __m128i*)(src + 32));
+        d = _mm_loadu_si128((const __m128i*)(src + 48));
+        _mm_stream_si128((__m128i*)dst, a);
+        _mm_stream_si128((__m128i*)(dst + 16), b);
+        _mm_stream_si128((__m128i*)(dst + 32), c);
+        _mm_stream_si128((__m128i*)(dst + 48), d);
+    }
+    memcpy(dst, src, len);
+}
+
+__attribute__((target("avx2"))) static void copy_stream_avx2(char* dst, const char* src, size_t len)
+{
+    size_t head = (-(uintptr_t)dst) & 31;
+    __m256i a, b, c, d;
+
+    if (head > len) {
+        head = len;
+    }
+    memcpy(dst, src, head);
+    dst += head, src += head, len -= head;
+    for (; len >= 128; dst += 128, src += 128, len -= 128) {
+        a = _mm256_loadu_si256((const __m256i*)src);
+        b = _mm256_loadu_si256((const __m256i*)(src + 32));
+        c = _mm256_loadu_si256((const __m256i*)(src + 64));
+        d = _mm256_loadu_si256((const __m256i*)(src + 96));
+        _mm256_stream_si256((__m256i*)dst, a);
+        _mm256_stream_si256((__m256i*)(dst + 32), b);
+        _mm256_stream_si256((__m256i*)(dst + 64), c);
+        _mm256_stream_si256((__m256i*)(dst + 96), d);
+    }
+    memcpy(dst, src, len);
+}
+
+#endif
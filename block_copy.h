@@ -0,0 +1,54 @@
+#ifndef BLOCK_COPY_INCLUDED
+#define BLOCK_COPY_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_copy.h
+//  Description    : This is the interface for the driver's bulk copy
+//                   kernels.  Small copies are plain memcpy.  Copies at or
+//                   above the streaming threshold use non-temporal stores
+//                   (AVX2 where the CPU has it, SSE2 otherwise), which write
+//                   around the CPU caches, so a large read does not push
+//                   everyone else's data out of them.  That only pays when
+//                   the reads are bigger than the last level cache (the
+//                   stores themselves are slower), so it is off by default.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stddef.h>
+
+// Defines
+#define BLOCK_COPY_DEFAULT_THRESHOLD 0 // Streaming is off unless a threshold is set
+
+// The streaming store kernels
+typedef enum {
+    BLOCK_COPY_AUTO = 0, // The best the CPU has
+    BLOCK_COPY_MEMCPY = 1, // No streaming, always memcpy
+    BLOCK_COPY_SSE2 = 2, // 16 byte non-temporal stores
+    BLOCK_COPY_AVX2 = 3, // 32 byte non-temporal stores
+} BlockCopyKernel;
+
+//
+// Interface functions
+
+void block_copy(void* dst, const void* src, size_t len);
+// Copy, streaming if "len" is at least the threshold (fenced)
+
+void block_copy_stream(void* dst, const void* src, size_t len);
+// Copy with streaming stores whatever the size (call block_copy_fence after)
+
+void block_copy_fence(void);
+// Order streamed stores before anything written after
+
+int set_block_copy_threshold(size_t threshold);
+// Set the size that streams (0 never streams)
+
+size_t get_block_copy_threshold(void);
+// Get the size that streams (0 if streaming is off)
+
+int set_block_copy_kernel(BlockCopyKernel kernel);
+// Choose the streaming kernel, -1 if the CPU lacks it
+
+#endif
@@ -8,11 +8,13 @@
 //
 
 // Includes
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
 // Project Includes
 #include <block_controller.h>
+#include <block_copy.h>
 #include <block_driver.h>
 #include <cmpsc311_log.h>
 #include <cmpsc311_util.h>
@@ -27,7 +29,7 @@ typedef char frame_t[BLOCK_FRAME_SIZE];
 struct file_data {
     char name[128];
     int size;
-    uint16_t frames[1024];
+    uint16_t frames[BLOCK_MAX_FRAME_PER_FILE];
     int nrFrames;
 };
 typedef struct file_data file_t;
@@ -43,7 +45,9 @@ typedef struct file_handler fh_t;
 extern int init_block_cache(void);
 extern int close_block_cache(void);
 extern int put_block_cache(BlockIndex blk, BlockFrameIndex frm, void* frame);
+extern int stream_block_cache(BlockIndex blk, BlockFrameIndex frm, void* frame);
 extern void* get_block_cache(BlockIndex blk, BlockFrameIndex frm);
+extern int peek_block_cache(BlockIndex blk, BlockFrameIndex frm);
 
 extern int compute_frame_checksum(void* frame, uint32_t* cs1);
 
@@ -55,10 +59,18 @@ int createNewFile(const char* path, file_t* file);
 int openFile(fh_t* handle, file_t* file);
 void closeFile(fh_t* handle);
 int verify_cs1(frame_t frame, uint32_t cs1);
-void executeOpcode(frame_t frame, uint32_t ky1, uint32_t fm1);
+int executeOpcode(frame_t frame, uint32_t ky1, uint32_t fm1);
 int allocateNewFrames(fh_t* handle, int32_t count);
 int getNbFiles(file_t* files);
 int getFreeFrame(file_t* files);
+static int32_t locked_block_poweron(void);
+static int32_t locked_block_poweroff(void);
+static int16_t locked_block_open(char* path);
+static int16_t locked_block_close(int16_t fd);
+static int32_t locked_block_read(int16_t fd, void* buf, int32_t count);
+static int32_t locked_block_write(int16_t fd, void* buf, int32_t count);
+static int32_t locked_block_seek(int16_t fd, uint32_t loc);
+static int32_t locked_block_pio(int16_t fd, void* buf, int32_t count, uint32_t loc, int write);
 
 // Global variables
 int isOn = 0;
@@ -67,10 +79,167 @@ int nbHandles;
 int freeFrameNr;
 file_t files[BLOCK_MAX_TOTAL_FILES];
 fh_t handles[BLOCK_MAX_TOTAL_FILES];
+static pthread_mutex_t block_driver_lock = PTHREAD_MUTEX_INITIALIZER; // Serializes the interface
+static BlockFrameAccessHook access_hook = NULL; // Frame access observer
+static void* access_hook_arg = NULL; // Argument passed to the observer
+static BlockFrameAccessHook prefetch_hook = NULL; // Frame access prefetcher
+static void* prefetch_hook_arg = NULL; // Argument passed to the prefetcher
 
 //
 // Implementation
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Interface functions : each one takes the driver lock around the real work,
+//                       so the driver can be called from several threads
+//
+
+int32_t block_poweron(void)
+{
+    int32_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_poweron();
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+int32_t block_poweroff(void)
+{
+    int32_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_poweroff();
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+int16_t block_open(char* path)
+{
+    int16_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_open(path);
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+int16_t block_close(int16_t fd)
+{
+    int16_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_close(fd);
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+int32_t block_read(int16_t fd, void* buf, int32_t count)
+{
+    int32_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_read(fd, buf, count);
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+int32_t block_write(int16_t fd, void* buf, int32_t count)
+{
+    int32_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_write(fd, buf, count);
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+int32_t block_seek(int16_t fd, uint32_t loc)
+{
+    int32_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_seek(fd, loc);
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+int32_t block_pread(int16_t fd, void* buf, int32_t count, uint32_t loc)
+{
+    int32_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_pio(fd, buf, count, loc, 0);
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+int32_t block_pwrite(int16_t fd, void* buf, int32_t count, uint32_t loc)
+{
+    int32_t ret;
+    pthread_mutex_lock(&block_driver_lock);
+    ret = locked_block_pio(fd, buf, count, loc, 1);
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_set_access_hook
+// Description  : Register a function to see every frame access (NULL to
+//                remove).  The hook runs with the driver lock held.
+//
+// Inputs       : hook - the function to call
+//                arg - passed through to the hook
+// Outputs      : none
+
+void block_set_access_hook(BlockFrameAccessHook hook, void* arg)
+{
+    pthread_mutex_lock(&block_driver_lock);
+    access_hook = hook;
+    access_hook_arg = arg;
+    pthread_mutex_unlock(&block_driver_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_set_prefetch_hook
+// Description  : Register a prefetcher to see every frame access (NULL to
+//                remove).  It runs after the access hook, with the driver
+//                lock held, so it must not call back into the driver.
+//
+// Inputs       : hook - the function to call
+//                arg - passed through to the hook
+// Outputs      : none
+
+void block_set_prefetch_hook(BlockFrameAccessHook hook, void* arg)
+{
+    pthread_mutex_lock(&block_driver_lock);
+    prefetch_hook = hook;
+    prefetch_hook_arg = arg;
+    pthread_mutex_unlock(&block_driver_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_fetch_frame
+// Description  : Read a frame into the cache ahead of its use, unless it is
+//                already there (for prefetching)
+//
+// Inputs       : frm - the frame to read
+// Outputs      : 1 if read, 0 if already cached, -1 if failure
+
+int32_t block_fetch_frame(uint16_t frm)
+{
+    frame_t frame;
+    int32_t ret = 0;
+    pthread_mutex_lock(&block_driver_lock);
+    if (!isOn || (frm < BLOCK_MAX_TOTAL_FILES) || (frm >= freeFrameNr)) {
+        ret = -1;
+    } else if (!peek_block_cache(0, frm)) {
+        if (executeOpcode(frame, BLOCK_OP_RDFRME, frm) != 0) {
+            ret = -1;
+        } else {
+            put_block_cache(0, frm, frame);
+            ret = 1;
+        }
+    }
+    pthread_mutex_unlock(&block_driver_lock);
+    return (ret);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Function     : block_poweron
@@ -79,15 +248,17 @@ fh_t handles[BLOCK_MAX_TOTAL_FILES];
 // Inputs       : none
 // Outputs      : 0 if successful, -1 if failure
 
-int32_t block_poweron(void)
+static int32_t locked_block_poweron(void)
 {
     int i;
     // Check that the device is not already on
     if (isOn) {
         return -1;
     }
-    // Call the INITMS opcode
-    executeOpcode(NULL, BLOCK_OP_INITMS, 0);
+    // Call the INITMS opcode (the controller can only be initialized once)
+    if (executeOpcode(NULL, BLOCK_OP_INITMS, 0) != 0) {
+        return -1;
+    }
     isOn = 1;
     // Call the BZERO opcode
     executeOpcode(NULL, BLOCK_OP_BZERO, 0);
@@ -115,7 +286,7 @@ int32_t block_poweron(void)
 // Inputs       : none
 // Outputs      : 0 if successful, -1 if failure
 
-int32_t block_poweroff(void)
+static int32_t locked_block_poweroff(void)
 {
     // Check that the device is powered on
     if (!isOn) {
@@ -129,6 +300,7 @@ int32_t block_poweroff(void)
     nbFiles = 0;
     nbHandles = 0;
     freeFrameNr = 0;
+    isOn = 0;
 	//clear and cleanup the cache
 	printf("closing the cache\n");
 	if (close_block_cache()!=0)
@@ -145,7 +317,7 @@ int32_t block_poweroff(void)
 // Inputs       : path - filename of the file to open
 // Outputs      : file handle if successful, -1 if failure
 
-int16_t block_open(char* path)
+static int16_t locked_block_open(char* path)
 {
     int i;
     int found;
@@ -158,12 +330,18 @@ int16_t block_open(char* path)
     found = 0;
     i = 0;
     while (i < nbFiles && !found) {
-        if (memcmp(files[i].name, path, strlen(path)) == 0) {
+        if (strncmp(files[i].name, path, BLOCK_MAX_PATH_LENGTH) == 0) {
             found = 1;
         } else {
             i++;
         }
     }
+    // Find a free handle, reusing closed ones
+    for (fd = 0; fd < BLOCK_MAX_TOTAL_FILES && handles[fd].status == OPEN; fd++)
+        ;
+    if (fd == BLOCK_MAX_TOTAL_FILES || (!found && nbFiles == BLOCK_MAX_TOTAL_FILES)) {
+        return -1;
+    }
     // If no, create/init it
     if (!found) {
         createNewFile(path, &files[nbFiles]);
@@ -171,9 +349,10 @@ int16_t block_open(char* path)
         nbFiles++;
     }
     // Open the file
-    openFile(&handles[nbHandles], &files[i]);
-    fd = nbHandles;
-    nbHandles++;
+    openFile(&handles[fd], &files[i]);
+    if (fd >= nbHandles) {
+        nbHandles = fd + 1;
+    }
     // THIS SHOULD RETURN A FILE HANDLE
     return (fd);
 }
@@ -186,7 +365,7 @@ int16_t block_open(char* path)
 // Inputs       : fd - the file descriptor
 // Outputs      : 0 if successful, -1 if failure
 
-int16_t block_close(int16_t fd)
+static int16_t locked_block_close(int16_t fd)
 {
     // Check that the device is on
     if (!isOn) {
@@ -206,14 +385,18 @@ int16_t block_close(int16_t fd)
 //
 // Function     : block_read
 // Description  : Reads "count" bytes from the file handle "fh" into the
-//                buffer "buf"
+//                buffer "buf".  Cached frames are copied straight into buf,
+//                and whole frames that miss are read into it (so frame
+//                aligned buffers, see block_buffer.h, avoid any bounce).
+//                Reads of the block_copy.h threshold or more use streaming
+//                stores, for the copies and for filling the cache.
 //
 // Inputs       : fd - filename of the file to read from
 //                buf - pointer to buffer to read into
 //                count - number of bytes to read
 // Outputs      : bytes read if successful, -1 if failure
 
-int32_t block_read(int16_t fd, void* buf, int32_t count)
+static int32_t locked_block_read(int16_t fd, void* buf, int32_t count)
 {
     int32_t remaining;
     int32_t bufOffset;
@@ -222,6 +405,7 @@ int32_t block_read(int16_t fd, void* buf, int32_t count)
     int32_t data_size;
     int32_t loc;
     int32_t fileSize;
+    int stream;
     frame_t frame;
     file_t* file;
     // Check that the device is on
@@ -239,6 +423,8 @@ int32_t block_read(int16_t fd, void* buf, int32_t count)
     if (fileSize - loc < count) {
     	count = fileSize - loc;
     }
+    // Large reads stream, so they do not flush the CPU caches
+    stream = (get_block_copy_threshold() != 0) && ((uint32_t)count >= get_block_copy_threshold());
     // While we haven't read `count` or reached the end of the file:
     remaining = count;
     bufOffset = 0;
@@ -246,27 +432,44 @@ int32_t block_read(int16_t fd, void* buf, int32_t count)
     while (remaining != 0) {
         frame_offset = loc % BLOCK_FRAME_SIZE;
         frame_nr = file->frames[loc / BLOCK_FRAME_SIZE];
-		cacheBuf = NULL;
+		if (access_hook != NULL)
+			access_hook(access_hook_arg, frame_nr, 0);
+		if (prefetch_hook != NULL)
+			prefetch_hook(prefetch_hook_arg, frame_nr, 0);
+        if (BLOCK_FRAME_SIZE - frame_offset > remaining) {
+        	data_size = remaining;
+        } else {
+        	data_size = BLOCK_FRAME_SIZE - frame_offset;
+        }
 		cacheBuf = get_block_cache(0,frame_nr);
 		if (cacheBuf != NULL) {
-			memcpy(frame,cacheBuf,BLOCK_FRAME_SIZE); 
+			//  Copy straight out of the cache
+			if (stream)
+				block_copy_stream(buf + bufOffset, cacheBuf + frame_offset, data_size);
+			else
+				memcpy(buf + bufOffset, cacheBuf + frame_offset, data_size);
+		}
+		else if (data_size == BLOCK_FRAME_SIZE) {
+			//  A whole frame, read it into the caller's buffer
+			executeOpcode(buf + bufOffset, BLOCK_OP_RDFRME, frame_nr);
+			if (stream)
+				stream_block_cache(0,frame_nr,buf + bufOffset);
+			else
+				put_block_cache(0,frame_nr,buf + bufOffset);
 		}
 		else {
-        	//  Call the RDFRME opcode
+        	//  Call the RDFRME opcode, and copy the relevant part over
         	executeOpcode(frame, BLOCK_OP_RDFRME, frame_nr);
 			put_block_cache(0,frame_nr,frame);
+			memcpy(buf + bufOffset, frame + frame_offset, data_size);
 		}
-        //  Copy the relevant contents of the frame over to the buffer
-        if (BLOCK_FRAME_SIZE - frame_offset > remaining) {
-        	data_size = remaining;
-        } else {
-        	data_size = BLOCK_FRAME_SIZE - frame_offset;
-        }
-        memcpy(buf + bufOffset, frame + frame_offset, data_size);
         bufOffset += data_size;
         loc += data_size;
         remaining -= data_size;
 	}
+    if (stream) {
+        block_copy_fence();
+    }
     handles[fd].loc = loc;
     // Return successfully
     return (count);
@@ -283,7 +486,7 @@ int32_t block_read(int16_t fd, void* buf, int32_t count)
 //                count - number of bytes to write
 // Outputs      : bytes written if successful, -1 if failure
 
-int32_t block_write(int16_t fd, void* buf, int32_t count)
+static int32_t locked_block_write(int16_t fd, void* buf, int32_t count)
 {
     int32_t loc;
     int32_t remaining;
@@ -291,6 +494,7 @@ int32_t block_write(int16_t fd, void* buf, int32_t count)
     int32_t frame_nr;
     int32_t bufOffset;
     int32_t data_size;
+    int stream;
     file_t* file;
     frame_t frame;
     // Check that the file handle is correct (file exists, is open, ...)
@@ -306,10 +510,16 @@ int32_t block_write(int16_t fd, void* buf, int32_t count)
     remaining = count;
     bufOffset = 0;
 	void *cacheBuf = NULL;
+    // Large writes fill the cache with streaming stores
+    stream = (get_block_copy_threshold() != 0) && ((uint32_t)count >= get_block_copy_threshold());
     // While we have not written `count`:
     while (remaining > 0) {
         frame_nr = file->frames[loc / BLOCK_FRAME_SIZE];
         frame_offset = loc % BLOCK_FRAME_SIZE;
+		if (access_hook != NULL)
+			access_hook(access_hook_arg, frame_nr, 1);
+		if (prefetch_hook != NULL)
+			prefetch_hook(prefetch_hook_arg, frame_nr, 1);
 		//update the cache
 		cacheBuf = NULL;
 		cacheBuf = get_block_cache(0,frame_nr);
@@ -329,14 +539,22 @@ int32_t block_write(int16_t fd, void* buf, int32_t count)
         memcpy(frame + frame_offset, (char*)buf + bufOffset, data_size);
         //  Call the WRFRME opcode to write the frame buffer
         executeOpcode(frame, BLOCK_OP_WRFRME, frame_nr);
-		put_block_cache(0,frame_nr,frame);
+		if (stream)
+			stream_block_cache(0,frame_nr,frame);
+		else
+			put_block_cache(0,frame_nr,frame);
         loc += data_size;
         bufOffset += data_size;
         remaining -= data_size;
     }
+    if (stream) {
+        block_copy_fence();
+    }
     // Return successfully
     handles[fd].loc = loc;
-    file->size += count;
+    if (loc > file->size) {
+        file->size = loc;
+    }
     return (count);
 }
 
@@ -349,7 +567,7 @@ int32_t block_write(int16_t fd, void* buf, int32_t count)
 //                loc - offfset of file in relation to beginning of file
 // Outputs      : 0 if successful, -1 if failure
 
-int32_t block_seek(int16_t fd, uint32_t loc)
+static int32_t locked_block_seek(int16_t fd, uint32_t loc)
 {
     // Check that the file handle is correct (file exists, is open, ...)
     if (handles[fd].status == CLOSED || handles[fd].file->size < loc) {
@@ -361,6 +579,37 @@ int32_t block_seek(int16_t fd, uint32_t loc)
     return (0);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_pread / block_pwrite
+// Description  : Read or write "count" bytes at "loc", leaving the file
+//                position where it was (the seek and the I/O happen under
+//                one hold of the lock, so other threads cannot move it)
+//
+// Inputs       : fd - the file handle
+//                buf - the buffer to read into or write from
+//                count - number of bytes
+//                loc - offset in the file
+//                write - 1 to write, 0 to read
+// Outputs      : bytes read or written if successful, -1 if failure
+
+static int32_t locked_block_pio(int16_t fd, void* buf, int32_t count, uint32_t loc, int write)
+{
+    int saved;
+    int32_t ret;
+    // Check the handle and count before touching the position
+    if (fd < 0 || fd >= BLOCK_MAX_TOTAL_FILES || handles[fd].status == CLOSED || count < 0) {
+        return -1;
+    }
+    saved = handles[fd].loc;
+    if (locked_block_seek(fd, loc) == -1) {
+        return -1;
+    }
+    ret = write ? locked_block_write(fd, buf, count) : locked_block_read(fd, buf, count);
+    handles[fd].loc = saved;
+    return (ret);
+}
+
 // Packs the given register
 BlockXferRegister pack(uint32_t ky1, uint32_t fm1, uint32_t cs1, uint32_t rt1)
 {
@@ -390,7 +639,7 @@ void closeAllFiles(fh_t* handles)
 // Creates a new file with the given path
 int createNewFile(const char* path, file_t* file)
 {
-    memcpy(file->name, path, strlen(path));
+    strncpy(file->name, path, sizeof(file->name) - 1);
     file->size = 0;
     file->nrFrames = 0;
     return 0;
@@ -427,8 +676,9 @@ int verify_cs1(frame_t frame, uint32_t cs1)
 }
 
 // Given a frame buffer, an instruction and a frame number,
-// executes the instruction
-void executeOpcode(frame_t frame, uint32_t ky1, uint32_t fm1)
+// executes the instruction (frame transfers are retried until their
+// checksums match, anything else fails on the first error)
+int executeOpcode(frame_t frame, uint32_t ky1, uint32_t fm1)
 {
     uint32_t rt1, cs1, cs1_comp;
     BlockXferRegister regstate;
@@ -445,9 +695,11 @@ void executeOpcode(frame_t frame, uint32_t ky1, uint32_t fm1)
         if (ky1 == BLOCK_OP_RDFRME) {
             compute_frame_checksum(frame, &cs1_comp);
             rt1 = (cs1 == cs1_comp) ? 0 : -1;
+        } else if ((ky1 != BLOCK_OP_WRFRME) && (rt1 != 0)) {
+            return (-1);
         }
     }
-    return;
+    return (0);
 }
 
 // Given a file handle and a number of bytes to write to a file,
@@ -459,6 +711,10 @@ int allocateNewFrames(fh_t* handle, int32_t count)
     nrFrames = handle->file->nrFrames;
     loc = handle->loc;
     while (loc + count > nrFrames * BLOCK_FRAME_SIZE) {
+        //  If the file is already as big as it can be, return -1
+        if (nrFrames == BLOCK_MAX_FRAME_PER_FILE) {
+            return -1;
+        }
         handle->file->frames[nrFrames] = freeFrameNr;
         freeFrameNr++;
         nrFrames++;
@@ -16,7 +16,10 @@
 // Defines
 #define BLOCK_MAX_TOTAL_FILES 1024 // Maximum number of files ever
 #define BLOCK_MAX_PATH_LENGTH 128 // Maximum length of filename length
-#define BLOCK_MAX_FRAME_PER_FILE 1024 // Maximum number of frames per file
+#define BLOCK_MAX_FRAME_PER_FILE 4096 // Maximum number of frames per file
+
+// Called for every frame the driver reads (write = 0) or writes (write = 1)
+typedef void (*BlockFrameAccessHook)(void* arg, uint16_t frm, int write);
 
 //
 // Interface functions
@@ -42,4 +45,19 @@ int32_t block_write(int16_t fd, void* buf, int32_t count);
 int32_t block_seek(int16_t fd, uint32_t loc);
 // Seek to specific point in the file
 
+int32_t block_pread(int16_t fd, void* buf, int32_t count, uint32_t loc);
+// Reads "count" bytes at "loc" without moving the file position
+
+int32_t block_pwrite(int16_t fd, void* buf, int32_t count, uint32_t loc);
+// Writes "count" bytes at "loc" without moving the file position
+
+void block_set_access_hook(BlockFrameAccessHook hook, void* arg);
+// Register a function to see every frame access (NULL to remove)
+
+void block_set_prefetch_hook(BlockFrameAccessHook hook, void* arg);
+// Register a prefetcher to see every frame access (NULL to remove)
+
+int32_t block_fetch_frame(uint16_t frm);
+// Read a frame into the cache ahead of use, 1 if read, 0 if already cached
+
 #endif
@@ -0,0 +1,380 @@
+#ifndef BLOCK_DRIVER_HPP_INCLUDED
+#define BLOCK_DRIVER_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_driver.hpp
+//  Description    : This is the header-only C++ interface to the BLOCK
+//                   driver.  block::Device owns the power state and
+//                   block::File owns an open file handle, closing it when it
+//                   goes out of scope.  I/O takes std::span buffers and
+//                   returns block::result, which holds either the value or a
+//                   block::errc.  Every member is inline and forwards
+//                   straight to the C call in block_driver.h (compare the
+//                   cxx_ and block_ rows of block_bench).
+//
+//                   Requires C++20 (std::span).  With C++23, block::result
+//                   is std::expected.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#if __has_include(<expected>)
+#include <expected>
+#endif
+
+// Project Includes
+extern "C" {
+#include <block_driver.h>
+}
+
+namespace block {
+
+// Why a call failed (the C interface only reports -1, so this names the call)
+enum class errc {
+    ok = 0,
+    bad_handle, // The file is not open
+    bad_argument, // The path or buffer is too long
+    power_on_failed, // block_poweron failed
+    power_off_failed, // block_poweroff failed
+    open_failed, // block_open failed
+    close_failed, // block_close failed
+    read_failed, // block_read or block_pread failed
+    write_failed, // block_write or block_pwrite failed
+    seek_failed, // block_seek failed (past the end of the file)
+};
+
+// The std::error_category of block::errc, for std::error_code
+inline const std::error_category& error_category() noexcept
+{
+    struct category : std::error_category {
+        const char* name() const noexcept override { return "block"; }
+        std::string message(int ev) const override
+        {
+            switch (static_cast<errc>(ev)) {
+            case errc::ok: return "success";
+            case errc::bad_handle: return "file is not open";
+            case errc::bad_argument: return "path or buffer too long";
+            case errc::power_on_failed: return "power on failed";
+            case errc::power_off_failed: return "power off failed";
+            case errc::open_failed: return "open failed";
+            case errc::close_failed: return "close failed";
+            case errc::read_failed: return "read failed";
+            case errc::write_failed: return "write failed";
+            case errc::seek_failed: return "seek failed";
+            }
+            return "unknown error";
+        }
+    };
+    static const category cat;
+    return cat;
+}
+
+inline std::error_code make_error_code(errc e) noexcept
+{
+    return { static_cast<int>(e), error_category() };
+}
+
+#if defined(__cpp_lib_expected) && (__cpp_lib_expected >= 202202L)
+
+// A value or the reason there is none
+template <class T>
+using result = std::expected<T, errc>;
+
+namespace detail {
+    inline std::unexpected<errc> fail(errc e) noexcept { return std::unexpected<errc>(e); }
+}
+
+#else
+
+namespace detail {
+    // The error half of a result (stands in for std::unexpected)
+    struct failure {
+        errc err;
+    };
+    inline failure fail(errc e) noexcept { return { e }; }
+}
+
+// A value or the reason there is none (the subset of std::expected used here)
+template <class T>
+class result {
+public:
+    result(T&& v) noexcept : val_(std::move(v)), err_(errc::ok) {}
+    result(const T& v) : val_(v), err_(errc::ok) {}
+    result(detail::failure f) noexcept : val_(), err_(f.err) {}
+
+    bool has_value() const noexcept { return err_ == errc::ok; }
+    explicit operator bool() const noexcept { return has_value(); }
+    errc error() const noexcept { return err_; }
+
+    T& value() &
+    {
+        check();
+        return val_;
+    }
+    const T& value() const&
+    {
+        check();
+        return val_;
+    }
+    T&& value() &&
+    {
+        check();
+        return std::move(val_);
+    }
+    T& operator*() noexcept { return val_; }
+    const T& operator*() const noexcept { return val_; }
+    T* operator->() noexcept { return &val_; }
+    const T* operator->() const noexcept { return &val_; }
+    template <class U>
+    T value_or(U&& other) const& { return has_value() ? val_ : static_cast<T>(std::forward<U>(other)); }
+
+private:
+    void check() const
+    {
+        if (!has_value()) {
+            throw std::system_error(make_error_code(err_));
+        }
+    }
+
+    T val_; // The value (default constructed on failure)
+    errc err_; // ok, or why it failed
+};
+
+// A success or the reason for failure
+template <>
+class result<void> {
+public:
+    result() noexcept : err_(errc::ok) {}
+    result(detail::failure f) noexcept : err_(f.err) {}
+
+    bool has_value() const noexcept { return err_ == errc::ok; }
+    explicit operator bool() const noexcept { return has_value(); }
+    errc error() const noexcept { return err_; }
+    void value() const
+    {
+        if (!has_value()) {
+            throw std::system_error(make_error_code(err_));
+        }
+    }
+
+private:
+    errc err_; // ok, or why it failed
+};
+
+#endif
+
+class File;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : Device
+// Description  : Owns the BLOCK device power state.  The destructor powers
+//                the device off (closing every file).  The controller can
+//                only be initialized once per process, so power on once.
+
+class Device {
+public:
+    Device() noexcept = default;
+    Device(const Device&) = delete;
+    Device& operator=(const Device&) = delete;
+    Device(Device&& other) noexcept : on_(std::exchange(other.on_, false)) {}
+    Device& operator=(Device&& other) noexcept
+    {
+        if (this != &other) {
+            (void)power_off();
+            on_ = std::exchange(other.on_, false);
+        }
+        return *this;
+    }
+    ~Device() { (void)power_off(); }
+
+    // Power the device on and initialize the filesystem
+    static result<Device> power_on() noexcept
+    {
+        if (block_poweron() != 0) {
+            return detail::fail(errc::power_on_failed);
+        }
+        Device dev;
+        dev.on_ = true;
+        return dev;
+    }
+
+    // Power the device off, closing every file (nothing if already off)
+    result<void> power_off() noexcept
+    {
+        if (on_) {
+            on_ = false;
+            if (block_poweroff() != 0) {
+                return detail::fail(errc::power_off_failed);
+            }
+        }
+        return {};
+    }
+
+    bool is_on() const noexcept { return on_; }
+    explicit operator bool() const noexcept { return on_; }
+
+    // Open (creating if needed) a file on this device
+    inline result<File> open(std::string_view path) const noexcept;
+
+private:
+    bool on_ = false; // Powered on by this object
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : File
+// Description  : Owns an open BLOCK file handle (move-only).  The destructor
+//                closes it.  Powering the device off closes every file, so
+//                close files first to see their close errors.
+
+class File {
+public:
+    File() noexcept = default;
+    explicit File(int16_t fd) noexcept : fd_(fd) {}
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+    File(File&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+    File& operator=(File&& other) noexcept
+    {
+        if (this != &other) {
+            (void)close();
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+    ~File() { (void)close(); }
+
+    // Open (creating if needed) a file
+    static result<File> open(std::string_view path) noexcept
+    {
+        char name[BLOCK_MAX_PATH_LENGTH];
+        int16_t fd;
+
+        // The C call wants a terminated, writable name
+        if (path.size() >= sizeof(name)) {
+            return detail::fail(errc::bad_argument);
+        }
+        std::memcpy(name, path.data(), path.size());
+        name[path.size()] = '\0';
+        if ((fd = block_open(name)) == -1) {
+            return detail::fail(errc::open_failed);
+        }
+        return File(fd);
+    }
+
+    // Read from the file position, returns the bytes read (short at the end)
+    result<std::size_t> read(std::span<std::byte> buf) noexcept
+    {
+        if (errc e = check(buf.size()); e != errc::ok) {
+            return detail::fail(e);
+        }
+        return done(block_read(fd_, buf.data(), static_cast<int32_t>(buf.size())), errc::read_failed);
+    }
+
+    // Write at the file position, returns the bytes written
+    result<std::size_t> write(std::span<const std::byte> buf) noexcept
+    {
+        if (errc e = check(buf.size()); e != errc::ok) {
+            return detail::fail(e);
+        }
+        return done(block_write(fd_, const_cast<std::byte*>(buf.data()), static_cast<int32_t>(buf.size())),
+            errc::write_failed);
+    }
+
+    // Read at an offset, leaving the file position alone
+    result<std::size_t> pread(std::span<std::byte> buf, uint32_t loc) noexcept
+    {
+        if (errc e = check(buf.size()); e != errc::ok) {
+            return detail::fail(e);
+        }
+        return done(block_pread(fd_, buf.data(), static_cast<int32_t>(buf.size()), loc), errc::read_failed);
+    }
+
+    // Write at an offset, leaving the file position alone
+    result<std::size_t> pwrite(std::span<const std::byte> buf, uint32_t loc) noexcept
+    {
+        if (errc e = check(buf.size()); e != errc::ok) {
+            return detail::fail(e);
+        }
+        return done(block_pwrite(fd_, const_cast<std::byte*>(buf.data()), static_cast<int32_t>(buf.size()), loc),
+            errc::write_failed);
+    }
+
+    // Move the file position (not past the end of the file)
+    result<void> seek(uint32_t loc) noexcept
+    {
+        if (fd_ < 0) {
+            return detail::fail(errc::bad_handle);
+        }
+        if (block_seek(fd_, loc) != 0) {
+            return detail::fail(errc::seek_failed);
+        }
+        return {};
+    }
+
+    // Close the file now rather than at destruction (nothing if not open)
+    result<void> close() noexcept
+    {
+        if (fd_ >= 0 && block_close(std::exchange(fd_, -1)) != 0) {
+            return detail::fail(errc::close_failed);
+        }
+        return {};
+    }
+
+    // Give up ownership of the handle without closing it
+    int16_t release() noexcept { return std::exchange(fd_, -1); }
+
+    int16_t native_handle() const noexcept { return fd_; }
+    bool is_open() const noexcept { return fd_ >= 0; }
+    explicit operator bool() const noexcept { return is_open(); }
+
+private:
+    // Check the handle and that the size fits the C count
+    errc check(std::size_t size) const noexcept
+    {
+        if (fd_ < 0) {
+            return errc::bad_handle;
+        }
+        if (size > static_cast<std::size_t>(INT32_MAX)) {
+            return errc::bad_argument;
+        }
+        return errc::ok;
+    }
+
+    // Turn a C return into a result
+    static result<std::size_t> done(int32_t ret, errc err) noexcept
+    {
+        if (ret < 0) {
+            return detail::fail(err);
+        }
+        return static_cast<std::size_t>(ret);
+    }
+
+    int16_t fd_ = -1; // The C handle, -1 if not open
+};
+
+inline result<File> Device::open(std::string_view path) const noexcept
+{
+    return File::open(path);
+}
+
+} // namespace block
+
+namespace std {
+template <>
+struct is_error_code_enum<block::errc> : true_type {};
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef BLOCK_GEOMETRY_HPP_INCLUDED
+#define BLOCK_GEOMETRY_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_geometry.hpp
+//  Description    : This is the compile-time device geometry.
+//                   block::geometry<FrameSize, BlockFrames, MaxFramesPerFile>
+//                   holds the sizes as constants, with the offset to frame
+//                   arithmetic, and the frame copy and checksum kernels are
+//                   specialized to a frame size.  block::device_geometry is
+//                   the geometry the emulator library is built for (its
+//                   frames are always BLOCK_FRAME_SIZE bytes).
+//
+//                   block::frame_model runs the driver's frame protocol (read
+//                   the frame on a miss, patch it, write it back, checksum
+//                   every transfer) over memory for any geometry, so other
+//                   frame sizes can be compared by bus operations and time.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Project Includes
+#include <block_cache.hpp>
+extern "C" {
+#include <block_controller.h>
+#include <block_driver.h>
+}
+
+namespace block {
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : geometry
+// Description  : The sizes of a device, and where offsets fall in frames
+
+template <std::size_t FrameSize, std::size_t BlockFrames, std::size_t MaxFramesPerFile>
+struct geometry {
+    static_assert((FrameSize >= 64) && std::has_single_bit(FrameSize), "frames must be a power of two, 64 B or more");
+
+    static constexpr std::size_t frame_size = FrameSize; // Bytes per frame
+    static constexpr std::size_t block_frames = BlockFrames; // Frames on the device
+    static constexpr std::size_t max_frames_per_file = MaxFramesPerFile; // Frames one file may use
+    static constexpr std::size_t max_file_size = FrameSize * MaxFramesPerFile; // Largest file
+    static constexpr unsigned frame_shift = std::countr_zero(FrameSize); // log2 of the frame size
+
+    // The file frame an offset is in, and where in that frame
+    static constexpr uint64_t frame_of(uint64_t off) noexcept { return off >> frame_shift; }
+    static constexpr uint64_t offset_in_frame(uint64_t off) noexcept { return off & (FrameSize - 1); }
+
+    // The frames "len" bytes at "off" touch
+    static constexpr uint64_t frames_spanned(uint64_t off, uint64_t len) noexcept
+    {
+        return (len == 0) ? 0 : frame_of(off + len - 1) - frame_of(off) + 1;
+    }
+};
+
+// The geometry of the emulator (fixed when the library was built)
+using device_geometry = geometry<BLOCK_FRAME_SIZE, BLOCK_BLOCK_SIZE, BLOCK_MAX_FRAME_PER_FILE>;
+static_assert(device_geometry::frame_of(BLOCK_FRAME_SIZE) == 1);
+
+//
+// Kernels
+
+// Copy one frame (a constant size copy the compiler expands)
+template <std::size_t FrameSize>
+inline void copy_frame(void* dst, const void* src) noexcept
+{
+    std::memcpy(dst, src, FrameSize);
+}
+
+// A 32 bit frame checksum (four lane Fletcher-64, unrolled for the size).
+// The emulator's bus checksum is compute_frame_checksum; this is the one
+// frame_model uses at any frame size.
+template <std::size_t FrameSize>
+inline uint32_t frame_checksum(const void* frame) noexcept
+{
+    static_assert(FrameSize % 32 == 0, "frames are checksummed 32 bytes at a time");
+    const unsigned char* p = static_cast<const unsigned char*>(frame);
+    uint64_t a[4] = { 0, 0, 0, 0 }, b[4] = { 0, 0, 0, 0 }, w, sum = 0;
+
+    for (std::size_t i = 0; i < FrameSize; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            std::memcpy(&w, p + i + 8 * l, sizeof(w));
+            a[l] += w;
+            b[l] += a[l];
+        }
+    }
+    for (int l = 0; l < 4; l++) {
+        sum = (sum ^ a[l] ^ (b[l] << 1)) * 0x9e3779b97f4a7c15ULL;
+    }
+    return static_cast<uint32_t>(sum ^ (sum >> 32));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : frame_model
+// Description  : An in-memory device with the driver's frame protocol and a
+//                frame cache of the same policy, for comparing geometries.
+//                One file, laid out in frame order.
+
+template <class Geometry>
+class frame_model {
+public:
+    static constexpr std::size_t frame_size = Geometry::frame_size;
+
+    // A device of "frames" frames with "cache_frames" of them cached
+    frame_model(std::size_t frames, std::size_t cache_frames)
+        : frames_(frames)
+        , mem_(std::make_unique<detail::frame<frame_size>[]>(frames))
+        , cache_(cache_frames)
+    {
+    }
+
+    // Read "len" bytes at "off" (within the device), frame by frame
+    void read(void* buf, uint64_t off, uint64_t len) noexcept
+    {
+        unsigned char* out = static_cast<unsigned char*>(buf);
+        for (uint64_t done = 0, n; done < len; done += n) {
+            uint64_t frm = Geometry::frame_of(off + done), at = Geometry::offset_in_frame(off + done);
+            n = (frame_size - at < len - done) ? frame_size - at : len - done;
+            const unsigned char* frame = cache_.get(static_cast<uint32_t>(frm));
+            if (frame == nullptr) {
+                bus_read(frm, scratch_.bytes);
+                cache_.put(static_cast<uint32_t>(frm), scratch_.bytes);
+                frame = scratch_.bytes;
+            }
+            std::memcpy(out + done, frame + at, n);
+        }
+    }
+
+    // Write "len" bytes at "off" (within the device), frame by frame
+    void write(const void* buf, uint64_t off, uint64_t len) noexcept
+    {
+        const unsigned char* in = static_cast<const unsigned char*>(buf);
+        for (uint64_t done = 0, n; done < len; done += n) {
+            uint64_t frm = Geometry::frame_of(off + done), at = Geometry::offset_in_frame(off + done);
+            n = (frame_size - at < len - done) ? frame_size - at : len - done;
+            const unsigned char* frame = cache_.get(static_cast<uint32_t>(frm));
+            if (frame != nullptr) {
+                copy_frame<frame_size>(scratch_.bytes, frame);
+            } else {
+                bus_read(frm, scratch_.bytes);
+            }
+            std::memcpy(scratch_.bytes + at, in + done, n);
+            bus_write(frm, scratch_.bytes);
+            cache_.put(static_cast<uint32_t>(frm), scratch_.bytes);
+        }
+    }
+
+    std::size_t frames() const noexcept { return frames_; }
+    uint64_t bus_ops() const noexcept { return bus_ops_; }
+    const frame_cache<uint32_t, frame_size, lru_on_put>& cache() const noexcept { return cache_; }
+
+private:
+    // One bus transfer each way, checksummed like the controller's
+    void bus_read(uint64_t frm, unsigned char* dst) noexcept
+    {
+        copy_frame<frame_size>(dst, mem_[frm].bytes);
+        sink_ ^= frame_checksum<frame_size>(dst);
+        bus_ops_++;
+    }
+    void bus_write(uint64_t frm, const unsigned char* src) noexcept
+    {
+        sink_ ^= frame_checksum<frame_size>(src);
+        copy_frame<frame_size>(mem_[frm].bytes, src);
+        bus_ops_++;
+    }
+
+    std::size_t frames_; // Frames on the device
+    std::unique_ptr<detail::frame<frame_size>[]> mem_; // The device memory
+    frame_cache<uint32_t, frame_size, lru_on_put> cache_; // The frame cache
+    detail::frame<frame_size> scratch_; // The frame being transferred
+    uint64_t bus_ops_ = 0; // Transfers so far
+    uint32_t sink_ = 0; // Checksums, kept so they are computed
+};
+
+} // namespace block
+
+#endif
@@ -0,0 +1,632 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_import.c
+//  Description    : This is a trace importer for the BLOCK simulator.  It
+//                   converts a fio iolog (version 2 or 3) or the text output
+//                   of blkparse into a workload in the block_sim format, and
+//                   writes the expected contents of every file it touches
+//                   (which block_sim validates against).
+//
+//                   Each fio file or block device becomes one block file.
+//                   The files are first filled to the furthest byte the
+//                   trace touches, then the reads and writes are replayed at
+//                   their offsets with generated (@pattern) payloads.
+//                   Traces that span more than the device holds have their
+//                   offsets folded into range, a region at a time.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_controller.h>
+#include <block_driver.h>
+#include <block_workload.h>
+
+// Defines
+#define IMPORT_ARGUMENTS "hw:d:f:a:n:S:"
+#define IMPORT_MAX_FILES 128 // Matches the simulator file table
+#define IMPORT_MAX_FILE_SIZE ((int64_t)BLOCK_MAX_FRAME_PER_FILE * BLOCK_FRAME_SIZE)
+#define IMPORT_MAX_PREFIX 64 // Longest file name prefix
+#define IMPORT_MAX_KEY 256 // Longest trace file or device name
+#define IMPORT_MAX_LINE 4096 // Longest trace line
+#define IMPORT_MAX_DEVICE_FRAMES (BLOCK_BLOCK_SIZE - BLOCK_MAX_TOTAL_FILES)
+#define IMPORT_SECTOR_SIZE 512 // blkparse sector size
+#define IMPORT_FOLD_REGION (256 * BLOCK_FRAME_SIZE) // Offsets folded together
+#define USAGE                                                                            \
+    "USAGE: block_import [-h] [-w <workload>] [-d <dir>] [-f <prefix>] [-a <actions>]\n" \
+    "                    [-n <ops>] [-S <seed>] <trace>\n"                                \
+    "\n"                                                                                 \
+    "where:\n"                                                                           \
+    "    -h - help mode (display this message)\n"                                        \
+    "    -w - workload file to write (default <dir>/<prefix>-workload.txt)\n"            \
+    "    -d - directory for the expected file contents (default workload)\n"             \
+    "    -f - file name prefix (default imp)\n"                                          \
+    "    -a - blkparse actions to import (default Q)\n"                                  \
+    "    -n - import at most this many reads and writes (default all)\n"                 \
+    "    -S - payload seed (default 1)\n"                                                \
+    "\n"                                                                                 \
+    "  The trace is a fio iolog (version 2 or 3) or blkparse text output.\n"            \
+    "\n"
+
+// The trace formats understood
+typedef enum {
+    IMPORT_FIO_V2 = 0,
+    IMPORT_FIO_V3 = 1,
+    IMPORT_BLKPARSE = 2,
+} ImportFormat;
+
+// A read or write from the trace
+typedef struct {
+    uint16_t file; // Index into the file table
+    uint16_t write; // Non-zero for a write
+    int64_t off; // Offset in the trace file or device
+    int64_t len; // Length of the I/O
+    uint64_t time; // Time since the start of the trace (ns)
+} ImportOp;
+
+// A trace file or device and the block file it becomes
+typedef struct {
+    char key[IMPORT_MAX_KEY]; // Name in the trace
+    char name[BLOCK_MAX_PATH_LENGTH]; // The block file name
+    int64_t extent; // Furthest byte touched in the trace
+    int64_t cap; // Largest block file it can have
+    int64_t size; // Size of the block file
+    int64_t pos; // Current position in the replay
+    char* data; // The expected contents
+} ImportFile;
+
+//
+// Global Data
+
+static ImportFile import_files[IMPORT_MAX_FILES]; // The files
+static int import_nfiles = 0; // Number of files
+static ImportOp* import_ops = NULL; // The trace operations
+static long import_nops = 0; // Number of operations
+static long import_maxops = 0; // Allocated size of import_ops
+static long import_skipped = 0; // Trace lines not imported
+static int import_timed = 0; // The trace has timestamps
+static const char* import_prefix = "imp"; // File name prefix
+static FILE* import_out; // The workload being written
+
+//
+// Functional Prototypes
+
+static int read_trace(const char* trace, const char* actions, long limit);
+static int parse_fio_line(char* line, ImportFormat fmt);
+static int parse_blkparse_line(char* line, const char* actions, double* start);
+static int add_op(const char* key, int write, int64_t off, int64_t len, uint64_t time);
+static int find_file(const char* key);
+static int plan_files(void);
+static int64_t fold_offset(ImportFile* file, int64_t off, int64_t len);
+static void emit_write(ImportFile* file, int command, int64_t off, int64_t len, uint64_t seed);
+static void emit_seek(ImportFile* file, int64_t off);
+static int write_expected(const char* dir, ImportFile* file);
+static uint64_t import_seed(uint64_t seed, uint64_t n);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the trace importer
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main(int argc, char* argv[])
+{
+    // Local variables
+    char wload[BLOCK_MAX_PATH_LENGTH * 2], tname[BLOCK_MAX_PATH_LENGTH * 2 + 8];
+    char *wname = NULL, *dir = "workload", *actions = "Q", *dot;
+    ImportFile* file;
+    FILE* times = NULL;
+    uint64_t seed = 1;
+    int64_t off, len, chunk;
+    long limit = 0, n, lines;
+    int ch, i;
+
+    // Process the command line parameters
+    while ((ch = getopt(argc, argv, IMPORT_ARGUMENTS)) != -1) {
+        switch (ch) {
+        case 'h': // Help, print usage
+            fprintf(stderr, USAGE);
+            return (-1);
+
+        case 'w': // Workload file
+            wname = optarg;
+            break;
+
+        case 'd': // Expected file directory
+            dir = optarg;
+            break;
+
+        case 'f': // File prefix
+            if (strlen(optarg) > IMPORT_MAX_PREFIX) {
+                fprintf(stderr, "File prefix [%s] too long, max %d.\n", optarg, IMPORT_MAX_PREFIX);
+                return (-1);
+            }
+            import_prefix = optarg;
+            break;
+
+        case 'a': // blkparse actions
+            actions = optarg;
+            break;
+
+        case 'n': // Op limit
+            if ((sscanf(optarg, "%ld", &limit) != 1) || (limit < 0)) {
+                fprintf(stderr, "Bad op count [%s].\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'S': // Seed
+            if (sscanf(optarg, "%" SCNu64, &seed) != 1) {
+                fprintf(stderr, "Bad seed [%s].\n", optarg);
+                return (-1);
+            }
+            break;
+
+        default: // Default (unknown)
+            fprintf(stderr, "Unknown command line option (%c), aborting.\n", ch);
+            return (-1);
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "Missing trace file, aborting.\n\n" USAGE);
+        return (-1);
+    }
+
+    // Read the trace and size the block files
+    if ((read_trace(argv[optind], actions, limit) != 0) || (plan_files() != 0)) {
+        return (-1);
+    }
+
+    // Open the workload file, and the timestamps if the trace has them
+    if (wname == NULL) {
+        snprintf(wload, sizeof(wload), "%s/%s-workload.txt", dir, import_prefix);
+        wname = wload;
+    }
+    if ((import_out = fopen(wname, "w")) == NULL) {
+        fprintf(stderr, "Failure opening workload file [%s], error: %s.\n", wname, strerror(errno));
+        return (-1);
+    }
+    if (import_timed) {
+        snprintf(tname, sizeof(tname), "%s", wname);
+        if (((dot = strrchr(tname, '.')) == NULL) || (strchr(dot, '/') != NULL)) {
+            dot = tname + strlen(tname);
+        }
+        strcpy(dot, ".times");
+        if ((times = fopen(tname, "w")) == NULL) {
+            fprintf(stderr, "Failure opening timestamp file [%s], error: %s.\n", tname, strerror(errno));
+            return (-1);
+        }
+    }
+
+    // Fill the files to their size, so the trace reads existing data
+    lines = 0;
+    for (i = 0; i < import_nfiles; i++) {
+        file = &import_files[i];
+        for (off = 0; off < file->size; off += chunk) {
+            chunk = (file->size - off < BLOCK_WORKLOAD_MAX_IO) ? file->size - off : BLOCK_WORKLOAD_MAX_IO;
+            emit_write(file, BLOCK_WL_WRITE, off, chunk, import_seed(seed, lines++));
+            if (times != NULL) {
+                fprintf(times, "0\n");
+            }
+        }
+    }
+
+    // Now the trace itself, split into payload sized pieces
+    for (n = 0; n < import_nops; n++) {
+        file = &import_files[import_ops[n].file];
+        len = (import_ops[n].len > file->cap) ? file->cap : import_ops[n].len;
+        off = fold_offset(file, import_ops[n].off, len);
+        if (len > file->size - off) {
+            len = file->size - off;
+        }
+        for (; len > 0; off += chunk, len -= chunk) {
+            chunk = (len < BLOCK_WORKLOAD_MAX_IO) ? len : BLOCK_WORKLOAD_MAX_IO;
+            if (import_ops[n].write) {
+                emit_write(file, BLOCK_WL_WRITEAT, off, chunk, import_seed(seed, lines++));
+            } else {
+                emit_seek(file, off);
+                fprintf(import_out, "%s READ %" PRId64 " 0 :\n", file->name, chunk);
+                file->pos += chunk;
+                lines++;
+            }
+            if (times != NULL) {
+                fprintf(times, "%" PRIu64 "\n", import_ops[n].time);
+            }
+        }
+    }
+    fclose(import_out);
+    if (times != NULL) {
+        fclose(times);
+    }
+
+    // Write out the expected file contents
+    for (i = 0; i < import_nfiles; i++) {
+        if (write_expected(dir, &import_files[i]) != 0) {
+            return (-1);
+        }
+        fprintf(stderr, "[%s] -> %s (%" PRId64 " bytes%s)\n", import_files[i].key, import_files[i].name,
+            import_files[i].size, (import_files[i].extent > import_files[i].cap) ? ", folded" : "");
+        free(import_files[i].data);
+    }
+    free(import_ops);
+    fprintf(stderr, "Imported %ld ops (%ld trace lines skipped) over %d files to [%s].\n", import_nops,
+        import_skipped, import_nfiles, wname);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : read_trace
+// Description  : Read the reads and writes from a trace, working out its
+//                format from the first line
+//
+// Inputs       : trace - the trace file
+//                actions - the blkparse actions to import
+//                limit - the most ops to import (0 for all)
+// Outputs      : 0 if successful, -1 if failure
+
+static int read_trace(const char* trace, const char* actions, long limit)
+{
+    char line[IMPORT_MAX_LINE];
+    ImportFormat fmt;
+    double start = -1.0;
+    uint32_t lineno = 0;
+    int ret, pending;
+    FILE* fh;
+
+    if ((fh = fopen(trace, "r")) == NULL) {
+        fprintf(stderr, "Failure opening trace file [%s], error: %s.\n", trace, strerror(errno));
+        return (-1);
+    }
+
+    // fio logs start with their version, anything else is taken as blkparse
+    if (fgets(line, sizeof(line), fh) == NULL) {
+        fprintf(stderr, "Trace file [%s] is empty.\n", trace);
+        fclose(fh);
+        return (-1);
+    }
+    if (strncmp(line, "fio version 2 iolog", 19) == 0) {
+        fmt = IMPORT_FIO_V2;
+    } else if (strncmp(line, "fio version 3 iolog", 19) == 0) {
+        fmt = IMPORT_FIO_V3;
+        import_timed = 1;
+    } else {
+        fmt = IMPORT_BLKPARSE;
+        import_timed = 1;
+    }
+
+    // Walk the trace (a blkparse trace starts with the line already read)
+    pending = (fmt == IMPORT_BLKPARSE);
+    while (((limit == 0) || (import_nops < limit)) && (pending || (fgets(line, sizeof(line), fh) != NULL))) {
+        pending = 0;
+        lineno++;
+        if ((strlen(line) == sizeof(line) - 1) && (line[sizeof(line) - 2] != '\n')) {
+            fprintf(stderr, "Trace line %u too long, max %d.\n", lineno, IMPORT_MAX_LINE);
+            fclose(fh);
+            return (-1);
+        }
+        if (fmt == IMPORT_BLKPARSE) {
+            ret = parse_blkparse_line(line, actions, &start);
+        } else {
+            ret = parse_fio_line(line, fmt);
+        }
+        if (ret == -1) {
+            fprintf(stderr, "Failed importing trace line %u.\n", lineno);
+            fclose(fh);
+            return (-1);
+        }
+        import_skipped += (ret == 0);
+    }
+    fclose(fh);
+
+    if (import_nops == 0) {
+        fprintf(stderr, "No reads or writes found in trace [%s].\n", trace);
+        return (-1);
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_fio_line
+// Description  : Parse a fio iolog line.  Version 2 lines are
+//                "<file> <action> [<offset> <length>]", version 3 lines have
+//                a timestamp (ms) in front.
+//
+// Inputs       : line - the trace line
+//                fmt - IMPORT_FIO_V2 or IMPORT_FIO_V3
+// Outputs      : 1 if imported, 0 if skipped, -1 if failure
+
+static int parse_fio_line(char* line, ImportFormat fmt)
+{
+    char key[IMPORT_MAX_KEY], action[32];
+    unsigned long long off, len;
+    uint64_t ms = 0;
+    int n;
+
+    if (fmt == IMPORT_FIO_V3) {
+        n = sscanf(line, "%" SCNu64 " %255s %31s %llu %llu", &ms, key, action, &off, &len) - 1;
+    } else {
+        n = sscanf(line, "%255s %31s %llu %llu", key, action, &off, &len);
+    }
+
+    // Only reads and writes carry I/O, the rest (open, trim, wait, ...) are skipped
+    if ((n != 4) || ((strcmp(action, "read") != 0) && (strcmp(action, "write") != 0)) || (len == 0)) {
+        return (0);
+    }
+    return (add_op(key, action[0] == 'w', off, len, ms * 1000000));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_blkparse_line
+// Description  : Parse a line of the default blkparse output,
+//                "<maj>,<min> <cpu> <seq> <time> <pid> <action> <rwbs>
+//                <sector> + <sectors> [<process>]"
+//
+// Inputs       : line - the trace line
+//                actions - the actions to import
+//                start - time of the first event (-1 before it)
+// Outputs      : 1 if imported, 0 if skipped, -1 if failure
+
+static int parse_blkparse_line(char* line, const char* actions, double* start)
+{
+    char key[IMPORT_MAX_KEY], action[8], rwbs[16];
+    unsigned int maj, min, cpu, seq, pid, sectors;
+    unsigned long long sector;
+    double time;
+
+    if ((sscanf(line, "%u,%u %u %u %lf %u %7s %15s %llu + %u", &maj, &min, &cpu, &seq, &time, &pid, action, rwbs,
+             &sector, &sectors)
+            != 10)
+        || (strlen(action) != 1) || (strchr(actions, action[0]) == NULL) || (sectors == 0)) {
+        return (0);
+    }
+
+    // Discards carry no data, and a flush without a read or write neither
+    if ((strchr(rwbs, 'D') != NULL) || ((strchr(rwbs, 'R') == NULL) && (strchr(rwbs, 'W') == NULL))) {
+        return (0);
+    }
+    if (*start < 0) {
+        *start = time;
+    }
+    snprintf(key, sizeof(key), "%u,%u", maj, min);
+    return (add_op(key, strchr(rwbs, 'W') != NULL, (int64_t)sector * IMPORT_SECTOR_SIZE,
+        (int64_t)sectors * IMPORT_SECTOR_SIZE, (uint64_t)((time - *start) * 1e9)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : add_op
+// Description  : Add a read or write to the trace operations
+//
+// Inputs       : key - the trace file or device
+//                write - non-zero for a write
+//                off - the offset
+//                len - the length
+//                time - time since the start of the trace (ns)
+// Outputs      : 1 if successful, -1 if failure
+
+static int add_op(const char* key, int write, int64_t off, int64_t len, uint64_t time)
+{
+    ImportOp* ops;
+    int file;
+
+    if ((off < 0) || (len <= 0) || ((file = find_file(key)) == -1)) {
+        return (-1);
+    }
+    if (import_nops == import_maxops) {
+        import_maxops = (import_maxops == 0) ? 4096 : import_maxops * 2;
+        if ((ops = realloc(import_ops, sizeof(ImportOp) * import_maxops)) == NULL) {
+            fprintf(stderr, "Out of memory reading the trace.\n");
+            return (-1);
+        }
+        import_ops = ops;
+    }
+    import_ops[import_nops].file = file;
+    import_ops[import_nops].write = write;
+    import_ops[import_nops].off = off;
+    import_ops[import_nops].len = len;
+    import_ops[import_nops].time = time;
+    import_nops++;
+    if (off + len > import_files[file].extent) {
+        import_files[file].extent = off + len;
+    }
+    return (1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : find_file
+// Description  : Find (or add) the block file for a trace file or device
+//
+// Inputs       : key - the trace file or device
+// Outputs      : index of the file, -1 if there are too many
+
+static int find_file(const char* key)
+{
+    int i;
+
+    for (i = 0; i < import_nfiles; i++) {
+        if (strcmp(import_files[i].key, key) == 0) {
+            return (i);
+        }
+    }
+    if (import_nfiles == IMPORT_MAX_FILES) {
+        fprintf(stderr, "Trace uses more than %d files or devices.\n", IMPORT_MAX_FILES);
+        return (-1);
+    }
+
+    snprintf(import_files[i].key, IMPORT_MAX_KEY, "%s", key);
+    snprintf(import_files[i].name, BLOCK_MAX_PATH_LENGTH, "%s%03d.dat", import_prefix, i);
+    return (import_nfiles++);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : plan_files
+// Description  : Size the block files.  Each gets an equal share of the
+//                device (up to the driver's file limit), and is as big as
+//                the furthest byte its trace touches within that share.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int plan_files(void)
+{
+    int64_t cap, frames, len, end;
+    ImportFile* file;
+    long n;
+    int i;
+
+    frames = (IMPORT_MAX_DEVICE_FRAMES - 1) / import_nfiles - 1;
+    cap = frames * BLOCK_FRAME_SIZE;
+    if (cap > IMPORT_MAX_FILE_SIZE) {
+        cap = IMPORT_MAX_FILE_SIZE;
+    }
+    for (i = 0; i < import_nfiles; i++) {
+        import_files[i].cap = cap;
+        import_files[i].size = (import_files[i].extent > cap) ? 0 : import_files[i].extent;
+    }
+
+    // Folded files are as big as their folded extent
+    for (n = 0; n < import_nops; n++) {
+        file = &import_files[import_ops[n].file];
+        len = (import_ops[n].len > cap) ? cap : import_ops[n].len;
+        end = fold_offset(file, import_ops[n].off, len) + len;
+        if ((file->extent > cap) && (end > file->size)) {
+            file->size = end;
+        }
+    }
+    for (i = 0; i < import_nfiles; i++) {
+        if ((import_files[i].data = malloc(import_files[i].size)) == NULL) {
+            fprintf(stderr, "Out of memory for the contents of [%s].\n", import_files[i].name);
+            return (-1);
+        }
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fold_offset
+// Description  : Bring a trace offset into the range of its block file.
+//                The trace is cut into regions, each of which lands on a
+//                region of the file picked by a hash of its number (so
+//                strided offsets do not all fold onto the same spot), keeping
+//                the offset within the region.  I/O that would then run off
+//                the end is moved back.
+//
+// Inputs       : file - the file
+//                off - the trace offset
+//                len - the length of the I/O (no more than the cap)
+// Outputs      : the offset in the block file
+
+static int64_t fold_offset(ImportFile* file, int64_t off, int64_t len)
+{
+    int64_t region = (file->cap < IMPORT_FOLD_REGION) ? BLOCK_FRAME_SIZE : IMPORT_FOLD_REGION;
+
+    if (file->extent <= file->cap) {
+        return (off);
+    }
+    off = (int64_t)(import_seed(0, off / region) % (file->cap / region)) * region + off % region;
+    return ((off + len > file->cap) ? file->cap - len : off);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : emit_write
+// Description  : Apply a generated payload to the expected contents and
+//                write a WRITE (at the current position) or WRITEAT line
+//
+// Inputs       : file - the file being written
+//                command - BLOCK_WL_WRITE or BLOCK_WL_WRITEAT
+//                off - the offset written (the current position for WRITE)
+//                len - the number of bytes
+//                seed - the payload seed
+// Outputs      : none
+
+static void emit_write(ImportFile* file, int command, int64_t off, int64_t len, uint64_t seed)
+{
+    fill_block_pattern(&file->data[off], len, seed);
+    fprintf(import_out, "%s %s %" PRId64 " %" PRId64 " :@pattern(%" PRIu64 ")\n", file->name,
+        block_workload_command_name(command), len, (command == BLOCK_WL_WRITEAT) ? off : 0, seed);
+    file->pos = off + len;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : emit_seek
+// Description  : Write a SEEK line, unless we are already there
+//
+// Inputs       : file - the file
+//                off - the offset to seek to
+// Outputs      : none
+
+static void emit_seek(ImportFile* file, int64_t off)
+{
+    if (file->pos != off) {
+        fprintf(import_out, "%s SEEK 0 %" PRId64 " :\n", file->name, off);
+        file->pos = off;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_expected
+// Description  : Write the expected contents of a file for validation
+//
+// Inputs       : dir - the directory to write into
+//                file - the file
+// Outputs      : 0 if successful, -1 if failure
+
+static int write_expected(const char* dir, ImportFile* file)
+{
+    char path[BLOCK_MAX_PATH_LENGTH * 2];
+    FILE* fh;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file->name);
+    if (((fh = fopen(path, "w")) == NULL) || (fwrite(file->data, 1, file->size, fh) != file->size)) {
+        fprintf(stderr, "Failure writing expected file [%s], error: %s.\n", path, strerror(errno));
+        if (fh != NULL) {
+            fclose(fh);
+        }
+        return (-1);
+    }
+    fclose(fh);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : import_seed
+// Description  : The payload seed of a workload line, so the same trace and
+//                seed always give the same workload
+//
+// Inputs       : seed - the base seed
+//                n - the line
+// Outputs      : the payload seed
+
+static uint64_t import_seed(uint64_t seed, uint64_t n)
+{
+    uint64_t z = seed * 0x9e3779b97f4a7c15ULL + n;
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31));
+}
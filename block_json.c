@@ -0,0 +1,327 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_json.c
+//  Description    : This is the implementation of the small JSON reader used
+//                   by the BLOCK tools.  It is a recursive descent parser
+//                   that builds a tree; \u escapes outside ASCII are kept as
+//                   '?' since the tools only compare names.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Project Includes
+#include <block_json.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define BLOCK_JSON_MAX_DEPTH 64 // Deepest nesting accepted
+
+// The parser position
+typedef struct {
+    const char* text; // The document
+    const char* pos; // Next character to read
+} BlockJsonParser;
+
+//
+// Functional Prototypes
+
+static BlockJson* parse_value(BlockJsonParser* p, int depth);
+static char* parse_string(BlockJsonParser* p);
+static void skip_space(BlockJsonParser* p);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_block_json
+// Description  : Parse a JSON document into a tree
+//
+// Inputs       : text - the document
+// Outputs      : the root value, NULL if the document is not valid
+
+BlockJson* parse_block_json(const char* text)
+{
+    BlockJsonParser p = { text, text };
+    BlockJson* js;
+
+    if ((js = parse_value(&p, 0)) == NULL) {
+        return (NULL);
+    }
+    skip_space(&p);
+    if (*p.pos != 0x0) {
+        logMessage(LOG_ERROR_LEVEL, "JSON has trailing text at offset %ld.", (long)(p.pos - p.text));
+        free_block_json(js);
+        return (NULL);
+    }
+    return (js);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : load_block_json
+// Description  : Read and parse a JSON file
+//
+// Inputs       : path - the file to read
+// Outputs      : the root value, NULL on failure
+
+BlockJson* load_block_json(const char* path)
+{
+    BlockJson* js;
+    FILE* fh;
+    char* text;
+    long len;
+
+    if ((fh = fopen(path, "r")) == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "Failure opening JSON file [%s], error: %s.", path, strerror(errno));
+        return (NULL);
+    }
+    fseek(fh, 0, SEEK_END);
+    len = ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+    if (((text = malloc(len + 1)) == NULL) || (fread(text, 1, len, fh) != len)) {
+        logMessage(LOG_ERROR_LEVEL, "Failure reading JSON file [%s].", path);
+        free(text);
+        fclose(fh);
+        return (NULL);
+    }
+    text[len] = 0x0;
+    fclose(fh);
+
+    if ((js = parse_block_json(text)) == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "Failure parsing JSON file [%s].", path);
+    }
+    free(text);
+    return (js);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_json_get
+// Description  : Return the member of an object with a name
+//
+// Inputs       : obj - the object
+//                key - the member name
+// Outputs      : the member, NULL if there is none (or obj is not an object)
+
+BlockJson* block_json_get(const BlockJson* obj, const char* key)
+{
+    BlockJson* m;
+
+    if ((obj == NULL) || (obj->type != BLOCK_JSON_OBJECT)) {
+        return (NULL);
+    }
+    for (m = obj->child; m != NULL; m = m->next) {
+        if (strcmp(m->key, key) == 0) {
+            return (m);
+        }
+    }
+    return (NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : free_block_json
+// Description  : Release a parsed document
+//
+// Inputs       : js - the root value
+// Outputs      : none
+
+void free_block_json(BlockJson* js)
+{
+    BlockJson* next;
+
+    for (; js != NULL; js = next) {
+        next = js->next;
+        free_block_json(js->child);
+        free(js->string);
+        free(js->key);
+        free(js);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_value
+// Description  : Parse one JSON value
+//
+// Inputs       : p - the parser
+//                depth - the current nesting
+// Outputs      : the value, NULL if it is not valid
+
+static BlockJson* parse_value(BlockJsonParser* p, int depth)
+{
+    BlockJson *js, **tail;
+    char *end, *key;
+    char close;
+
+    skip_space(p);
+    if ((depth > BLOCK_JSON_MAX_DEPTH) || ((js = calloc(1, sizeof(BlockJson))) == NULL)) {
+        return (NULL);
+    }
+
+    switch (*p->pos) {
+    case '{':
+    case '[':
+        // Objects and arrays, a list of (named) children
+        js->type = (*p->pos == '{') ? BLOCK_JSON_OBJECT : BLOCK_JSON_ARRAY;
+        close = (*p->pos == '{') ? '}' : ']';
+        p->pos++;
+        skip_space(p);
+        tail = &js->child;
+        if (*p->pos == close) {
+            p->pos++;
+            return (js);
+        }
+        while (1) {
+            key = NULL;
+            if (js->type == BLOCK_JSON_OBJECT) {
+                skip_space(p);
+                if ((key = parse_string(p)) == NULL) {
+                    break;
+                }
+                skip_space(p);
+                if (*p->pos++ != ':') {
+                    free(key);
+                    break;
+                }
+            }
+            if ((*tail = parse_value(p, depth + 1)) == NULL) {
+                free(key);
+                break;
+            }
+            (*tail)->key = key;
+            tail = &(*tail)->next;
+            skip_space(p);
+            if (*p->pos == ',') {
+                p->pos++;
+            } else if (*p->pos == close) {
+                p->pos++;
+                return (js);
+            } else {
+                break;
+            }
+        }
+        logMessage(LOG_ERROR_LEVEL, "JSON syntax error at offset %ld.", (long)(p->pos - p->text));
+        free_block_json(js);
+        return (NULL);
+
+    case '"':
+        js->type = BLOCK_JSON_STRING;
+        if ((js->string = parse_string(p)) == NULL) {
+            free(js);
+            return (NULL);
+        }
+        return (js);
+
+    default:
+        if (strncmp(p->pos, "true", 4) == 0) {
+            js->type = BLOCK_JSON_BOOL;
+            js->number = 1;
+            p->pos += 4;
+        } else if (strncmp(p->pos, "false", 5) == 0) {
+            js->type = BLOCK_JSON_BOOL;
+            p->pos += 5;
+        } else if (strncmp(p->pos, "null", 4) == 0) {
+            js->type = BLOCK_JSON_NULL;
+            p->pos += 4;
+        } else {
+            js->type = BLOCK_JSON_NUMBER;
+            js->number = strtod(p->pos, &end);
+            if (end == p->pos) {
+                logMessage(LOG_ERROR_LEVEL, "JSON bad value at offset %ld.", (long)(p->pos - p->text));
+                free(js);
+                return (NULL);
+            }
+            p->pos = end;
+        }
+        return (js);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_string
+// Description  : Parse a quoted JSON string, handling the escapes
+//
+// Inputs       : p - the parser (at the opening quote)
+// Outputs      : the string (malloc'd), NULL if it is not valid
+
+static char* parse_string(BlockJsonParser* p)
+{
+    const char* s;
+    char *str, *d;
+    unsigned int u;
+
+    if (*p->pos != '"') {
+        return (NULL);
+    }
+
+    // The unescaped string is never longer than the quoted one
+    for (s = p->pos + 1; (*s != '"') && (*s != 0x0); s += (*s == '\\' && s[1] != 0x0) ? 2 : 1)
+        ;
+    if ((*s != '"') || ((str = malloc(s - p->pos)) == NULL)) {
+        return (NULL);
+    }
+    for (s = p->pos + 1, d = str; *s != '"'; s++) {
+        if (*s != '\\') {
+            *d++ = *s;
+            continue;
+        }
+        switch (*++s) {
+        case 'n':
+            *d++ = '\n';
+            break;
+        case 't':
+            *d++ = '\t';
+            break;
+        case 'r':
+            *d++ = '\r';
+            break;
+        case 'b':
+            *d++ = '\b';
+            break;
+        case 'f':
+            *d++ = '\f';
+            break;
+        case 'u':
+            // Exactly four hex digits (sscanf alone would take fewer and run past the string)
+            if (!isxdigit((unsigned char)s[1]) || !isxdigit((unsigned char)s[2]) || !isxdigit((unsigned char)s[3])
+                || !isxdigit((unsigned char)s[4]) || (sscanf(s + 1, "%4x", &u) != 1)) {
+                free(str);
+                return (NULL);
+            }
+            *d++ = (u < 0x80) ? (char)u : '?';
+            s += 4;
+            break;
+        default:
+            *d++ = *s;
+            break;
+        }
+    }
+    *d = 0x0;
+    p->pos = s + 1;
+    return (str);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : skip_space
+// Description  : Skip over whitespace
+//
+// Inputs       : p - the parser
+// Outputs      : none
+
+static void skip_space(BlockJsonParser* p)
+{
+    while ((*p->pos == ' ') || (*p->pos == '\t') || (*p->pos == '\n') || (*p->pos == '\r')) {
+        p->pos++;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef BLOCK_JSON_INCLUDED
+#define BLOCK_JSON_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_json.h
+//  Description    : This is the interface for the small JSON reader used by
+//                   the BLOCK tools to load benchmark and simulation results.
+//
+//  Author         : Chloe Gregory
+//
+
+// The kinds of JSON value
+typedef enum {
+    BLOCK_JSON_NULL = 0,
+    BLOCK_JSON_BOOL = 1,
+    BLOCK_JSON_NUMBER = 2,
+    BLOCK_JSON_STRING = 3,
+    BLOCK_JSON_ARRAY = 4,
+    BLOCK_JSON_OBJECT = 5,
+} BlockJsonType;
+
+// A JSON value, arrays and objects hold a list of children
+typedef struct BlockJson {
+    BlockJsonType type; // The kind of value
+    double number; // Number (or 0/1 for a bool)
+    char* string; // String value
+    char* key; // Member name, when inside an object
+    struct BlockJson* child; // First element or member
+    struct BlockJson* next; // Next element or member of the parent
+} BlockJson;
+
+//
+// Interface functions
+
+BlockJson* parse_block_json(const char* text);
+// Parse a JSON document, NULL if it is not valid
+
+BlockJson* load_block_json(const char* path);
+// Read and parse a JSON file, NULL on failure
+
+BlockJson* block_json_get(const BlockJson* obj, const char* key);
+// Return the member of an object with a name, NULL if there is none
+
+void free_block_json(BlockJson* js);
+// Release a parsed document
+
+#endif
@@ -0,0 +1,520 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_prefetch.c
+//  Description    : This is the implementation of the trace-driven frame
+//                   prefetcher.  A first order Markov table (the most
+//                   frequent next frames after each frame, found with a
+//                   Misra-Gries count per frame and then counted exactly
+//                   in a second pass) is mined from an access log.  Each frame access then queues its successors, and
+//                   the chain of most likely frames after them, for a
+//                   background thread to read into the cache.
+//
+//                   A prefetch is useful if its frame is used while still
+//                   cached, and wasted if it is evicted first or not used
+//                   within the horizon.  Every window of judged prefetches
+//                   the depth grows if they were mostly useful and shrinks
+//                   if not, down to a pause that doubles each time.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Project Includes
+#include <block_cache.h>
+#include <block_controller.h>
+#include <block_driver.h>
+#include <block_prefetch.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define BLOCK_PREFETCH_CANDIDATES 4 // Successors counted per frame while mining
+#define BLOCK_PREFETCH_QUEUE 1024 // Predictions waiting for the thread
+#define BLOCK_PREFETCH_RING 65536 // Prefetches waiting to be judged
+#define BLOCK_PREFETCH_WINDOW 256 // Prefetches judged between depth changes
+#define BLOCK_PREFETCH_LOW 0.5 // Accuracy below which it backs off
+#define BLOCK_PREFETCH_HIGH 0.75 // Accuracy above which it goes deeper
+#define BLOCK_PREFETCH_MIN_BACKOFF 1024 // First pause (accesses)
+#define BLOCK_PREFETCH_MAX_BACKOFF (1 << 20) // Longest pause (accesses)
+#define BLOCK_PREFETCH_DEFAULT_HORIZON 1024 // Accesses a prefetch has to be used in
+
+// A prediction waiting to be read, or a prefetch waiting to be judged
+typedef struct {
+    uint16_t frm; // The frame
+    uint32_t time; // When it was predicted or read
+} BlockPrefetchIssue;
+
+// The prefetcher state
+struct BlockPrefetch {
+    uint16_t succ[BLOCK_BLOCK_SIZE][BLOCK_PREFETCH_WAYS]; // Likely next frames, most likely first
+    uint8_t nsucc[BLOCK_BLOCK_SIZE]; // Number of successors of each frame
+    uint32_t issued_at[BLOCK_BLOCK_SIZE]; // When each frame was prefetched (0 = not waiting)
+    uint8_t inflight[BLOCK_BLOCK_SIZE]; // Set while the thread is reading a frame
+    uint8_t queued[BLOCK_BLOCK_SIZE]; // Set while a frame is in the queue
+    uint32_t accessed_at[BLOCK_BLOCK_SIZE]; // When each frame was last accessed
+    BlockPrefetchIssue ring[BLOCK_PREFETCH_RING]; // Prefetches in the order read
+    uint32_t ring_tail, ring_count; // Oldest entry and number of entries
+    BlockPrefetchIssue queue[BLOCK_PREFETCH_QUEUE]; // Frames for the thread to read
+    uint32_t queue_head, queue_count; // Next entry and number of entries
+    uint32_t now; // Frame accesses seen (+1)
+    uint32_t horizon; // Accesses a prefetch has to be used in
+    uint32_t depth; // Steps predicted ahead (0 while paused)
+    uint32_t backoff; // Length of the next pause
+    uint32_t pause_until; // Access the pause ends at
+    int32_t last; // Last frame accessed
+    uint32_t window_useful, window_judged; // Judgements in the current window
+    BlockPrefetchStats stats; // The counters
+    pthread_t thread; // The prefetch thread
+    pthread_mutex_t lock; // Protects all of the above
+    pthread_cond_t wake; // Signalled when the queue fills or it is stopped
+    int stop; // Set to stop the thread
+};
+
+//
+// Functional Prototypes
+
+static int next_frame(FILE* fh, int32_t prev, unsigned int* frm);
+static void* prefetch_worker(void* arg);
+static void enqueue_frame(BlockPrefetch* pf, uint16_t frm, uint16_t from);
+static void judge_prefetch(BlockPrefetch* pf, int useful);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : create_block_prefetch
+// Description  : Mine the frame successor table from an access log (lines
+//                of "R <frame>" or "W <frame>", as block_sim --access-log
+//                writes).  Only changes of frame count as successions.
+//                The Misra-Gries counts can be short by a fifth of a
+//                frame's successions, so the candidates they leave are
+//                counted again exactly before the confidence test.
+//
+// Inputs       : log - the access log
+//                horizon - accesses a prefetch has to be used in (0 for
+//                          the default, the cache size is a good choice)
+// Outputs      : the prefetcher, NULL on failure
+
+BlockPrefetch* create_block_prefetch(const char* log, uint32_t horizon)
+{
+    // Local variables
+    uint16_t(*cand)[BLOCK_PREFETCH_CANDIDATES];
+    uint32_t(*count)[BLOCK_PREFETCH_CANDIDATES];
+    uint32_t(*exact)[BLOCK_PREFETCH_CANDIDATES];
+    uint32_t *total, c, i, j, k, learned = 0;
+    uint64_t accesses = 0;
+    int32_t prev = -1;
+    unsigned int frm;
+    BlockPrefetch* pf;
+    FILE* fh;
+
+    if ((fh = fopen(log, "r")) == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "Failure opening prefetch access log [%s], error: %s.", log, strerror(errno));
+        return (NULL);
+    }
+    pf = calloc(1, sizeof(BlockPrefetch));
+    cand = calloc(BLOCK_BLOCK_SIZE, sizeof(*cand));
+    count = calloc(BLOCK_BLOCK_SIZE, sizeof(*count));
+    exact = calloc(BLOCK_BLOCK_SIZE, sizeof(*exact));
+    total = calloc(BLOCK_BLOCK_SIZE, sizeof(uint32_t));
+    if ((pf == NULL) || (cand == NULL) || (count == NULL) || (exact == NULL) || (total == NULL)) {
+        logMessage(LOG_ERROR_LEVEL, "Out of memory mining the prefetch table.");
+        fclose(fh);
+        free(pf);
+        free(cand);
+        free(count);
+        free(exact);
+        free(total);
+        return (NULL);
+    }
+
+    // Count the successors of each frame, keeping the frequent ones
+    while (next_frame(fh, prev, &frm)) {
+        accesses++;
+        if (prev != -1) {
+            total[prev]++;
+            for (k = 0; (k < BLOCK_PREFETCH_CANDIDATES) && ((count[prev][k] == 0) || (cand[prev][k] != frm)); k++)
+                ;
+            if (k == BLOCK_PREFETCH_CANDIDATES) {
+                for (k = 0; (k < BLOCK_PREFETCH_CANDIDATES) && (count[prev][k] != 0); k++)
+                    ;
+            }
+            if (k < BLOCK_PREFETCH_CANDIDATES) {
+                cand[prev][k] = frm;
+                count[prev][k]++;
+            } else {
+                for (k = 0; k < BLOCK_PREFETCH_CANDIDATES; k++) {
+                    count[prev][k]--;
+                }
+            }
+        }
+        prev = frm;
+    }
+
+    // Count the surviving candidates exactly
+    rewind(fh);
+    for (prev = -1; next_frame(fh, prev, &frm); prev = frm) {
+        if (prev != -1) {
+            for (k = 0; k < BLOCK_PREFETCH_CANDIDATES; k++) {
+                if ((count[prev][k] != 0) && (cand[prev][k] == frm)) {
+                    exact[prev][k]++;
+                    break;
+                }
+            }
+        }
+    }
+    fclose(fh);
+
+    // Keep the most frequent successors that are seen often enough
+    for (i = 0; i < BLOCK_BLOCK_SIZE; i++) {
+        for (j = 0; j < BLOCK_PREFETCH_WAYS; j++) {
+            for (c = 0, k = 1; k < BLOCK_PREFETCH_CANDIDATES; k++) {
+                if (exact[i][k] > exact[i][c]) {
+                    c = k;
+                }
+            }
+            if ((exact[i][c] < 2) || (exact[i][c] < BLOCK_PREFETCH_MIN_CONFIDENCE * total[i])) {
+                break;
+            }
+            pf->succ[i][pf->nsucc[i]++] = cand[i][c];
+            exact[i][c] = 0;
+        }
+        learned += (pf->nsucc[i] > 0);
+    }
+    free(cand);
+    free(count);
+    free(exact);
+    free(total);
+
+    // Setup the runtime state
+    pf->horizon = (horizon == 0) ? BLOCK_PREFETCH_DEFAULT_HORIZON : horizon;
+    pf->depth = 1;
+    pf->backoff = BLOCK_PREFETCH_MIN_BACKOFF;
+    pf->now = 1;
+    pf->last = -1;
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->wake, NULL);
+    logMessage(LOG_OUTPUT_LEVEL, "Prefetch table has successors for %u frames, from %" PRIu64 " accesses in [%s].",
+        learned, accesses, log);
+    return (pf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : start_block_prefetch
+// Description  : Start the prefetch thread and hook it into the driver
+//
+// Inputs       : pf - the prefetcher
+// Outputs      : 0 if successful, -1 if failure
+
+int start_block_prefetch(BlockPrefetch* pf)
+{
+    pf->stop = 0;
+    if (pthread_create(&pf->thread, NULL, prefetch_worker, pf) != 0) {
+        logMessage(LOG_ERROR_LEVEL, "Failed to create the prefetch thread.");
+        return (-1);
+    }
+    block_set_prefetch_hook(block_prefetch_access, pf);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : stop_block_prefetch
+// Description  : Unhook and stop the prefetch thread.  Prefetches still
+//                waiting to be used count as wasted.
+//
+// Inputs       : pf - the prefetcher
+//                stats - set to the counters
+// Outputs      : none
+
+void stop_block_prefetch(BlockPrefetch* pf, BlockPrefetchStats* stats)
+{
+    uint64_t hits;
+    uint32_t i;
+
+    block_set_prefetch_hook(NULL, NULL);
+    pthread_mutex_lock(&pf->lock);
+    pf->stop = 1;
+    pthread_cond_signal(&pf->wake);
+    pthread_mutex_unlock(&pf->lock);
+    pthread_join(pf->thread, NULL);
+
+    for (i = 0; i < BLOCK_BLOCK_SIZE; i++) {
+        if (pf->issued_at[i] != 0) {
+            pf->issued_at[i] = 0;
+            pf->stats.wasted++;
+        }
+    }
+    pf->ring_count = 0;
+    get_block_cache_stats(&hits, &pf->stats.misses);
+    pf->stats.depth = pf->depth;
+    *stats = pf->stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : report_block_prefetch
+// Description  : Log the prefetch counters.  Accuracy is the share of the
+//                prefetches that were useful, coverage the share of the
+//                misses (without prefetching) that they saved.
+//
+// Inputs       : stats - the counters
+// Outputs      : none
+
+void report_block_prefetch(const BlockPrefetchStats* stats)
+{
+    uint64_t judged = stats->useful + stats->wasted, needed = stats->useful + stats->misses;
+
+    logMessage(LOG_OUTPUT_LEVEL, "Prefetch: %" PRIu64 " issued, %" PRIu64 " useful, %" PRIu64 " wasted, %" PRIu64
+                                 " dropped",
+        stats->issued, stats->useful, stats->wasted, stats->dropped);
+    logMessage(LOG_OUTPUT_LEVEL, "Prefetch accuracy %.2f%%, coverage %.2f%%, %" PRIu64 " back offs, final depth %u",
+        (judged == 0) ? 0.0 : 100.0 * stats->useful / judged, (needed == 0) ? 0.0 : 100.0 * stats->useful / needed,
+        stats->throttles, stats->depth);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_prefetch_access
+// Description  : See a frame access: judge any prefetch of it (or any that
+//                have run out of time), and queue the predicted next frames.
+//                Runs with the driver lock held.
+//
+// Inputs       : prefetch - the prefetcher
+//                frm - the frame accessed
+//                write - non-zero if the frame is being written
+// Outputs      : none
+
+void block_prefetch_access(void* prefetch, uint16_t frm, int write)
+{
+    BlockPrefetch* pf = prefetch;
+    BlockPrefetchIssue* old;
+    uint32_t k, g;
+
+    pthread_mutex_lock(&pf->lock);
+    pf->now++;
+
+    // Prefetches not used within the horizon were wasted
+    while ((pf->ring_count > 0) && (pf->now - pf->ring[pf->ring_tail].time > pf->horizon)) {
+        old = &pf->ring[pf->ring_tail];
+        if ((pf->issued_at[old->frm] == old->time) && !pf->inflight[old->frm]) {
+            pf->issued_at[old->frm] = 0;
+            judge_prefetch(pf, 0);
+        }
+        pf->ring_tail = (pf->ring_tail + 1) % BLOCK_PREFETCH_RING;
+        pf->ring_count--;
+    }
+
+    // A prefetched frame is useful if it is still in the cache.  One that
+    // thread is still reading has either just arrived (and is useful) or
+    // not been read yet, and now will not be.
+    if (pf->issued_at[frm] != 0) {
+        if (!pf->inflight[frm]) {
+            judge_prefetch(pf, peek_block_cache(0, frm));
+        } else if (peek_block_cache(0, frm)) {
+            pf->stats.issued++;
+            judge_prefetch(pf, 1);
+        }
+        pf->issued_at[frm] = 0;
+        pf->inflight[frm] = 0;
+    }
+    pf->accessed_at[frm] = pf->now;
+
+    // Predict on each change of frame (unless paused)
+    if ((pf->depth == 0) && ((int32_t)(pf->now - pf->pause_until) >= 0)) {
+        pf->depth = 1;
+    }
+    if (((int32_t)frm != pf->last) && (pf->depth > 0) && (pf->nsucc[frm] > 0)) {
+        for (k = 0; k < pf->nsucc[frm]; k++) {
+            enqueue_frame(pf, pf->succ[frm][k], frm);
+        }
+        for (k = 1, g = pf->succ[frm][0]; (k < pf->depth) && (pf->nsucc[g] > 0); k++) {
+            g = pf->succ[g][0];
+            enqueue_frame(pf, g, frm);
+        }
+    }
+    pf->last = frm;
+    pthread_mutex_unlock(&pf->lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : free_block_prefetch
+// Description  : Release the prefetcher state (stopped first)
+//
+// Inputs       : pf - the prefetcher
+// Outputs      : none
+
+void free_block_prefetch(BlockPrefetch* pf)
+{
+    if (pf != NULL) {
+        pthread_mutex_destroy(&pf->lock);
+        pthread_cond_destroy(&pf->wake);
+        free(pf);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : next_frame
+// Description  : Read the access log up to the next change of frame
+//
+// Inputs       : fh - the access log
+//                prev - the frame before (-1 for none)
+//                frm - set to the next frame
+// Outputs      : 1 if a frame was read, 0 at the end of the log
+
+static int next_frame(FILE* fh, int32_t prev, unsigned int* frm)
+{
+    char op, line[64];
+
+    while (fgets(line, sizeof(line), fh) != NULL) {
+        if ((sscanf(line, "%c %u", &op, frm) == 2) && (*frm < BLOCK_BLOCK_SIZE) && ((int32_t)*frm != prev)) {
+            return (1);
+        }
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : prefetch_worker
+// Description  : The prefetch thread, reads the queued frames into the cache
+//
+// Inputs       : arg - the prefetcher
+// Outputs      : NULL
+
+static void* prefetch_worker(void* arg)
+{
+    BlockPrefetch* pf = arg;
+    BlockPrefetchIssue* old;
+    uint32_t time;
+    uint16_t frm;
+    int32_t ret;
+
+    pthread_mutex_lock(&pf->lock);
+    while (1) {
+        while ((pf->queue_count == 0) && !pf->stop) {
+            pthread_cond_wait(&pf->wake, &pf->lock);
+        }
+        if (pf->stop) {
+            break;
+        }
+        frm = pf->queue[pf->queue_head].frm;
+        time = pf->queue[pf->queue_head].time;
+        pf->queue_head = (pf->queue_head + 1) % BLOCK_PREFETCH_QUEUE;
+        pf->queue_count--;
+        pf->queued[frm] = 0;
+
+        // Predictions that came true (or went stale) while queued are dropped
+        if ((pf->accessed_at[frm] >= time) || (pf->now - time > pf->horizon)) {
+            continue;
+        }
+
+        // Read it (the driver lock is taken without holding ours), unless
+        // an access got to it first
+        pf->issued_at[frm] = time = pf->now;
+        pf->inflight[frm] = 1;
+        pthread_mutex_unlock(&pf->lock);
+        ret = block_fetch_frame(frm);
+        pthread_mutex_lock(&pf->lock);
+        if (!pf->inflight[frm] || (pf->issued_at[frm] != time)) {
+            continue;
+        }
+        pf->inflight[frm] = 0;
+        if (ret != 1) {
+            pf->issued_at[frm] = 0;
+            continue;
+        }
+
+        // Wait for it to be used, making room if too many are waiting
+        if (pf->ring_count == BLOCK_PREFETCH_RING) {
+            old = &pf->ring[pf->ring_tail];
+            if ((pf->issued_at[old->frm] == old->time) && !pf->inflight[old->frm]) {
+                pf->issued_at[old->frm] = 0;
+                judge_prefetch(pf, 0);
+            }
+            pf->ring_tail = (pf->ring_tail + 1) % BLOCK_PREFETCH_RING;
+            pf->ring_count--;
+        }
+        pf->ring[(pf->ring_tail + pf->ring_count++) % BLOCK_PREFETCH_RING] = (BlockPrefetchIssue) { frm, time };
+        pf->stats.issued++;
+    }
+    pthread_mutex_unlock(&pf->lock);
+    return (NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : enqueue_frame
+// Description  : Queue a predicted frame for the thread, unless it is the
+//                frame being accessed, already queued or already prefetched
+//
+// Inputs       : pf - the prefetcher (locked)
+//                frm - the predicted frame
+//                from - the frame being accessed
+// Outputs      : none
+
+static void enqueue_frame(BlockPrefetch* pf, uint16_t frm, uint16_t from)
+{
+    if ((frm == from) || pf->queued[frm] || (pf->issued_at[frm] != 0)) {
+        return;
+    }
+    if (pf->queue_count == BLOCK_PREFETCH_QUEUE) {
+        pf->stats.dropped++;
+        return;
+    }
+    pf->queue[(pf->queue_head + pf->queue_count++) % BLOCK_PREFETCH_QUEUE] = (BlockPrefetchIssue) { frm, pf->now };
+    pf->queued[frm] = 1;
+    pthread_cond_signal(&pf->wake);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : judge_prefetch
+// Description  : Count a prefetch as useful or wasted, and at the end of each
+//                window go deeper or back off depending on the accuracy
+//
+// Inputs       : pf - the prefetcher (locked)
+//                useful - non-zero if the prefetch was useful
+// Outputs      : none
+
+static void judge_prefetch(BlockPrefetch* pf, int useful)
+{
+    double accuracy;
+
+    if (useful) {
+        pf->stats.useful++;
+        pf->window_useful++;
+    } else {
+        pf->stats.wasted++;
+    }
+    if (++pf->window_judged < BLOCK_PREFETCH_WINDOW) {
+        return;
+    }
+
+    accuracy = (double)pf->window_useful / pf->window_judged;
+    pf->window_useful = pf->window_judged = 0;
+    if ((accuracy < BLOCK_PREFETCH_LOW) && (pf->depth > 0)) {
+        pf->stats.throttles++;
+        if (--pf->depth == 0) {
+            pf->pause_until = pf->now + pf->backoff;
+            if (pf->backoff < BLOCK_PREFETCH_MAX_BACKOFF) {
+                pf->backoff *= 2;
+            }
+        }
+    } else if (accuracy >= BLOCK_PREFETCH_HIGH) {
+        if (pf->depth < BLOCK_PREFETCH_MAX_DEPTH) {
+            pf->depth++;
+        }
+        pf->backoff = BLOCK_PREFETCH_MIN_BACKOFF;
+    }
+}
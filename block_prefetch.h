@@ -0,0 +1,58 @@
+#ifndef BLOCK_PREFETCH_INCLUDED
+#define BLOCK_PREFETCH_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_prefetch.h
+//  Description    : This is the interface for the trace-driven frame
+//                   prefetcher.  It learns which frames follow which from
+//                   an access log of a previous run, and reads the likely
+//                   next frames into the cache on a background thread.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// Defines
+#define BLOCK_PREFETCH_WAYS 2 // Successors kept for each frame
+#define BLOCK_PREFETCH_MAX_DEPTH 4 // Most steps predicted ahead
+#define BLOCK_PREFETCH_MIN_CONFIDENCE 0.2 // Least share of a frame's successors kept
+
+// The prefetcher counters
+typedef struct {
+    uint64_t issued; // Frames read into the cache ahead of use
+    uint64_t useful; // Of those, used while still cached
+    uint64_t wasted; // Of those, evicted or not used in time
+    uint64_t dropped; // Predictions dropped with the queue full
+    uint64_t throttles; // Times the prefetcher backed off
+    uint64_t misses; // Demand cache misses left
+    uint32_t depth; // Steps predicted ahead at the end
+} BlockPrefetchStats;
+
+// The prefetcher state (opaque)
+typedef struct BlockPrefetch BlockPrefetch;
+
+//
+// Interface functions
+
+BlockPrefetch* create_block_prefetch(const char* log, uint32_t horizon);
+// Learn the frame successors from an access log, NULL on failure
+
+int start_block_prefetch(BlockPrefetch* pf);
+// Start the prefetch thread and hook it into the driver
+
+void stop_block_prefetch(BlockPrefetch* pf, BlockPrefetchStats* stats);
+// Unhook and stop the prefetch thread, and get its counters
+
+void report_block_prefetch(const BlockPrefetchStats* stats);
+// Log the prefetch counters, accuracy and coverage
+
+void block_prefetch_access(void* pf, uint16_t frm, int write);
+// Predict from a frame access (matches BlockFrameAccessHook)
+
+void free_block_prefetch(BlockPrefetch* pf);
+// Release the prefetcher state
+
+#endif
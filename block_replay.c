@@ -0,0 +1,645 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_replay.c
+//  Description    : This is the implementation of the workload replay engine
+//                   for the BLOCK simulator.  With more than one job the
+//                   operations are split into per-file queues (keeping the
+//                   order within each file) and handed out to worker threads,
+//                   which steal whole files from each other when they run dry.
+//                   The open-loop replay issues operations on a schedule
+//                   instead, and charges any lateness to the operation.
+//                   prepare_block_replay sets up the queues and read buffers
+//                   once, so the replays themselves do not touch the heap.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Project Includes
+#include <block_backend.h>
+#include <block_buffer.h>
+#include <block_controller.h>
+#include <block_replay.h>
+#include <cmpsc311_log.h>
+
+// The per-worker state, a deque of files to replay
+typedef struct BlockReplayShared BlockReplayShared;
+typedef struct {
+    BlockReplayShared* shared; // The state shared by all workers
+    pthread_t thread; // The worker thread
+    pthread_mutex_t lock; // Protects the deque
+    int id; // The worker number
+    int* files; // Deque of file indices
+    int head; // First file still queued
+    int tail; // One past the last file queued
+    volatile uint32_t load; // Number of operations still queued
+    uint32_t executed; // Number of operations run by this worker
+    uint32_t steals; // Number of files taken from other workers
+    BlockLatencyStats* stats; // Per-command timings of this worker (or NULL)
+    BlockLatencyStats* timings; // The worker's timings, when stats are kept
+    char* rbuf; // Read buffer (as long as the longest operation)
+} BlockReplayWorker;
+
+// The state shared by all of the workers
+struct BlockReplayShared {
+    BlockWorkload* wl; // The workload being replayed
+    BlockSimulationTable* ftable; // The file table
+    uint32_t* start; // Index of the first op of each file in order[]
+    uint32_t* order; // The op indices, grouped by file
+    BlockReplayWorker* workers; // The workers
+    int nworkers; // Number of workers allocated
+    int jobs; // Number of workers in this replay
+    volatile int failed; // Set when any operation fails
+};
+
+static BlockReplayShared replay; // The prepared replay state (wl NULL if none)
+
+//
+// Functional Prototypes
+
+static int replay_sequential(BlockWorkload* wl, BlockSimulationTable* ftable, BlockLatencyStats* stats);
+static int replay_parallel(BlockWorkload* wl, BlockSimulationTable* ftable, int jobs, BlockLatencyStats* stats);
+static int timed_block_op(BlockSimulationTable* ftable, BlockWorkloadOp* op, char* rbuf, BlockLatencyStats* stats);
+static char* prepared_buffer(BlockWorkload* wl);
+static void* replay_worker(void* arg);
+static int next_replay_file(BlockReplayShared* shared, BlockReplayWorker* self);
+static void wait_until(uint64_t when);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : init_block_replay_table
+// Description  : Setup the file table for a workload (no files opened yet)
+//
+// Inputs       : ftable - the table to setup (BLOCK_WORKLOAD_MAX_FILES entries)
+//                wl - the loaded workload
+// Outputs      : none
+
+void init_block_replay_table(BlockSimulationTable* ftable, BlockWorkload* wl)
+{
+    int i;
+
+    memset(ftable, 0x0, sizeof(BlockSimulationTable) * BLOCK_WORKLOAD_MAX_FILES);
+    for (i = 0; i < wl->nfiles; i++) {
+        ftable[i].filename = wl->files[i];
+        ftable[i].fhandle = -1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : rewind_block_replay_table
+// Description  : Seek every open file back to the start.  Replaying a
+//                workload again from there rewrites the same bytes in the
+//                same places, so the files still validate afterwards.
+//
+// Inputs       : ftable - the file table
+//                nfiles - the number of entries in the table
+// Outputs      : none
+
+void rewind_block_replay_table(BlockSimulationTable* ftable, int nfiles)
+{
+    int i;
+
+    for (i = 0; i < nfiles; i++) {
+        if (ftable[i].fhandle != -1) {
+            block_backend->seek(ftable[i].fhandle, 0);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : execute_block_op
+// Description  : Run one workload operation against the driver, opening the
+//                file on first use
+//
+// Inputs       : ftable - the file table
+//                op - the operation to run
+//                rbuf - buffer for a READ of op->len bytes (NULL to take
+//                       one from the buffer pool)
+// Outputs      : 0 if successful, -1 if failure
+
+int execute_block_op(BlockSimulationTable* ftable, BlockWorkloadOp* op, char* rbuf)
+{
+    // Local variables
+    BlockSimulationTable* ent = &ftable[op->file];
+    char* fname = ent->filename;
+    char* buf;
+
+    // Just log the contents
+    logMessage(BlockSimulatorLLevel, "File [%s], command [%s], len=%d, offset=%d",
+        fname, block_workload_command_name(op->command), op->len, op->off);
+
+    // File is not open yet, open the file
+    if (ent->fhandle == -1) {
+        logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Opening file [%s]", fname);
+        ent->fhandle = block_backend->open(fname);
+        if (ent->fhandle == -1) {
+            // Failed, error out
+            logMessage(LOG_ERROR_LEVEL, "Open of new file [%s] failed, aborting simulation.", fname);
+            return (-1);
+        }
+    }
+
+    // Now execute the specific command
+    switch (op->command) {
+    case BLOCK_WL_WRITEAT:
+
+        // Log the command executed
+        logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Writing %d bytes at position %d from file [%s]", op->len, op->off, fname);
+
+        // First perform the seek
+        if (block_backend->seek(ent->fhandle, op->off)) {
+            // Failed, error out
+            logMessage(LOG_ERROR_LEVEL, "Seek/WriteAt file [%s] to position %d failed, aborting simulation.", fname, op->off);
+            return (-1);
+        }
+
+        // Now perform the write
+        if (block_backend->write(ent->fhandle, op->data, op->len) != op->len) {
+            // Failed, error out
+            logMessage(LOG_ERROR_LEVEL, "WriteAt of file [%s], length %d failed, aborting simulation.", fname, op->len);
+            return (-1);
+        }
+        break;
+
+    case BLOCK_WL_WRITE:
+
+        // Log the command executed
+        logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Writing %d bytes to file [%s]", op->len, fname);
+
+        // Now perform the write
+        if (block_backend->write(ent->fhandle, op->data, op->len) != op->len) {
+            // Failed, error out
+            logMessage(LOG_ERROR_LEVEL, "Write of file [%s], length %d failed, aborting simulation.", fname, op->len);
+            return (-1);
+        }
+        break;
+
+    case BLOCK_WL_SEEK:
+
+        // Log the command executed
+        logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Seeking to position %d in file [%s]", op->off, fname);
+
+        // Now perform the seek
+        if (block_backend->seek(ent->fhandle, op->off) != op->len) {
+            // Failed, error out
+            logMessage(LOG_ERROR_LEVEL, "Seek in file [%s] to position %d failed, aborting simulation.", fname, op->off);
+            return (-1);
+        }
+        break;
+
+    case BLOCK_WL_READ:
+
+        // Log the command executed
+        logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Reading %d bytes from file [%s]", op->len, fname);
+
+        // Now perform the read
+        buf = (rbuf != NULL) ? rbuf : block_buffer_alloc(op->len);
+        if (block_backend->read(ent->fhandle, buf, op->len) != op->len) {
+            // Failed, error out
+            logMessage(LOG_ERROR_LEVEL, "Read file [%s] of length %d failed, aborting simulation.", fname, op->off);
+            if (rbuf == NULL) {
+                block_buffer_free(buf, op->len);
+            }
+            return (-1);
+        }
+        if (rbuf == NULL) {
+            block_buffer_free(buf, op->len);
+        }
+        break;
+
+    default:
+        // Bomb out, don't understand the command
+        CMPSC_ASSERT1(0, "BLOCK_SIM : Failed, unknown command [%d]", op->command);
+        return (-1);
+    }
+
+    // Return successfully
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_block_workload
+// Description  : Replay the workload, splitting it by file over "jobs"
+//                threads (a single job replays the lines in file order)
+//
+// Inputs       : wl - the loaded workload
+//                ftable - the file table
+//                jobs - the number of threads to use
+//                stats - BLOCK_WL_MAXVAL per-command timings to add to, or
+//                        NULL to run untimed
+// Outputs      : 0 if successful, -1 if failure
+
+int replay_block_workload(BlockWorkload* wl, BlockSimulationTable* ftable, int jobs, BlockLatencyStats* stats)
+{
+    if (jobs <= 1) {
+        return (replay_sequential(wl, ftable, stats));
+    }
+    if (jobs > BLOCK_REPLAY_MAX_JOBS) {
+        jobs = BLOCK_REPLAY_MAX_JOBS;
+    }
+    return (replay_parallel(wl, ftable, jobs, stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : timed_block_op
+// Description  : Run one workload operation, timing it if asked to
+//
+// Inputs       : ftable - the file table
+//                op - the operation to run
+//                rbuf - read buffer (or NULL)
+//                stats - per-command timings to add to (or NULL)
+// Outputs      : 0 if successful, -1 if failure
+
+static int timed_block_op(BlockSimulationTable* ftable, BlockWorkloadOp* op, char* rbuf, BlockLatencyStats* stats)
+{
+    uint64_t start;
+    int ret;
+
+    if (stats == NULL) {
+        return (execute_block_op(ftable, op, rbuf));
+    }
+    start = block_clock_ns();
+    ret = execute_block_op(ftable, op, rbuf);
+    record_block_latency(&stats[op->command], block_clock_ns() - start,
+        (op->command == BLOCK_WL_SEEK) ? 0 : op->len);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_sequential
+// Description  : Replay the workload in file order on the calling thread
+//
+// Inputs       : wl - the loaded workload
+//                ftable - the file table
+//                stats - per-command timings to add to (or NULL)
+// Outputs      : 0 if successful, -1 if failure
+
+static int replay_sequential(BlockWorkload* wl, BlockSimulationTable* ftable, BlockLatencyStats* stats)
+{
+    char* rbuf = prepared_buffer(wl);
+    uint32_t i;
+
+    for (i = 0; i < wl->nops; i++) {
+        if (timed_block_op(ftable, &wl->ops[i], rbuf, stats) != 0) {
+            return (-1);
+        }
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_parallel
+// Description  : Split the workload into per-file queues and replay them on
+//                "jobs" worker threads
+//
+// Inputs       : wl - the loaded workload
+//                ftable - the file table
+//                jobs - the number of threads to use
+//                stats - per-command timings to add to (or NULL)
+// Outputs      : 0 if successful, -1 if failure
+
+static int replay_parallel(BlockWorkload* wl, BlockSimulationTable* ftable, int jobs, BlockLatencyStats* stats)
+{
+    // Local variables
+    BlockReplayWorker* w;
+    int sorted[BLOCK_WORKLOAD_MAX_FILES], f, j, k, c, best, ret, temporary = 0;
+
+    // Use the prepared state, or prepare it just for this replay
+    if ((replay.wl != wl) || (replay.nworkers < jobs)) {
+        if (prepare_block_replay(wl, jobs) != 0) {
+            return (-1);
+        }
+        temporary = 1;
+    }
+    replay.ftable = ftable;
+    replay.jobs = jobs;
+    replay.failed = 0;
+
+    // Hand the files out, biggest first, to the least loaded worker
+    for (f = 0; f < wl->nfiles; f++) {
+        sorted[f] = f;
+    }
+    for (f = 1; f < wl->nfiles; f++) {
+        k = sorted[f];
+        for (j = f - 1; (j >= 0) && (replay.start[sorted[j] + 1] - replay.start[sorted[j]] < replay.start[k + 1] - replay.start[k]); j--) {
+            sorted[j + 1] = sorted[j];
+        }
+        sorted[j + 1] = k;
+    }
+    for (j = 0; j < jobs; j++) {
+        w = &replay.workers[j];
+        w->head = w->tail = 0;
+        w->load = w->executed = w->steals = 0;
+        w->stats = (stats != NULL) ? w->timings : NULL;
+        for (c = 0; (w->stats != NULL) && (c < BLOCK_WL_MAXVAL); c++) {
+            init_block_latency(&w->stats[c]);
+        }
+    }
+    for (f = 0; f < wl->nfiles; f++) {
+        best = 0;
+        for (j = 1; j < jobs; j++) {
+            if (replay.workers[j].load < replay.workers[best].load) {
+                best = j;
+            }
+        }
+        w = &replay.workers[best];
+        w->files[w->tail++] = sorted[f];
+        w->load += replay.start[sorted[f] + 1] - replay.start[sorted[f]];
+    }
+
+    // Start the workers and wait for them to drain all of the queues
+    for (j = 0; j < jobs; j++) {
+        pthread_create(&replay.workers[j].thread, NULL, replay_worker, &replay.workers[j]);
+    }
+    for (j = 0; j < jobs; j++) {
+        w = &replay.workers[j];
+        pthread_join(w->thread, NULL);
+        logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Worker %d ran %u ops, stole %u files.",
+            w->id, w->executed, w->steals);
+        for (c = 0; (w->stats != NULL) && (c < BLOCK_WL_MAXVAL); c++) {
+            merge_block_latency(&stats[c], &w->stats[c]);
+        }
+    }
+    ret = (replay.failed) ? -1 : 0;
+
+    // Cleanup and return
+    if (temporary) {
+        release_block_replay();
+    }
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : prepare_block_replay
+// Description  : Allocate the replay state for a workload: the operations
+//                grouped by file, and the queues, timings and a read buffer
+//                (as long as the longest operation) for each of "jobs"
+//                workers.  Replays of this workload then make no heap
+//                allocations.
+//
+// Inputs       : wl - the loaded workload
+//                jobs - the most threads it will be replayed on
+// Outputs      : 0 if successful, -1 if failure
+
+int prepare_block_replay(BlockWorkload* wl, int jobs)
+{
+    // Local variables
+    uint32_t fill[BLOCK_WORKLOAD_MAX_FILES], i;
+    BlockReplayWorker* w;
+    int f, j;
+
+    // Group the operations by file, keeping the order within each file
+    release_block_replay();
+    jobs = (jobs < 1) ? 1 : jobs;
+    replay.wl = wl;
+    replay.start = calloc(wl->nfiles + 1, sizeof(uint32_t));
+    replay.order = malloc(sizeof(uint32_t) * (wl->nops + 1));
+    replay.workers = calloc(jobs, sizeof(BlockReplayWorker));
+    if ((replay.start == NULL) || (replay.order == NULL) || (replay.workers == NULL)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK replay allocation failed.");
+        release_block_replay();
+        return (-1);
+    }
+    for (i = 0; i < wl->nops; i++) {
+        replay.start[wl->ops[i].file + 1]++;
+    }
+    for (f = 0; f < wl->nfiles; f++) {
+        replay.start[f + 1] += replay.start[f];
+        fill[f] = replay.start[f];
+    }
+    for (i = 0; i < wl->nops; i++) {
+        replay.order[fill[wl->ops[i].file]++] = i;
+    }
+
+    // Now each worker's queue, timings and read buffer
+    for (j = 0; j < jobs; j++) {
+        w = &replay.workers[j];
+        w->shared = &replay;
+        w->id = j;
+        pthread_mutex_init(&w->lock, NULL);
+        replay.nworkers++;
+        w->files = malloc(sizeof(int) * (wl->nfiles + 1));
+        w->timings = malloc(sizeof(BlockLatencyStats) * BLOCK_WL_MAXVAL);
+        w->rbuf = block_buffer_alloc((wl->maxlen > 0) ? wl->maxlen : 1);
+        if ((w->files == NULL) || (w->timings == NULL) || (w->rbuf == NULL)) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK replay allocation failed.");
+            release_block_replay();
+            return (-1);
+        }
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : release_block_replay
+// Description  : Free the prepared replay state (if any)
+//
+// Inputs       : none
+// Outputs      : none
+
+void release_block_replay(void)
+{
+    BlockReplayWorker* w;
+    int j;
+
+    for (j = 0; j < replay.nworkers; j++) {
+        w = &replay.workers[j];
+        pthread_mutex_destroy(&w->lock);
+        free(w->files);
+        free(w->timings);
+        block_buffer_free(w->rbuf, (replay.wl->maxlen > 0) ? replay.wl->maxlen : 1);
+    }
+    free(replay.start);
+    free(replay.order);
+    free(replay.workers);
+    memset(&replay, 0x0, sizeof(replay));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : prepared_buffer
+// Description  : Find the prepared read buffer for a single threaded replay
+//
+// Inputs       : wl - the workload being replayed
+// Outputs      : the first worker's buffer, or NULL if wl is not prepared
+
+static char* prepared_buffer(BlockWorkload* wl)
+{
+    return (((replay.wl == wl) && (replay.nworkers > 0)) ? replay.workers[0].rbuf : NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_worker
+// Description  : The worker thread, replays files until there are none left
+//
+// Inputs       : arg - the worker state
+// Outputs      : NULL
+
+static void* replay_worker(void* arg)
+{
+    // Local variables
+    BlockReplayWorker* self = arg;
+    BlockReplayShared* shared = self->shared;
+    uint32_t i;
+    int f;
+
+    // Replay whole files, in order, until the queues are empty
+    while ((!shared->failed) && ((f = next_replay_file(shared, self)) != -1)) {
+        for (i = shared->start[f]; (i < shared->start[f + 1]) && (!shared->failed); i++) {
+            if (timed_block_op(shared->ftable, &shared->wl->ops[shared->order[i]], self->rbuf, self->stats) != 0) {
+                shared->failed = 1;
+            }
+            self->executed++;
+        }
+    }
+    return (NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : next_replay_file
+// Description  : Take the next file from our own queue, or steal the last
+//                file of the most loaded worker if our queue is empty
+//
+// Inputs       : shared - the shared replay state
+//                self - the calling worker
+// Outputs      : the file index, or -1 if there is no work left
+
+static int next_replay_file(BlockReplayShared* shared, BlockReplayWorker* self)
+{
+    // Local variables
+    BlockReplayWorker* victim;
+    uint32_t most;
+    int f, j;
+
+    // Try our own queue first
+    pthread_mutex_lock(&self->lock);
+    if (self->head < self->tail) {
+        f = self->files[self->head++];
+        self->load -= shared->start[f + 1] - shared->start[f];
+        pthread_mutex_unlock(&self->lock);
+        return (f);
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    // Steal from the back of whoever has the most left
+    while (1) {
+        victim = NULL;
+        most = 0;
+        for (j = 0; j < shared->jobs; j++) {
+            if ((&shared->workers[j] != self) && (shared->workers[j].load > most)) {
+                victim = &shared->workers[j];
+                most = victim->load;
+            }
+        }
+        if (victim == NULL) {
+            return (-1);
+        }
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail) {
+            f = victim->files[--victim->tail];
+            victim->load -= shared->start[f + 1] - shared->start[f];
+            pthread_mutex_unlock(&victim->lock);
+            self->steals++;
+            return (f);
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_block_workload_open
+// Description  : Replay the workload open-loop: operation i is scheduled at
+//                a fixed time from the start whatever happened before it,
+//                and its latency runs from that scheduled time (so a slow
+//                operation shows up in the latency of the ones queued behind
+//                it, rather than silently lowering the offered load).
+//
+// Inputs       : wl - the loaded workload
+//                ftable - the file table
+//                iops - the target operations per second
+//                arrival - how the operations are spaced
+//                stats - BLOCK_WL_MAXVAL per-command timings to add to
+//                elapsed - set to the time taken by the replay
+// Outputs      : 0 if successful, -1 if failure
+
+int replay_block_workload_open(BlockWorkload* wl, BlockSimulationTable* ftable, double iops,
+    BlockArrival arrival, BlockLatencyStats* stats, uint64_t* elapsed)
+{
+    // Local variables
+    uint64_t start, now, rng = BLOCK_REPLAY_SEED;
+    double when = 0, u;
+    BlockWorkloadOp* op;
+    char* rbuf = prepared_buffer(wl);
+    uint32_t i;
+
+    start = block_clock_ns();
+    for (i = 0; i < wl->nops; i++) {
+        op = &wl->ops[i];
+
+        // Wait for the scheduled start of the operation
+        wait_until(start + (uint64_t)when);
+        if (execute_block_op(ftable, op, rbuf) != 0) {
+            return (-1);
+        }
+        now = block_clock_ns();
+        record_block_latency(&stats[op->command], now - (start + (uint64_t)when),
+            (op->command == BLOCK_WL_SEEK) ? 0 : op->len);
+
+        // Schedule the next operation
+        if (arrival == BLOCK_ARRIVAL_POISSON) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            u = (rng >> 11) * (1.0 / 9007199254740992.0);
+            when += -log(1.0 - u) * 1e9 / iops;
+        } else {
+            when += 1e9 / iops;
+        }
+    }
+    *elapsed = block_clock_ns() - start;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : wait_until
+// Description  : Sleep until shortly before a time, then spin up to it
+//
+// Inputs       : when - the monotonic time to wait for (ns)
+// Outputs      : none
+
+static void wait_until(uint64_t when)
+{
+    struct timespec ts;
+    uint64_t now = block_clock_ns();
+
+    if (now + 50000 < when) {
+        ts.tv_sec = (when - 50000) / 1000000000ULL;
+        ts.tv_nsec = (when - 50000) % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+    while (block_clock_ns() < when)
+        ;
+}
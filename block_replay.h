@@ -0,0 +1,65 @@
+#ifndef BLOCK_REPLAY_INCLUDED
+#define BLOCK_REPLAY_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_replay.h
+//  Description    : This is the interface for replaying a loaded workload
+//                   against the selected backend, on one or more threads.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// Project Includes
+#include <block_stats.h>
+#include <block_workload.h>
+
+// Defines
+#define BLOCK_REPLAY_MAX_JOBS 64 // Maximum number of replay threads
+#define BLOCK_REPLAY_SEED 1 // Seed for the Poisson arrival times
+
+// How open-loop operations are scheduled
+typedef enum {
+    BLOCK_ARRIVAL_CONSTANT = 0, // Evenly spaced at the target rate
+    BLOCK_ARRIVAL_POISSON = 1, // Exponential gaps with the target mean rate
+} BlockArrival;
+
+// This is the file table
+typedef struct {
+    char* filename; // This is the filename for the test file
+    int16_t fhandle; // This is a file handle for the opened file (-1 if not open)
+} BlockSimulationTable;
+
+//
+// Interface functions
+
+void init_block_replay_table(BlockSimulationTable* ftable, BlockWorkload* wl);
+// Setup the file table for a workload (no files opened yet)
+
+int execute_block_op(BlockSimulationTable* ftable, BlockWorkloadOp* op, char* rbuf);
+// Run one workload operation against the driver (reading into rbuf, or a
+// pooled buffer if it is NULL)
+
+int prepare_block_replay(BlockWorkload* wl, int jobs);
+// Allocate the queues and read buffers to replay wl on up to "jobs" threads
+// (the replays then make no heap allocations)
+
+void release_block_replay(void);
+// Free the state from prepare_block_replay
+
+void rewind_block_replay_table(BlockSimulationTable* ftable, int nfiles);
+// Seek every open file back to the start so the workload can be replayed again
+
+int replay_block_workload(BlockWorkload* wl, BlockSimulationTable* ftable, int jobs, BlockLatencyStats* stats);
+// Replay the workload, splitting it by file over "jobs" threads (timing each
+// command into stats[BLOCK_WL_MAXVAL] unless it is NULL)
+
+int replay_block_workload_open(BlockWorkload* wl, BlockSimulationTable* ftable, double iops,
+    BlockArrival arrival, BlockLatencyStats* stats, uint64_t* elapsed);
+// Replay the workload open-loop at "iops", timing each command from its
+// scheduled start into stats[BLOCK_WL_MAXVAL]
+
+#endif
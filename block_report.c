@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_report.c
+//  Description    : This is the implementation of the timing reports for the
+//                   BLOCK simulator.  Op and byte rates are over the wall
+//                   clock time of the replay phase.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <inttypes.h>
+#include <string.h>
+
+// Project Includes
+#include <block_report.h>
+#include <cmpsc311_log.h>
+
+// The names of the phases
+static const char* block_phase_names[BLOCK_PHASE_MAXVAL] = {
+    "poweron", "warmup", "replay", "validate", "poweroff"
+};
+
+//
+// Functional Prototypes
+
+static void write_json_latency(FILE* out, const char* name, BlockLatencyStats* st, uint64_t wall_ns);
+static void write_json_string(FILE* out, const char* str);
+static void write_json_passes(FILE* out, const char* name, const double* x, int n);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : init_block_result
+// Description  : Clear the timings of a run
+//
+// Inputs       : res - the result to clear
+//                backend - the name of the backend
+// Outputs      : none
+
+void init_block_result(BlockSimulationResult* res, const char* backend)
+{
+    int i;
+
+    memset(res, 0x0, sizeof(BlockSimulationResult));
+    res->backend = backend;
+    init_block_latency(&res->latency);
+    for (i = 0; i < BLOCK_WL_MAXVAL; i++) {
+        init_block_latency(&res->commands[i]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : report_block_result
+// Description  : Log the phase and per-command timings of a run
+//
+// Inputs       : res - the result of the run
+// Outputs      : none
+
+void report_block_result(BlockSimulationResult* res)
+{
+    double secs = res->phase_ns[BLOCK_PHASE_REPLAY] / 1e9, mean, half;
+    BlockLatencyStats* st;
+    int i;
+
+    logMessage(LOG_OUTPUT_LEVEL, "========== Timing (%s) ==========", res->backend);
+    for (i = 0; i < BLOCK_PHASE_MAXVAL; i++) {
+        logMessage(LOG_OUTPUT_LEVEL, "%-8s %10.3f ms", block_phase_names[i], res->phase_ns[i] / 1e6);
+    }
+    logMessage(LOG_OUTPUT_LEVEL, "%-8s %9s %10s %11s %9s %9s %9s %9s %9s %9s",
+        "command", "count", "total ms", "ops/s", "MB/s", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+    for (i = 0; i <= BLOCK_WL_MAXVAL; i++) {
+        st = (i == BLOCK_WL_MAXVAL) ? &res->latency : &res->commands[i];
+        if ((st->count == 0) && (i != BLOCK_WL_MAXVAL)) {
+            continue;
+        }
+        logMessage(LOG_OUTPUT_LEVEL, "%-8s %9lu %10.3f %11.0f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f",
+            (i == BLOCK_WL_MAXVAL) ? "all" : block_workload_command_name(i), st->count, st->total_ns / 1e6,
+            (secs > 0) ? st->count / secs : 0.0, (secs > 0) ? st->bytes / secs / 1e6 : 0.0,
+            (st->count > 0) ? st->total_ns / 1e3 / st->count : 0.0,
+            block_latency_percentile(st, 50) / 1e3, block_latency_percentile(st, 90) / 1e3,
+            block_latency_percentile(st, 99) / 1e3, st->max_ns / 1e3);
+    }
+
+    // The steady state, over the measured passes
+    if ((res->passes > 1) || (res->warmup > 0)) {
+        mean = block_mean_ci95(res->pass_ops, res->passes, &half);
+        logMessage(LOG_OUTPUT_LEVEL, "%d passes after %d warmup: %.0f +/- %.0f ops/s (95%% CI)",
+            res->passes, res->warmup, mean, half);
+        if (res->pass_hits[0] >= 0) {
+            mean = block_mean_ci95(res->pass_hits, res->passes, &half);
+            logMessage(LOG_OUTPUT_LEVEL, "%d passes after %d warmup: %.2f%% +/- %.2f%% cache hits (95%% CI)",
+                res->passes, res->warmup, mean * 100, half * 100);
+        }
+    }
+    logMessage(LOG_OUTPUT_LEVEL, "=================================");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : report_backends
+// Description  : Log the replay throughput and latency of each backend
+//                side by side
+//
+// Inputs       : results - the results of each backend
+//                count - the number of backends
+// Outputs      : none
+
+void report_backends(BlockSimulationResult* results, int count)
+{
+    BlockSimulationResult* r;
+    double secs;
+    int b;
+
+    logMessage(LOG_OUTPUT_LEVEL, "========== Backend Comparison ==========");
+    logMessage(LOG_OUTPUT_LEVEL, "%-8s %10s %12s %10s %10s %10s %10s",
+        "backend", "replay ms", "ops/s", "MB/s", "mean us", "p50 us", "p99 us");
+    for (b = 0; b < count; b++) {
+        r = &results[b];
+        secs = r->phase_ns[BLOCK_PHASE_REPLAY] / 1e9;
+        logMessage(LOG_OUTPUT_LEVEL, "%-8s %10.2f %12.0f %10.2f %10.2f %10.2f %10.2f",
+            r->backend, r->phase_ns[BLOCK_PHASE_REPLAY] / 1e6, (secs > 0) ? r->latency.count / secs : 0.0,
+            (secs > 0) ? r->latency.bytes / secs / 1e6 : 0.0,
+            (r->latency.count > 0) ? r->latency.total_ns / 1e3 / r->latency.count : 0.0,
+            block_latency_percentile(&r->latency, 50) / 1e3, block_latency_percentile(&r->latency, 99) / 1e3);
+    }
+    logMessage(LOG_OUTPUT_LEVEL, "========================================");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_block_report_json
+// Description  : Write the timings of every run as JSON
+//
+// Inputs       : out - the stream to write to
+//                workload - the name of the workload file
+//                cache_size - the frame cache size
+//                jobs - the number of replay threads
+//                results - the results of each backend
+//                count - the number of backends
+// Outputs      : 0 if successful, -1 if failure
+
+int write_block_report_json(FILE* out, const char* workload, uint32_t cache_size, int jobs,
+    BlockSimulationResult* results, int count)
+{
+    BlockSimulationResult* r;
+    int b, i;
+
+    fprintf(out, "{\n  \"workload\": ");
+    write_json_string(out, workload);
+    fprintf(out, ",\n  \"cache_size\": %u,\n  \"jobs\": %d,\n  \"runs\": [\n", cache_size, jobs);
+    for (b = 0; b < count; b++) {
+        r = &results[b];
+        fprintf(out, "    {\n      \"backend\": \"%s\",\n      \"phases_ns\": {", r->backend);
+        for (i = 0; i < BLOCK_PHASE_MAXVAL; i++) {
+            fprintf(out, "%s\"%s\": %" PRIu64, (i == 0) ? " " : ", ", block_phase_names[i], r->phase_ns[i]);
+        }
+        fprintf(out, " },\n      \"commands\": {\n");
+        for (i = 0; i < BLOCK_WL_MAXVAL; i++) {
+            write_json_latency(out, block_workload_command_name(i), &r->commands[i], r->phase_ns[BLOCK_PHASE_REPLAY]);
+            fprintf(out, ",\n");
+        }
+        write_json_latency(out, "all", &r->latency, r->phase_ns[BLOCK_PHASE_REPLAY]);
+        fprintf(out, "\n      },\n      \"warmup\": %d,\n      \"passes\": %d,\n", r->warmup, r->passes);
+        write_json_passes(out, "ops_per_s", r->pass_ops, r->passes);
+        if (r->pass_hits[0] >= 0) {
+            fprintf(out, ",\n");
+            write_json_passes(out, "hit_ratio", r->pass_hits, r->passes);
+        }
+        fprintf(out, "\n    }%s\n", (b < count - 1) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return (ferror(out) ? -1 : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_json_latency
+// Description  : Write one latency distribution as a JSON member
+//
+// Inputs       : out - the stream to write to
+//                name - the member name
+//                st - the distribution
+//                wall_ns - the wall clock time the rates are over
+// Outputs      : none
+
+static void write_json_latency(FILE* out, const char* name, BlockLatencyStats* st, uint64_t wall_ns)
+{
+    double secs = wall_ns / 1e9;
+
+    fprintf(out, "        \"%s\": { \"count\": %" PRIu64 ", \"bytes\": %" PRIu64 ", \"total_ns\": %" PRIu64 ", "
+                 "\"ops_per_s\": %.1f, \"mb_per_s\": %.3f, \"mean_ns\": %.1f, \"min_ns\": %" PRIu64 ", "
+                 "\"p50_ns\": %" PRIu64 ", \"p90_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 ", "
+                 "\"p999_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 " }",
+        name, st->count, st->bytes, st->total_ns, (secs > 0) ? st->count / secs : 0.0,
+        (secs > 0) ? st->bytes / secs / 1e6 : 0.0, (st->count > 0) ? (double)st->total_ns / st->count : 0.0,
+        (st->count > 0) ? st->min_ns : 0, block_latency_percentile(st, 50), block_latency_percentile(st, 90),
+        block_latency_percentile(st, 99), block_latency_percentile(st, 99.9), st->max_ns);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_json_passes
+// Description  : Write the per-pass values of a measure, with their mean and
+//                95% confidence interval, as a JSON member
+//
+// Inputs       : out - the stream to write to
+//                name - the member name
+//                x - the value of each pass
+//                n - the number of passes
+// Outputs      : none
+
+static void write_json_passes(FILE* out, const char* name, const double* x, int n)
+{
+    double mean, half;
+    int i;
+
+    mean = block_mean_ci95(x, n, &half);
+    fprintf(out, "      \"%s\": { \"mean\": %.6g, \"ci95\": %.6g, \"samples\": [", name, mean, half);
+    for (i = 0; i < n; i++) {
+        fprintf(out, "%s%.6g", (i == 0) ? "" : ", ", x[i]);
+    }
+    fprintf(out, "] }");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_json_string
+// Description  : Write a string as a quoted, escaped JSON string
+//
+// Inputs       : out - the stream to write to
+//                str - the string
+// Outputs      : none
+
+static void write_json_string(FILE* out, const char* str)
+{
+    fputc('"', out);
+    for (; *str != 0x0; str++) {
+        if ((*str == '"') || (*str == '\\')) {
+            fprintf(out, "\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char)*str);
+        } else {
+            fputc(*str, out);
+        }
+    }
+    fputc('"', out);
+}
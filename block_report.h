@@ -0,0 +1,63 @@
+#ifndef BLOCK_REPORT_INCLUDED
+#define BLOCK_REPORT_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_report.h
+//  Description    : This is the interface for reporting the timings of a
+//                   BLOCK simulation run, as text or as JSON.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+#include <stdio.h>
+
+// Project Includes
+#include <block_stats.h>
+#include <block_workload.h>
+
+// Defines
+#define BLOCK_REPORT_MAX_PASSES 256 // Maximum measured replays in one run
+
+// The phases of a run
+typedef enum {
+    BLOCK_PHASE_POWERON = 0, // Starting the backend
+    BLOCK_PHASE_WARMUP = 1, // Unmeasured replays
+    BLOCK_PHASE_REPLAY = 2, // Replaying the workload
+    BLOCK_PHASE_VALIDATE = 3, // Checking the files
+    BLOCK_PHASE_POWEROFF = 4, // Shutting the backend down
+    BLOCK_PHASE_MAXVAL = 5, // Maximum phase value
+} BlockPhase;
+
+// The timings of one backend's run
+typedef struct {
+    const char* backend; // The name of the backend
+    uint64_t phase_ns[BLOCK_PHASE_MAXVAL]; // Time taken by each phase
+    BlockLatencyStats latency; // Latency of every operation
+    BlockLatencyStats commands[BLOCK_WL_MAXVAL]; // Latency of each command
+    int warmup; // Unmeasured replays before the measured ones
+    int passes; // Measured replays
+    double pass_ops[BLOCK_REPORT_MAX_PASSES]; // Operations per second of each replay
+    double pass_hits[BLOCK_REPORT_MAX_PASSES]; // Cache hit ratio of each replay (-1 if no cache)
+} BlockSimulationResult;
+
+//
+// Interface functions
+
+void init_block_result(BlockSimulationResult* res, const char* backend);
+// Clear the timings of a run
+
+void report_block_result(BlockSimulationResult* res);
+// Log the phase and per-command timings of a run (and the spread over the
+// passes when the workload was replayed more than once)
+
+void report_backends(BlockSimulationResult* results, int count);
+// Log the replay throughput and latency of each backend side by side
+
+int write_block_report_json(FILE* out, const char* workload, uint32_t cache_size, int jobs,
+    BlockSimulationResult* results, int count);
+// Write the timings of every run as JSON
+
+#endif
@@ -0,0 +1,431 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_server.c
+//  Description    : This is the BLOCK service daemon.  The driver state is
+//                   global to a process (and the controller can only be
+//                   initialized once), so this process owns the driver and
+//                   its cache and serves other processes through the client
+//                   library (block_client.h).  Each client gets a thread and
+//                   a shared memory segment (see block_service.h); the
+//                   thread runs the client's requests against the driver,
+//                   reading and writing straight in the shared data area.
+//                   A client may only use the handles it opened, and they
+//                   are closed when it goes away.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_cache.h>
+#include <block_controller.h>
+#include <block_driver.h>
+#include <block_service.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define SERVER_ARGUMENTS "hvc:s:"
+#define SERVER_MAX_CLIENTS 64 // Most clients connected at once
+#define USAGE                                                                  \
+    "USAGE: block_server [-h] [-v] [-c <sz>] [-s <socket>]\n"                  \
+    "\n"                                                                       \
+    "where:\n"                                                                 \
+    "    -h - help mode (display this message)\n"                              \
+    "    -v - verbose output\n"                                                \
+    "    -c - set the block cache to size <sz> frames\n"                       \
+    "    -s - the socket to listen on (default " BLOCK_SERVICE_SOCKET ")\n"    \
+    "\n"                                                                       \
+    "Runs until interrupted, serving block_client.h clients.\n"                \
+    "\n"
+
+// A connected client
+typedef struct {
+    int active; // Slot in use
+    volatile int done; // Set when the client thread has finished
+    int id; // Connection number
+    int sock; // The client's socket
+    BlockServiceShared* sh; // Its shared segment
+    pthread_t thread; // The thread serving it
+    uint64_t requests; // Requests served
+    uint8_t open[BLOCK_MAX_TOTAL_FILES]; // The handles it has open
+} ServerClient;
+
+//
+// Functional Prototypes
+
+static int accept_client(int sock, int id);
+static void reap_clients(int all);
+static void* serve_client(void* arg);
+static int32_t serve_request(ServerClient* c, const BlockServiceRequest* req);
+static int client_gone(int sock);
+static void stop_server(int sig);
+
+//
+// Global Data
+
+static volatile sig_atomic_t stopping = 0; // Set by SIGINT / SIGTERM
+static ServerClient clients[SERVER_MAX_CLIENTS]; // The client slots
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : Power on the driver, then accept clients until stopped
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main(int argc, char* argv[])
+{
+    // Local variables
+    const char* path = BLOCK_SERVICE_SOCKET;
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    uint32_t cache_size = 0;
+    uint64_t hits, misses;
+    int ch, verbose = 0, sock, conn, id = 0;
+
+    // Process the command line parameters
+    while ((ch = getopt(argc, argv, SERVER_ARGUMENTS)) != -1) {
+        switch (ch) {
+        case 'h': // Help, print usage
+            fprintf(stderr, USAGE);
+            return (-1);
+
+        case 'v': // Verbose Flag
+            verbose = 1;
+            break;
+
+        case 'c': // Set cache size
+            if (sscanf(optarg, "%u", &cache_size) != 1) {
+                fprintf(stderr, "Bad cache size [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 's': // Set the socket
+            path = optarg;
+            break;
+
+        default: // Default (unknown)
+            fprintf(stderr, "Unknown command line option (%c), aborting.\n", ch);
+            return (-1);
+        }
+    }
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path [%s] too long, aborting.\n", path);
+        return (-1);
+    }
+
+    // Setup the log and the driver
+    initializeLogWithFilehandle(CMPSC311_LOG_STDERR);
+    BlockControllerLLevel = registerLogLevel("BLOCK_CONTROLLER", 0);
+    BlockDriverLLevel = registerLogLevel("BLOCK_DRIVER", 0);
+    BlockSimulatorLLevel = registerLogLevel("BLOCK_SIMULATOR", 0);
+    if (verbose) {
+        enableLogLevels(LOG_INFO_LEVEL);
+        enableLogLevels(BlockDriverLLevel | BlockSimulatorLLevel);
+    }
+    if (cache_size != 0) {
+        set_block_cache_size(cache_size);
+    }
+    if (block_poweron() == -1) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK server failed powering on the device.");
+        return (-1);
+    }
+
+    // Stop on an interrupt (not restarting accept), and survive dead clients
+    memset(&sa, 0x0, sizeof(sa));
+    sa.sa_handler = stop_server;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Listen for clients
+    memset(&addr, 0x0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+        || (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) || (listen(sock, SERVER_MAX_CLIENTS) == -1)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK server failed listening on [%s], error: %s.", path, strerror(errno));
+        block_poweroff();
+        return (-1);
+    }
+    logMessage(LOG_OUTPUT_LEVEL, "BLOCK server listening on [%s].", path);
+
+    // Serve until stopped
+    while (!stopping) {
+        if ((conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC)) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logMessage(LOG_ERROR_LEVEL, "BLOCK server accept failed, error: %s.", strerror(errno));
+            break;
+        }
+        reap_clients(0);
+        if (accept_client(conn, ++id) != 0) {
+            close(conn);
+        }
+    }
+
+    // Shut down
+    close(sock);
+    unlink(path);
+    reap_clients(1);
+    get_block_cache_stats(&hits, &misses);
+    logMessage(LOG_OUTPUT_LEVEL, "BLOCK server stopping after %d clients, cache hit ratio %.2f%%.", id,
+        (hits + misses > 0) ? 100.0 * hits / (hits + misses) : 0.0);
+    if (block_poweroff() == -1) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK server failed powering off the device.");
+        return (-1);
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : accept_client
+// Description  : Make a client's shared segment, send it, and start the
+//                thread serving it
+//
+// Inputs       : sock - the client's socket
+//                id - the connection number
+// Outputs      : 0 if successful, -1 if failure
+
+static int accept_client(int sock, int id)
+{
+    ServerClient* c = NULL;
+    BlockServiceShared* sh;
+    int i, mfd;
+
+    // Find a free slot
+    for (i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        if (!clients[i].active) {
+            c = &clients[i];
+            break;
+        }
+    }
+    if (c == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK server refusing client %d, %d clients already.", id, SERVER_MAX_CLIENTS);
+        return (-1);
+    }
+
+    // Make the segment and hand it over (both sides map it)
+    if ((mfd = memfd_create("block_service", MFD_CLOEXEC)) == -1) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK server failed creating client memory, error: %s.", strerror(errno));
+        return (-1);
+    }
+    if ((ftruncate(mfd, sizeof(BlockServiceShared)) == -1)
+        || ((sh = mmap(NULL, sizeof(BlockServiceShared), PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0)) == MAP_FAILED)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK server failed mapping client memory, error: %s.", strerror(errno));
+        close(mfd);
+        return (-1);
+    }
+    sh->magic = BLOCK_SERVICE_MAGIC;
+    if (block_service_send_fd(sock, mfd) != 0) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK server failed sending client %d its memory.", id);
+        munmap(sh, sizeof(BlockServiceShared));
+        close(mfd);
+        return (-1);
+    }
+    close(mfd);
+
+    // Start serving it
+    memset(c, 0x0, sizeof(ServerClient));
+    c->id = id;
+    c->sock = sock;
+    c->sh = sh;
+    if (pthread_create(&c->thread, NULL, serve_client, c) != 0) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK server failed starting client %d thread.", id);
+        munmap(sh, sizeof(BlockServiceShared));
+        return (-1);
+    }
+    c->active = 1;
+    logMessage(BlockSimulatorLLevel, "BLOCK server client %d connected.", id);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : reap_clients
+// Description  : Join the threads of clients that have gone (or of all of
+//                them, once stopping), freeing their slots
+//
+// Inputs       : all - wait for every client
+// Outputs      : none
+
+static void reap_clients(int all)
+{
+    int i;
+
+    for (i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        if (clients[i].active && (all || clients[i].done)) {
+            pthread_join(clients[i].thread, NULL);
+            clients[i].active = 0;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : serve_client
+// Description  : Run a client's requests in ring order until it goes away
+//                or the server stops, then close the handles it left open
+//
+// Inputs       : arg - the client
+// Outputs      : NULL
+
+static void* serve_client(void* arg)
+{
+    ServerClient* c = arg;
+    BlockServiceShared* sh = c->sh;
+    BlockServiceRequest req;
+    uint32_t head = 0, tail, done = 0;
+    int fd;
+
+    while (!stopping) {
+        // Sleep until there is a request, checking now and then that the client is still there
+        if ((tail = __atomic_load_n(&sh->sq_tail, __ATOMIC_ACQUIRE)) == head) {
+            if ((block_service_wait(&sh->sq_tail, head, &sh->server_waiting, BLOCK_SERVICE_POLL_MS) != 0)
+                && client_gone(c->sock)) {
+                break;
+            }
+            continue;
+        }
+
+        // Run each one posted (copied out, the client can write the ring) and
+        // post its result, then wake the client once for all of them
+        while (head != tail) {
+            req = sh->sq[head % BLOCK_SERVICE_RING];
+            sh->cq[done % BLOCK_SERVICE_RING] = (BlockServiceCompletion) { serve_request(c, &req), req.tag };
+            c->requests++;
+            __atomic_store_n(&sh->sq_head, ++head, __ATOMIC_RELEASE);
+            __atomic_store_n(&sh->cq_tail, ++done, __ATOMIC_RELEASE);
+        }
+        block_service_wake(&sh->cq_tail, done, &sh->client_waiting);
+    }
+
+    // Clean up after the client
+    for (fd = 0; fd < BLOCK_MAX_TOTAL_FILES; fd++) {
+        if (c->open[fd]) {
+            block_close(fd);
+        }
+    }
+    logMessage(BlockSimulatorLLevel, "BLOCK server client %d gone after %" PRIu64 " requests.", c->id, c->requests);
+    munmap(sh, sizeof(BlockServiceShared));
+    close(c->sock);
+    c->done = 1;
+    return (NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : serve_request
+// Description  : Check a request against the client's segment and handles,
+//                and run it against the driver
+//
+// Inputs       : c - the client
+//                req - the request
+// Outputs      : what the driver returned, or -1 if the request is bad
+
+static int32_t serve_request(ServerClient* c, const BlockServiceRequest* req)
+{
+    char path[BLOCK_MAX_PATH_LENGTH], *data;
+    int32_t ret;
+
+    // The buffer must be inside the data area, the handle one of the client's
+    if ((req->op >= BLOCK_SVC_MAXVAL) || (req->count < 0) || (req->data > BLOCK_SERVICE_DATA)
+        || ((uint32_t)req->count > BLOCK_SERVICE_DATA - req->data)) {
+        return (-1);
+    }
+    if ((req->op != BLOCK_SVC_OPEN) && ((req->fd < 0) || (req->fd >= BLOCK_MAX_TOTAL_FILES) || !c->open[req->fd])) {
+        return (-1);
+    }
+    data = c->sh->data + req->data;
+
+    switch (req->op) {
+    case BLOCK_SVC_OPEN:
+        if ((req->count == 0) || (req->count >= BLOCK_MAX_PATH_LENGTH)) {
+            return (-1);
+        }
+        memcpy(path, data, req->count);
+        path[req->count] = '\0';
+        if ((ret = block_open(path)) >= 0) {
+            c->open[ret] = 1;
+        }
+        return (ret);
+
+    case BLOCK_SVC_CLOSE:
+        if ((ret = block_close(req->fd)) == 0) {
+            c->open[req->fd] = 0;
+        }
+        return (ret);
+
+    case BLOCK_SVC_READ:
+        return (block_read(req->fd, data, req->count));
+
+    case BLOCK_SVC_WRITE:
+        return (block_write(req->fd, data, req->count));
+
+    case BLOCK_SVC_SEEK:
+        return (block_seek(req->fd, req->loc));
+
+    case BLOCK_SVC_PREAD:
+        return (block_pread(req->fd, data, req->count, req->loc));
+
+    case BLOCK_SVC_PWRITE:
+        return (block_pwrite(req->fd, data, req->count, req->loc));
+    }
+    return (-1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : client_gone
+// Description  : Check whether a client has hung up (it never sends on the
+//                socket, so anything readable means it is closed)
+//
+// Inputs       : sock - the client's socket
+// Outputs      : 1 if gone, 0 if still connected
+
+static int client_gone(int sock)
+{
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    char byte;
+
+    if (poll(&pfd, 1, 0) <= 0) {
+        return (0);
+    }
+    return (recv(sock, &byte, 1, MSG_DONTWAIT) <= 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : stop_server
+// Description  : Signal handler, stop accepting and serving
+//
+// Inputs       : sig - the signal
+// Outputs      : none
+
+static void stop_server(int sig)
+{
+    stopping = 1;
+}
@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_service.c
+//  Description    : This is the code shared by the BLOCK service daemon and
+//                   its client library: sleeping on and waking the shared
+//                   rings (futexes on the ring tails, which work between
+//                   processes on a shared mapping), and passing the segment
+//                   over the socket.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_service.h>
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_service_wait
+// Description  : Wait for a ring word to change.  Poll it for a while (the
+//                other side is usually quick), then flag that we are asleep
+//                and sleep on it.  Flagging then checking here, and storing
+//                then checking the flag in block_service_wake, means one
+//                side always sees the other.
+//
+// Inputs       : word - the ring word
+//                seen - its value last seen
+//                waiting - our asleep flag
+//                timeout_ms - longest sleep, -1 for no limit
+// Outputs      : 0 if the word changed, -1 on timeout
+
+int block_service_wait(uint32_t* word, uint32_t seen, uint32_t* waiting, int timeout_ms)
+{
+    struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    int i;
+
+    for (i = 0; i < BLOCK_SERVICE_SPINS; i++) {
+        if (__atomic_load_n(word, __ATOMIC_ACQUIRE) != seen) {
+            return (0);
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    // Sleep until it moves (or the time is up)
+    __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(word, __ATOMIC_SEQ_CST) == seen) {
+        if ((syscall(SYS_futex, word, FUTEX_WAIT, seen, (timeout_ms < 0) ? NULL : &ts, NULL, 0) == -1)
+            && (errno == ETIMEDOUT)) {
+            break;
+        }
+    }
+    __atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+    return ((__atomic_load_n(word, __ATOMIC_ACQUIRE) != seen) ? 0 : -1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_service_wake
+// Description  : Store a ring word, and wake the other side if it is asleep
+//
+// Inputs       : word - the ring word
+//                value - its new value
+//                waiting - the other side's asleep flag
+// Outputs      : none
+
+void block_service_wake(uint32_t* word, uint32_t value, uint32_t* waiting)
+{
+    __atomic_store_n(word, value, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+        syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_service_send_fd
+// Description  : Pass a file descriptor over a Unix domain socket
+//
+// Inputs       : sock - the connected socket
+//                fd - the descriptor to pass
+// Outputs      : 0 if successful, -1 if failure
+
+int block_service_send_fd(int sock, int fd)
+{
+    char byte = 0, ctl[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &byte, 1 };
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+
+    memset(&msg, 0x0, sizeof(msg));
+    memset(ctl, 0x0, sizeof(ctl));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl;
+    msg.msg_controllen = sizeof(ctl);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return ((sendmsg(sock, &msg, MSG_NOSIGNAL) == 1) ? 0 : -1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_service_recv_fd
+// Description  : Receive a file descriptor from a Unix domain socket
+//
+// Inputs       : sock - the connected socket
+// Outputs      : the descriptor, or -1 on failure
+
+int block_service_recv_fd(int sock)
+{
+    char byte, ctl[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &byte, 1 };
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+    int fd;
+
+    memset(&msg, 0x0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl;
+    msg.msg_controllen = sizeof(ctl);
+    if (recvmsg(sock, &msg, 0) != 1) {
+        return (-1);
+    }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if ((cmsg == NULL) || (cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS)) {
+        return (-1);
+    }
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return (fd);
+}
@@ -0,0 +1,88 @@
+#ifndef BLOCK_SERVICE_INCLUDED
+#define BLOCK_SERVICE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_service.h
+//  Description    : This is the protocol between the BLOCK service daemon
+//                   (block_server) and its clients (block_client.h).  A
+//                   client connects on a Unix domain socket and is sent a
+//                   shared memory segment: a request ring, a completion ring
+//                   and a data area that requests point into, so data is
+//                   read and written by the driver in place.  The socket is
+//                   then only used to notice the client going away; the
+//                   rings are signalled through futexes on their tails.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// Defines
+#define BLOCK_SERVICE_SOCKET "/tmp/block_server.sock" // Default socket path
+#define BLOCK_SERVICE_MAGIC 0x424c4b53 // "BLKS", the segment is set up
+#define BLOCK_SERVICE_RING 64 // Requests a client may have in flight
+#define BLOCK_SERVICE_DATA (4 * 1024 * 1024) // Shared data area per client
+#define BLOCK_SERVICE_SPINS 200 // Polls of a ring before sleeping on it
+#define BLOCK_SERVICE_POLL_MS 100 // Longest server sleep between hangup checks
+
+// The requests
+typedef enum {
+    BLOCK_SVC_OPEN = 0, // block_open (the path is in the data area)
+    BLOCK_SVC_CLOSE = 1, // block_close
+    BLOCK_SVC_READ = 2, // block_read
+    BLOCK_SVC_WRITE = 3, // block_write
+    BLOCK_SVC_SEEK = 4, // block_seek
+    BLOCK_SVC_PREAD = 5, // block_pread
+    BLOCK_SVC_PWRITE = 6, // block_pwrite
+    BLOCK_SVC_MAXVAL = 7, // Maximum request value
+} BlockServiceOp;
+
+// A request ring entry
+typedef struct {
+    uint8_t op; // BlockServiceOp
+    int16_t fd; // File handle
+    int32_t count; // Bytes (or the path length for OPEN)
+    uint32_t loc; // Offset in the file (SEEK, PREAD, PWRITE)
+    uint32_t data; // Offset of the buffer in the data area
+    uint64_t tag; // Returned with the completion
+} BlockServiceRequest;
+
+// A completion ring entry
+typedef struct {
+    int32_t res; // What the driver call returned
+    uint64_t tag; // From the request
+} BlockServiceCompletion;
+
+// The shared segment (one per client).  The client writes sq_tail and
+// cq_head, the server sq_head and cq_tail; each side sets its waiting flag
+// before sleeping so the other only makes the wake call when needed.
+typedef struct {
+    uint32_t magic; // BLOCK_SERVICE_MAGIC
+    uint32_t sq_tail, sq_head; // Requests posted and taken
+    uint32_t cq_tail, cq_head; // Completions posted and taken
+    uint32_t server_waiting; // Server asleep on sq_tail
+    uint32_t client_waiting; // Client asleep on cq_tail
+    BlockServiceRequest sq[BLOCK_SERVICE_RING]; // Request ring
+    BlockServiceCompletion cq[BLOCK_SERVICE_RING]; // Completion ring
+    char data[BLOCK_SERVICE_DATA] __attribute__((aligned(4096))); // Data area
+} BlockServiceShared;
+
+//
+// Interface functions
+
+int block_service_wait(uint32_t* word, uint32_t seen, uint32_t* waiting, int timeout_ms);
+// Wait for *word to move on from "seen" (spin, then sleep up to timeout_ms, -1
+// for no limit), 0 if it did, -1 on timeout
+
+void block_service_wake(uint32_t* word, uint32_t value, uint32_t* waiting);
+// Publish a new *word and wake the other side if it is asleep on it
+
+int block_service_send_fd(int sock, int fd);
+// Pass a file descriptor over a Unix domain socket
+
+int block_service_recv_fd(int sock);
+// Receive a file descriptor from a Unix domain socket, -1 on failure
+
+#endif
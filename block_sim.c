@@ -11,52 +11,143 @@
 // Include Files
 #include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 // Project Includes
+#include <block_alloc.h>
+#include <block_backend.h>
 #include <block_cache.h>
 #include <block_controller.h>
+#include <block_copy.h>
 #include <block_driver.h>
+#include <block_prefetch.h>
+#include <block_replay.h>
+#include <block_report.h>
+#include <block_stats.h>
+#include <block_sweep.h>
+#include <block_validate.h>
+#include <block_workload.h>
 #include <cmpsc311_log.h>
 #include <cmpsc311_util.h>
 
 // Defines
-#define BLOCK_WORKLOAD_DIR "workload"
-#define BLOCK_SIM_MAX_OPEN_FILES 128
-#define BLOCK_ARGUMENTS "huvl:c:"
-#define USAGE                                                                    \
-    "USAGE: block_sim [-h] [-v] [-l <logfile>] [-c <sz>] <workload-file>\n"      \
-    "\n"                                                                         \
-    "where:\n"                                                                   \
-    "    -h - help mode (display this message)\n"                                \
-    "    -v - verbose output\n"                                                  \
-    "    -l - write log messages to the filename <logfile>\n"                    \
-    "    -c - set the block block cache to size <sz> (disabled for assign #2)\n" \
-    "\n"                                                                         \
-    "    <workload-file> - file contain the workload to simulate\n"              \
+#define BLOCK_SIM_MAX_OPEN_FILES BLOCK_WORKLOAD_MAX_FILES
+#define BLOCK_SIM_MAX_RATES 64 // Maximum open-loop rates in one run
+#define BLOCK_ARGUMENTS "huvl:c:j:b:"
+#define USAGE                                                                      \
+    "USAGE: block_sim [-h] [-v] [-l <logfile>] [-c <sz>] [-j <n>] [-b <list>]\n"   \
+    "                 [--sweep <min>:<max>:x<f>] [--rate <iops>] [--arrival <a>]\n" \
+    "                 [--backup] [--json <file>] [--warmup <n>] [--repeat <m>]\n" \
+    "                 [--access-log <file>] [--prefetch <file>]\n"                \
+    "                 [--stream-threshold <bytes>] [--count-allocs]\n"           \
+    "                 [--no-front-cache]\n"                                       \
+    "                 <workload-file>\n"                                          \
+    "\n"                                                                           \
+    "where:\n"                                                                     \
+    "    -h - help mode (display this message)\n"                                  \
+    "    -v - verbose output\n"                                                    \
+    "    -l - write log messages to the filename <logfile>\n"                      \
+    "    -c - set the block block cache to size <sz> (disabled for assign #2)\n"   \
+    "    -j - replay and validate the workload on <n> threads, split by file\n"    \
+    "         (default 1)\n"                                                       \
+    "    -b - comma separated backends to replay against and compare: driver,\n"   \
+    "         mem or posix[:<dir>] (default driver)\n"                              \
+    "    --sweep - also simulate an LRU cache of every size from <min> to <max>\n" \
+    "              (x<f> multiplies, +<s> adds) and print a CSV to stdout\n"       \
+    "    --rate - after the replay, replay again open-loop at each target IOPS\n"    \
+    "             (a comma separated list or <min>:<max>:x<f>) and print the\n"      \
+    "             latency at each rate as a CSV to stdout\n"                        \
+    "    --arrival - open-loop arrivals, const or poisson (default const)\n"        \
+    "    --backup - write the final contents of each file to <file>.cmm\n"         \
+    "    --json - also write the phase and per-command timings to <file>\n"       \
+    "    --warmup - replay the workload <n> times unmeasured first (default 0)\n"  \
+    "    --repeat - replay the workload <m> times measured and report the mean\n"  \
+    "               and 95%% confidence interval of each pass (default 1)\n"      \
+    "    --access-log - write every frame the driver reads or writes to <file>\n"   \
+    "                   (for block_cachesim)\n"                                    \
+    "    --prefetch - prefetch frames in the background, predicted from an\n"    \
+    "                 access log of an earlier run\n"                             \
+    "    --stream-threshold - copy driver reads and writes of at least <bytes>\n" \
+    "                         with streaming stores (default 0, never)\n"           \
+    "    --count-allocs - count the heap allocations made by the measured\n"      \
+    "                     replays (there should be none)\n"                      \
+    "    --no-front-cache - look every frame up in the shared cache, without\n"    \
+    "                       the per-thread front caches\n"                         \
+    "\n"                                                                           \
+    "    <workload-file> - file contain the workload to simulate\n"                \
     "\n"
 
-// This is the file table
-typedef struct {
-    char* filename; // This is the filename for the test file
-    int16_t fhandle; // This is a file handle for the opened file
-} BlockSimulationTable;
+// The long-only options
+enum {
+    BLOCK_OPT_SWEEP = 256,
+    BLOCK_OPT_RATE,
+    BLOCK_OPT_ARRIVAL,
+    BLOCK_OPT_BACKUP,
+    BLOCK_OPT_JSON,
+    BLOCK_OPT_WARMUP,
+    BLOCK_OPT_REPEAT,
+    BLOCK_OPT_ACCESS_LOG,
+    BLOCK_OPT_PREFETCH,
+    BLOCK_OPT_STREAM_THRESHOLD,
+    BLOCK_OPT_COUNT_ALLOCS,
+    BLOCK_OPT_NO_FRONT_CACHE,
+};
+
+static struct option block_long_options[] = {
+    { "help", no_argument, NULL, 'h' },
+    { "sweep", required_argument, NULL, BLOCK_OPT_SWEEP },
+    { "rate", required_argument, NULL, BLOCK_OPT_RATE },
+    { "arrival", required_argument, NULL, BLOCK_OPT_ARRIVAL },
+    { "backup", no_argument, NULL, BLOCK_OPT_BACKUP },
+    { "json", required_argument, NULL, BLOCK_OPT_JSON },
+    { "warmup", required_argument, NULL, BLOCK_OPT_WARMUP },
+    { "repeat", required_argument, NULL, BLOCK_OPT_REPEAT },
+    { "access-log", required_argument, NULL, BLOCK_OPT_ACCESS_LOG },
+    { "prefetch", required_argument, NULL, BLOCK_OPT_PREFETCH },
+    { "stream-threshold", required_argument, NULL, BLOCK_OPT_STREAM_THRESHOLD },
+    { "count-allocs", no_argument, NULL, BLOCK_OPT_COUNT_ALLOCS },
+    { "no-front-cache", no_argument, NULL, BLOCK_OPT_NO_FRONT_CACHE },
+    { NULL, 0, NULL, 0 }
+};
 
 //
 // Global Data
 int verbose;
 uint32_t cache_size = 0;
+int replay_jobs = 1;
+uint32_t sweep_sizes[BLOCK_SWEEP_MAX_SIZES];
+int sweep_count = 0;
+const BlockBackend* backends[BLOCK_BACKEND_MAX];
+int backend_count = 0;
+uint32_t open_rates[BLOCK_SIM_MAX_RATES];
+int rate_count = 0;
+BlockArrival open_arrival = BLOCK_ARRIVAL_CONSTANT;
+int validate_backup = 0;
+char* json_report = NULL;
+int warmup_passes = 0;
+int repeat_passes = 1;
+char* access_log_name = NULL;
+FILE* access_log = NULL;
+char* prefetch_log = NULL;
+size_t stream_threshold = BLOCK_COPY_DEFAULT_THRESHOLD;
+int count_allocs = 0;
 
 //
 // Functional Prototypes
 
 int simulate_BLOCK(char* wload); // control loop of the BLOCK simulation
-int validate_file(char* fname, int16_t mfh); // Validate a file in the filesystem
+int run_simulation(BlockWorkload* wl, BlockSimulationResult* res); // Replay against one backend
+int run_replays(BlockWorkload* wl, BlockSimulationTable* ftable, BlockSimulationResult* res); // Warmup and measured replays
+int run_open_loop(BlockWorkload* wl, BlockSimulationTable* ftable); // Latency at each open-loop rate
+void log_frame_access(void* sweep, uint16_t frm, int write); // Access hook writing the access log
 
 //
 // Functions
@@ -74,11 +165,12 @@ int main(int argc, char* argv[])
 {
 
     // Local variables
-    int ch, verbose = 0, log_initialized = 0, unit_tests = 0;
+    int ch, verbose = 0, log_initialized = 0, unit_tests = 0, i;
+    char* tok;
     // uint32_t cache_size = 0;
 
     // Process the command line parameters
-    while ((ch = getopt(argc, argv, BLOCK_ARGUMENTS)) != -1) {
+    while ((ch = getopt_long(argc, argv, BLOCK_ARGUMENTS, block_long_options, NULL)) != -1) {
 
         switch (ch) {
         case 'h': // Help, print usage
@@ -104,6 +196,110 @@ int main(int argc, char* argv[])
             }
             break;
 
+        case 'j': // Set the number of replay threads
+            if ((sscanf(optarg, "%d", &replay_jobs) != 1) || (replay_jobs < 1)
+                || (replay_jobs > BLOCK_REPLAY_MAX_JOBS)) {
+                fprintf(stderr, "Bad replay thread count [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'b': // Set the backends
+            for (tok = strtok(optarg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+                if ((backend_count == BLOCK_BACKEND_MAX) || ((backends[backend_count++] = find_block_backend(tok)) == NULL)) {
+                    fprintf(stderr, "Bad or too many backends [%s], aborting.\n", tok);
+                    return (-1);
+                }
+                for (i = 0; i < backend_count - 1; i++) {
+                    if (backends[i] == backends[backend_count - 1]) {
+                        // The controller can only be powered on once per run
+                        fprintf(stderr, "Backend [%s] listed twice, aborting.\n", tok);
+                        return (-1);
+                    }
+                }
+            }
+            break;
+
+        case BLOCK_OPT_SWEEP: // Sweep the cache sizes
+            if ((sweep_count = parse_block_sweep(optarg, sweep_sizes, BLOCK_SWEEP_MAX_SIZES)) <= 0) {
+                return (-1);
+            }
+            break;
+
+        case BLOCK_OPT_RATE: // Set the open-loop rates
+            if (strchr(optarg, ':') != NULL) {
+                if ((rate_count = parse_block_sweep(optarg, open_rates, BLOCK_SIM_MAX_RATES)) <= 0) {
+                    return (-1);
+                }
+                break;
+            }
+            for (tok = strtok(optarg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+                if ((rate_count == BLOCK_SIM_MAX_RATES) || (sscanf(tok, "%u", &open_rates[rate_count]) != 1)
+                    || (open_rates[rate_count++] == 0)) {
+                    fprintf(stderr, "Bad or too many rates [%s], aborting.\n", tok);
+                    return (-1);
+                }
+            }
+            break;
+
+        case BLOCK_OPT_ARRIVAL: // Set the open-loop arrivals
+            if (strcmp(optarg, "const") == 0) {
+                open_arrival = BLOCK_ARRIVAL_CONSTANT;
+            } else if (strcmp(optarg, "poisson") == 0) {
+                open_arrival = BLOCK_ARRIVAL_POISSON;
+            } else {
+                fprintf(stderr, "Bad arrival [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case BLOCK_OPT_BACKUP: // Keep a copy of the files
+            validate_backup = 1;
+            break;
+
+        case BLOCK_OPT_JSON: // Write the timings as JSON
+            json_report = optarg;
+            break;
+
+        case BLOCK_OPT_WARMUP: // Set the unmeasured replays
+            if ((sscanf(optarg, "%d", &warmup_passes) != 1) || (warmup_passes < 0)) {
+                fprintf(stderr, "Bad warmup count [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case BLOCK_OPT_REPEAT: // Set the measured replays
+            if ((sscanf(optarg, "%d", &repeat_passes) != 1) || (repeat_passes < 1)
+                || (repeat_passes > BLOCK_REPORT_MAX_PASSES)) {
+                fprintf(stderr, "Bad repeat count [%s], must be 1-%d, aborting.\n", optarg, BLOCK_REPORT_MAX_PASSES);
+                return (-1);
+            }
+            break;
+
+        case BLOCK_OPT_ACCESS_LOG: // Log the frame accesses
+            access_log_name = optarg;
+            break;
+
+        case BLOCK_OPT_PREFETCH: // Prefetch from an earlier access log
+            prefetch_log = optarg;
+            break;
+
+        case BLOCK_OPT_STREAM_THRESHOLD: // Set the streaming copy size
+            if (sscanf(optarg, "%zu", &stream_threshold) != 1) {
+                fprintf(stderr, "Bad stream threshold [%s], aborting.\n", optarg);
+                return (-1);
+            }
+            set_block_copy_threshold(stream_threshold);
+            break;
+
+        case BLOCK_OPT_COUNT_ALLOCS: // Count the replay's heap allocations
+            count_allocs = 1;
+            break;
+
+        case BLOCK_OPT_NO_FRONT_CACHE: // Skip the front caches
+            set_block_front_cache(0);
+            break;
+
         default: // Default (unknown)
             fprintf(stderr, "Unknown command line option (%c), aborting.\n", ch);
             return (-1);
@@ -122,6 +318,11 @@ int main(int argc, char* argv[])
         enableLogLevels(BlockControllerLLevel | BlockDriverLLevel | BlockSimulatorLLevel);
     }
 
+    // Default to replaying against the driver
+    if (backend_count == 0) {
+        backends[backend_count++] = find_block_backend("driver");
+    }
+
     // Setup the cache size as needed
     if (cache_size != 0) {
         set_block_cache_size(cache_size);
@@ -168,7 +369,7 @@ int main(int argc, char* argv[])
 //
 // Function     : simulate_BLOCK
 // Description  : The main control loop for the processing of the BLOCK
-//                simulation.
+//                simulation, runs the workload against each backend.
 //
 // Inputs       : wload - the name of the workload file
 // Outputs      : 0 if successful test, -1 if failure
@@ -177,295 +378,331 @@ int simulate_BLOCK(char* wload)
 {
 
     // Local variables
-    char line[1024], fname[128], command[128], text[1025], *sep, *rbuf;
-    FILE* fhandle = NULL;
-    int32_t err = 0, len, off, fields, linecount;
-    BlockSimulationTable ftable[BLOCK_SIM_MAX_OPEN_FILES];
-    int idx, i;
+    BlockWorkload wl;
+    BlockSimulationResult results[BLOCK_BACKEND_MAX];
+    FILE* out;
+    int b;
 
-    // Setup the file table
-    memset(ftable, 0x0, sizeof(BlockSimulationTable) * BLOCK_SIM_MAX_OPEN_FILES);
-
-    // Open the workload file
-    linecount = 0;
-    if ((fhandle = fopen(wload, "r")) == NULL) {
-        logMessage(LOG_ERROR_LEVEL, "Failure opening the workload file [%s], error: %s.\n",
-            wload, strerror(errno));
+    // Read the workload file
+    if (load_block_workload(wload, &wl) != 0) {
         return (-1);
     }
-
-    // Startup the interface
-    if (block_poweron() == -1) {
-        logMessage(LOG_ERROR_LEVEL, "BLOCK simulator failed initialization.");
-        fclose(fhandle);
+    if (prepare_block_replay(&wl, replay_jobs) != 0) {
+        free_block_workload(&wl);
         return (-1);
     }
-    logMessage(BlockSimulatorLLevel, "BLOCK simulator initialization complete.");
-
-    // While file not done
-    while (!feof(fhandle)) {
-
-        // Get the line and bail out on fail
-        if (fgets(line, 1024, fhandle) != NULL) {
-
-            // Parse out the string
-            linecount++;
-            fields = sscanf(line, "%s %s %d %d", fname, command, &len, &off);
-            sep = strchr(line, ':');
-            if ((fields != 4) || (sep == NULL)) {
-                logMessage(LOG_ERROR_LEVEL, "BLOCK un-parsable workload string, aborting [%s], line %d",
-                    line, linecount);
-                fclose(fhandle);
-                return (-1);
-            }
 
-            // Just log the contents
-            logMessage(BlockSimulatorLLevel, "File [%s], command [%s], len=%d, offset=%d",
-                fname, command, len, off);
+    // Run the workload against every backend
+    for (b = 0; b < backend_count; b++) {
+        select_block_backend(backends[b]);
+        if (run_simulation(&wl, &results[b]) != 0) {
+            release_block_replay();
+            free_block_workload(&wl);
+            return (-1);
+        }
+    }
+    release_block_replay();
+    if (backend_count > 1) {
+        report_backends(results, backend_count);
+    }
 
-            // Now walk the the table looking for the file
-            idx = -1;
-            i = 0;
-            while ((i < BLOCK_SIM_MAX_OPEN_FILES) && (idx == -1)) {
-                if ((ftable[i].filename != NULL) && (strcmp(ftable[i].filename, fname) == 0)) {
-                    idx = i;
-                }
-                i++;
+    // Save the timings for comparing runs
+    if (json_report != NULL) {
+        if (((out = fopen(json_report, "w")) == NULL)
+            || (write_block_report_json(out, wload, cache_size, replay_jobs, results, backend_count) != 0)) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK simulator failed writing the report [%s].", json_report);
+            if (out != NULL) {
+                fclose(out);
             }
+            free_block_workload(&wl);
+            return (-1);
+        }
+        fclose(out);
+    }
 
-            // File is not found, open the file
-            if (idx == -1) {
-
-                // Log message, find unused index and save filename for later use
-                logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Opening file [%s]", fname);
-                idx = 0;
-                while ((ftable[idx].filename != NULL) && (idx < BLOCK_SIM_MAX_OPEN_FILES)) {
-                    idx++;
-                }
-                CMPSC_ASSERT1(idx < BLOCK_SIM_MAX_OPEN_FILES, "Too many open files on BLOCK sim [%d]", idx);
-                ftable[idx].filename = strdup(fname);
-
-                // Now perform the open
-                ftable[idx].fhandle = block_open(ftable[idx].filename);
-                if (ftable[idx].fhandle == -1) {
-                    // Failed, error out
-                    logMessage(LOG_ERROR_LEVEL, "Open of new file [%s] failed, aborting simulation.", fname);
-                    return (-1);
-                }
-            }
-
-            // Now execute the specific command
-            if (strncmp(command, "WRITEAT", 7) == 0) {
-
-                // Log the command executed
-                logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Writing %d bytes at position %d from file [%s]", len, off, fname);
-
-                // First perform the seek
-                if (block_seek(ftable[idx].fhandle, off)) {
-                    // Failed, error out
-                    logMessage(LOG_ERROR_LEVEL, "Seek/WriteAt file [%s] to position %d failed, aborting simulation.", fname, off);
-                    return (-1);
-                }
-
-                // Now see if we need more data to fill, terminate the lines
-                CMPSC_ASSERT1(len < 1024, "Simulated workload command text too large [%d]", len);
-                CMPSC_ASSERT2((strlen(sep + 1) >= len), "Workload str [%d<%d]", strlen(sep + 1), len);
-                strncpy(text, sep + 1, len);
-                text[len] = 0x0;
-                for (i = 0; i < strlen(text); i++) {
-                    if (text[i] == '^') {
-                        text[i] = '\n';
-                    }
-                }
-
-                // Now perform the write
-                if (block_write(ftable[idx].fhandle, text, len) != len) {
-                    // Failed, error out
-                    logMessage(LOG_ERROR_LEVEL, "WriteAt of file [%s], length %d failed, aborting simulation.", fname, len);
-                    return (-1);
-                }
-
-            } else if (strncmp(command, "WRITE", 5) == 0) {
-
-                // Now see if we need more data to fill, terminate the lines
-                CMPSC_ASSERT1(len < 1024, "Simulated workload command text too large [%d]", len);
-                CMPSC_ASSERT2((strlen(sep + 1) >= len), "Workload str [%d<%d]", strlen(sep + 1), len);
-                strncpy(text, sep + 1, len);
-                text[len] = 0x0;
-                for (i = 0; i < strlen(text); i++) {
-                    if (text[i] == '^') {
-                        text[i] = '\n';
-                    }
-                }
-
-                // Log the command executed
-                logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Writing %d bytes to file [%s]", len, fname);
-
-                // Now perform the write
-                if (block_write(ftable[idx].fhandle, text, len) != len) {
-                    // Failed, error out
-                    logMessage(LOG_ERROR_LEVEL, "Write of file [%s], length %d failed, aborting simulation.", fname, len);
-                    return (-1);
-                }
-
-            } else if (strncmp(command, "SEEK", 4) == 0) {
+    // Release the workload, successfully
+    free_block_workload(&wl);
+    return (0);
+}
 
-                // Log the command executed
-                logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Seeking to position %d in file [%s]", off, fname);
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : run_simulation
+// Description  : Power on the selected backend, replay and validate the
+//                workload, and power off
+//
+// Inputs       : wl - the loaded workload
+//                res - the timing results to fill in
+// Outputs      : 0 if successful test, -1 if failure
 
-                // Now perform the seek
-                if (block_seek(ftable[idx].fhandle, off) != len) {
-                    // Failed, error out
-                    logMessage(LOG_ERROR_LEVEL, "Seek in file [%s] to position %d failed, aborting simulation.", fname, off);
-                    return (-1);
-                }
+int run_simulation(BlockWorkload* wl, BlockSimulationResult* res)
+{
 
-            } else if (strncmp(command, "READ", 4) == 0) {
+    // Local variables
+    BlockSimulationTable ftable[BLOCK_SIM_MAX_OPEN_FILES];
+    BlockSweep* sweep = NULL;
+    BlockPrefetch* prefetch = NULL;
+    BlockPrefetchStats pstats;
+    int driver = (block_backend == find_block_backend("driver"));
+    uint64_t start, front_hits, front_lookups;
 
-                // Log the command executed
-                logMessage(BlockSimulatorLLevel, "BLOCK_SIM : Reading %d bytes from file [%s]", len, fname);
+    // Setup the table and the timings
+    init_block_replay_table(ftable, wl);
+    init_block_result(res, block_backend->name);
 
-                // Now perform the read
-                rbuf = malloc(len);
-                if (block_read(ftable[idx].fhandle, rbuf, len) != len) {
-                    // Failed, error out
-                    logMessage(LOG_ERROR_LEVEL, "Read file [%s] of length %d failed, aborting simulation.", fname, off);
-                    return (-1);
-                }
-                free(rbuf);
-                rbuf = NULL;
+    // Startup the interface
+    start = block_clock_ns();
+    if (block_backend->poweron() == -1) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK simulator failed initialization.");
+        return (-1);
+    }
+    res->phase_ns[BLOCK_PHASE_POWERON] = block_clock_ns() - start;
+    logMessage(BlockSimulatorLLevel, "BLOCK simulator initialization complete (%s).", block_backend->name);
 
-            } else {
+    // Watch the frame accesses if sweeping the cache sizes
+    if ((sweep_count > 0) && driver) {
+        if ((sweep = create_block_sweep(sweep_sizes, sweep_count)) == NULL) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK simulator failed to allocate the cache sweep.");
+            return (-1);
+        }
+        block_set_access_hook(block_sweep_access, sweep);
+    }
 
-                // Bomb out, don't understand the command
-                CMPSC_ASSERT1(0, "BLOCK_SIM : Failed, unknown command [%s]", command);
-            }
+    // Log them too if asked (passing them on to the sweep)
+    if ((access_log_name != NULL) && driver) {
+        if ((access_log = fopen(access_log_name, "w")) == NULL) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK simulator failed opening access log [%s], error: %s.",
+                access_log_name, strerror(errno));
+            free_block_sweep(sweep);
+            return (-1);
         }
+        block_set_access_hook(log_frame_access, sweep);
+    }
 
-        // Check for the virtual level failing
-        if (err) {
-            logMessage(LOG_ERROR_LEVEL, "CRUS system failed, aborting [%d]", err);
-            fclose(fhandle);
+    // Prefetch during the replays, from what the earlier run accessed
+    if ((prefetch_log != NULL) && driver) {
+        if (((prefetch = create_block_prefetch(prefetch_log, cache_size)) == NULL)
+            || (start_block_prefetch(prefetch) != 0)) {
+            block_set_access_hook(NULL, NULL);
+            free_block_prefetch(prefetch);
+            free_block_sweep(sweep);
             return (-1);
         }
     }
 
-    // Now walk the the table looking for the file
-    for (i = 0; i < BLOCK_SIM_MAX_OPEN_FILES; i++) {
-        if (ftable[i].filename != NULL) {
-            if (validate_file(ftable[i].filename, ftable[i].fhandle) != 0) {
-                logMessage(LOG_ERROR_LEVEL, "BLOCK Validation failed on file [%s].", ftable[i].filename, fname);
-                fclose(fhandle);
-                return (-1);
-            }
+    // Replay the workload
+    if (run_replays(wl, ftable, res) != 0) {
+        if (prefetch != NULL) {
+            stop_block_prefetch(prefetch, &pstats);
+            free_block_prefetch(prefetch);
         }
+        block_set_access_hook(NULL, NULL);
+        free_block_sweep(sweep);
+        return (-1);
+    }
+    block_set_access_hook(NULL, NULL);
+    if (prefetch != NULL) {
+        stop_block_prefetch(prefetch, &pstats);
+        report_block_prefetch(&pstats);
+        free_block_prefetch(prefetch);
+    }
+
+    // Report the sweep (the validation reads are not part of the workload)
+    if (sweep != NULL) {
+        write_block_sweep_csv(sweep, stdout);
+        free_block_sweep(sweep);
+    }
+    if ((access_log != NULL) && (fclose(access_log) != 0)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK simulator failed writing access log [%s].", access_log_name);
+        return (-1);
     }
 
+    // Measure the latency at each rate, on the files the replay left behind
+    if ((rate_count > 0) && (run_open_loop(wl, ftable) != 0)) {
+        return (-1);
+    }
+
+    // Now check every file the workload opened (against the copies next to it)
+    start = block_clock_ns();
+    if (validate_block_files(wl->dir, ftable, wl->nfiles, replay_jobs, validate_backup) != 0) {
+        return (-1);
+    }
+    res->phase_ns[BLOCK_PHASE_VALIDATE] = block_clock_ns() - start;
+
     // Shut down the interface
-    if (block_poweroff() == -1) {
+    start = block_clock_ns();
+    if (block_backend->poweroff() == -1) {
         logMessage(LOG_ERROR_LEVEL, "BLOCK simulator failed shutdown.");
-        fclose(fhandle);
         return (-1);
     }
+    res->phase_ns[BLOCK_PHASE_POWEROFF] = block_clock_ns() - start;
+    report_block_result(res);
     logMessage(BlockSimulatorLLevel, "BLOCK simulator shutdown complete.");
     logMessage(LOG_OUTPUT_LEVEL, "BLOCK simulation: all tests successful!!!.");
 
-    // calculate cache performance
+    // calculate cache performance (only the driver has a cache)
+    if (!driver) {
+        return (0);
+    }
     logMessage(LOG_OUTPUT_LEVEL, "========== Cache Performance ==========");
     if (get_performance(cache_size) != 0) {
         logMessage(LOG_ERROR_LEVEL, "BLOCK simulator failed calculating cache performance.");
         logMessage(LOG_OUTPUT_LEVEL, "=======================================");
-        fclose(fhandle);
         return (-1);
     }
+    get_block_front_cache_stats(&front_hits, &front_lookups);
+    logMessage(LOG_OUTPUT_LEVEL, "Front cache hit ratio: %.2f%% (%" PRIu64 " of %" PRIu64 " lookups)",
+        (front_lookups > 0) ? 100.0 * front_hits / front_lookups : 0.0, front_hits, front_lookups);
     logMessage(LOG_OUTPUT_LEVEL, "=======================================");
-
-    // Close the workload file, successfully
-    fclose(fhandle);
     return (0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : validate_file
-// Description  : Vadliate a file in the filesystem
+// Function     : run_replays
+// Description  : Replay the workload the warmup number of times unmeasured,
+//                then the repeat number of times measured, recording the
+//                throughput and cache hit ratio of each measured pass.  The
+//                device stays powered on throughout (it cannot be powered on
+//                twice), with the files rewound before every pass.
 //
-// Inputs       : fname - the name of the file to validate
-//                mfh - the memory file handle
+// Inputs       : wl - the loaded workload
+//                ftable - the file table
+//                res - the timing results to fill in
 // Outputs      : 0 if successful test, -1 if failure
 
-int validate_file(char* fname, int16_t mfh)
+int run_replays(BlockWorkload* wl, BlockSimulationTable* ftable, BlockSimulationResult* res)
 {
 
     // Local variables
-    char filename[256], bkfile[256], *filbuf, *membuf;
-    struct stat stats;
-    int idx, fh;
-
-    // First figure out how big the file is, setup buffer
-    snprintf(filename, 256, "%s/%s", BLOCK_WORKLOAD_DIR, fname);
-    if ((stat(filename, &stats) != 0) || (stats.st_size == 0)) {
-        logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], missing or "
-                                    "unknown source.",
-            filename);
-        return (-1);
-    }
-    if (((filbuf = malloc(stats.st_size)) == NULL) || ((membuf = malloc(stats.st_size)) == NULL)) {
-        logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], failed "
-                                    "buffer allocation.",
-            filename);
-        return (-1);
+    BlockLatencyStats stats[BLOCK_WL_MAXVAL], pass;
+    uint64_t start, elapsed, hits, misses, hits0, misses0, allocs;
+    int driver = (block_backend == find_block_backend("driver"));
+    int p, i;
+
+    // Bring the device to its steady state
+    start = block_clock_ns();
+    for (p = 0; p < warmup_passes; p++) {
+        rewind_block_replay_table(ftable, wl->nfiles);
+        if (replay_block_workload(wl, ftable, replay_jobs, NULL) != 0) {
+            return (-1);
+        }
     }
+    res->phase_ns[BLOCK_PHASE_WARMUP] = block_clock_ns() - start;
+    res->warmup = warmup_passes;
+
+    // Now the measured passes
+    for (p = 0; p < repeat_passes; p++) {
+        init_block_latency(&pass);
+        for (i = 0; i < BLOCK_WL_MAXVAL; i++) {
+            init_block_latency(&stats[i]);
+        }
+        hits0 = misses0 = 0;
+        if (driver) {
+            get_block_cache_stats(&hits0, &misses0);
+        }
 
-    // Now open the file and read the contents
-    if ((fh = open(filename, O_RDONLY)) == -1) {
-        logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], open failed ", filename);
-        return (-1);
-    }
-    if ((read(fh, filbuf, stats.st_size)) == -1) {
-        logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], read failed ", filename);
-        return (-1);
-    }
-    close(fh);
+        rewind_block_replay_table(ftable, wl->nfiles);
+        if (count_allocs) {
+            start_block_alloc_count();
+        }
+        start = block_clock_ns();
+        if (replay_block_workload(wl, ftable, replay_jobs, stats) != 0) {
+            return (-1);
+        }
+        elapsed = block_clock_ns() - start;
+        if (count_allocs) {
+            allocs = stop_block_alloc_count();
+            logMessage(LOG_OUTPUT_LEVEL, "Heap allocations in measured pass %d: %" PRIu64 " (%.3f per operation).",
+                p + 1, allocs, (wl->nops > 0) ? (double)allocs / wl->nops : 0.0);
+        }
 
-    // Seek to the beginning of the memory file, read the contents
-    if (block_seek(mfh, 0) == -1) {
-        // Failed, error out
-        logMessage(LOG_ERROR_LEVEL, "Read block file [%s] see to zero failed.", fname);
-        return (-1);
-    }
-    if (block_read(mfh, membuf, stats.st_size) != stats.st_size) {
-        // Failed, error out
-        logMessage(LOG_ERROR_LEVEL, "Read block file [%s] of length %d failed.", fname, stats.st_size);
-        return (-1);
+        // Add the pass to the totals
+        for (i = 0; i < BLOCK_WL_MAXVAL; i++) {
+            merge_block_latency(&pass, &stats[i]);
+            merge_block_latency(&res->commands[i], &stats[i]);
+        }
+        merge_block_latency(&res->latency, &pass);
+        res->phase_ns[BLOCK_PHASE_REPLAY] += elapsed;
+        res->pass_ops[p] = (elapsed > 0) ? pass.count / (elapsed / 1e9) : 0.0;
+        res->pass_hits[p] = -1;
+        if (driver) {
+            get_block_cache_stats(&hits, &misses);
+            hits -= hits0;
+            misses -= misses0;
+            res->pass_hits[p] = (hits + misses > 0) ? (double)hits / (hits + misses) : 0.0;
+        }
+        res->passes++;
     }
+    return (0);
+}
 
-    // Now create a backup of the memory file so people can debug
-    snprintf(bkfile, 256, "%s/%s.cmm", BLOCK_WORKLOAD_DIR, fname);
-    if ((fh = open(bkfile, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU)) == -1) {
-        logMessage(LOG_ERROR_LEVEL, "Failure creating backup file [%s], open failed (%s) ",
-            bkfile, strerror(errno));
-        return (-1);
-    }
-    if ((write(fh, membuf, stats.st_size)) == -1) {
-        logMessage(LOG_ERROR_LEVEL, "Failure writing backup file [%s].", bkfile);
-        return (-1);
-    }
-    close(fh);
-
-    // Now walk the buffers and compare byte for byte
-    for (idx = 0; idx < stats.st_size; idx++) {
-        if (membuf[idx] != filbuf[idx]) {
-            logMessage(LOG_ERROR_LEVEL, "Validation of [%s] failed at offset %d (mem %x/'%c' "
-                                        "!= fil %x/'%c'",
-                fname, idx, membuf[idx], membuf[idx], filbuf[idx], filbuf[idx]);
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : run_open_loop
+// Description  : Replay the workload again open-loop at each of the rates
+//                and print the latency against the throughput as CSV.  The
+//                files are rewound between rates (the controller cannot be
+//                powered on again), and rewriting them leaves the same
+//                contents, so they still validate afterwards.
+//
+// Inputs       : wl - the loaded workload
+//                ftable - the file table of the replay
+// Outputs      : 0 if successful test, -1 if failure
+
+int run_open_loop(BlockWorkload* wl, BlockSimulationTable* ftable)
+{
+
+    // Local variables
+    BlockLatencyStats stats[BLOCK_WL_MAXVAL], all;
+    uint64_t elapsed;
+    int r, i;
+
+    printf("arrival,target_iops,achieved_iops,ops,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n");
+    for (r = 0; r < rate_count; r++) {
+
+        // Replay from the start of every file at this rate
+        init_block_latency(&all);
+        for (i = 0; i < BLOCK_WL_MAXVAL; i++) {
+            init_block_latency(&stats[i]);
+        }
+        rewind_block_replay_table(ftable, wl->nfiles);
+        if (replay_block_workload_open(wl, ftable, open_rates[r], open_arrival, stats, &elapsed) != 0) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK open-loop replay at %u IOPS failed.", open_rates[r]);
             return (-1);
         }
-    }
+        for (i = 0; i < BLOCK_WL_MAXVAL; i++) {
+            merge_block_latency(&all, &stats[i]);
+        }
 
-    // Free the buffers, log success, and return successfully
-    free(filbuf);
-    free(membuf);
-    logMessage(LOG_OUTPUT_LEVEL, "Validation of [%s], length %d sucessful.", fname, stats.st_size);
+        printf("%s,%u,%.0f,%" PRIu64 ",%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n",
+            (open_arrival == BLOCK_ARRIVAL_POISSON) ? "poisson" : "const", open_rates[r],
+            (elapsed > 0) ? all.count / (elapsed / 1e9) : 0.0, all.count,
+            (all.count > 0) ? all.total_ns / 1e3 / all.count : 0.0,
+            block_latency_percentile(&all, 50) / 1e3, block_latency_percentile(&all, 90) / 1e3,
+            block_latency_percentile(&all, 99) / 1e3, block_latency_percentile(&all, 99.9) / 1e3,
+            all.max_ns / 1e3);
+    }
+    fflush(stdout);
     return (0);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : log_frame_access
+// Description  : Frame access hook that writes each access to the access
+//                log, as "R <frame>" or "W <frame>", and passes it on to the
+//                cache sweep if there is one
+//
+// Inputs       : sweep - the cache sweep (or NULL)
+//                frm - the frame accessed
+//                write - non-zero if the frame is being written
+// Outputs      : none
+
+void log_frame_access(void* sweep, uint16_t frm, int write)
+{
+    fprintf(access_log, "%c %u\n", write ? 'W' : 'R', frm);
+    if (sweep != NULL) {
+        block_sweep_access(sweep, frm, write);
+    }
+}
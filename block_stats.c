@@ -0,0 +1,234 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_stats.c
+//  Description    : This is the implementation of the timing and latency
+//                   statistics used by the BLOCK simulator.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+// Project Includes
+#include <block_stats.h>
+
+// Two-sided 95% Student's t values for 1 to 30 degrees of freedom
+static const double block_t95[30] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+//
+// Functional Prototypes
+
+static uint32_t latency_bucket(uint64_t ns);
+static uint64_t bucket_value(uint32_t idx);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_clock_ns
+// Description  : Read the monotonic clock in nanoseconds
+//
+// Inputs       : none
+// Outputs      : the time in nanoseconds
+
+uint64_t block_clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : init_block_latency
+// Description  : Clear a latency distribution
+//
+// Inputs       : st - the distribution
+// Outputs      : none
+
+void init_block_latency(BlockLatencyStats* st)
+{
+    memset(st, 0x0, sizeof(BlockLatencyStats));
+    st->min_ns = UINT64_MAX;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : record_block_latency
+// Description  : Add one sample to a distribution
+//
+// Inputs       : st - the distribution
+//                ns - the latency
+//                bytes - the bytes moved by the operation
+// Outputs      : none
+
+void record_block_latency(BlockLatencyStats* st, uint64_t ns, uint64_t bytes)
+{
+    st->count++;
+    st->total_ns += ns;
+    st->bytes += bytes;
+    if (ns < st->min_ns) {
+        st->min_ns = ns;
+    }
+    if (ns > st->max_ns) {
+        st->max_ns = ns;
+    }
+    st->buckets[latency_bucket(ns)]++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : merge_block_latency
+// Description  : Add all of the samples of one distribution to another
+//
+// Inputs       : into - the distribution to add to
+//                from - the distribution to add
+// Outputs      : none
+
+void merge_block_latency(BlockLatencyStats* into, const BlockLatencyStats* from)
+{
+    uint32_t i;
+
+    into->count += from->count;
+    into->total_ns += from->total_ns;
+    into->bytes += from->bytes;
+    if (from->min_ns < into->min_ns) {
+        into->min_ns = from->min_ns;
+    }
+    if (from->max_ns > into->max_ns) {
+        into->max_ns = from->max_ns;
+    }
+    for (i = 0; i < BLOCK_STATS_BUCKETS; i++) {
+        into->buckets[i] += from->buckets[i];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_latency_percentile
+// Description  : Return the latency at a percentile of the distribution
+//
+// Inputs       : st - the distribution
+//                pct - the percentile (0-100)
+// Outputs      : the latency in nanoseconds (0 if there are no samples)
+
+uint64_t block_latency_percentile(const BlockLatencyStats* st, double pct)
+{
+    uint64_t rank, seen;
+    uint32_t i;
+
+    if (st->count == 0) {
+        return (0);
+    }
+    rank = (uint64_t)(pct / 100.0 * st->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (i = 0, seen = 0; i < BLOCK_STATS_BUCKETS; i++) {
+        seen += st->buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    if (i == BLOCK_STATS_BUCKETS) {
+        return (st->max_ns);
+    }
+
+    // Clamp the bucket to the observed range
+    seen = bucket_value(i);
+    if (seen < st->min_ns) {
+        seen = st->min_ns;
+    }
+    if (seen > st->max_ns) {
+        seen = st->max_ns;
+    }
+    return (seen);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_mean_ci95
+// Description  : Return the mean of a set of samples and the half width of
+//                its 95% confidence interval
+//
+// Inputs       : x - the samples
+//                n - the number of samples
+//                half - set to the half width (0 if n < 2)
+// Outputs      : the mean (0 if there are no samples)
+
+double block_mean_ci95(const double* x, int n, double* half)
+{
+    double mean = 0, var = 0;
+    int i;
+
+    *half = 0;
+    if (n < 1) {
+        return (0);
+    }
+    for (i = 0; i < n; i++) {
+        mean += x[i];
+    }
+    mean /= n;
+    if (n < 2) {
+        return (mean);
+    }
+    for (i = 0; i < n; i++) {
+        var += (x[i] - mean) * (x[i] - mean);
+    }
+    var /= n - 1;
+    *half = ((n - 1 <= 30) ? block_t95[n - 2] : 1.960) * sqrt(var / n);
+    return (mean);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : latency_bucket
+// Description  : Find the histogram bucket of a latency
+//
+// Inputs       : ns - the latency
+// Outputs      : the bucket index
+
+static uint32_t latency_bucket(uint64_t ns)
+{
+    uint32_t e;
+
+    if (ns < BLOCK_STATS_SUB_BUCKETS) {
+        return ((uint32_t)ns);
+    }
+    e = 63 - __builtin_clzll(ns);
+    if (e > BLOCK_STATS_MAX_EXP) {
+        return (BLOCK_STATS_BUCKETS - 1);
+    }
+    return ((e - BLOCK_STATS_SUB_BITS + 1) * BLOCK_STATS_SUB_BUCKETS
+        + ((ns >> (e - BLOCK_STATS_SUB_BITS)) & (BLOCK_STATS_SUB_BUCKETS - 1)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bucket_value
+// Description  : The midpoint of the latencies that fall in a bucket
+//
+// Inputs       : idx - the bucket index
+// Outputs      : the latency in nanoseconds
+
+static uint64_t bucket_value(uint32_t idx)
+{
+    uint32_t e, sub;
+
+    if (idx < BLOCK_STATS_SUB_BUCKETS) {
+        return (idx);
+    }
+    e = idx / BLOCK_STATS_SUB_BUCKETS + BLOCK_STATS_SUB_BITS - 1;
+    sub = idx % BLOCK_STATS_SUB_BUCKETS;
+    return (((uint64_t)(BLOCK_STATS_SUB_BUCKETS + sub) << (e - BLOCK_STATS_SUB_BITS))
+        + ((1ULL << (e - BLOCK_STATS_SUB_BITS)) >> 1));
+}
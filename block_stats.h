@@ -0,0 +1,56 @@
+#ifndef BLOCK_STATS_INCLUDED
+#define BLOCK_STATS_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_stats.h
+//  Description    : This is the interface for the timing and latency
+//                   statistics used by the BLOCK simulator.  Latencies go
+//                   into a log-linear histogram (32 buckets per power of
+//                   two, about 3% error), so percentiles are cheap to record.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// Defines
+#define BLOCK_STATS_SUB_BITS 5 // log2 of the buckets per power of two
+#define BLOCK_STATS_SUB_BUCKETS (1 << BLOCK_STATS_SUB_BITS)
+#define BLOCK_STATS_MAX_EXP 48 // Largest power of two recorded (ns)
+#define BLOCK_STATS_BUCKETS (BLOCK_STATS_SUB_BUCKETS * (BLOCK_STATS_MAX_EXP - BLOCK_STATS_SUB_BITS + 2))
+
+// A latency distribution
+typedef struct {
+    uint64_t count; // Number of samples
+    uint64_t total_ns; // Sum of the samples
+    uint64_t min_ns; // Smallest sample
+    uint64_t max_ns; // Largest sample
+    uint64_t bytes; // Bytes moved by the timed operations
+    uint32_t buckets[BLOCK_STATS_BUCKETS]; // The histogram
+} BlockLatencyStats;
+
+//
+// Interface functions
+
+uint64_t block_clock_ns(void);
+// Read the monotonic clock in nanoseconds
+
+void init_block_latency(BlockLatencyStats* st);
+// Clear a latency distribution
+
+void record_block_latency(BlockLatencyStats* st, uint64_t ns, uint64_t bytes);
+// Add one sample to a distribution
+
+void merge_block_latency(BlockLatencyStats* into, const BlockLatencyStats* from);
+// Add all of the samples of one distribution to another
+
+uint64_t block_latency_percentile(const BlockLatencyStats* st, double pct);
+// Return the latency at a percentile (0-100) of the distribution
+
+double block_mean_ci95(const double* x, int n, double* half);
+// Return the mean of n samples, setting half to the half width of its 95%
+// confidence interval (Student's t, 0 for a single sample)
+
+#endif
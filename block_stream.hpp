@@ -0,0 +1,359 @@
+#ifndef BLOCK_STREAM_HPP_INCLUDED
+#define BLOCK_STREAM_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_stream.hpp
+//  Description    : This is the iostreams interface to BLOCK files.
+//                   block::streambuf buffers a block::File in frame-sized
+//                   chunks, so formatted I/O touches memory until a buffer
+//                   fills and then moves whole frames with one pread or
+//                   pwrite.  block::ifstream, block::ofstream and
+//                   block::fstream wrap it like their std:: namesakes.
+//
+//                   The driver has no way to ask a file's size, so seeking
+//                   from the end is not supported.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+
+// Project Includes
+#include <block_driver.hpp>
+extern "C" {
+#include <block_controller.h>
+}
+
+namespace block {
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Class        : streambuf
+// Description  : A std::streambuf over a block::File.  One buffer serves as
+//                the get or the put area.  Buffers start at the stream
+//                position and end on a frame boundary, so after the first
+//                every flush writes whole frames.  Bulk reads and writes
+//                larger than the buffer go straight to the file.
+
+class streambuf : public std::streambuf {
+public:
+    static constexpr std::size_t default_frames = 16; // Frames buffered (64 KiB)
+
+    streambuf() = default;
+    explicit streambuf(File file, std::size_t frames = default_frames) { open(std::move(file), frames); }
+    streambuf(const streambuf&) = delete;
+    streambuf& operator=(const streambuf&) = delete;
+    ~streambuf() override { (void)close(); }
+
+    // Buffer an open file from its start, false if it is not open
+    bool open(File file, std::size_t frames = default_frames)
+    {
+        if (!file.is_open() || is_open()) {
+            return false;
+        }
+        size_ = std::max<std::size_t>(frames, 1) * BLOCK_FRAME_SIZE;
+        buf_ = std::make_unique<char[]>(size_);
+        file_ = std::move(file);
+        pos_ = 0;
+        setg(nullptr, nullptr, nullptr);
+        setp(nullptr, nullptr);
+        return true;
+    }
+
+    // Flush and close the file
+    result<void> close()
+    {
+        if (!is_open()) {
+            return {};
+        }
+        bool flushed = flush_put();
+        setg(nullptr, nullptr, nullptr);
+        buf_.reset();
+        result<void> ret = file_.close();
+        if (!flushed) {
+            return detail::fail(errc::write_failed);
+        }
+        return ret;
+    }
+
+    bool is_open() const noexcept { return file_.is_open(); }
+
+    // The file underneath (flush with pubsync before using it directly)
+    File& file() noexcept { return file_; }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (!is_open()) {
+            return traits_type::eof();
+        }
+        if (pbase() == nullptr) {
+            drop_get();
+        } else if (!flush_put()) {
+            return traits_type::eof();
+        }
+        start_put();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char_type* s, std::streamsize n) override
+    {
+        std::streamsize done = 0, left, chunk;
+
+        if (!is_open()) {
+            return 0;
+        }
+        while (done < n) {
+            if (pbase() == nullptr) {
+                drop_get();
+                start_put();
+            }
+            left = n - done;
+
+            // With the buffer empty, whole buffers go straight to the file
+            if ((pptr() == pbase()) && (left >= epptr() - pbase())) {
+                chunk = left - (pos_ + left) % BLOCK_FRAME_SIZE;
+                auto r = file_.pwrite(std::span(reinterpret_cast<const std::byte*>(s + done), chunk), pos_);
+                if (!r || (*r != static_cast<std::size_t>(chunk))) {
+                    return done;
+                }
+                pos_ += chunk;
+                done += chunk;
+                setp(nullptr, nullptr);
+                continue;
+            }
+            chunk = std::min<std::streamsize>(left, epptr() - pptr());
+            std::memcpy(pptr(), s + done, chunk);
+            pbump(static_cast<int>(chunk));
+            done += chunk;
+            if ((pptr() == epptr()) && !flush_put()) {
+                return done;
+            }
+        }
+        return done;
+    }
+
+    int_type underflow() override
+    {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (!is_open() || !flush_put()) {
+            return traits_type::eof();
+        }
+        drop_get();
+        auto r = file_.pread(std::span(reinterpret_cast<std::byte*>(buf_.get()), size_ - pos_ % BLOCK_FRAME_SIZE),
+            pos_);
+        if (!r || (*r == 0)) {
+            return traits_type::eof();
+        }
+        setg(buf_.get(), buf_.get(), buf_.get() + *r);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize xsgetn(char_type* s, std::streamsize n) override
+    {
+        std::streamsize done = 0, left, chunk;
+
+        while (done < n) {
+            left = n - done;
+            if (gptr() < egptr()) {
+                chunk = std::min<std::streamsize>(left, egptr() - gptr());
+                std::memcpy(s + done, gptr(), chunk);
+                gbump(static_cast<int>(chunk));
+                done += chunk;
+                continue;
+            }
+
+            // Reads of a buffer or more go straight to the file
+            if (is_open() && (left >= static_cast<std::streamsize>(size_))) {
+                if (!flush_put()) {
+                    break;
+                }
+                drop_get();
+                auto r = file_.pread(std::span(reinterpret_cast<std::byte*>(s + done), left), pos_);
+                if (!r) {
+                    break;
+                }
+                pos_ += *r;
+                done += *r;
+                if (*r < static_cast<std::size_t>(left)) {
+                    break;
+                }
+                continue;
+            }
+            if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+                break;
+            }
+        }
+        return done;
+    }
+
+    int sync() override { return flush_put() ? 0 : -1; }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override
+    {
+        off_type target;
+
+        if (!is_open()) {
+            return pos_type(off_type(-1));
+        }
+        if (dir == std::ios_base::beg) {
+            target = off;
+        } else if (dir == std::ios_base::cur) {
+            target = static_cast<off_type>(tell()) + off;
+            if (off == 0) {
+                return pos_type(target);
+            }
+        } else {
+            return pos_type(off_type(-1));
+        }
+        return seek_to(target);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode) override
+    {
+        if (!is_open()) {
+            return pos_type(off_type(-1));
+        }
+        return seek_to(off_type(pos));
+    }
+
+private:
+    // The stream position in the file
+    uint32_t tell() const noexcept
+    {
+        if (pbase() != nullptr) {
+            return pos_ + static_cast<uint32_t>(pptr() - pbase());
+        }
+        return pos_ + static_cast<uint32_t>(gptr() - eback());
+    }
+
+    // Flush, then move to a position in the file (not past its end)
+    pos_type seek_to(off_type target)
+    {
+        if (!flush_put()) {
+            return pos_type(off_type(-1));
+        }
+        setg(nullptr, nullptr, nullptr);
+        if ((target < 0) || (target > UINT32_MAX) || !file_.seek(static_cast<uint32_t>(target))) {
+            return pos_type(off_type(-1));
+        }
+        pos_ = static_cast<uint32_t>(target);
+        return pos_type(target);
+    }
+
+    // Start the put area at the position, ending on a frame boundary
+    void start_put() noexcept
+    {
+        setp(buf_.get(), buf_.get() + size_ - pos_ % BLOCK_FRAME_SIZE);
+    }
+
+    // Write out the put area (if any) and end it
+    bool flush_put()
+    {
+        std::size_t n;
+
+        if (pbase() == nullptr) {
+            return true;
+        }
+        n = pptr() - pbase();
+        if (n > 0) {
+            auto r = file_.pwrite(std::span(reinterpret_cast<const std::byte*>(pbase()), n), pos_);
+            if (!r || (*r != n)) {
+                return false;
+            }
+            pos_ += static_cast<uint32_t>(n);
+        }
+        setp(nullptr, nullptr);
+        return true;
+    }
+
+    // End the get area, moving the position past what was consumed
+    void drop_get() noexcept
+    {
+        if (eback() != nullptr) {
+            pos_ += static_cast<uint32_t>(gptr() - eback());
+            setg(nullptr, nullptr, nullptr);
+        }
+    }
+
+    std::unique_ptr<char[]> buf_; // The get or put area
+    std::size_t size_ = 0; // Bytes in the buffer
+    File file_; // The file being buffered
+    uint32_t pos_ = 0; // File offset of the start of the get or put area
+};
+
+namespace detail {
+
+    // A stream that owns its block::streambuf (the std::fstream pattern)
+    template <class Stream>
+    class stream : public Stream {
+    public:
+        stream() : Stream(nullptr) { this->init(&buf_); }
+        explicit stream(std::string_view path, std::size_t frames = streambuf::default_frames) : stream()
+        {
+            open(path, frames);
+        }
+        explicit stream(File file, std::size_t frames = streambuf::default_frames) : stream()
+        {
+            open(std::move(file), frames);
+        }
+
+        // Open (creating if needed) a file, setting failbit on failure
+        void open(std::string_view path, std::size_t frames = streambuf::default_frames)
+        {
+            auto file = File::open(path);
+            if (!file) {
+                this->setstate(std::ios_base::failbit);
+                return;
+            }
+            open(std::move(*file), frames);
+        }
+
+        // Take over an open file, setting failbit on failure
+        void open(File file, std::size_t frames = streambuf::default_frames)
+        {
+            if (buf_.open(std::move(file), frames)) {
+                this->clear();
+            } else {
+                this->setstate(std::ios_base::failbit);
+            }
+        }
+
+        // Flush and close, setting failbit on failure
+        void close()
+        {
+            if (!buf_.close()) {
+                this->setstate(std::ios_base::failbit);
+            }
+        }
+
+        bool is_open() const noexcept { return buf_.is_open(); }
+        streambuf* rdbuf() const noexcept { return const_cast<streambuf*>(&buf_); }
+
+    private:
+        streambuf buf_; // The buffer the stream reads and writes through
+    };
+
+}
+
+using ifstream = detail::stream<std::istream>; // Input from a BLOCK file
+using ofstream = detail::stream<std::ostream>; // Output to a BLOCK file
+using fstream = detail::stream<std::iostream>; // Both
+
+} // namespace block
+
+#endif
@@ -0,0 +1,274 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_sweep.c
+//  Description    : This is the implementation of the single-pass cache size
+//                   sweep.  Every access is given its LRU stack distance (the
+//                   number of distinct frames touched since the last access
+//                   to the same frame) using a Fenwick tree over access
+//                   times, so a cache of size C hits exactly the accesses
+//                   with distance < C.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Project Includes
+#include <block_controller.h>
+#include <block_sweep.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define BLOCK_SWEEP_TIME_SLOTS (1 << 20) // Access times kept before compacting
+
+// The sweep state
+struct BlockSweep {
+    uint32_t sizes[BLOCK_SWEEP_MAX_SIZES]; // The cache sizes simulated
+    int nsizes; // Number of cache sizes
+    int32_t* tree; // Fenwick tree, 1 at the last access time of each frame
+    uint32_t last[BLOCK_BLOCK_SIZE]; // Last access time of each frame (0 = never)
+    uint32_t now; // Current access time
+    uint64_t* distance; // Count of accesses at each stack distance
+    uint64_t cold; // Accesses to frames never seen before
+    uint64_t accesses; // Total frame accesses
+    uint64_t writes; // Frame writes (each one is a bus write)
+};
+
+//
+// Functional Prototypes
+
+static void tree_add(BlockSweep* sw, uint32_t t, int32_t v);
+static uint32_t tree_sum(BlockSweep* sw, uint32_t t);
+static int compact_times(BlockSweep* sw);
+static int compare_last(const void* a, const void* b);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_block_sweep
+// Description  : Parse a sweep specification into a list of cache sizes
+//
+// Inputs       : spec - <min>:<max>:x<factor> or <min>:<max>:+<step>
+//                sizes - the array to fill in
+//                max - the size of the array
+// Outputs      : number of sizes if successful, -1 if failure
+
+int parse_block_sweep(const char* spec, uint32_t* sizes, int max)
+{
+    uint32_t lo, hi, step, sz;
+    char how;
+    int n = 0;
+
+    if ((sscanf(spec, "%u:%u:%c%u", &lo, &hi, &how, &step) != 4) || (lo == 0) || (lo > hi)
+        || ((how == 'x') && (step < 2)) || ((how == '+') && (step < 1)) || ((how != 'x') && (how != '+'))) {
+        logMessage(LOG_ERROR_LEVEL, "Bad sweep [%s], expected <min>:<max>:x<factor> or <min>:<max>:+<step>.", spec);
+        return (-1);
+    }
+    for (sz = lo; (sz <= hi) && (n < max); sz = (how == 'x') ? sz * step : sz + step) {
+        sizes[n++] = sz;
+        if ((how == 'x') && (sz > hi / step)) {
+            break;
+        }
+    }
+    return (n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : create_block_sweep
+// Description  : Create the sweep state for the given cache sizes
+//
+// Inputs       : sizes - the cache sizes to simulate
+//                nsizes - the number of sizes
+// Outputs      : the sweep state, NULL on failure
+
+BlockSweep* create_block_sweep(const uint32_t* sizes, int nsizes)
+{
+    BlockSweep* sw;
+
+    if ((sw = calloc(1, sizeof(BlockSweep))) == NULL) {
+        return (NULL);
+    }
+    sw->tree = calloc(BLOCK_SWEEP_TIME_SLOTS + 1, sizeof(int32_t));
+    sw->distance = calloc(BLOCK_BLOCK_SIZE, sizeof(uint64_t));
+    if ((sw->tree == NULL) || (sw->distance == NULL)) {
+        free_block_sweep(sw);
+        return (NULL);
+    }
+    sw->nsizes = (nsizes > BLOCK_SWEEP_MAX_SIZES) ? BLOCK_SWEEP_MAX_SIZES : nsizes;
+    memcpy(sw->sizes, sizes, sizeof(uint32_t) * sw->nsizes);
+    return (sw);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_sweep_access
+// Description  : Record a frame access and its stack distance
+//
+// Inputs       : sweep - the sweep state
+//                frm - the frame accessed
+//                write - non-zero if the frame is being written
+// Outputs      : none
+
+void block_sweep_access(void* sweep, uint16_t frm, int write)
+{
+    BlockSweep* sw = sweep;
+    uint32_t prev;
+
+    // Make room for another access time (dropping the access if there is none)
+    if ((sw->now == BLOCK_SWEEP_TIME_SLOTS) && (compact_times(sw) != 0)) {
+        return;
+    }
+    sw->now++;
+    sw->accesses++;
+    if (write) {
+        sw->writes++;
+    }
+
+    // Count the distinct frames touched since the last access to this one
+    prev = sw->last[frm];
+    if (prev == 0) {
+        sw->cold++;
+    } else {
+        sw->distance[tree_sum(sw, sw->now - 1) - tree_sum(sw, prev)]++;
+        tree_add(sw, prev, -1);
+    }
+    tree_add(sw, sw->now, 1);
+    sw->last[frm] = sw->now;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_block_sweep_csv
+// Description  : Write the results for every cache size as CSV.  A frame
+//                miss costs a bus read and every frame write is a bus write
+//                (the driver writes through).
+//
+// Inputs       : sweep - the sweep state
+//                out - the stream to write to
+// Outputs      : 0 if successful, -1 if failure
+
+int write_block_sweep_csv(BlockSweep* sw, FILE* out)
+{
+    uint64_t hits, misses;
+    uint32_t d;
+    int i;
+
+    fprintf(out, "cache_size,accesses,hits,misses,hit_ratio,bus_reads,bus_writes,bus_ops\n");
+    for (i = 0, d = 0, hits = 0; i < sw->nsizes; i++) {
+        for (; (d < sw->sizes[i]) && (d < BLOCK_BLOCK_SIZE); d++) {
+            hits += sw->distance[d];
+        }
+        misses = sw->accesses - hits;
+        fprintf(out, "%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", sw->sizes[i],
+            sw->accesses, hits, misses, (sw->accesses == 0) ? 0.0 : (double)hits / sw->accesses, misses, sw->writes,
+            misses + sw->writes);
+    }
+    return (ferror(out) ? -1 : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : free_block_sweep
+// Description  : Release the sweep state
+//
+// Inputs       : sweep - the sweep state
+// Outputs      : none
+
+void free_block_sweep(BlockSweep* sw)
+{
+    if (sw != NULL) {
+        free(sw->tree);
+        free(sw->distance);
+        free(sw);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : tree_add
+// Description  : Add a value at an access time in the Fenwick tree
+//
+// Inputs       : sw - the sweep state
+//                t - the access time (1 based)
+//                v - the value to add
+// Outputs      : none
+
+static void tree_add(BlockSweep* sw, uint32_t t, int32_t v)
+{
+    for (; t <= BLOCK_SWEEP_TIME_SLOTS; t += t & (-t)) {
+        sw->tree[t] += v;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : tree_sum
+// Description  : Sum of the Fenwick tree over access times [1, t]
+//
+// Inputs       : sw - the sweep state
+//                t - the access time
+// Outputs      : the sum
+
+static uint32_t tree_sum(BlockSweep* sw, uint32_t t)
+{
+    int32_t sum = 0;
+
+    for (; t > 0; t -= t & (-t)) {
+        sum += sw->tree[t];
+    }
+    return (sum);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : compact_times
+// Description  : Renumber the last access times 1..n (keeping their order)
+//                once the time slots run out
+//
+// Inputs       : sw - the sweep state
+// Outputs      : 0 if successful, -1 if failure (the times are left as they were)
+
+static int compact_times(BlockSweep* sw)
+{
+    uint64_t* frames;
+    uint32_t i, n;
+
+    if ((frames = malloc(sizeof(uint64_t) * BLOCK_BLOCK_SIZE)) == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "Failed allocating the cache sweep compaction buffer.");
+        return (-1);
+    }
+    for (i = 0, n = 0; i < BLOCK_BLOCK_SIZE; i++) {
+        if (sw->last[i] != 0) {
+            frames[n++] = ((uint64_t)sw->last[i] << 16) | i;
+        }
+    }
+    qsort(frames, n, sizeof(uint64_t), compare_last);
+    memset(sw->tree, 0x0, sizeof(int32_t) * (BLOCK_SWEEP_TIME_SLOTS + 1));
+    for (i = 0; i < n; i++) {
+        sw->last[frames[i] & 0xffff] = i + 1;
+        tree_add(sw, i + 1, 1);
+    }
+    sw->now = n;
+    free(frames);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : compare_last
+// Description  : qsort comparison, orders packed (time, frame) values
+//
+// Inputs       : a, b - the values to compare
+// Outputs      : <0, 0 or >0
+
+static int compare_last(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return ((x < y) ? -1 : (x > y));
+}
@@ -0,0 +1,42 @@
+#ifndef BLOCK_SWEEP_INCLUDED
+#define BLOCK_SWEEP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_sweep.h
+//  Description    : This is the interface for the single-pass cache size
+//                   sweep.  It watches the frame accesses of one replay and
+//                   computes the hit rate of an LRU cache of every size.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+#include <stdio.h>
+
+// Defines
+#define BLOCK_SWEEP_MAX_SIZES 256 // Maximum number of cache sizes in a sweep
+
+// The sweep state (opaque)
+typedef struct BlockSweep BlockSweep;
+
+//
+// Interface functions
+
+int parse_block_sweep(const char* spec, uint32_t* sizes, int max);
+// Parse <min>:<max>:x<factor> or <min>:<max>:+<step>, returns the count or -1
+
+BlockSweep* create_block_sweep(const uint32_t* sizes, int nsizes);
+// Create the sweep state for the given cache sizes
+
+void block_sweep_access(void* sweep, uint16_t frm, int write);
+// Record a frame access (matches BlockFrameAccessHook)
+
+int write_block_sweep_csv(BlockSweep* sweep, FILE* out);
+// Write the size, hit rate and bus op results as CSV
+
+void free_block_sweep(BlockSweep* sweep);
+// Release the sweep state
+
+#endif
@@ -0,0 +1,280 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_validate.c
+//  Description    : This is the implementation of the file validation for
+//                   the BLOCK simulator.  Files are streamed through a pair
+//                   of fixed size buffers, so memory use does not grow with
+//                   the file, and several files are checked at once.  The
+//                   buffers come from the buffer pool, so each thread reuses
+//                   one pair for all of its files.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_backend.h>
+#include <block_buffer.h>
+#include <block_controller.h>
+#include <block_validate.h>
+#include <cmpsc311_log.h>
+
+// The state shared by the validation threads
+typedef struct {
+    const char* dir; // Directory holding the expected files
+    BlockSimulationTable* ftable; // The file table
+    int nfiles; // Entries in the table
+    int backup; // Write the .cmm backups
+    pthread_mutex_t lock; // Protects next and failed
+    int next; // Next table entry to check
+    int failed; // Set once any file fails
+} BlockValidateShared;
+
+//
+// Functional Prototypes
+
+static void* validate_worker(void* arg);
+static ssize_t read_fully(int fh, char* buf, size_t len);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : validate_block_file
+// Description  : Validate a file in the filesystem, reading both copies a
+//                chunk at a time and reporting the first byte that differs
+//
+// Inputs       : dir - the directory holding the expected file
+//                fname - the name of the file to validate
+//                mfh - the memory file handle
+//                backup - non-zero to also write <dir>/<fname>.cmm
+// Outputs      : 0 if successful test, -1 if failure
+
+int validate_block_file(const char* dir, char* fname, int16_t mfh, int backup)
+{
+
+    // Local variables
+    char filename[256], bkfile[256], *filbuf, *membuf;
+    struct stat stats;
+    uint64_t off = 0;
+    int32_t len;
+    int fh, bk = -1, ret = -1;
+    size_t idx;
+
+    // First figure out how big the file is, setup buffers
+    snprintf(filename, 256, "%s/%s", dir, fname);
+    if ((fh = open(filename, O_RDONLY)) == -1) {
+        logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], open failed ", filename);
+        return (-1);
+    }
+    if ((fstat(fh, &stats) != 0) || (stats.st_size == 0)) {
+        logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], missing or "
+                                    "unknown source.",
+            filename);
+        close(fh);
+        return (-1);
+    }
+    filbuf = block_buffer_alloc(BLOCK_VALIDATE_CHUNK);
+    membuf = block_buffer_alloc(BLOCK_VALIDATE_CHUNK);
+    if ((filbuf == NULL) || (membuf == NULL)) {
+        logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], failed "
+                                    "buffer allocation.",
+            filename);
+        goto done;
+    }
+
+    // Create a backup of the memory file if people want to debug
+    if (backup) {
+        snprintf(bkfile, 256, "%s/%s.cmm", dir, fname);
+        if ((bk = open(bkfile, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU)) == -1) {
+            logMessage(LOG_ERROR_LEVEL, "Failure creating backup file [%s], open failed (%s) ",
+                bkfile, strerror(errno));
+            goto done;
+        }
+    }
+
+    // Seek to the beginning of the memory file
+    if (block_backend->seek(mfh, 0) == -1) {
+        logMessage(LOG_ERROR_LEVEL, "Read block file [%s] see to zero failed.", fname);
+        goto done;
+    }
+
+    // Now walk the files a chunk at a time
+    while (off < stats.st_size) {
+        len = (stats.st_size - off < BLOCK_VALIDATE_CHUNK) ? stats.st_size - off : BLOCK_VALIDATE_CHUNK;
+        if (read_fully(fh, filbuf, len) != len) {
+            logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], read failed ", filename);
+            goto done;
+        }
+        if (block_backend->read(mfh, membuf, len) != len) {
+            logMessage(LOG_ERROR_LEVEL, "Read block file [%s] of length %d at offset %" PRIu64 " failed.",
+                fname, len, off);
+            goto done;
+        }
+        if ((bk != -1) && (write(bk, membuf, len) != len)) {
+            logMessage(LOG_ERROR_LEVEL, "Failure writing backup file [%s].", bkfile);
+            goto done;
+        }
+
+        // Only look for the byte when the chunk differs
+        if (memcmp(membuf, filbuf, len) != 0) {
+            for (idx = 0; membuf[idx] == filbuf[idx]; idx++)
+                ;
+            logMessage(LOG_ERROR_LEVEL, "Validation of [%s] failed at offset %" PRIu64 " (mem %x/'%c' "
+                                        "!= fil %x/'%c'",
+                fname, off + idx, membuf[idx], membuf[idx], filbuf[idx], filbuf[idx]);
+            goto done;
+        }
+        off += len;
+    }
+
+    // Log success
+    logMessage(LOG_OUTPUT_LEVEL, "Validation of [%s], length %ld sucessful.", fname, stats.st_size);
+    ret = 0;
+
+done:
+    // Free the buffers and close the files
+    block_buffer_free(filbuf, BLOCK_VALIDATE_CHUNK);
+    block_buffer_free(membuf, BLOCK_VALIDATE_CHUNK);
+    if (bk != -1) {
+        close(bk);
+    }
+    close(fh);
+    return (ret);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : validate_block_files
+// Description  : Validate every open file in the table.  Each file is read
+//                through its own handle, so the files can be checked on
+//                separate threads.
+//
+// Inputs       : dir - the directory holding the expected files
+//                ftable - the file table
+//                nfiles - the number of entries in the table
+//                jobs - the number of threads to use
+//                backup - non-zero to also write the .cmm backups
+// Outputs      : 0 if every file validated, -1 if failure
+
+int validate_block_files(const char* dir, BlockSimulationTable* ftable, int nfiles, int jobs, int backup)
+{
+
+    // Local variables
+    BlockValidateShared shared;
+    pthread_t threads[BLOCK_REPLAY_MAX_JOBS];
+    int i, started;
+
+    // Setup the shared state
+    shared.dir = dir;
+    shared.ftable = ftable;
+    shared.nfiles = nfiles;
+    shared.backup = backup;
+    shared.next = 0;
+    shared.failed = 0;
+    pthread_mutex_init(&shared.lock, NULL);
+
+    // Check the files, on this thread if there is only one job
+    if (jobs > BLOCK_REPLAY_MAX_JOBS) {
+        jobs = BLOCK_REPLAY_MAX_JOBS;
+    }
+    if (jobs <= 1) {
+        validate_worker(&shared);
+    } else {
+        for (started = 0; started < jobs; started++) {
+            if (pthread_create(&threads[started], NULL, validate_worker, &shared) != 0) {
+                logMessage(LOG_ERROR_LEVEL, "BLOCK validation failed to create a thread.");
+                shared.failed = 1;
+                break;
+            }
+        }
+        for (i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    pthread_mutex_destroy(&shared.lock);
+    return (shared.failed ? -1 : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : validate_worker
+// Description  : Validate files from the table until they run out or one
+//                fails
+//
+// Inputs       : arg - the shared validation state
+// Outputs      : NULL
+
+static void* validate_worker(void* arg)
+{
+    BlockValidateShared* shared = arg;
+    BlockSimulationTable* entry;
+    int f;
+
+    while (1) {
+
+        // Take the next open file
+        pthread_mutex_lock(&shared->lock);
+        while ((shared->next < shared->nfiles) && (shared->ftable[shared->next].fhandle == -1)) {
+            shared->next++;
+        }
+        if (shared->failed || (shared->next == shared->nfiles)) {
+            pthread_mutex_unlock(&shared->lock);
+            return (NULL);
+        }
+        f = shared->next++;
+        pthread_mutex_unlock(&shared->lock);
+
+        // Check it
+        entry = &shared->ftable[f];
+        if (validate_block_file(shared->dir, entry->filename, entry->fhandle, shared->backup) != 0) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK Validation failed on file [%s].", entry->filename);
+            pthread_mutex_lock(&shared->lock);
+            shared->failed = 1;
+            pthread_mutex_unlock(&shared->lock);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : read_fully
+// Description  : Read from a file until the length is read or it ends
+//
+// Inputs       : fh - the file to read
+//                buf - the buffer to read into
+//                len - the number of bytes to read
+// Outputs      : the number of bytes read, -1 if failure
+
+static ssize_t read_fully(int fh, char* buf, size_t len)
+{
+    size_t got = 0;
+    ssize_t n;
+
+    while (got < len) {
+        if ((n = read(fh, buf + got, len - got)) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (-1);
+        }
+        if (n == 0) {
+            break;
+        }
+        got += n;
+    }
+    return (got);
+}
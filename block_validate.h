@@ -0,0 +1,33 @@
+#ifndef BLOCK_VALIDATE_INCLUDED
+#define BLOCK_VALIDATE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_validate.h
+//  Description    : This is the interface for checking the files left by a
+//                   replay against their expected contents on disk.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// Project Includes
+#include <block_controller.h>
+#include <block_replay.h>
+
+// Defines
+#define BLOCK_VALIDATE_CHUNK (16 * BLOCK_FRAME_SIZE) // Bytes compared at a time
+
+//
+// Interface functions
+
+int validate_block_file(const char* dir, char* fname, int16_t mfh, int backup);
+// Compare an open file with <dir>/<fname>, a chunk at a time (also writing
+// its contents to <dir>/<fname>.cmm if backup is set)
+
+int validate_block_files(const char* dir, BlockSimulationTable* ftable, int nfiles, int jobs, int backup);
+// Validate every open file in the table, on up to "jobs" threads
+
+#endif
@@ -0,0 +1,628 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_wlgen.c
+//  Description    : This is a synthetic workload generator for the BLOCK
+//                   simulator.  It writes a workload file in the block_sim
+//                   format and the expected contents of every file it
+//                   touches (which block_sim validates against).
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Project Includes
+#include <block_controller.h>
+#include <block_driver.h>
+#include <block_workload.h>
+
+// Defines
+#define WLGEN_ARGUMENTS "hw:d:n:s:i:m:p:c:S:f:"
+#define WLGEN_MAX_FILES 128 // Matches the simulator file table
+#define WLGEN_MAX_FILE_SIZE (BLOCK_MAX_FRAME_PER_FILE * BLOCK_FRAME_SIZE)
+#define WLGEN_MAX_PREFIX 64 // Longest file name prefix
+#define WLGEN_MAX_INLINE (BLOCK_WORKLOAD_MAX_LINE - 128) // Payload that fits on a line
+#define WLGEN_MAX_IO_SIZE BLOCK_WORKLOAD_MAX_IO // Largest I/O generated
+#define WLGEN_MAX_DEVICE_FRAMES (BLOCK_BLOCK_SIZE - BLOCK_MAX_TOTAL_FILES)
+#define USAGE                                                                          \
+    "USAGE: block_wlgen [-h] [-w <workload>] [-d <dir>] [-n <files>] [-s <dist>]\n"    \
+    "                   [-i <dist>] [-m <mix>] [-p <pattern>] [-c <ops>] [-S <seed>]\n" \
+    "                   [-f <prefix>]\n"                                                \
+    "\n"                                                                               \
+    "where:\n"                                                                         \
+    "    -h - help mode (display this message)\n"                                      \
+    "    -w - workload file to write (default <dir>/<prefix>-workload.txt)\n"          \
+    "    -d - directory for the expected file contents (default workload)\n"           \
+    "    -n - number of files (default 8)\n"                                           \
+    "    -s - initial file size distribution (default uniform:4096:65536)\n"           \
+    "    -i - I/O size distribution (default uniform:1:896, larger writes are\n"       \
+    "         written as @pattern payloads)\n"                                      \
+    "    -m - op mix ratios, e.g. read=70,writeat=20,write=10 (the default)\n"         \
+    "    -p - access pattern: seq, uniform, zipf:<theta>, hotspot:<frac>:<prob>\n"     \
+    "         (default uniform)\n"                                                     \
+    "    -c - number of ops after the files are created (default 10000)\n"             \
+    "    -S - random seed (default 1)\n"                                               \
+    "    -f - file name prefix (default gen)\n"                                        \
+    "\n"                                                                               \
+    "  Distributions are fixed:<n>, uniform:<min>:<max> or exp:<mean>.\n"              \
+    "\n"
+
+// A size distribution
+typedef enum {
+    WLGEN_DIST_FIXED = 0,
+    WLGEN_DIST_UNIFORM = 1,
+    WLGEN_DIST_EXP = 2,
+} WlgenDistType;
+
+typedef struct {
+    WlgenDistType type;
+    double a; // fixed value, minimum or mean
+    double b; // maximum (uniform)
+} WlgenDist;
+
+// The access patterns
+typedef enum {
+    WLGEN_PAT_SEQ = 0,
+    WLGEN_PAT_UNIFORM = 1,
+    WLGEN_PAT_ZIPF = 2,
+    WLGEN_PAT_HOTSPOT = 3,
+} WlgenPatternType;
+
+typedef struct {
+    WlgenPatternType type;
+    double theta; // Zipf skew
+    double hotfrac; // Fraction of the file that is hot
+    double hotprob; // Probability an access goes to the hot region
+} WlgenPattern;
+
+// The state of one generated file
+typedef struct {
+    char name[BLOCK_MAX_PATH_LENGTH]; // The file name
+    char* data; // The expected contents
+    int32_t size; // Current size
+    int32_t target; // Initial size to create
+    int32_t pos; // Current position in the replay
+    int32_t cursor; // Next sequential offset
+    uint32_t nslots; // Frames covered by the Zipf table
+    double* cdf; // Zipf cumulative distribution over frames
+} WlgenFile;
+
+//
+// Global Data
+
+static uint64_t wlgen_rng; // The PRNG state
+static FILE* wlgen_out; // The workload being written
+static int32_t wlgen_frames; // Frames allocated on the device so far
+
+//
+// Functional Prototypes
+
+static uint64_t wlgen_next(void);
+static double wlgen_uniform(void);
+static int parse_dist(const char* spec, WlgenDist* dist);
+static int parse_pattern(const char* spec, WlgenPattern* pat);
+static int parse_mix(const char* spec, double* mix);
+static int32_t sample_dist(WlgenDist* dist, int32_t lo, int32_t hi);
+static int32_t pick_offset(WlgenFile* file, WlgenPattern* pat, int32_t len);
+static void emit_write(WlgenFile* file, int command, int32_t off, int32_t len);
+static void emit_seek(WlgenFile* file, int32_t off);
+static int write_expected(const char* dir, WlgenFile* file);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the workload generator
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main(int argc, char* argv[])
+{
+    // Local variables
+    char wload[BLOCK_MAX_PATH_LENGTH * 2], *wname = NULL, *dir = "workload", *prefix = "gen";
+    WlgenDist fsize = { WLGEN_DIST_UNIFORM, 4096, 65536 }, iosize = { WLGEN_DIST_UNIFORM, 1, WLGEN_MAX_INLINE };
+    WlgenPattern pat = { WLGEN_PAT_UNIFORM, 0.0, 0.0, 0.0 };
+    double mix[BLOCK_WL_MAXVAL] = { 0.1, 0.2, 0.0, 0.7 }, r;
+    WlgenFile* files;
+    int ch, nfiles = 8, i, cmd;
+    long ops = 10000, n;
+    int32_t len, off, created;
+    uint64_t seed = 1;
+
+    // Process the command line parameters
+    while ((ch = getopt(argc, argv, WLGEN_ARGUMENTS)) != -1) {
+        switch (ch) {
+        case 'h': // Help, print usage
+            fprintf(stderr, USAGE);
+            return (-1);
+
+        case 'w': // Workload file
+            wname = optarg;
+            break;
+
+        case 'd': // Expected file directory
+            dir = optarg;
+            break;
+
+        case 'n': // Number of files
+            if ((sscanf(optarg, "%d", &nfiles) != 1) || (nfiles < 1) || (nfiles > WLGEN_MAX_FILES)) {
+                fprintf(stderr, "Bad number of files [%s], must be 1-%d.\n", optarg, WLGEN_MAX_FILES);
+                return (-1);
+            }
+            break;
+
+        case 's': // File size distribution
+            if (parse_dist(optarg, &fsize) != 0) {
+                return (-1);
+            }
+            break;
+
+        case 'i': // I/O size distribution
+            if (parse_dist(optarg, &iosize) != 0) {
+                return (-1);
+            }
+            break;
+
+        case 'm': // Op mix
+            if (parse_mix(optarg, mix) != 0) {
+                return (-1);
+            }
+            break;
+
+        case 'p': // Access pattern
+            if (parse_pattern(optarg, &pat) != 0) {
+                return (-1);
+            }
+            break;
+
+        case 'c': // Number of ops
+            if ((sscanf(optarg, "%ld", &ops) != 1) || (ops < 0)) {
+                fprintf(stderr, "Bad op count [%s].\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'S': // Seed
+            if (sscanf(optarg, "%" SCNu64, &seed) != 1) {
+                fprintf(stderr, "Bad seed [%s].\n", optarg);
+                return (-1);
+            }
+            break;
+
+        case 'f': // File prefix
+            if (strlen(optarg) > WLGEN_MAX_PREFIX) {
+                fprintf(stderr, "File prefix [%s] too long, max %d.\n", optarg, WLGEN_MAX_PREFIX);
+                return (-1);
+            }
+            prefix = optarg;
+            break;
+
+        default: // Default (unknown)
+            fprintf(stderr, "Unknown command line option (%c), aborting.\n", ch);
+            return (-1);
+        }
+    }
+    wlgen_rng = seed ^ 0x9e3779b97f4a7c15ULL;
+
+    // Open the workload file
+    if (wname == NULL) {
+        snprintf(wload, sizeof(wload), "%s/%s-workload.txt", dir, prefix);
+        wname = wload;
+    }
+    if ((wlgen_out = fopen(wname, "w")) == NULL) {
+        fprintf(stderr, "Failure opening workload file [%s], error: %s.\n", wname, strerror(errno));
+        return (-1);
+    }
+
+    // Setup the files, with fixed width names
+    files = calloc(nfiles, sizeof(WlgenFile));
+    for (i = 0; i < nfiles; i++) {
+        snprintf(files[i].name, BLOCK_MAX_PATH_LENGTH, "%s%03d.dat", prefix, i);
+        files[i].data = malloc(WLGEN_MAX_FILE_SIZE);
+        files[i].target = sample_dist(&fsize, 1, WLGEN_MAX_FILE_SIZE);
+    }
+
+    // Create the files, round robin so their frames interleave on the device
+    do {
+        created = 0;
+        for (i = 0; i < nfiles; i++) {
+            if (files[i].size < files[i].target) {
+                len = sample_dist(&iosize, 1, WLGEN_MAX_IO_SIZE);
+                if (len > files[i].target - files[i].size) {
+                    len = files[i].target - files[i].size;
+                }
+                if (wlgen_frames + (len + BLOCK_FRAME_SIZE - 1) / BLOCK_FRAME_SIZE + 1 >= WLGEN_MAX_DEVICE_FRAMES) {
+                    // Out of device space, stop growing this file
+                    files[i].target = files[i].size;
+                    continue;
+                }
+                emit_write(&files[i], BLOCK_WL_WRITE, files[i].size, len);
+                created = 1;
+            }
+        }
+    } while (created);
+
+    // Now generate the mixed operations
+    for (n = 0; n < ops; n++) {
+        i = wlgen_uniform() * nfiles;
+        len = sample_dist(&iosize, 1, WLGEN_MAX_IO_SIZE);
+
+        // Pick the command from the mix
+        r = wlgen_uniform() * (mix[BLOCK_WL_READ] + mix[BLOCK_WL_WRITE] + mix[BLOCK_WL_WRITEAT]);
+        if (r < mix[BLOCK_WL_READ]) {
+            cmd = BLOCK_WL_READ;
+        } else if (r < mix[BLOCK_WL_READ] + mix[BLOCK_WL_WRITEAT]) {
+            cmd = BLOCK_WL_WRITEAT;
+        } else {
+            cmd = BLOCK_WL_WRITE;
+        }
+
+        // Appends that would overflow the file or device turn into overwrites
+        if ((cmd == BLOCK_WL_WRITE) && ((files[i].size + len > WLGEN_MAX_FILE_SIZE)
+                                           || (wlgen_frames + (len + BLOCK_FRAME_SIZE - 1) / BLOCK_FRAME_SIZE + 1
+                                               >= WLGEN_MAX_DEVICE_FRAMES))) {
+            cmd = BLOCK_WL_WRITEAT;
+        }
+        if (cmd != BLOCK_WL_WRITE) {
+            if (len > files[i].size) {
+                len = files[i].size;
+            }
+            if (len == 0) {
+                continue;
+            }
+        }
+
+        // Emit the operation
+        switch (cmd) {
+        case BLOCK_WL_READ:
+            off = pick_offset(&files[i], &pat, len);
+            emit_seek(&files[i], off);
+            fprintf(wlgen_out, "%s READ %d 0 :\n", files[i].name, len);
+            files[i].pos += len;
+            break;
+
+        case BLOCK_WL_WRITEAT:
+            off = pick_offset(&files[i], &pat, len);
+            emit_write(&files[i], BLOCK_WL_WRITEAT, off, len);
+            break;
+
+        default:
+            emit_seek(&files[i], files[i].size);
+            emit_write(&files[i], BLOCK_WL_WRITE, files[i].size, len);
+            break;
+        }
+    }
+    fclose(wlgen_out);
+
+    // Write out the expected file contents
+    for (i = 0; i < nfiles; i++) {
+        if (write_expected(dir, &files[i]) != 0) {
+            return (-1);
+        }
+        free(files[i].data);
+        free(files[i].cdf);
+    }
+    free(files);
+    fprintf(stderr, "Wrote %ld ops over %d files to [%s].\n", ops, nfiles, wname);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : wlgen_next
+// Description  : Next value from the generator PRNG (xorshift64*)
+//
+// Inputs       : none
+// Outputs      : the random value
+
+static uint64_t wlgen_next(void)
+{
+    wlgen_rng ^= wlgen_rng >> 12;
+    wlgen_rng ^= wlgen_rng << 25;
+    wlgen_rng ^= wlgen_rng >> 27;
+    return (wlgen_rng * 0x2545f4914f6cdd1dULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : wlgen_uniform
+// Description  : A uniform random value in [0, 1)
+//
+// Inputs       : none
+// Outputs      : the random value
+
+static double wlgen_uniform(void)
+{
+    return ((wlgen_next() >> 11) * (1.0 / 9007199254740992.0));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_dist
+// Description  : Parse a size distribution specification
+//
+// Inputs       : spec - fixed:<n>, uniform:<min>:<max> or exp:<mean>
+//                dist - the distribution to fill in
+// Outputs      : 0 if successful, -1 if failure
+
+static int parse_dist(const char* spec, WlgenDist* dist)
+{
+    if (sscanf(spec, "fixed:%lf", &dist->a) == 1) {
+        dist->type = WLGEN_DIST_FIXED;
+    } else if ((sscanf(spec, "uniform:%lf:%lf", &dist->a, &dist->b) == 2) && (dist->a <= dist->b)) {
+        dist->type = WLGEN_DIST_UNIFORM;
+    } else if (sscanf(spec, "exp:%lf", &dist->a) == 1) {
+        dist->type = WLGEN_DIST_EXP;
+    } else {
+        fprintf(stderr, "Bad distribution [%s].\n", spec);
+        return (-1);
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_pattern
+// Description  : Parse an access pattern specification
+//
+// Inputs       : spec - seq, uniform, zipf:<theta> or hotspot:<frac>:<prob>
+//                pat - the pattern to fill in
+// Outputs      : 0 if successful, -1 if failure
+
+static int parse_pattern(const char* spec, WlgenPattern* pat)
+{
+    if (strcmp(spec, "seq") == 0) {
+        pat->type = WLGEN_PAT_SEQ;
+    } else if (strcmp(spec, "uniform") == 0) {
+        pat->type = WLGEN_PAT_UNIFORM;
+    } else if ((sscanf(spec, "zipf:%lf", &pat->theta) == 1) && (pat->theta > 0.0)) {
+        pat->type = WLGEN_PAT_ZIPF;
+    } else if ((sscanf(spec, "hotspot:%lf:%lf", &pat->hotfrac, &pat->hotprob) == 2)
+        && (pat->hotfrac > 0.0) && (pat->hotfrac < 1.0) && (pat->hotprob >= 0.0) && (pat->hotprob <= 1.0)) {
+        pat->type = WLGEN_PAT_HOTSPOT;
+    } else {
+        fprintf(stderr, "Bad access pattern [%s].\n", spec);
+        return (-1);
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_mix
+// Description  : Parse the op mix ratios (read, writeat and write)
+//
+// Inputs       : spec - comma separated <op>=<weight> list
+//                mix - the weights, indexed by BlockWorkloadCommand
+// Outputs      : 0 if successful, -1 if failure
+
+static int parse_mix(const char* spec, double* mix)
+{
+    char buf[256], *tok, *save;
+    double w;
+
+    memset(mix, 0x0, sizeof(double) * BLOCK_WL_MAXVAL);
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0x0;
+    for (tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        if ((sscanf(tok, "read=%lf", &w) == 1) && (w >= 0)) {
+            mix[BLOCK_WL_READ] = w;
+        } else if ((sscanf(tok, "writeat=%lf", &w) == 1) && (w >= 0)) {
+            mix[BLOCK_WL_WRITEAT] = w;
+        } else if ((sscanf(tok, "write=%lf", &w) == 1) && (w >= 0)) {
+            mix[BLOCK_WL_WRITE] = w;
+        } else {
+            fprintf(stderr, "Bad op mix entry [%s].\n", tok);
+            return (-1);
+        }
+    }
+    if (mix[BLOCK_WL_READ] + mix[BLOCK_WL_WRITEAT] + mix[BLOCK_WL_WRITE] <= 0) {
+        fprintf(stderr, "Op mix [%s] has no weight.\n", spec);
+        return (-1);
+    }
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : sample_dist
+// Description  : Draw a size from a distribution, clamped to [lo, hi]
+//
+// Inputs       : dist - the distribution
+//                lo, hi - the bounds
+// Outputs      : the size
+
+static int32_t sample_dist(WlgenDist* dist, int32_t lo, int32_t hi)
+{
+    double v;
+
+    switch (dist->type) {
+    case WLGEN_DIST_FIXED:
+        v = dist->a;
+        break;
+    case WLGEN_DIST_UNIFORM:
+        v = dist->a + wlgen_uniform() * (dist->b - dist->a + 1);
+        break;
+    default:
+        v = -dist->a * log(1.0 - wlgen_uniform());
+        break;
+    }
+    if (v < lo) {
+        v = lo;
+    }
+    if (v > hi) {
+        v = hi;
+    }
+    return ((int32_t)v);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : pick_offset
+// Description  : Pick the offset of an access of "len" bytes in a file
+//                according to the pattern.  Zipf and hotspot rank the frames
+//                of the file, frame 0 being the hottest.
+//
+// Inputs       : file - the file being accessed (len <= size)
+//                pat - the access pattern
+//                len - the length of the access
+// Outputs      : the offset
+
+static int32_t pick_offset(WlgenFile* file, WlgenPattern* pat, int32_t len)
+{
+    // Local variables
+    int32_t span = file->size - len, off;
+    uint32_t nslots, slot, lo, hi, mid;
+    double u, sum;
+
+    switch (pat->type) {
+    case WLGEN_PAT_SEQ:
+        if (file->cursor > span) {
+            file->cursor = 0;
+        }
+        off = file->cursor;
+        file->cursor += len;
+        return (off);
+
+    case WLGEN_PAT_UNIFORM:
+        return ((int32_t)(wlgen_uniform() * (span + 1)));
+
+    case WLGEN_PAT_ZIPF:
+        // Rebuild the table when the file has grown
+        nslots = span / BLOCK_FRAME_SIZE + 1;
+        if (nslots != file->nslots) {
+            free(file->cdf);
+            file->cdf = malloc(sizeof(double) * nslots);
+            for (sum = 0, slot = 0; slot < nslots; slot++) {
+                sum += 1.0 / pow(slot + 1, pat->theta);
+                file->cdf[slot] = sum;
+            }
+            file->nslots = nslots;
+        }
+        u = wlgen_uniform() * file->cdf[nslots - 1];
+        for (lo = 0, hi = nslots - 1; lo < hi;) {
+            mid = (lo + hi) / 2;
+            if (file->cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        slot = lo;
+        break;
+
+    default:
+        nslots = span / BLOCK_FRAME_SIZE + 1;
+        hi = (uint32_t)(nslots * pat->hotfrac);
+        if (hi == 0) {
+            hi = 1;
+        }
+        if ((wlgen_uniform() < pat->hotprob) || (hi >= nslots)) {
+            slot = wlgen_uniform() * hi;
+        } else {
+            slot = hi + wlgen_uniform() * (nslots - hi);
+        }
+        break;
+    }
+
+    // Pick a spot within the chosen frame
+    off = slot * BLOCK_FRAME_SIZE + (int32_t)(wlgen_uniform() * BLOCK_FRAME_SIZE);
+    return ((off > span) ? span : off);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : emit_write
+// Description  : Generate a payload, apply it to the expected contents and
+//                write a WRITE (at the current position) or WRITEAT line.
+//                Payloads too long for a line are written as @pattern.
+//
+// Inputs       : file - the file being written
+//                command - BLOCK_WL_WRITE or BLOCK_WL_WRITEAT
+//                off - the offset written (the current position for WRITE)
+//                len - the number of bytes
+// Outputs      : none
+
+static void emit_write(WlgenFile* file, int command, int32_t off, int32_t len)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    int32_t i, end;
+    uint64_t seed;
+
+    if (len > WLGEN_MAX_INLINE) {
+        seed = wlgen_next();
+        fill_block_pattern(&file->data[off], len, seed);
+        fprintf(wlgen_out, "%s %s %d %d :@pattern(%" PRIu64 ")\n", file->name, block_workload_command_name(command),
+            len, (command == BLOCK_WL_WRITEAT) ? off : 0, seed);
+    } else {
+        for (i = 0; i < len; i++) {
+            file->data[off + i] = alphabet[wlgen_next() % (sizeof(alphabet) - 1)];
+        }
+        fprintf(wlgen_out, "%s %s %d %d :%.*s\n", file->name, block_workload_command_name(command),
+            len, (command == BLOCK_WL_WRITEAT) ? off : 0, len, &file->data[off]);
+    }
+
+    // Track the position, size and frames used on the device
+    end = off + len;
+    if (end > file->size) {
+        wlgen_frames += (end + BLOCK_FRAME_SIZE - 1) / BLOCK_FRAME_SIZE
+            - (file->size + BLOCK_FRAME_SIZE - 1) / BLOCK_FRAME_SIZE;
+        file->size = end;
+    }
+    file->pos = end;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : emit_seek
+// Description  : Write a SEEK line, unless we are already there
+//
+// Inputs       : file - the file
+//                off - the offset to seek to
+// Outputs      : none
+
+static void emit_seek(WlgenFile* file, int32_t off)
+{
+    if (file->pos != off) {
+        fprintf(wlgen_out, "%s SEEK 0 %d :\n", file->name, off);
+        file->pos = off;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_expected
+// Description  : Write the expected contents of a file for validation
+//
+// Inputs       : dir - the directory to write into
+//                file - the file
+// Outputs      : 0 if successful, -1 if failure
+
+static int write_expected(const char* dir, WlgenFile* file)
+{
+    char path[BLOCK_MAX_PATH_LENGTH * 2];
+    FILE* fh;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file->name);
+    if (((fh = fopen(path, "w")) == NULL) || (fwrite(file->data, 1, file->size, fh) != file->size)) {
+        fprintf(stderr, "Failure writing expected file [%s], error: %s.\n", path, strerror(errno));
+        if (fh != NULL) {
+            fclose(fh);
+        }
+        return (-1);
+    }
+    fclose(fh);
+    return (0);
+}
@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_workload.c
+//  Description    : This is the implementation of the workload loader for the
+//                   BLOCK simulator.  Lines have the form:
+//
+//                      <file> <command> <len> <off> :<payload>
+//
+//                   Payloads too large for a line can be given instead as
+//                   :@pattern(<seed>), generated bytes, or :@file(<path>[,<off>]),
+//                   bytes from another file (relative to the workload's
+//                   directory).
+//
+//  Author         : Chloe Gregory
+//
+
+// Include Files
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Project Includes
+#include <block_workload.h>
+#include <cmpsc311_log.h>
+
+// The spelling of the commands in the workload file
+static const char* block_workload_commands[BLOCK_WL_MAXVAL] = {
+    "WRITE", "WRITEAT", "SEEK", "READ"
+};
+
+//
+// Functional Prototypes
+
+static int parse_workload_line(BlockWorkload* wl, const char* dir, char* line, uint32_t linecount);
+static char* load_payload(const char* dir, const char* spec, int32_t len, uint32_t linecount);
+static int find_workload_file(BlockWorkload* wl, const char* fname);
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : load_block_workload
+// Description  : Read and parse a workload file into memory
+//
+// Inputs       : wload - the name of the workload file
+//                wl - the workload structure to fill in
+// Outputs      : 0 if successful, -1 if failure
+
+int load_block_workload(const char* wload, BlockWorkload* wl)
+{
+    // Local variables
+    char line[BLOCK_WORKLOAD_MAX_LINE], path[BLOCK_WORKLOAD_MAX_LINE], *dir;
+    FILE* fhandle;
+    uint32_t linecount;
+
+    // Setup the workload structure
+    memset(wl, 0x0, sizeof(BlockWorkload));
+
+    // Open the workload file
+    if ((fhandle = fopen(wload, "r")) == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "Failure opening the workload file [%s], error: %s.\n",
+            wload, strerror(errno));
+        return (-1);
+    }
+
+    // Walk the lines, parsing each one (payload files are found next to the workload)
+    strncpy(path, wload, sizeof(path) - 1);
+    path[sizeof(path) - 1] = 0x0;
+    dir = dirname(path);
+    wl->dir = strdup(dir);
+    linecount = 0;
+    while (fgets(line, BLOCK_WORKLOAD_MAX_LINE, fhandle) != NULL) {
+        linecount++;
+        if (parse_workload_line(wl, dir, line, linecount) != 0) {
+            fclose(fhandle);
+            free_block_workload(wl);
+            return (-1);
+        }
+    }
+
+    // Close the file and return successfully
+    fclose(fhandle);
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : free_block_workload
+// Description  : Release the memory held by a loaded workload
+//
+// Inputs       : wl - the workload to free
+// Outputs      : none
+
+void free_block_workload(BlockWorkload* wl)
+{
+    uint32_t i;
+
+    for (i = 0; i < wl->nops; i++) {
+        free(wl->ops[i].data);
+    }
+    for (i = 0; i < wl->nfiles; i++) {
+        free(wl->files[i]);
+    }
+    free(wl->ops);
+    free(wl->dir);
+    memset(wl, 0x0, sizeof(BlockWorkload));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : block_workload_command_name
+// Description  : Return the workload file spelling of a command
+//
+// Inputs       : command - the BlockWorkloadCommand
+// Outputs      : the command name
+
+const char* block_workload_command_name(int command)
+{
+    if ((command < 0) || (command >= BLOCK_WL_MAXVAL)) {
+        return ("UNKNOWN");
+    }
+    return (block_workload_commands[command]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fill_block_pattern
+// Description  : Fill a buffer with the bytes of an @pattern(seed) payload.
+//                Each 8 byte word is a hash of the seed and its position, so
+//                misplaced data never matches by accident.
+//
+// Inputs       : buf - the buffer to fill
+//                len - the number of bytes
+//                seed - the pattern seed
+// Outputs      : none
+
+void fill_block_pattern(char* buf, int32_t len, uint64_t seed)
+{
+    uint64_t z, word;
+    int32_t i;
+
+    for (i = 0, word = 0; i < len; word++) {
+
+        // splitmix64 of the seed and word number
+        z = seed + (word + 1) * 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        if (len - i >= 8) {
+            memcpy(buf + i, &z, 8);
+            i += 8;
+        } else {
+            for (; i < len; z >>= 8) {
+                buf[i++] = (char)z;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_workload_line
+// Description  : Parse a single workload line and append it to the list
+//
+// Inputs       : wl - the workload being built
+//                dir - the directory holding the workload file
+//                line - the text of the line
+//                linecount - the line number (for errors)
+// Outputs      : 0 if successful, -1 if failure
+
+static int parse_workload_line(BlockWorkload* wl, const char* dir, char* line, uint32_t linecount)
+{
+    // Local variables
+    char fname[128], command[128], *sep, *text;
+    int32_t len, off, fields;
+    BlockWorkloadOp* op;
+    int i;
+
+    // Parse out the string
+    fields = sscanf(line, "%127s %127s %d %d", fname, command, &len, &off);
+    sep = strchr(line, ':');
+    if ((fields != 4) || (sep == NULL)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK un-parsable workload string, aborting [%s], line %d",
+            line, linecount);
+        return (-1);
+    }
+
+    // Grow the operation list as needed
+    if (wl->nops == wl->maxops) {
+        wl->maxops = (wl->maxops == 0) ? 1024 : wl->maxops * 2;
+        if ((op = realloc(wl->ops, sizeof(BlockWorkloadOp) * wl->maxops)) == NULL) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK workload allocation failed, line %d", linecount);
+            return (-1);
+        }
+        wl->ops = op;
+    }
+    op = &wl->ops[wl->nops];
+    memset(op, 0x0, sizeof(BlockWorkloadOp));
+    op->len = len;
+    op->off = off;
+    op->line = linecount;
+
+    // Figure out which command this is (WRITEAT must be checked before WRITE)
+    if (strncmp(command, "WRITEAT", 7) == 0) {
+        op->command = BLOCK_WL_WRITEAT;
+    } else if (strncmp(command, "WRITE", 5) == 0) {
+        op->command = BLOCK_WL_WRITE;
+    } else if (strncmp(command, "SEEK", 4) == 0) {
+        op->command = BLOCK_WL_SEEK;
+    } else if (strncmp(command, "READ", 4) == 0) {
+        op->command = BLOCK_WL_READ;
+    } else {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK_SIM : Failed, unknown command [%s], line %d", command, linecount);
+        return (-1);
+    }
+
+    // Generate or load the described payloads
+    if (((op->command == BLOCK_WL_WRITE) || (op->command == BLOCK_WL_WRITEAT)) && (sep[1] == '@')) {
+        if ((op->data = load_payload(dir, sep + 1, len, linecount)) == NULL) {
+            return (-1);
+        }
+
+    // Pull out the payload for the writes, terminate the lines
+    } else if ((op->command == BLOCK_WL_WRITE) || (op->command == BLOCK_WL_WRITEAT)) {
+        CMPSC_ASSERT1(len < BLOCK_WORKLOAD_MAX_LINE, "Simulated workload command text too large [%d]", len);
+        CMPSC_ASSERT2((strlen(sep + 1) >= len), "Workload str [%d<%d]", strlen(sep + 1), len);
+        if ((text = malloc(len + 1)) == NULL) {
+            logMessage(LOG_ERROR_LEVEL, "BLOCK workload allocation failed, line %d", linecount);
+            return (-1);
+        }
+        strncpy(text, sep + 1, len);
+        text[len] = 0x0;
+        for (i = 0; i < len; i++) {
+            if (text[i] == '^') {
+                text[i] = '\n';
+            }
+        }
+        op->data = text;
+    }
+
+    // Find or add the file
+    if ((i = find_workload_file(wl, fname)) == -1) {
+        return (-1);
+    }
+    op->file = i;
+    if (len > wl->maxlen) {
+        wl->maxlen = len;
+    }
+    wl->nops++;
+    return (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : find_workload_file
+// Description  : Find the index of a file in the workload table, adding it
+//                if it has not been seen before
+//
+// Inputs       : wl - the workload being built
+//                fname - the name of the file
+// Outputs      : index of the file if successful, -1 if failure
+
+static int find_workload_file(BlockWorkload* wl, const char* fname)
+{
+    int i;
+
+    for (i = 0; i < wl->nfiles; i++) {
+        if (strcmp(wl->files[i], fname) == 0) {
+            return (i);
+        }
+    }
+    if (wl->nfiles >= BLOCK_WORKLOAD_MAX_FILES) {
+        logMessage(LOG_ERROR_LEVEL, "Too many open files on BLOCK sim [%d]", wl->nfiles);
+        return (-1);
+    }
+    wl->files[wl->nfiles] = strdup(fname);
+    return (wl->nfiles++);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : load_payload
+// Description  : Build the payload of a write given as :@pattern(<seed>) or
+//                :@file(<path>[,<off>])
+//
+// Inputs       : dir - the directory holding the workload file
+//                spec - the payload text after the ':'
+//                len - the length of the write
+//                linecount - the line number (for errors)
+// Outputs      : the payload if successful, NULL if failure
+
+static char* load_payload(const char* dir, const char* spec, int32_t len, uint32_t linecount)
+{
+    // Local variables
+    char name[BLOCK_WORKLOAD_MAX_LINE], path[BLOCK_WORKLOAD_MAX_LINE * 2], *data;
+    unsigned long long seed;
+    long off = 0;
+    FILE* fh;
+    int n;
+
+    if ((len < 0) || (len > BLOCK_WORKLOAD_MAX_IO)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK workload payload length %d out of range, line %d", len, linecount);
+        return (NULL);
+    }
+    if ((data = malloc(len + 1)) == NULL) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK workload allocation failed, line %d", linecount);
+        return (NULL);
+    }
+    data[len] = 0x0;
+
+    // Generated bytes
+    if (sscanf(spec, "@pattern(%llu)", &seed) == 1) {
+        fill_block_pattern(data, len, seed);
+        return (data);
+    }
+
+    // Bytes from a file, at an offset
+    n = sscanf(spec, "@file(%1023[^,)],%ld)", name, &off);
+    if ((n < 1) || (off < 0)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK bad workload payload [%s], line %d", spec, linecount);
+        free(data);
+        return (NULL);
+    }
+    if (name[0] == '/') {
+        snprintf(path, sizeof(path), "%s", name);
+    } else {
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+    }
+    if (((fh = fopen(path, "r")) == NULL) || (fseek(fh, off, SEEK_SET) != 0)
+        || (fread(data, 1, len, fh) != len)) {
+        logMessage(LOG_ERROR_LEVEL, "BLOCK failed reading %d bytes at %ld of payload file [%s], line %d",
+            len, off, path, linecount);
+        if (fh != NULL) {
+            fclose(fh);
+        }
+        free(data);
+        return (NULL);
+    }
+    fclose(fh);
+    return (data);
+}
@@ -0,0 +1,66 @@
+#ifndef BLOCK_WORKLOAD_INCLUDED
+#define BLOCK_WORKLOAD_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : block_workload.h
+//  Description    : This is the interface for loading the BLOCK simulator
+//                   workload files into an in-memory list of operations.
+//
+//  Author         : Chloe Gregory
+//
+
+// Include files
+#include <stdint.h>
+
+// Defines
+#define BLOCK_WORKLOAD_MAX_FILES 128 // Maximum number of distinct files
+#define BLOCK_WORKLOAD_MAX_LINE 1024 // Maximum length of a workload line
+#define BLOCK_WORKLOAD_MAX_IO (16 * 1024 * 1024) // Largest @pattern or @file payload
+
+// The commands that can appear in a workload
+typedef enum {
+    BLOCK_WL_WRITE = 0, // Write at the current position
+    BLOCK_WL_WRITEAT = 1, // Seek then write
+    BLOCK_WL_SEEK = 2, // Seek to a position
+    BLOCK_WL_READ = 3, // Read from the current position
+    BLOCK_WL_MAXVAL = 4, // Maximum command value
+} BlockWorkloadCommand;
+
+// A single parsed workload line
+typedef struct {
+    uint16_t file; // Index into the workload file table
+    uint16_t command; // The BlockWorkloadCommand to run
+    int32_t len; // Length of the operation
+    int32_t off; // Offset of the operation
+    char* data; // Payload for the write commands (NULL otherwise)
+    uint32_t line; // Line number in the workload file
+} BlockWorkloadOp;
+
+// The whole workload, in file order
+typedef struct {
+    char* dir; // Directory holding the workload file (and its expected files)
+    char* files[BLOCK_WORKLOAD_MAX_FILES]; // Names of the files, in first-use order
+    int nfiles; // Number of files used
+    BlockWorkloadOp* ops; // The operations
+    uint32_t nops; // Number of operations
+    uint32_t maxops; // Allocated size of ops
+    int32_t maxlen; // Largest operation length
+} BlockWorkload;
+
+//
+// Interface functions
+
+int load_block_workload(const char* wload, BlockWorkload* wl);
+// Read and parse a workload file into memory
+
+void free_block_workload(BlockWorkload* wl);
+// Release the memory held by a loaded workload
+
+const char* block_workload_command_name(int command);
+// Return the workload file spelling of a command
+
+void fill_block_pattern(char* buf, int32_t len, uint64_t seed);
+// Fill a buffer with the bytes of an @pattern(seed) payload
+
+#endif